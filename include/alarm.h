@@ -4,6 +4,20 @@
 #include "Arduino.h"
 #include "settings.h"
 
+#define ALARM_PREWARM_GRACE_MS 60000    // Drop a pre-warmed station if its alarm doesn't sound
+#define ALARM_AUDIBLE_TIMEOUT_MS 60000  // Give up measuring the alarm start after this
+#define ALARM_FALLBACK_DELAY_MS 10000   // No programme from the station this long = local alarm tone
+
+// Scheduled time to first audible output, per alarm
+struct AlarmStartStats {
+  uint32_t alarms;
+  uint32_t prewarmed;       // Alarms whose station was connected ahead of time
+  uint32_t silent;          // Not audible within ALARM_AUDIBLE_TIMEOUT_MS
+  long lastLatencyMs;       // First audible minus scheduled time (negative = early)
+  bool lastPrewarmed;
+  long maxLatencyMs;
+};
+
 // Alarm system functions
 void initializeAlarms();
 void checkAlarms();
@@ -14,9 +28,12 @@ int getSnoozingAlarmIndex();
 bool isAlarmTime(const Alarm& alarm);
 void startAlarm(int alarmIndex);
 void updateAlarmFade();
+bool alarmPrewarmActive();
+void getAlarmStartStats(AlarmStartStats& stats);
 
 // Stream connection helper (defined in main.cpp)
 void connectToStream(int streamIndex);
+void stopStream();
 
 // Alarm system variables
 extern bool alarmSystemActive;
@@ -0,0 +1,21 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include "Arduino.h"
+
+// Counts heap allocations made by one task between start and stop, e.g. while
+// a display frame is rendered. Only built with -DALLOC_COUNTER (the
+// esp32-s3-devkitc-1-alloccount environment), which also wraps malloc, calloc
+// and realloc at link time; other tasks then only pay a pointer compare.
+// Without it the calls below do nothing and stop returns 0.
+
+#ifdef ALLOC_COUNTER
+// Function declarations
+void allocCounterStart();
+uint32_t allocCounterStop();
+#else
+inline void allocCounterStart() {}
+inline uint32_t allocCounterStop() { return 0; }
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef ASRC_H
+#define ASRC_H
+
+#include "Arduino.h"
+
+// Asynchronous sample-rate converter for decoded PCM. Every station is
+// converted to one fixed output rate, so I2S never has to be re-clocked, and
+// the ratio can be nudged by a few hundred ppm to follow the sender's clock.
+// The interpolator is a Kaiser-windowed sinc stored as a Q15 polyphase table;
+// the output of the two nearest phases is interpolated linearly.
+#define ASRC_OUTPUT_RATE 48000
+#define ASRC_TAPS 32                  // Per phase
+#define ASRC_PHASES 64                // Must be a power of two
+#define ASRC_PHASE_BITS 6             // log2(ASRC_PHASES)
+#define ASRC_COEF_SHIFT 15            // Coefficients are Q15, each phase sums to unity
+#define ASRC_CUTOFF 0.455f            // -6 dB point in cycles per sample at the lower of the two rates
+#define ASRC_KAISER_BETA 8.0f         // About 80 dB stopband, flat to ~16.5 kHz at 44.1 kHz
+#define ASRC_HISTORY_FRAMES 1024      // Input accepted per write, longer blocks are fed in pieces
+#define ASRC_MAX_PPM 500              // Largest ratio correction (under a cent of pitch)
+
+struct Asrc {
+  uint32_t inputRate;
+  uint32_t outputRate;
+  float cutoff;                      // Cutoff the table was designed for
+  int32_t correctionPpm;             // Positive = consume input faster
+  uint64_t step;                     // Input frames per output frame, Q32
+  uint64_t position;                 // First tap's frame in history, Q32
+  uint32_t historyFrames;            // Valid frames in history
+  int16_t coefs[ASRC_PHASES + 1][ASRC_TAPS];
+  int16_t history[(ASRC_HISTORY_FRAMES + ASRC_TAPS) * 2];
+};
+
+// Function declarations
+void asrcInit(Asrc& asrc, uint32_t outputRate);
+void asrcConfigure(Asrc& asrc, uint32_t inputRate);
+void asrcSetCorrection(Asrc& asrc, int32_t ppm);
+uint32_t asrcWrite(Asrc& asrc, const int16_t* in, uint32_t frames);
+uint32_t asrcRead(Asrc& asrc, int16_t* out, uint32_t maxFrames);
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef AUDIO_ENGINE_H
+#define AUDIO_ENGINE_H
+
+#include "Arduino.h"
+#include "tone_control.h"
+#include "fallback_tone.h"
+#include "asrc.h"
+
+// Audio engine task configuration
+#define AUDIO_TASK_STACK_SIZE 8192
+#define AUDIO_TASK_PRIORITY 3        // Above loop() (priority 1) so slow UI work can't starve the decoder
+#define AUDIO_TASK_CORE 1            // WiFi and AsyncTCP run on core 0
+#define AUDIO_COMMAND_QUEUE_LENGTH 8
+#define AUDIO_EVENT_QUEUE_LENGTH 8
+#define AUDIO_LOOP_DEADLINE_US 10000 // audio.loop() must be serviced at least every 10ms
+#define AUDIO_AUDIBLE_THRESHOLD 64    // PCM level that counts as the first audible sample
+#define AUDIO_LIBRARY_VOLUME 21      // Library volume stays at its top (unity) step; gain is applied by gain_ramp
+#define AUDIO_DEFAULT_SAMPLE_RATE 44100 // Used for ramp lengths before the decoder reports a rate
+#define AUDIO_SILENCE_LEVEL 32        // Block RMS below this (about -60 dBFS) counts as silence
+#define AUDIO_SILENCE_STRIDE 4        // Check every 4th frame, plenty for an energy estimate
+#define AUDIO_I2S_PORT 0              // I2S port the audio library drives (Audio() default)
+#define FALLBACK_BLOCK_FRAMES 128     // Fallback tone is written to I2S in blocks of this size
+#define FALLBACK_DECODER_IDLE_MS 50   // No PCM from the decoder this long = write the tone directly
+#define FALLBACK_CROSSFADE_MS 2000    // Tone to stream hand-over
+#define AUDIO_OUTPUT_BLOCK_FRAMES 256 // Converter output is mixed, gained and written in blocks of this size
+#define AUDIO_I2S_WRITE_TIMEOUT_MS 100
+
+// Clock drift: the converter ratio is steered to keep the relay buffer at its target
+#define ASRC_CONTROL_INTERVAL_MS 1000
+#define ASRC_FILL_SMOOTHING 64        // Averaged over about a minute, so TCP bursts and HLS segments even out
+#define ASRC_KP_PPM_PER_MS 1.0f       // Correction per ms of buffer above (below) target
+#define ASRC_KI_PPM_PER_MS 0.00025f   // Integral gain per control interval, removes the steady-state offset
+
+// Commands accepted by the audio engine task
+enum AudioCommandType {
+  AUDIO_CMD_CONNECT = 0,
+  AUDIO_CMD_STOP = 1,
+  AUDIO_CMD_SET_VOLUME = 2,
+  AUDIO_CMD_PAUSE = 3,
+  AUDIO_CMD_RESUME = 4,
+  AUDIO_CMD_SET_TONE = 5,
+  AUDIO_CMD_SET_GAIN_OFFSET = 6,
+  AUDIO_CMD_ARM_FALLBACK = 7
+};
+
+struct AudioCommand {
+  AudioCommandType type;
+  int value;       // Volume for AUDIO_CMD_SET_VOLUME, 1 = warm (standby) start for AUDIO_CMD_CONNECT,
+                   // 0.1 dB offset for AUDIO_CMD_SET_GAIN_OFFSET, delay in ms for AUDIO_CMD_ARM_FALLBACK
+  unsigned long rampMs; // Gain ramp length for AUDIO_CMD_SET_VOLUME and AUDIO_CMD_SET_GAIN_OFFSET
+  unsigned long requestTime; // millis() when the command was issued
+  int8_t toneGainDb[TONE_BANDS]; // Band gains for AUDIO_CMD_SET_TONE
+  char url[256];   // Stream URL for AUDIO_CMD_CONNECT (same size as RadioStream url)
+};
+
+// Events posted by the audio engine task for the main loop
+enum AudioEventType {
+  AUDIO_EVENT_STATION = 0,
+  AUDIO_EVENT_TITLE = 1
+};
+
+struct AudioEvent {
+  AudioEventType type;
+  char text[128];
+};
+
+// Audio engine counters
+struct AudioEngineStats {
+  unsigned long loopCount;          // audio.loop() calls
+  unsigned long deadlineMisses;     // Times audio.loop() was not serviced within AUDIO_LOOP_DEADLINE_US
+  unsigned long maxLoopGapUs;       // Longest time between two audio.loop() calls
+  unsigned long maxLoopDurationUs;  // Longest single audio.loop() call
+  unsigned long commandsProcessed;
+  unsigned long commandsDropped;    // Commands rejected because the queue was full
+  unsigned long eventsDropped;      // Events lost because the main loop did not drain them
+  unsigned int stackHighWater;      // Minimum free stack seen (bytes)
+
+  // Station start latency: connect request (button press) to first audible sample
+  unsigned long lastFirstFrameMs;   // Connect request to the first decoded PCM block
+  unsigned long lastStartMs;
+  bool lastStartWarm;
+  unsigned long warmStarts;         // Started from a standby connection
+  unsigned long warmStartTotalMs;
+  unsigned long coldStarts;
+  unsigned long coldStartTotalMs;
+
+  // Fallback alarm tone
+  unsigned long fallbackStarts;     // Times the stream had no audio and the tone took over
+  unsigned long fallbackHandovers;  // Times the stream came up and the tone faded out
+  bool fallbackActive;
+
+  // Sample-rate converter
+  uint32_t asrcInputRate;           // Decoder rate being converted to ASRC_OUTPUT_RATE
+  int32_t asrcCorrectionPpm;
+  unsigned long asrcRateChanges;    // Station rate changes absorbed without re-clocking I2S
+  unsigned long asrcI2sReclocks;    // Times the library re-clocked I2S and it was set back
+  unsigned long asrcDroppedFrames;  // Output I2S did not take within AUDIO_I2S_WRITE_TIMEOUT_MS
+};
+
+// Function declarations
+void initAudioEngine();
+bool audioEngineConnect(const char* url, bool warmStart = false);
+void audioEngineStop();
+void audioEngineSetVolume(int vol);
+void audioEngineFadeVolume(int vol, unsigned long durationMs);
+void audioEnginePause();
+void audioEngineResume();
+void audioEngineSetTone(const int8_t* gainDb);
+void audioEngineSetGainOffset(int offsetDb10, unsigned long rampMs);
+void audioEngineArmFallback(unsigned long delayMs);
+bool audioEngineIsRunning();
+void audioEngineWatchAudible();
+unsigned long audioEngineAudibleAt();
+uint32_t audioEngineFramesOut();
+uint32_t audioEngineInputFill();
+uint32_t audioEngineInputSize();
+uint32_t audioEngineSilenceMs();
+void postAudioEvent(AudioEventType type, const char* text);
+bool pollAudioEvent(AudioEvent& event);
+void getAudioEngineStats(AudioEngineStats& stats);
+void printAudioEngineStats();
+void updateAsrcControl();
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef AUDIO_TELEMETRY_H
+#define AUDIO_TELEMETRY_H
+
+#include "Arduino.h"
+
+// Audio pipeline telemetry in fixed-size counters. The audio task records
+// decode times, output gaps and decoder errors; loop() samples buffer levels,
+// received bytes and its own loop time once per second.
+#define TELEMETRY_DECODE_BUCKETS 12       // Powers of two from <128us up to >=131ms
+#define TELEMETRY_DECODE_FIRST_SHIFT 7    // First bucket: below 2^7 us
+#define TELEMETRY_FILL_BUCKETS 10         // Decoder input buffer fill in 10% steps
+#define TELEMETRY_HISTORY_SECONDS 60      // Per-second samples kept
+#define TELEMETRY_I2S_DMA_FRAMES 8192     // DMA queue of the audio library (16 x 512 frames)
+
+// One second of pipeline state, together with what loop() was doing
+struct TelemetrySample {
+  uint32_t time;            // millis() at the end of the second
+  uint8_t inputFillPct;     // Decoder input buffer
+  uint16_t relayFillMs;     // PSRAM relay buffer (0 when not relayed)
+  uint16_t kbps;            // Audio received from the station
+  uint16_t maxLoopMs;       // Longest loop() iteration
+  uint8_t underruns;
+  uint8_t decodeErrors;
+};
+
+struct AudioTelemetry {
+  uint32_t decodeHistogram[TELEMETRY_DECODE_BUCKETS];
+  uint32_t decodeMaxUs;
+  uint32_t fillHistogram[TELEMETRY_FILL_BUCKETS];
+  uint32_t outputUnderruns;   // PCM gaps longer than the I2S DMA queue
+  uint32_t decodeErrors;
+  uint32_t bytesPerSecond;    // Last full second
+  uint32_t maxLoopMs;         // Longest loop() iteration seen
+  int historyCount;
+  TelemetrySample history[TELEMETRY_HISTORY_SECONDS]; // Oldest first
+};
+
+// Function declarations
+void telemetryLoopStarted();
+void telemetryBlockDecoded(uint32_t sampleRate);
+void telemetryDecoderInfo(const char* info);
+void telemetryOutputRestarted();
+void updateAudioTelemetry();
+void getAudioTelemetry(AudioTelemetry& telemetry);
+void resetAudioTelemetry();
+void printAudioTelemetry();
+
+#endif
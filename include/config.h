@@ -27,10 +27,11 @@
 #define VOLUME_DISPLAY_TIMEOUT 5000
 #define BACKLIGHT_TIMEOUT 5000
 #define LONG_PRESS_DURATION 2000
+#define HOLD_PRESS_DURATION 800    // Released after this, before LONG_PRESS_DURATION = hold (pause / back to live)
 
 // EEPROM settings
-#define EEPROM_SIZE 512
-#define SETTINGS_VERSION 6
+#define EEPROM_SIZE 1024
+#define SETTINGS_VERSION 14
 
 // NTP settings
 #define NTP_SERVER "pool.ntp.org"
@@ -2,15 +2,14 @@
 #define DISPLAY_H
 
 #include "Arduino.h"
-#include "LiquidCrystal_I2C.h"
+#include "lcd_framebuffer.h"
+#include "lcd_line.h"
+#include "display_render.h"
 
 // Display-related variables
-extern LiquidCrystal_I2C lcd;
+extern LcdFramebuffer lcd;
 extern unsigned long lastLcdUpdate;
-extern bool isStreaming;
-extern String currentStreamName;
 extern bool forceImmediateLcdUpdate;
-extern bool showVolumeDisplay;
 extern unsigned long lastVolumeChange;
 extern unsigned long lastActivity;
 extern bool displayJustWokenUp;
@@ -26,30 +25,30 @@ extern bool editingTime;
 extern bool editingHours;
 extern bool editingMinutes;
 
-// Now Playing Info variables
-extern String currentTrackInfo;
-extern bool hasTrackInfo;
-extern bool showTrackInfo;
-extern unsigned long lastTrackToggle;
-extern int trackScrollPosition;
-extern unsigned long lastTrackScroll;
-
 // Temporary message display variables
 extern bool showTemporaryMessage;
-extern String temporaryMessage;
 extern unsigned long temporaryMessageStart;
 extern unsigned long temporaryMessageDuration;
 
-// Custom characters
-extern byte backspaceSymbol[8];
+// Heap use of the regular screens (updateLCD() outside WiFi setup)
+struct DisplayFrameStats {
+  uint32_t frames;                 // Regular updates rendered
+  uint32_t allocations;            // Since boot, the goal is none
+  uint32_t framesWithAllocations;
+  uint32_t maxAllocations;         // In one updateLCD() call
+  uint32_t lastAllocations;        // Last rendered frame
+  bool counting;                   // Built with ALLOC_COUNTER, otherwise the counts stay 0
+};
 
 // Function declarations
 void scanI2C();
 void setupLCD();
 void updateLCD();
-void updateLCDLine(int line, String content, bool center = false);
+void updateLCDLine(int line, const LcdLine& content, bool center = false);
+void updateLCDLine(int line, const char* content, bool center = false);
 void displayCurrentMenuOptimized();
 void showTemporaryLCDMessage(String message, unsigned long duration = 3000);
-bool hasEnabledAlarms();
+void printLcdStats();
+void getDisplayFrameStats(DisplayFrameStats& stats);
 
 #endif
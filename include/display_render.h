@@ -0,0 +1,77 @@
+#ifndef DISPLAY_RENDER_H
+#define DISPLAY_RENDER_H
+
+#include "Arduino.h"
+#include "config.h"
+#include "lcd_line.h"
+#include "lcd_glyphs.h"
+#include "level_meter.h"
+#include <time.h>
+
+// Composes the rows of the regular screens from the radio's state. Nothing here
+// touches the LCD, the network or the clock: display.cpp takes those readings,
+// calls these functions and writes the rows out. The same code is built on the
+// host (pio test -e native-alloccount) to check that no screen allocates.
+
+// Custom characters, given a CGRAM slot only while a frame shows them (lcd_glyphs.h)
+#define GLYPH_BACKSPACE (LCD_GLYPH_FIRST + 0)
+#define GLYPH_DEGREE (LCD_GLYPH_FIRST + 1)
+#define GLYPH_SUN (LCD_GLYPH_FIRST + 2)
+#define GLYPH_CLOUD (LCD_GLYPH_FIRST + 3)
+#define GLYPH_CLOCK (LCD_GLYPH_FIRST + 4)
+#define GLYPH_UP_ARROW (LCD_GLYPH_FIRST + 5)
+#define GLYPH_METER_HALF (LCD_GLYPH_FIRST + 6)
+#define GLYPH_METER_PEAK (LCD_GLYPH_FIRST + 7)
+#define GLYPH_RAIN (LCD_GLYPH_FIRST + 8)
+#define GLYPH_SNOW (LCD_GLYPH_FIRST + 9)
+#define GLYPH_THUNDER (LCD_GLYPH_FIRST + 10)
+#define GLYPH_MIST (LCD_GLYPH_FIRST + 11)
+
+// Level meter bar characters (0xFF is the ROM full block)
+#define METER_CHAR_HALF GLYPH_METER_HALF
+#define METER_CHAR_PEAK GLYPH_METER_PEAK
+#define METER_CHAR_FULL 0xFF
+
+// State the screens show, defined in display.cpp
+extern bool isStreaming;
+extern String currentStreamName;
+extern bool showVolumeDisplay;
+extern String currentTrackInfo;
+extern bool hasTrackInfo;
+extern bool showTrackInfo;
+extern unsigned long lastTrackToggle;
+extern int trackScrollPosition;
+extern unsigned long lastTrackScroll;
+extern String temporaryMessage;
+
+// Readings from the clock, WiFi and the relay, taken by display.cpp for each frame
+struct DisplayInputs {
+  struct tm time;                  // Local time, only valid when timeValid
+  bool timeValid;
+  bool wifiConnected;
+  uint8_t ip[4];
+  bool behindLive;                 // Playing time-shifted audio
+  uint32_t behindLiveMs;
+};
+
+// Both rows of one frame; short rows are padded with spaces when written
+struct DisplayRows {
+  LcdLine line[LCD_ROWS];
+  bool center[LCD_ROWS];
+};
+
+enum DisplayRowsContent {
+  DISPLAY_ROWS_NONE = 0,           // Nothing to draw yet (clock not set)
+  DISPLAY_ROWS_TEXT = 1,           // Both rows
+  DISPLAY_ROWS_LEVEL_METER = 2     // Row 0 only, row 1 is the level meter bar
+};
+
+// Function declarations
+bool hasEnabledAlarms();
+void composeTemporaryMessage(DisplayRows& rows);
+void composeVolumeScreen(DisplayRows& rows);
+DisplayRowsContent composeMainScreen(DisplayRows& rows, const DisplayInputs& inputs);
+void composeMenuScreen(DisplayRows& rows, const DisplayInputs& inputs);
+void composeLevelMeterRow(const LevelMeterLevels& levels, uint8_t cells[LCD_COLS]);
+
+#endif
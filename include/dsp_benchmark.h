@@ -0,0 +1,35 @@
+#ifndef DSP_BENCHMARK_H
+#define DSP_BENCHMARK_H
+
+#include "Arduino.h"
+
+// On-device micro-benchmarks for the PCM processing kernels, in CPU cycles
+// per sample. Requested from the web interface (/dsp-benchmark), they run in
+// a one-shot low-priority task and the last results are kept for the next
+// request. The converter's THD+N sweep is a host test (pio test -e native).
+#define DSP_BENCHMARK_FRAMES 1152     // One MP3 frame of stereo PCM
+#define DSP_BENCHMARK_RUNS 16         // Best of N, to hide interrupts and cache misses
+#define DSP_BENCHMARK_MAX_RESULTS 8
+#define DSP_BENCHMARK_PPM 200         // ASRC correction while timed, as when tracking drift
+#define DSP_BENCHMARK_TASK_STACK 4096
+#define DSP_BENCHMARK_TASK_PRIORITY 1 // Below the relay tasks, streaming keeps the CPU
+#define DSP_BENCHMARK_TASK_CORE 0     // Away from the audio task and loop()
+
+struct DspBenchmarkResult {
+  const char* name;
+  float cyclesPerSample;
+};
+
+struct DspBenchmarkReport {
+  bool running;
+  bool valid;                        // Results below are from a finished run
+  unsigned long finishedAt;          // millis() when they were taken
+  int count;
+  DspBenchmarkResult results[DSP_BENCHMARK_MAX_RESULTS];
+};
+
+// Function declarations
+bool startDspBenchmarks();
+void getDspBenchmarks(DspBenchmarkReport& out);
+
+#endif
@@ -11,6 +11,7 @@ extern volatile int encoderCounter;
 // Function declarations
 void IRAM_ATTR handleEncoder();
 bool checkButtonPress();
+bool lastButtonPressWasHold();
 bool checkLongButtonPress();
 
 #endif
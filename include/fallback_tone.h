@@ -0,0 +1,33 @@
+#ifndef FALLBACK_TONE_H
+#define FALLBACK_TONE_H
+
+#include "Arduino.h"
+
+// Locally generated alarm sound for when the station doesn't deliver audio.
+// A beep pattern is read from a step table and synthesised from a sine
+// table with a phase accumulator; all state lives in FallbackTone, so
+// nothing is allocated and it works at any output sample rate.
+#define FALLBACK_TONE_LEVEL 16384         // Peak amplitude before the volume gain (-6 dBFS)
+#define FALLBACK_TONE_EDGE_MS 5           // Attack/release of each beep, avoids clicks
+#define FALLBACK_TONE_SINE_BITS 8         // 256-entry sine table
+
+struct FallbackTone {
+  bool active;
+  uint32_t sampleRate;
+  uint8_t step;            // Current entry of the pattern table
+  uint32_t stepFrames;     // Frames left in the current entry
+  uint32_t phase;          // Sine phase, full circle = 2^32
+  uint32_t phaseStep;
+  int32_t envelope;        // Beep envelope, Q15
+  int32_t envelopeStep;
+  int32_t fade;            // Crossfade weight of the tone, Q23 (1 = tone only)
+  int32_t fadeStep;        // 0 while not fading out
+};
+
+// Function declarations
+void fallbackToneStart(FallbackTone& tone, uint32_t sampleRate);
+void fallbackToneFadeOut(FallbackTone& tone, uint32_t frames);
+void fallbackToneRender(FallbackTone& tone, int16_t* buff, uint32_t frames);
+void fallbackToneMix(FallbackTone& tone, int16_t* buff, uint32_t frames);
+
+#endif
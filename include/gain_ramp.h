@@ -0,0 +1,32 @@
+#ifndef GAIN_RAMP_H
+#define GAIN_RAMP_H
+
+#include "Arduino.h"
+
+// Fixed-point gain stage for decoded PCM. Volume steps (0-80) map to gains
+// through a logarithmic table, and gain changes are interpolated per sample
+// so volume changes and alarm fades don't produce zipper noise.
+#define GAIN_VOLUME_MAX 80
+#define GAIN_RANGE_DB 50              // Volume 1 is 50 dB below volume 80
+#define GAIN_UNITY 32768              // Q15
+#define GAIN_RAMP_MS 30               // Ramp length for ordinary volume changes
+#define GAIN_POSITION_SHIFT 24        // Ramp position is the volume step in Q24
+
+struct GainRamp {
+  int32_t position;   // Current volume step, Q24
+  int32_t target;     // Target volume step, Q24
+  int32_t step;       // Position change per frame, Q24
+  int32_t gain;       // Gain at the current position, Q15
+  int32_t offset;     // Loudness offset in volume steps, Q24 (never mutes, never exceeds unity)
+  int volume;         // Requested volume, without the offset
+};
+
+// Function declarations
+int32_t gainForVolume(int vol);
+void gainRampInit(GainRamp& ramp, int vol);
+void gainRampSetTarget(GainRamp& ramp, int vol, uint32_t frames);
+void gainRampSetOffset(GainRamp& ramp, int offsetDb10, uint32_t frames);
+bool gainRampActive(const GainRamp& ramp);
+void gainRampProcess(GainRamp& ramp, int16_t* buff, uint32_t frames);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef HLS_H
+#define HLS_H
+
+#include "Arduino.h"
+
+// HLS formats for the stream relay: an m3u8 parser that is fed the playlist
+// body as it arrives and keeps the newest segments, and an MPEG-TS demuxer
+// that turns TS segments back into the plain AAC/MP3 elementary stream the
+// decoder plays. Networking and scheduling live in stream_relay.cpp.
+#define HLS_MAX_SEGMENTS 8                // Newest playlist entries kept
+#define HLS_URI_LENGTH 256
+#define HLS_LINE_LENGTH 320
+#define HLS_LIVE_START_SEGMENTS 3         // Live playback starts this far from the end (RFC 8216)
+#define HLS_MAX_VARIANT_BANDWIDTH 192000  // Highest variant picked from a master playlist (bit/s)
+#define TS_PACKET_SIZE 188
+#define TS_PID_NONE 0xFFFF
+
+struct HlsSegment {
+  uint32_t sequence;
+  uint32_t durationMs;
+  bool discontinuity;        // Demuxer restarts at this segment
+  char uri[HLS_URI_LENGTH];  // As written in the playlist, may be relative
+};
+
+struct HlsPlaylist {
+  bool valid;                // Started with #EXTM3U
+  bool master;               // Lists variants instead of segments
+  bool endList;              // VOD or finished event, no refresh needed
+  bool unsupported;          // Encrypted or fMP4 segments
+  uint32_t targetDurationMs;
+  uint32_t mediaSequence;
+
+  // Newest segments (or the first ones from keepFrom), oldest first from segments[first]
+  HlsSegment segments[HLS_MAX_SEGMENTS];
+  int first;
+  int count;
+  bool keepOldest;
+  uint32_t keepFrom;
+
+  // Master playlist: the variant that was picked
+  char variantUri[HLS_URI_LENGTH];
+  uint32_t variantBandwidth;
+
+  // Parser state; after the last line nextSequence is one past the newest segment
+  uint32_t nextSequence;
+  uint32_t pendingDurationMs;
+  bool pendingDiscontinuity;
+  int32_t pendingBandwidth;  // -1 unless the next URI is a variant
+  char line[HLS_LINE_LENGTH];
+  size_t lineLength;
+};
+
+struct TsDemuxer {
+  uint8_t packet[TS_PACKET_SIZE];
+  uint8_t fill;
+  uint16_t pmtPid;
+  uint16_t audioPid;
+  uint8_t streamType;        // PMT stream type of the audio PID
+};
+
+// Function declarations
+void hlsPlaylistBegin(HlsPlaylist& playlist);
+void hlsPlaylistKeepFrom(HlsPlaylist& playlist, uint32_t sequence);
+void hlsPlaylistFeed(HlsPlaylist& playlist, const char* data, size_t len);
+void hlsPlaylistEnd(HlsPlaylist& playlist);
+const HlsSegment* hlsPlaylistSegment(const HlsPlaylist& playlist, int index);
+const HlsSegment* hlsPlaylistFind(const HlsPlaylist& playlist, uint32_t sequence);
+size_t hlsId3TagLength(const uint8_t* data, size_t len);
+
+void tsDemuxReset(TsDemuxer& demux);
+size_t tsDemux(TsDemuxer& demux, const uint8_t* data, size_t len, uint8_t* out);
+const char* tsDemuxContentType(const TsDemuxer& demux);
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef LCD_FRAMEBUFFER_H
+#define LCD_FRAMEBUFFER_H
+
+#include "Arduino.h"
+#include "lcd_pcf8574.h"
+#include "lcd_glyphs.h"
+#include "config.h"
+
+// Shadow framebuffer in front of the I2C LCD. print(), setCursor() and clear()
+// only write cells in RAM; flush() hands a snapshot to a low-priority writer
+// task and returns. The task compares it with what the LCD shows and sends the
+// changed runs, moving the cursor only where a run does not continue from the
+// previous one. Frames are not queued themselves: the queue carries a token,
+// and a frame submitted while one is still waiting replaces it, so the LCD is
+// never more than one frame behind. The task counts the I2C bytes it sends
+// per second, together with what rewriting each changed line in full through
+// LiquidCrystal_I2C (one transaction per expander write) would have sent.
+// Custom characters are logical glyph codes in the framebuffer; flush() maps
+// them to CGRAM slots (see lcd_glyphs.h) and the frame carries the uploads.
+#define LCD_LIBRARY_BYTES_PER_COMMAND 12  // Two nibbles, each written and strobed: 6 transactions of address + data
+#define LCD_LIBRARY_BYTES_PER_EXPANDER 2  // Backlight change: one transaction
+#define LCD_FLUSH_MAX_GAP 1               // Unchanged cells re-sent instead of a cursor move (which costs one command)
+#define LCD_STATS_WINDOW_MS 1000
+#define LCD_TASK_STACK 3072
+#define LCD_TASK_PRIORITY 1               // Below the relay tasks, the bus never holds up streaming
+#define LCD_TASK_CORE 0                   // Away from the audio task and loop()
+#define LCD_QUEUE_LENGTH 8                // Frame token plus backlight commands
+
+// One complete screen, the writer task works out what changed
+struct LcdFrame {
+  uint8_t cells[LCD_ROWS][LCD_COLS];
+  uint8_t cursorCol;
+  uint8_t cursorRow;
+  bool cursorOn;
+  uint8_t uploadCount;                       // CGRAM slots to load before the cells that use them
+  LcdGlyphUpload uploads[LCD_CGRAM_SLOTS];
+};
+
+enum LcdCommandType {
+  LCD_CMD_FRAME = 0,        // Write the pending frame
+  LCD_CMD_BACKLIGHT = 1
+};
+
+struct LcdCommand {
+  uint8_t type;
+  bool on;                  // Backlight
+};
+
+struct LcdStats {
+  uint32_t flushes;                // Frames that sent anything
+  uint32_t cellsWritten;
+  uint32_t cursorMoves;
+  uint32_t i2cBytes;               // Since boot
+  uint32_t bytesPerSecond;         // Last full second
+  uint32_t lineRewriteBytesPerSecond; // Same frames sent as whole changed lines
+  uint32_t peakBytesPerSecond;
+  uint32_t framesSubmitted;        // flush() calls with a changed frame
+  uint32_t framesCoalesced;        // Replaced a frame still waiting for the task
+  uint32_t framesWritten;
+  uint32_t commandsDropped;        // Queue full
+  uint32_t queueDepth;
+  uint32_t maxQueueDepth;
+  uint32_t lastFlushUs;            // Writing one frame to the LCD
+  uint32_t maxFlushUs;
+  uint32_t avgFlushUs;
+  LcdBenchmark benchmark;          // Measured once at boot
+  LcdGlyphStats glyphs;
+};
+
+class LcdFramebuffer : public Print {
+ public:
+  LcdFramebuffer(uint8_t address);
+
+  void init();
+  void clear();
+  void home();
+  void setCursor(uint8_t col, uint8_t row);
+  size_t write(uint8_t value) override;
+  using Print::write;
+  void flush() override;
+
+  // Custom character for a glyph code, loaded into CGRAM while a frame shows it
+  void defineGlyph(uint8_t code, const uint8_t bitmap[8], char fallback);
+
+  // Queued behind the frames already submitted
+  void backlight();
+  void noBacklight();
+
+  // Hardware cursor, placed at the write position when the frame is written
+  void cursor();
+  void noCursor();
+
+  void getStats(LcdStats& stats);
+
+ private:
+  static void writerTask(void* arg);
+  void sendCommand(const LcdCommand& cmd);
+  void runCommand(const LcdCommand& cmd);
+  void writeFrame(const LcdFrame& frame);
+  void writeRuns(const LcdFrame& frame, uint8_t deferredSlots, uint32_t& written, uint32_t& moves);
+  bool cellChanged(const LcdFrame& frame, uint8_t r, uint8_t c, uint8_t deferredSlots);
+  void countBytes(uint32_t lineBytes);
+
+  // Caller side
+  uint8_t cells[LCD_ROWS][LCD_COLS];
+  uint8_t col, row;                    // Write position, col may run past the edge
+  bool cursorWanted;
+  LcdFrame submitted;                  // Last frame handed to the task, before glyph mapping
+  bool submittedValid;
+  LcdGlyphs glyphs;
+
+  // Shared, under the stats lock
+  LcdFrame pending;
+  bool framePending;                   // A frame token is in the queue
+  LcdStats stats;
+  uint64_t totalFlushUs;
+
+  // Writer task side
+  LcdPcf8574 device;
+  QueueHandle_t queue;
+  uint8_t shown[LCD_ROWS][LCD_COLS];   // What the LCD displays
+  int8_t deviceCol, deviceRow;         // LCD address counter, -1 = unknown
+  bool cursorShown;
+  uint32_t countedBytes;               // device.bytesSent() already in the stats
+  uint32_t windowBytes, windowLineBytes;
+  unsigned long windowStart;
+};
+
+#endif
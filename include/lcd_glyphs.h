@@ -0,0 +1,64 @@
+#ifndef LCD_GLYPHS_H
+#define LCD_GLYPHS_H
+
+#include "Arduino.h"
+#include "config.h"
+
+// Custom characters loaded on demand. The HD44780 has only 8 CGRAM slots, so
+// screens write logical glyph codes (LCD_GLYPH_FIRST onwards, blank in the
+// character ROM) and resolve() maps the glyphs a frame shows to slots when the
+// frame is flushed. A glyph already in a slot costs nothing; otherwise its
+// bitmap is uploaded into a free slot or the one whose glyph was shown least
+// recently, never into a slot the same frame uses. Past 8 different glyphs in
+// one frame the rest are shown as their ROM fallback character.
+#define LCD_CGRAM_SLOTS 8
+#define LCD_GLYPH_FIRST 0x10
+#define LCD_GLYPH_COUNT 16                // Codes 0x10-0x1F
+#define LCD_GLYPH_STATS_WINDOW_MS 60000   // Uploads are reported per minute
+#define LCD_SLOT_FREE 0xFF
+
+// One CGRAM write, sent together with the frame that needs it
+struct LcdGlyphUpload {
+  uint8_t slot;
+  uint8_t bitmap[8];
+};
+
+struct LcdGlyphStats {
+  uint32_t uploads;                // Since boot
+  uint32_t uploadsPerMinute;       // Last full minute
+  uint32_t evictions;              // Uploads that replaced another glyph
+  uint32_t fallbacks;              // Glyphs shown as the ROM character, no slot left
+  uint8_t defined;
+  uint8_t resident;                // Slots holding a glyph
+};
+
+class LcdGlyphs {
+ public:
+  LcdGlyphs();
+
+  void define(uint8_t code, const uint8_t bitmap[8], char fallback);
+
+  // Replaces glyph codes in cells with CGRAM slots; returns how many uploads
+  // were added to uploads, which must reach the LCD before these cells
+  uint8_t resolve(uint8_t cells[LCD_ROWS][LCD_COLS], LcdGlyphUpload uploads[LCD_CGRAM_SLOTS]);
+
+  // True when the stats changed since the last call
+  bool takeStats(LcdGlyphStats& out);
+
+ private:
+  uint8_t allocateSlot(uint16_t slotsInFrame);
+
+  uint8_t bitmaps[LCD_GLYPH_COUNT][8];
+  char fallbacks[LCD_GLYPH_COUNT];
+  uint16_t definedMask;
+  uint8_t slotGlyph[LCD_CGRAM_SLOTS];  // Glyph index per slot, LCD_SLOT_FREE if none
+  uint32_t slotUsed[LCD_CGRAM_SLOTS];  // Frame stamp of the last frame showing it
+  uint32_t frameStamp;
+
+  LcdGlyphStats stats;
+  bool statsChanged;
+  uint32_t windowUploads;
+  unsigned long windowStart;
+};
+
+#endif
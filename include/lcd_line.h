@@ -0,0 +1,32 @@
+#ifndef LCD_LINE_H
+#define LCD_LINE_H
+
+#include "Arduino.h"
+#include "config.h"
+
+// Fixed-capacity line composer for the LCD. Lines live on the stack and are
+// built with appends that truncate at the display width, so rendering a frame
+// never touches the heap. The text is not NUL-terminated; the length is kept
+// explicitly. Custom characters are written as logical glyph codes 0x10-0x1F
+// (GLYPH_*), never as raw CGRAM slot numbers; LcdGlyphs::resolve() maps them
+// to slots when the frame is flushed.
+#define LCD_LINE_CAPACITY LCD_COLS
+
+struct LcdLine {
+  uint8_t length;
+  char text[LCD_LINE_CAPACITY];
+};
+
+// Function declarations
+void lineClear(LcdLine& line);
+void lineAppend(LcdLine& line, const char* text);
+void lineAppendN(LcdLine& line, const char* text, size_t length);
+void lineAppendChar(LcdLine& line, char c);
+void lineAppendGlyph(LcdLine& line, uint8_t glyph);
+void lineAppendInt(LcdLine& line, long value, uint8_t minDigits = 1);
+void lineAppendLine(LcdLine& line, const LcdLine& other);
+void linePad(LcdLine& line, uint8_t column);
+void lineRightAlign(LcdLine& line, const LcdLine& right);
+void lineCenter(LcdLine& line);
+
+#endif
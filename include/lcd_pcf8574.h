@@ -0,0 +1,68 @@
+#ifndef LCD_PCF8574_H
+#define LCD_PCF8574_H
+
+#include "Arduino.h"
+
+// HD44780 in 4-bit mode behind a PCF8574 backpack. Each LCD byte becomes two
+// nibbles, each written with E high and then low; instead of one I2C
+// transaction per expander write, the writes are collected and sent as one
+// transaction per LCD_I2C_BATCH_BYTES. The bus runs at LCD_I2C_FAST_HZ when
+// the backpack reads its port back correctly at that speed, otherwise at the
+// standard 100 kHz. At the fast clock idle writes are added so the controller
+// has finished the previous byte before the next nibble is latched.
+#define LCD_I2C_FAST_HZ 400000
+#define LCD_I2C_STANDARD_HZ 100000
+#define LCD_I2C_BATCH_BYTES 128           // Wire transmit buffer
+#define LCD_EXEC_US 50                    // Longest data/command execution (37 us nominal, slow clones)
+#define LCD_CLEAR_US 2000                 // Clear and home
+#define LCD_BENCHMARK_FRAMES 10
+
+// PCF8574 port bits on the common backpack, D4-D7 on P4-P7
+#define LCD_PIN_RS 0x01
+#define LCD_PIN_RW 0x02
+#define LCD_PIN_EN 0x04
+#define LCD_PIN_BACKLIGHT 0x08
+
+struct LcdBenchmark {
+  uint32_t busHz;
+  uint32_t fullScreenUs;          // 32 cells and 2 cursor moves, batched
+  uint32_t libraryFullScreenUs;   // Same, one transaction per expander write at 100 kHz
+};
+
+class LcdPcf8574 {
+ public:
+  LcdPcf8574(uint8_t address);
+
+  bool init();                    // False when the backpack does not answer
+  void clear();
+  void setCursor(uint8_t col, uint8_t row);
+  void write(uint8_t value);
+  void createChar(uint8_t location, const uint8_t charmap[8]);
+  void backlight(bool on);
+  void cursor(bool on);
+  void send();                    // Transmit what is batched
+
+  void benchmark(LcdBenchmark& result);
+  uint32_t busHz() { return clockHz; }
+  uint32_t bytesSent() { return sentBytes; }
+
+ private:
+  void queueByte(uint8_t value, uint8_t mode);
+  void queueExpander(uint8_t pins);
+  void writeExpander(uint8_t pins);
+  void writeLibraryStyle(uint8_t value, uint8_t mode);
+  bool probe(uint32_t hz);
+  uint32_t timeFullScreen(bool libraryStyle);
+
+  uint8_t address;
+  uint8_t backlightPin;
+  uint8_t displayControl;
+  uint8_t mode;                   // RS of the last expander write
+  uint8_t padBytes;               // Idle writes after each LCD byte
+  uint32_t clockHz;
+  uint32_t sentBytes;             // Including address bytes
+  uint8_t batch[LCD_I2C_BATCH_BYTES];
+  uint8_t batchLength;
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef LEVEL_METER_H
+#define LEVEL_METER_H
+
+#include "Arduino.h"
+
+// VU/peak meter on the decoded PCM. The audio task only measures each block
+// (RMS and peak); ballistics run in the display at a fixed frame rate.
+#define LEVEL_METER_FPS 20
+#define LEVEL_METER_FLOOR_DB -48.0f       // Bottom of the bar
+#define LEVEL_METER_RMS_DECAY_DB 1.0f     // Per frame (20 dB/s at 20 fps)
+#define LEVEL_METER_PEAK_DECAY_DB 1.5f    // Per frame once the hold expires
+#define LEVEL_METER_PEAK_HOLD_FRAMES 20   // 1 second
+
+// Meter levels in dBFS, LEVEL_METER_FLOOR_DB when silent
+struct LevelMeterLevels {
+  float rmsDb;
+  float peakDb;
+};
+
+// Function declarations
+void levelMeterSetActive(bool active);
+bool levelMeterIsActive();
+void levelMeterMeasure(const int16_t* buff, uint32_t frames, uint32_t& rms, uint32_t& peak);
+void levelMeterProcess(const int16_t* buff, uint32_t frames);
+void levelMeterFrame(LevelMeterLevels& levels);
+
+#endif
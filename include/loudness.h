@@ -0,0 +1,32 @@
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include "Arduino.h"
+
+// Per-station loudness, learned while listening. The audio task measures the
+// mean square of high-passed mono PCM over 400 ms blocks (a cheap stand-in for
+// K-weighted LUFS); loop() folds the gated blocks into the playing station's
+// running estimate, which is kept in /streams.json. On connect the station is
+// moved towards LOUDNESS_TARGET_DB through the volume gain.
+#define LOUDNESS_BLOCK_MS 400
+#define LOUDNESS_GATE_DB -50.0f           // Quieter blocks (silence, pauses) are ignored
+#define LOUDNESS_TARGET_DB -18.0f
+#define LOUDNESS_MAX_BOOST_DB 6.0f
+#define LOUDNESS_MAX_CUT_DB 12.0f
+#define LOUDNESS_MIN_BLOCKS 25            // 10 s of programme before the estimate is used
+#define LOUDNESS_MAX_BLOCKS 750           // Averaging window grows to 5 minutes, then slides
+#define LOUDNESS_SETTLE_MS 2000           // Ignore blocks right after a station change
+#define LOUDNESS_RAMP_MS 3000             // A first estimate during playback fades in
+#define LOUDNESS_SAVE_INTERVAL_MS 600000  // Write learned estimates at most every 10 minutes
+#define LOUDNESS_HIGHPASS_SHIFT 6         // One-pole high-pass, about 110 Hz at 44.1 kHz
+
+// Function declarations
+void loudnessProcess(const int16_t* buff, uint32_t frames, uint32_t sampleRate);
+void loudnessReset();
+void loudnessStationChanged(int streamIndex);
+void updateLoudness();
+void saveLoudnessIfDirty(bool force = false);
+int loudnessOffsetDb10(int streamIndex);
+void loudnessReapply(unsigned long rampMs);
+
+#endif
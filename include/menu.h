@@ -75,6 +75,8 @@ enum AlarmSubMenuState {
 struct RadioStream {
   char name[17];   // 16 characters + null terminator (same as WebRadioStream)
   char url[256];   // URL for the stream (same as WebRadioStream)
+  float loudnessDb;        // Learned programme loudness (dBFS), see loudness.h
+  uint16_t loudnessBlocks; // Blocks behind the estimate, 0 = not measured yet
 };
 
 // Maximum number of radio streams
@@ -102,6 +104,37 @@ extern bool brightnessChanged;
 extern RadioStream menuStreams[MAX_MENU_STREAMS];
 extern int menuStreamCount;
 extern int playingStream;
+extern bool streamPaused;
+
+// Sleep timer fade-out: when the last sleepFadeMinutes begin, loop() starts a gain
+// ramp on the audio task over the time left, so the volume reaches zero exactly
+// when the timer expires. Then the stream is stopped and a heap check compares
+// free heap and PSRAM with a baseline taken before playback started.
+// The relay's two upstream rings, the time-shift ring and the HLS playlist
+// buffers are a permanent PSRAM reservation made once at boot, so they are part
+// of the baseline and are not expected to be freed on sleep.
+#define SLEEP_FADE_DEFAULT_MINUTES 3
+#define SLEEP_FADE_MAX_MINUTES 30
+#define SLEEP_FADE_RESTORE_MS 1000         // Volume comes back this fast when the timer is cancelled mid-fade
+#define SLEEP_HEAP_CHECK_DELAY_MS 5000     // Give the relay and decoder tasks time to close their sockets
+#define SLEEP_HEAP_SLACK_BYTES 16384       // Below the baseline by more than this = not reclaimed
+#define SLEEP_HEAP_DRIFT_WARN_BYTES 8192   // Less free heap than after the previous sleep by this much = warn
+
+struct SleepTimerStats {
+  uint32_t fades;             // Timers that ended with a fade-out
+  uint32_t hardStops;         // Timers that ended without one (fade off)
+  uint32_t checks;            // Heap checks after the radio was turned off
+  uint32_t heapBaseline;      // Free heap before playback started, 0 = none taken yet
+  uint32_t psramBaseline;
+  uint32_t heapAfter;         // SLEEP_HEAP_CHECK_DELAY_MS after the stream was stopped
+  uint32_t largestBlockAfter;
+  uint32_t psramAfter;
+  int32_t heapDeltaBytes;     // heapAfter against the baseline, negative = less free
+  int32_t psramDeltaBytes;
+  int32_t driftBytes;         // heapAfter against the previous check, negative = less free
+  bool connectionsClosed;     // Upstream, standby and decoder closed, relay ring empty
+  bool released;              // ...and heap and PSRAM back within SLEEP_HEAP_SLACK_BYTES of the baseline
+};
 
 // Sleep timer variables
 extern unsigned long sleepTimerStart;
@@ -113,14 +146,21 @@ void enterMenu();
 void exitMenu();
 void nextMenuItem();
 void printCurrentMenu();
-void displayCurrentMenu();
 void selectStream();
 void connectToStream(int streamIndex);  // Helper function for clean stream connections
+void playUrl(const char* url);
+void reconnectStream();
+void stopStream();
+void pauseStream();
+void resumeStream();
+void returnToLive();
+bool streamBehindLive();
 void handleMenuEncoderClockwise(unsigned long currentTime);
 void handleMenuEncoderCounterClockwise(unsigned long currentTime);
 void handleMenuButtonPress();
 void resetWiFiSettings();
 void loadMenuStreamsFromFile();
+void saveMenuStreamsToFile();
 void createDefaultStreamsFile();
 void loadDefaultStreamsToMemory();
 void displayWeatherMenu();
@@ -128,8 +168,11 @@ void handleWeatherMenuButtonPress();
 void handleSystemMenuButtonPress();
 void handleSleepMenuButtonPress();
 void setSleepTimer(int minutes);
+void cancelSleepTimer();
 void checkSleepTimer();
-void displayAlarmMenu();
+bool sleepTimerFading();
+void getSleepTimerStats(SleepTimerStats& stats);
+void recordPlaybackBaseline();
 void handleAlarmMenuButtonPress();
 
 #endif
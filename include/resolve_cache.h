@@ -0,0 +1,26 @@
+#ifndef RESOLVE_CACHE_H
+#define RESOLVE_CACHE_H
+
+#include "Arduino.h"
+
+// Per-station cache of the final media URL after redirects and playlist
+// wrappers, stored next to /streams.json so reconnects skip the resolution.
+#define RESOLVE_CACHE_FILE "/resolved.json"
+#define RESOLVE_CACHE_ENTRIES 20          // One per station (MAX_MENU_STREAMS)
+#define RESOLVE_CACHE_URL_LENGTH 256
+
+struct ResolvedUrl {
+  char stationUrl[RESOLVE_CACHE_URL_LENGTH];
+  char mediaUrl[RESOLVE_CACHE_URL_LENGTH];
+  unsigned long lastUsed;
+};
+
+// Function declarations
+void loadResolveCache();
+void saveResolveCacheIfDirty();
+bool resolveCacheLookup(const char* stationUrl, char* mediaUrl, size_t size);
+void resolveCacheStore(const char* stationUrl, const char* mediaUrl);
+void resolveCacheInvalidate(const char* stationUrl);
+int resolveCacheCount();
+
+#endif
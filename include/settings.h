@@ -2,6 +2,7 @@
 #define SETTINGS_H
 
 #include "Arduino.h"
+#include "tone_control.h"
 
 // Forward declaration for alarm structures
 enum AlarmSchedule {
@@ -48,6 +49,8 @@ struct Alarm {
 #define ALARM_SNOOZE_MINUTES 10
 #define ALARM_FADE_SECONDS 30
 #define ALARM_TIMEOUT_MINUTES 5
+#define ALARM_PREWARM_DEFAULT_SECONDS 30  // Connect the alarm station this long before it sounds
+#define ALARM_PREWARM_MAX_SECONDS 120
 
 // Settings structure for EEPROM storage
 struct Settings {
@@ -60,6 +63,16 @@ struct Settings {
   char wifiPassword[64];
   char weatherApiKey[64];
   Alarm alarms[5];  // Array of 5 alarms
+  // Version 7+ fields are appended so older layouts keep their alarms
+  uint16_t prebufferMinMs; // Stream relay adaptive prebuffer bounds
+  uint16_t prebufferMaxMs;
+  bool levelMeterEnabled;  // Version 8+: level meter on the second row while playing
+  int backupStream;        // Version 9+: station to fail over to on dead air, -1 = none
+  int8_t toneGainDb[TONE_BANDS]; // Version 10+: bass/mid/treble in dB
+  bool loudnessNormalization; // Version 11+: even out station loudness
+  uint8_t alarmPrewarmSeconds; // Version 12+: 0 = connect at the alarm time
+  uint8_t hlsPrefetchSegments; // Version 13+: HLS segments fetched ahead of playback
+  uint8_t sleepFadeMinutes; // Version 14+: sleep timer fades out over its last minutes, 0 = hard stop
 };
 
 // Global settings variables
@@ -70,6 +83,15 @@ extern volatile int volume;
 extern int currentStream;
 extern bool backlightAlwaysOn;
 extern bool radioPowerOn;
+extern int prebufferMinMs;
+extern int prebufferMaxMs;
+extern bool levelMeterEnabled;
+extern int backupStream;
+extern int8_t toneGainDb[TONE_BANDS];
+extern bool loudnessNormalization;
+extern int alarmPrewarmSeconds;
+extern int hlsPrefetchSegments;
+extern int sleepFadeMinutes;
 
 // Global alarm variables
 extern Alarm alarms[5];
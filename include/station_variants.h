@@ -0,0 +1,44 @@
+#ifndef STATION_VARIANTS_H
+#define STATION_VARIANTS_H
+
+#include "Arduino.h"
+
+// Bitrate variants per station and the policy that moves between them.
+// /streams.json may list a station's variants lowest bitrate first
+// ("variants": [...]); stations whose URL ends in _low/_medium/_high get the
+// other two derived. While the relay buffer keeps draining the player steps
+// down one variant, and after a stable period it steps back up towards the
+// configured URL. The new variant is buffered on the standby connection
+// first, so the switch is a warm swap instead of a cold connect.
+#define VARIANT_MAX 3
+#define VARIANT_URL_LENGTH 256
+#define VARIANT_DRAIN_SECONDS 10          // Buffer below target and falling this long = step down
+#define VARIANT_STABLE_MS 300000          // No trouble this long = step back up
+#define VARIANT_SWITCH_TIMEOUT_MS 15000   // Wait for the standby copy before switching cold (down) or giving up (up)
+
+// Switch counters
+struct VariantStats {
+  int station;               // Station being adapted, -1 = none
+  int level;                 // Variant playing, 0 = lowest
+  int defaultLevel;          // The station's configured URL
+  int count;
+  int pendingLevel;          // Being buffered on the standby connection, -1 = none
+  uint32_t stepsDown;
+  uint32_t stepsUp;
+  uint32_t warmSwitches;     // Standby copy was buffered in time
+  uint32_t coldSwitches;
+  uint32_t abandoned;        // Step up given up because the variant didn't buffer
+};
+
+// Function declarations
+void stationVariantsClear();
+void stationVariantsAdd(int station, const char* url);
+void stationVariantsFinish(int station, const char* url);
+int stationVariantCount(int station);
+const char* stationVariantUrl(int station, int level);
+const char* stationStreamUrl(int station);
+void updateStationVariants(int station);
+bool stationVariantSwitchPending();
+void getVariantStats(VariantStats& stats);
+
+#endif
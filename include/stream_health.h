@@ -0,0 +1,60 @@
+#ifndef STREAM_HEALTH_H
+#define STREAM_HEALTH_H
+
+#include "Arduino.h"
+
+// Stream health monitor configuration
+#define HEALTH_CHECK_INTERVAL 1000      // Check once per second from loop()
+#define HEALTH_START_TIMEOUT_MS 20000   // No audio this long after a connect = failed start
+#define HEALTH_DECODER_STALL_MS 8000    // Decoder silent this long while data is waiting = stalled
+#define HEALTH_STABLE_MS 60000          // Playing this long resets the backoff
+#define HEALTH_BACKOFF_BASE_MS 1000
+#define HEALTH_BACKOFF_MAX_MS 60000
+#define HEALTH_DEAD_AIR_MS 20000        // Decoded audio silent this long = dead air
+#define HEALTH_AUDIBLE_MS 2000          // Programme within this long = audio is really back
+#define HEALTH_FAILOVER_RECONNECTS 1    // Failed reconnects before switching to the backup station
+#define HEALTH_UNREACHABLE_MS 60000     // Relay unable to reach the station this long = fail over
+
+// Why a stream had to be reconnected
+enum ReconnectReason {
+  RECONNECT_UPSTREAM_CLOSED = 0,   // Server closed the connection
+  RECONNECT_UPSTREAM_STALLED = 1,  // Connection open but no bytes arriving
+  RECONNECT_DECODER_STALLED = 2,   // Data available but no decoder output
+  RECONNECT_START_TIMEOUT = 3,     // Stream never produced audio after connecting
+  RECONNECT_DEAD_AIR = 4,          // Connected and decoding, but only silence
+  RECONNECT_REASON_COUNT = 5
+};
+
+struct ReconnectReasonStats {
+  uint32_t count;
+  uint32_t recovered;        // Reconnects that got audio playing again
+  uint32_t totalDurationMs;  // Detection to first decoded audio, summed over recovered
+  uint32_t maxDurationMs;
+};
+
+struct StreamHealthStats {
+  ReconnectReasonStats reasons[RECONNECT_REASON_COUNT];
+  uint32_t failedAttempts;     // Connection attempts that failed (and were backed off)
+  uint32_t consecutiveFailures;
+  uint32_t currentBackoffMs;   // Delay before the next full reconnect, 0 when healthy
+  bool recovering;             // A reconnect is in progress
+  int recoveringReason;
+  bool deadAir;                // Silence is being played right now
+  uint32_t deadAirEvents;
+  uint32_t deadAirTotalMs;     // Summed over finished events
+  uint32_t deadAirMaxMs;
+  uint32_t lastDeadAirMs;
+  uint32_t failovers;          // Switches to the backup station
+};
+
+// Function declarations
+void streamHealthConnected();
+void streamHealthStopped();
+void checkStreamHealth();
+void streamHealthReconnectStarted(ReconnectReason reason);
+void streamHealthConnectFailed();
+unsigned long streamHealthBackoffMs(uint32_t failures);
+const char* reconnectReasonName(int reason);
+void getStreamHealthStats(StreamHealthStats& stats);
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef STREAM_RELAY_H
+#define STREAM_RELAY_H
+
+#include "Arduino.h"
+
+// The stream relay fetches the station into a PSRAM ring buffer and serves it
+// to the decoder over a local HTTP connection, so network hiccups are absorbed
+// by the ring instead of turning into silence. A second connection can be kept
+// buffering the next likely station so switching to it starts immediately.
+// Pausing keeps the upstream running: audio the relay ring can't hold spills
+// into a larger time-shift ring, so playback resumes where it stopped.
+// HLS stations are played by following the playlist here: segments are
+// prefetched over one keep-alive connection and demuxed into the same ring.
+
+// Relay configuration
+#define RELAY_PORT 8100
+#define RELAY_RING_SIZE (512 * 1024)      // PSRAM jitter buffer
+#define RELAY_CHUNK_SIZE 2048
+#define RELAY_FETCH_TASK_STACK 10240      // TLS handshakes need a large stack
+#define RELAY_SERVE_TASK_STACK 4096
+#define RELAY_TASK_PRIORITY 2
+#define RELAY_TASK_CORE 0
+#define RELAY_MAX_REDIRECTS 5
+#define RELAY_HEADER_TIMEOUT_MS 5000
+#define RELAY_DATA_TIMEOUT_MS 10000       // Upstream silent this long = connection lost
+#define RELAY_UPSTREAM_WAIT_MS 15000      // How long the decoder request waits for the upstream
+#define RELAY_DECODER_LOW_WATER 16384     // Keep the decoder's own input buffer topped up to this
+#define RELAY_DECODER_EMPTY 1024          // Decoder input below this = audible underrun
+#define RELAY_DEFAULT_BITRATE_KBPS 128
+#define STANDBY_SETTLE_MS 500            // Highlighted station must stay put this long before it is prepared
+
+// Time-shift (pause live radio)
+#define TIMESHIFT_RING_SIZE (4 * 1024 * 1024)         // ~4.4 minutes at 128 kbps, oldest audio is overwritten
+#define TIMESHIFT_SPILL_LEVEL (RELAY_RING_SIZE - 65536) // Relay ring fill above which audio moves to the time-shift ring
+
+// Adaptive prebuffer defaults (milliseconds of audio)
+#define PREBUFFER_MIN_MS_DEFAULT 1000
+#define PREBUFFER_MAX_MS_DEFAULT 8000
+#define PREBUFFER_INITIAL_MS 2000
+#define PREBUFFER_STABLE_PERIOD_MS 120000 // Shrink the target after this long without underruns
+#define PREBUFFER_LIMIT_MS 30000          // Upper bound accepted for the configurable maximum
+
+// HLS
+#define HLS_PREFETCH_DEFAULT 3            // Fetched segments kept ahead of the decoder
+#define HLS_PREFETCH_MAX 6
+#define HLS_QUEUE_LENGTH (HLS_PREFETCH_MAX + 2)
+#define HLS_DEFAULT_TARGET_MS 6000        // Used when the playlist has no EXT-X-TARGETDURATION
+#define HLS_REFRESH_RETRY_MS 1000
+#define HLS_STALL_TARGETS 4               // Live playlist not growing for this many target durations = stalled
+#define HLS_SEGMENT_RETRIES 3             // Failed fetches of one segment before the station is reconnected
+
+// Relay counters and buffer state
+struct RelayStats {
+  bool active;              // A station is being relayed
+  bool upstreamConnected;
+  bool feeding;             // Prebuffer reached, decoder is being fed
+  uint32_t ringFill;        // Bytes currently buffered
+  uint32_t ringCapacity;
+  uint32_t fillMs;          // Buffered audio at the current bitrate
+  uint32_t targetMs;        // Current adaptive prebuffer target
+  uint32_t targetBytes;
+  uint32_t minMs;
+  uint32_t maxMs;
+  uint32_t underruns;
+  uint32_t bitrateKbps;
+  uint32_t bytesReceived;   // Audio bytes received from the station (ICY metadata stripped)
+  uint32_t lastFirstByteMs; // relayStart() to the first audio byte of that station
+  uint32_t maxGapMs;        // Longest gap between upstream packets in the current window
+  uint32_t upstreamConnects;
+  uint32_t upstreamFailures;
+  bool standbyConnected;    // Standby station is connected and buffering
+  uint32_t standbyFillMs;
+  uint32_t standbyOpens;    // Standby connections started, tells a new standby from the previous one
+  uint32_t standbyHits;     // Station starts served from the standby connection
+  uint32_t standbyMisses;   // Station starts that needed a cold connect
+  uint32_t cachedConnects;  // Upstream connects that went straight to the cached media URL
+  uint32_t cachedConnectTotalMs;
+  uint32_t resolvedConnects; // Connects that resolved redirects/playlists from the station URL
+  uint32_t resolvedConnectTotalMs;
+  uint32_t cacheFallbacks;  // Cached URL failed and the station URL was resolved again
+  bool paused;              // Decoder feed paused, upstream still buffering
+  uint32_t behindLiveMs;    // How far playback is behind the newest received audio
+  uint32_t timeShiftFill;   // Bytes in the time-shift ring
+  uint32_t timeShiftCapacity;
+  uint32_t timeShiftMaxMs;  // Capacity at the current bitrate
+  uint32_t timeShiftDropped; // Paused audio overwritten because the ring was full
+
+  // HLS segment pipeline
+  bool hlsActive;
+  uint32_t hlsQueueDepth;   // Fetched segments not yet played
+  uint32_t hlsPrefetch;     // Queue depth the prefetch aims for
+  bool hlsFetching;         // A segment download is in progress
+  uint32_t hlsSegments;     // Segments fetched
+  uint32_t hlsLastFetchMs;  // Request to last byte of the newest segment
+  uint32_t hlsFetchTotalMs;
+  uint32_t hlsMaxFetchMs;
+  uint32_t hlsSlowFetches;  // Segments that took longer to fetch than to play
+  uint32_t hlsPlaylistLoads;
+  uint32_t hlsRequests;     // HTTP requests for playlists and segments
+  uint32_t hlsReusedRequests; // Requests sent on the kept-alive connection
+  uint32_t hlsSkipped;      // Segments that left the live window before they were fetched
+  uint32_t hlsFailures;     // Failed playlist or segment fetches
+};
+
+// Function declarations
+void initStreamRelay();
+bool relayAvailable();
+const char* relayStart(const char* url, bool* warm = NULL);
+void relayStop();
+void relayPrepareStandby(const char* url);
+void relayPause();
+void relayResume();
+void relayGoLive();
+void setRelayPrebuffer(int minMs, int maxMs);
+void setRelayHlsPrefetch(int segments);
+bool relayHlsAvailable();
+void getRelayStats(RelayStats& stats);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+#include "Arduino.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Byte ring buffer for compressed stream data, allocated in PSRAM.
+// One task writes and another reads, so every operation takes the ring mutex.
+struct StreamRing {
+  uint8_t* data;
+  size_t capacity;
+  size_t readPos;
+  size_t writePos;
+  size_t fill;
+  uint32_t totalWritten;   // Monotonic byte counters (wrap around, use differences)
+  uint32_t totalRead;
+  uint32_t totalDropped;   // Bytes discarded by overwrite/drop
+  SemaphoreHandle_t mutex;
+};
+
+// Function declarations
+bool streamRingInit(StreamRing& ring, size_t capacity);
+void streamRingRelease(StreamRing& ring);
+void streamRingReset(StreamRing& ring);
+size_t streamRingWrite(StreamRing& ring, const uint8_t* src, size_t len);
+size_t streamRingWriteOverwrite(StreamRing& ring, const uint8_t* src, size_t len);
+size_t streamRingPeek(StreamRing& ring, uint8_t* dst, size_t len);
+size_t streamRingRead(StreamRing& ring, uint8_t* dst, size_t len);
+size_t streamRingConsume(StreamRing& ring, size_t len);
+size_t streamRingDiscard(StreamRing& ring, size_t len);
+size_t streamRingFill(const StreamRing& ring);
+size_t streamRingSpace(const StreamRing& ring);
+
+#endif
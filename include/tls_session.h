@@ -0,0 +1,57 @@
+#ifndef TLS_SESSION_H
+#define TLS_SESSION_H
+
+#include "Arduino.h"
+#include <WiFi.h>
+
+// TLS client that remembers the session (ID or ticket) per host, so the next
+// connection to the same host can use an abbreviated handshake. Certificates
+// are not verified, matching the setInsecure() clients it replaces.
+#define TLS_SESSION_CACHE_SIZE 8
+#define TLS_CONNECT_TIMEOUT_MS 5000
+#define TLS_HANDSHAKE_TIMEOUT_MS 15000
+#define TLS_IO_TIMEOUT_MS 5000
+
+// Handshake counters, shared by every TlsSessionClient
+struct TlsHandshakeStats {
+  uint32_t fullHandshakes;
+  uint32_t fullTotalMs;
+  uint32_t resumedHandshakes;
+  uint32_t resumedTotalMs;
+  uint32_t failedHandshakes;
+  uint32_t lastHandshakeMs;
+  bool lastResumed;
+  uint32_t cachedSessions;
+};
+
+class TlsSessionClient : public WiFiClient {
+ public:
+  TlsSessionClient();
+  ~TlsSessionClient();
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  int connect(const char* host, uint16_t port, int32_t timeout) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+  using Print::write;
+
+ private:
+  struct Context;      // mbedtls state, only allocated while connected
+  Context* ctx;
+  int peeked;          // Byte returned by peek(), -1 if none
+};
+
+// Function declarations
+void initTlsSessionCache();
+void getTlsHandshakeStats(TlsHandshakeStats& stats);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef TONE_CONTROL_H
+#define TONE_CONTROL_H
+
+#include "Arduino.h"
+
+// Bass/mid/treble for decoded PCM: a cascade of fixed-point biquads (RBJ
+// shelves and a peaking band). Coefficients are computed when the settings
+// or the sample rate change; blocks are filtered band by band in an int32
+// scratch buffer so only the final output is saturated.
+#define TONE_BANDS 3
+#define TONE_GAIN_MAX_DB 12           // Per band, +/-
+#define TONE_COEF_SHIFT 28            // Coefficients are Q28 (|c| < 8)
+#define TONE_SAMPLE_SHIFT 8           // Extra fraction bits while filtering
+#define TONE_BLOCK_FRAMES 128         // Scratch size, longer blocks are split
+
+enum ToneBandType {
+  TONE_LOW_SHELF = 0,
+  TONE_PEAKING = 1,
+  TONE_HIGH_SHELF = 2
+};
+
+struct ToneBand {
+  bool active;               // False at 0 dB, the band is skipped
+  int32_t b0, b1, b2, a1, a2; // Normalised by a0, Q28
+};
+
+// Filter history for one band and channel
+struct ToneBandState {
+  int32_t x1, x2, y1, y2;
+};
+
+struct ToneControl {
+  bool active;               // Any band active
+  uint32_t sampleRate;
+  int8_t gainDb[TONE_BANDS];
+  ToneBand bands[TONE_BANDS];
+  ToneBandState state[TONE_BANDS][2];
+  int32_t scratch[TONE_BLOCK_FRAMES * 2];
+};
+
+// Function declarations
+const char* toneBandName(int band);
+void toneControlInit(ToneControl& tone);
+void toneControlConfigure(ToneControl& tone, const int8_t* gainDb, uint32_t sampleRate);
+void toneControlProcess(ToneControl& tone, int16_t* buff, uint32_t frames);
+
+#endif
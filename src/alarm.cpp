@@ -3,8 +3,11 @@
 #include "settings.h"
 #include "display.h"
 #include "menu.h"
-#include "Audio.h"
+#include "audio_engine.h"
+#include "stream_relay.h"
+#include "station_variants.h"
 #include "time.h"
+#include <sys/time.h>
 
 // Alarm system variables
 bool alarmSystemActive = false;
@@ -13,8 +16,18 @@ unsigned long alarmFadeStart = 0;
 int alarmCurrentVolume = 0;
 int userOriginalVolume = 0; // Store user's volume before alarm
 
+// Pre-warm: the alarm station is connected ahead of time so the fade starts on time
+static int prewarmAlarm = -1;
+static unsigned long prewarmDue = 0;       // millis() when the alarm is scheduled to sound
+static bool prewarmMuted = false;          // Decoder is already playing the station at zero volume
+
+// Scheduled vs first audible time of the last alarm
+static unsigned long alarmScheduledAt = 0;
+static bool alarmStartMeasured = true;
+static bool alarmWasPrewarmed = false;
+static AlarmStartStats alarmStartStats = {};
+
 // External variables
-extern Audio audio;
 extern bool radioPowerOn;
 extern bool isStreaming;
 extern String currentStreamName;
@@ -23,6 +36,164 @@ extern int currentStream;
 extern RadioStream menuStreams[];
 extern int menuStreamCount;
 extern bool forceImmediateLcdUpdate;
+extern int playingStream;
+
+static void beginAlarm(int alarmIndex, unsigned long scheduledAt);
+
+// Wall clock in milliseconds, to line alarm minutes up with millis()
+static int64_t epochMs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static bool alarmMatches(const Alarm& alarm, const struct tm& timeinfo) {
+  // Check time match
+  if (timeinfo.tm_hour != alarm.hour || timeinfo.tm_min != alarm.minute) {
+    return false;
+  }
+  
+  // Check schedule
+  switch (alarm.schedule) {
+    case ALARM_DAILY:
+      return true;
+      
+    case ALARM_WEEKDAYS:
+      // Monday = 1, Friday = 5 (tm_wday: Sunday = 0, Saturday = 6)
+      return (timeinfo.tm_wday >= 1 && timeinfo.tm_wday <= 5);
+      
+    case ALARM_WEEKENDS:
+      // Saturday = 6, Sunday = 0
+      return (timeinfo.tm_wday == 0 || timeinfo.tm_wday == 6);
+      
+    case ALARM_ONCE:
+      // For "once" alarms, disable after triggering
+      return true;
+  }
+  
+  return false;
+}
+
+bool alarmPrewarmActive() {
+  return prewarmAlarm >= 0;
+}
+
+static void startPrewarm(int alarmIndex, unsigned long due) {
+  int station = alarms[alarmIndex].stationIndex;
+  if (station < 0 || station >= menuStreamCount) return;
+  
+  prewarmAlarm = alarmIndex;
+  prewarmDue = due;
+  prewarmMuted = false;
+  
+  if (radioPowerOn && isStreaming) {
+    // Someone is listening - keep the alarm station buffering next to it instead
+    if (playingStream != station &&
+        (relayHlsAvailable() || strstr(stationStreamUrl(station), ".m3u8") == NULL)) {
+      relayPrepareStandby(stationStreamUrl(station));
+    }
+  } else {
+    // Radio is off: connect and buffer at zero volume, the display stays off.
+    // Powering on before the alarm still plays the listener's own station.
+    int listenerStream = currentStream;
+    audioEngineFadeVolume(0, 0);
+    connectToStream(station);
+    currentStream = listenerStream;
+    prewarmMuted = true;
+  }
+  
+  Serial.print("Alarm ");
+  Serial.print(alarmIndex + 1);
+  Serial.print(": pre-warming ");
+  Serial.print(menuStreams[station].name);
+  Serial.print(", due in ");
+  Serial.print((long)(due - millis()));
+  Serial.println("ms");
+}
+
+static void cancelPrewarm() {
+  if (prewarmMuted && !radioPowerOn) {
+    stopStream();
+    isStreaming = false;
+    audioEngineSetVolume(volume);
+  }
+  Serial.print("Alarm ");
+  Serial.print(prewarmAlarm + 1);
+  Serial.println(": pre-warm cancelled");
+  prewarmAlarm = -1;
+  prewarmMuted = false;
+}
+
+// Start connecting alarms that are due within alarmPrewarmSeconds
+static void checkAlarmPrewarm(const struct tm& now) {
+  if (prewarmAlarm >= 0) {
+    // The radio was switched on meanwhile - the listener gets their own volume back
+    if (prewarmMuted && radioPowerOn) {
+      prewarmMuted = false;
+      audioEngineSetVolume(volume);
+    }
+    // Disabled or edited since: don't keep a silent connection open
+    if ((long)(millis() - prewarmDue) > ALARM_PREWARM_GRACE_MS) {
+      cancelPrewarm();
+    }
+    return;
+  }
+  if (alarmPrewarmSeconds <= 0 || activeAlarmIndex >= 0) return;
+  
+  unsigned long lead = alarmPrewarmSeconds * 1000UL;
+  for (int i = 0; i < MAX_ALARMS; i++) {
+    if (!alarms[i].enabled || alarms[i].isActive) continue;
+    if (editingTime && i == currentAlarmSlot) continue;
+    
+    if (alarms[i].isSnoozing) {
+      unsigned long due = alarms[i].snoozeStart + ALARM_SNOOZE_MINUTES * 60 * 1000UL;
+      if ((long)(due - millis()) <= (long)lead) {
+        startPrewarm(i, due);
+        return;
+      }
+      continue;
+    }
+    
+    // Does the alarm minute start within the lead time?
+    int64_t nowMs = epochMs();
+    time_t ahead = (time_t)((nowMs + lead) / 1000);
+    struct tm aheadInfo;
+    localtime_r(&ahead, &aheadInfo);
+    if (alarmMatches(alarms[i], aheadInfo) && !alarmMatches(alarms[i], now)) {
+      int64_t dueMs = (int64_t)(ahead - aheadInfo.tm_sec) * 1000;
+      startPrewarm(i, millis() + (unsigned long)(dueMs - nowMs));
+      return;
+    }
+  }
+}
+
+// Log how far the first audible output was from the scheduled alarm time
+static void checkAlarmStart() {
+  if (alarmStartMeasured) return;
+  
+  unsigned long audibleAt = audioEngineAudibleAt();
+  if (audibleAt == 0 && millis() - alarmScheduledAt < ALARM_AUDIBLE_TIMEOUT_MS) return;
+  alarmStartMeasured = true;
+  
+  if (audibleAt == 0) {
+    alarmStartStats.silent++;
+    Serial.println("Alarm start: nothing audible within 60s of the scheduled time");
+    return;
+  }
+  
+  long latency = (long)(audibleAt - alarmScheduledAt);
+  alarmStartStats.lastLatencyMs = latency;
+  alarmStartStats.lastPrewarmed = alarmWasPrewarmed;
+  if (latency > alarmStartStats.maxLatencyMs) alarmStartStats.maxLatencyMs = latency;
+  
+  Serial.print("Alarm start: first audible ");
+  Serial.print(latency);
+  Serial.println(alarmWasPrewarmed ? "ms after the scheduled time (pre-warmed)" : "ms after the scheduled time");
+}
+
+void getAlarmStartStats(AlarmStartStats& stats) {
+  stats = alarmStartStats;
+}
 
 void initializeAlarms() {
   // Initialize all alarms to default state
@@ -52,6 +223,9 @@ void checkAlarms() {
   struct tm timeinfo;
   if (!getLocalTime(&timeinfo)) return;
   
+  checkAlarmPrewarm(timeinfo);
+  checkAlarmStart();
+  
   // Check for alarm timeout (5 minutes after alarm starts without user interaction)
   if (activeAlarmIndex >= 0) {
     unsigned long alarmDuration = millis() - alarms[activeAlarmIndex].alarmStart;
@@ -81,13 +255,14 @@ void checkAlarms() {
       }
       
       // Stop the alarm and return to normal operation
+      audioEngineArmFallback(0);
       alarms[activeAlarmIndex].isActive = false;
       activeAlarmIndex = -1;
       alarmCurrentVolume = 0;
       
       // Restore user's original volume
       volume = userOriginalVolume;
-      audio.setVolume(volume);
+      audioEngineSetVolume(volume);
       
       forceImmediateLcdUpdate = true;
       return;
@@ -111,7 +286,7 @@ void checkAlarms() {
       if (millis() - alarms[i].snoozeStart >= (ALARM_SNOOZE_MINUTES * 60 * 1000)) {
         // Snooze time ended, trigger alarm again
         alarms[i].isSnoozing = false;
-        startAlarm(i);
+        beginAlarm(i, alarms[i].snoozeStart + ALARM_SNOOZE_MINUTES * 60 * 1000UL);
       }
       continue;
     }
@@ -119,9 +294,13 @@ void checkAlarms() {
     // Skip if alarm is already active
     if (alarms[i].isActive) continue;
     
-    // Check if current time matches alarm time
-    if (isAlarmTime(alarms[i])) {
-      startAlarm(i);
+    // A pre-warmed alarm sounds at its exact due time, others when the minute matches
+    if (i == prewarmAlarm && (long)(millis() - prewarmDue) >= 0) {
+      beginAlarm(i, prewarmDue);
+      break;
+    }
+    if (alarmMatches(alarms[i], timeinfo)) {
+      beginAlarm(i, millis() - (unsigned long)(epochMs() % 60000));
       break; // Only trigger one alarm at a time
     }
   }
@@ -135,36 +314,23 @@ void checkAlarms() {
 bool isAlarmTime(const Alarm& alarm) {
   struct tm timeinfo;
   if (!getLocalTime(&timeinfo)) return false;
-  
-  // Check time match
-  if (timeinfo.tm_hour != alarm.hour || timeinfo.tm_min != alarm.minute) {
-    return false;
-  }
-  
-  // Check schedule
-  switch (alarm.schedule) {
-    case ALARM_DAILY:
-      return true;
-      
-    case ALARM_WEEKDAYS:
-      // Monday = 1, Friday = 5 (tm_wday: Sunday = 0, Saturday = 6)
-      return (timeinfo.tm_wday >= 1 && timeinfo.tm_wday <= 5);
-      
-    case ALARM_WEEKENDS:
-      // Saturday = 6, Sunday = 0
-      return (timeinfo.tm_wday == 0 || timeinfo.tm_wday == 6);
-      
-    case ALARM_ONCE:
-      // For "once" alarms, disable after triggering
-      return true;
-  }
-  
-  return false;
+  return alarmMatches(alarm, timeinfo);
 }
 
 void startAlarm(int alarmIndex) {
+  beginAlarm(alarmIndex, millis());
+}
+
+// scheduledAt is the millis() time the alarm was due, for the start latency log
+static void beginAlarm(int alarmIndex, unsigned long scheduledAt) {
   if (alarmIndex < 0 || alarmIndex >= MAX_ALARMS) return;
   
+  int station = alarms[alarmIndex].stationIndex;
+  bool prewarmed = prewarmAlarm == alarmIndex;
+  bool connected = prewarmed && prewarmMuted && isStreaming && playingStream == station;
+  prewarmAlarm = -1;
+  prewarmMuted = false;
+  
   activeAlarmIndex = alarmIndex;
   alarms[alarmIndex].isActive = true;
   alarms[alarmIndex].alarmStart = millis(); // Record when alarm started
@@ -179,13 +345,27 @@ void startAlarm(int alarmIndex) {
     radioPowerOn = true;
   }
   
-  // Start playing the alarm station
-  if (alarms[alarmIndex].stationIndex < menuStreamCount) {
-    connectToStream(alarms[alarmIndex].stationIndex);  // Use helper function for consistent behavior
+  // Start silent and let the audio engine ramp up to the alarm volume sample by sample
+  // (don't modify global volume variable)
+  audioEngineFadeVolume(0, 0);
+  
+  // Start playing the alarm station, unless it has been buffering muted already
+  if (!connected && station < menuStreamCount) {
+    connectToStream(station);  // Use helper function for consistent behavior
   }
   
-  // Set initial alarm volume (don't modify global volume variable)
-  audio.setVolume(alarmCurrentVolume);
+  audioEngineFadeVolume(alarms[alarmIndex].maxVolume, ALARM_FADE_SECONDS * 1000UL);
+  
+  // If the station stays silent (network or station down) the alarm still sounds
+  audioEngineArmFallback(ALARM_FALLBACK_DELAY_MS);
+  
+  // Measure scheduled time to first audible output
+  audioEngineWatchAudible();
+  alarmScheduledAt = scheduledAt;
+  alarmWasPrewarmed = prewarmed;
+  alarmStartMeasured = false;
+  alarmStartStats.alarms++;
+  if (prewarmed) alarmStartStats.prewarmed++;
   
   // If this was a "once" alarm, disable it
   if (alarms[alarmIndex].schedule == ALARM_ONCE) {
@@ -208,21 +388,17 @@ void updateAlarmFade() {
   
   int maxVol = alarms[activeAlarmIndex].maxVolume;
   
+  // The gain ramp itself runs in the audio engine; this only tracks the level for display
   if (fadeTime < totalFadeTime) {
-    // Calculate fade volume from 0 to maxVolume over ALARM_FADE_SECONDS
     alarmCurrentVolume = (maxVol * fadeTime) / totalFadeTime;
-    
-    // Update audio volume directly (don't modify global volume variable)
-    audio.setVolume(alarmCurrentVolume);
   } else {
-    // Fade complete, set to max volume
     alarmCurrentVolume = maxVol;
-    audio.setVolume(alarmCurrentVolume);
   }
 }
 
 void stopAlarm() {
   if (activeAlarmIndex >= 0) {
+    audioEngineArmFallback(0);
     alarms[activeAlarmIndex].isActive = false;
     alarms[activeAlarmIndex].isSnoozing = false;
     activeAlarmIndex = -1;
@@ -230,7 +406,7 @@ void stopAlarm() {
     
     // Restore user's original volume
     volume = userOriginalVolume;
-    audio.setVolume(volume);
+    audioEngineSetVolume(volume);
     
     // Show confirmation message
     showTemporaryLCDMessage("STOPPED", 2000);
@@ -248,7 +424,7 @@ void snoozeAlarm() {
     
     // Turn off radio during snooze
     radioPowerOn = false;
-    audio.stopSong();
+    stopStream();
     isStreaming = false;
     
     activeAlarmIndex = -1;
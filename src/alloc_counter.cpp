@@ -0,0 +1,64 @@
+#include "alloc_counter.h"
+
+#ifdef ALLOC_COUNTER
+
+static portMUX_TYPE counterMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t volatile countedTask = NULL;
+static uint32_t allocations = 0;   // Only changed by countedTask
+static uint8_t depth = 0;          // Nested starts of countedTask
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static inline void countAllocation() {
+  TaskHandle_t task = countedTask;
+  if (task != NULL && xTaskGetCurrentTaskHandle() == task) allocations++;
+}
+
+void* __wrap_malloc(size_t size) {
+  countAllocation();
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  countAllocation();
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  countAllocation();
+  return __real_realloc(ptr, size);
+}
+}
+
+// Count allocations made by the calling task from now on. A nested start
+// keeps the outer count going; while another task is counting this is ignored.
+void allocCounterStart() {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  portENTER_CRITICAL(&counterMux);
+  if (countedTask == self) {
+    depth++;
+  } else if (countedTask == NULL) {
+    allocations = 0;
+    depth = 1;
+    countedTask = self;
+  }
+  portEXIT_CRITICAL(&counterMux);
+}
+
+// Allocations since the outermost start, 0 if the caller was not counting
+uint32_t allocCounterStop() {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  uint32_t count = 0;
+  portENTER_CRITICAL(&counterMux);
+  if (countedTask == self) {
+    count = allocations;
+    if (--depth == 0) countedTask = NULL;
+  }
+  portEXIT_CRITICAL(&counterMux);
+  return count;
+}
+
+#endif
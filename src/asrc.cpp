@@ -0,0 +1,141 @@
+#include "asrc.h"
+#include <math.h>
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static float besselI0(float x) {
+  float sum = 1.0f;
+  float term = 1.0f;
+  for (int k = 1; k < 32; k++) {
+    float t = x / (2.0f * k);
+    term *= t * t;
+    sum += term;
+    if (term < sum * 1e-9f) break;
+  }
+  return sum;
+}
+
+// Windowed sinc at t input frames from the output instant
+static float kernel(float t, float cutoff, float windowNorm) {
+  float half = ASRC_TAPS / 2.0f;
+  if (fabsf(t) >= half) return 0.0f;
+  float x = 2.0f * cutoff * t;
+  float sinc = fabsf(x) < 1e-6f ? 1.0f : sinf((float)M_PI * x) / ((float)M_PI * x);
+  float r = t / half;
+  return 2.0f * cutoff * sinc * besselI0(ASRC_KAISER_BETA * sqrtf(1.0f - r * r)) / windowNorm;
+}
+
+// Phase p interpolates at p / ASRC_PHASES of a frame past tap ASRC_TAPS / 2 - 1;
+// the extra last phase is a whole frame on, for interpolating past the last one
+static void designTable(Asrc& asrc, float cutoff) {
+  float windowNorm = besselI0(ASRC_KAISER_BETA);
+  for (int p = 0; p <= ASRC_PHASES; p++) {
+    float taps[ASRC_TAPS];
+    float sum = 0;
+    for (int i = 0; i < ASRC_TAPS; i++) {
+      taps[i] = kernel((float)p / ASRC_PHASES + ASRC_TAPS / 2 - 1 - i, cutoff, windowNorm);
+      sum += taps[i];
+    }
+    // Unity DC gain in every phase, the rounding error goes to the largest tap
+    int32_t total = 0;
+    int largest = 0;
+    for (int i = 0; i < ASRC_TAPS; i++) {
+      asrc.coefs[p][i] = (int16_t)lroundf(taps[i] / sum * (1 << ASRC_COEF_SHIFT));
+      total += asrc.coefs[p][i];
+      if (abs(asrc.coefs[p][i]) > abs(asrc.coefs[p][largest])) largest = i;
+    }
+    asrc.coefs[p][largest] += (1 << ASRC_COEF_SHIFT) - total;
+  }
+  asrc.cutoff = cutoff;
+}
+
+static void updateStep(Asrc& asrc) {
+  double ratio = (double)asrc.inputRate / asrc.outputRate * (1.0 + asrc.correctionPpm * 1e-6);
+  asrc.step = (uint64_t)(ratio * 4294967296.0);
+}
+
+void asrcInit(Asrc& asrc, uint32_t outputRate) {
+  memset(&asrc, 0, sizeof(asrc));
+  asrc.outputRate = outputRate;
+  asrcConfigure(asrc, outputRate);
+}
+
+// New input rate: the history is dropped; the table is only redesigned when
+// the cutoff changes, i.e. never for rates up to the output rate
+void asrcConfigure(Asrc& asrc, uint32_t inputRate) {
+  if (inputRate == 0) return;
+  asrc.inputRate = inputRate;
+  float cutoff = ASRC_CUTOFF * min(1.0f, (float)asrc.outputRate / inputRate);
+  if (cutoff != asrc.cutoff) designTable(asrc, cutoff);
+  asrc.position = 0;
+  asrc.historyFrames = 0;
+  updateStep(asrc);
+}
+
+void asrcSetCorrection(Asrc& asrc, int32_t ppm) {
+  ppm = constrain(ppm, -ASRC_MAX_PPM, ASRC_MAX_PPM);
+  if (ppm == asrc.correctionPpm) return;
+  asrc.correctionPpm = ppm;
+  updateStep(asrc);
+}
+
+// Take up to frames of interleaved stereo input; returns how many were taken.
+// Read the output before writing again once this returns less than frames.
+uint32_t asrcWrite(Asrc& asrc, const int16_t* in, uint32_t frames) {
+  // Drop what the read position has passed
+  uint32_t consumed = (uint32_t)(asrc.position >> 32);
+  if (consumed > asrc.historyFrames) consumed = asrc.historyFrames;
+  if (consumed > 0) {
+    asrc.historyFrames -= consumed;
+    memmove(asrc.history, asrc.history + consumed * 2, asrc.historyFrames * 2 * sizeof(int16_t));
+    asrc.position -= (uint64_t)consumed << 32;
+  }
+
+  uint32_t space = ASRC_HISTORY_FRAMES + ASRC_TAPS - asrc.historyFrames;
+  uint32_t n = frames < space ? frames : space;
+  memcpy(asrc.history + asrc.historyFrames * 2, in, n * 2 * sizeof(int16_t));
+  asrc.historyFrames += n;
+  return n;
+}
+
+static inline int16_t saturate(int64_t v) {
+  if (v > 32767) return 32767;
+  if (v < -32768) return -32768;
+  return (int16_t)v;
+}
+
+// Produce up to maxFrames of output from the buffered input; returns the count
+uint32_t asrcRead(Asrc& asrc, int16_t* out, uint32_t maxFrames) {
+  const int64_t round = 1LL << (ASRC_COEF_SHIFT + 15); // Output scale after the Q16 interpolation
+  uint32_t count = 0;
+
+  while (count < maxFrames) {
+    uint32_t base = (uint32_t)(asrc.position >> 32);
+    if (base + ASRC_TAPS > asrc.historyFrames) break;
+
+    uint32_t frac = (uint32_t)asrc.position;
+    uint32_t phase = frac >> (32 - ASRC_PHASE_BITS);
+    int64_t weight = (frac >> (32 - ASRC_PHASE_BITS - 16)) & 0xFFFF; // Position between the two phases, Q16
+    const int16_t* c0 = asrc.coefs[phase];
+    const int16_t* c1 = asrc.coefs[phase + 1];
+    const int16_t* x = asrc.history + base * 2;
+
+    // |sum of taps| stays well below 2 for this kernel, so int32 can't overflow
+    int32_t left0 = 0, right0 = 0, left1 = 0, right1 = 0;
+    for (int i = 0; i < ASRC_TAPS; i++) {
+      int32_t l = x[i * 2];
+      int32_t r = x[i * 2 + 1];
+      left0 += l * c0[i];
+      right0 += r * c0[i];
+      left1 += l * c1[i];
+      right1 += r * c1[i];
+    }
+
+    int64_t left = ((int64_t)left0 << 16) + ((int64_t)left1 - left0) * weight;
+    int64_t right = ((int64_t)right0 << 16) + ((int64_t)right1 - right0) * weight;
+    out[count * 2] = saturate((left + round) >> (ASRC_COEF_SHIFT + 16));
+    out[count * 2 + 1] = saturate((right + round) >> (ASRC_COEF_SHIFT + 16));
+    count++;
+    asrc.position += asrc.step;
+  }
+  return count;
+}
@@ -0,0 +1,711 @@
+#include "audio_engine.h"
+#include "config.h"
+#include "gain_ramp.h"
+#include "level_meter.h"
+#include "audio_telemetry.h"
+#include "loudness.h"
+#include "stream_relay.h"
+#include "Audio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "driver/i2s.h"
+
+// Audio object - owned by the audio engine task, never touch it from loop()
+static Audio audio;
+
+// Task and queues
+static TaskHandle_t audioTaskHandle = NULL;
+static QueueHandle_t audioCommandQueue = NULL;
+static QueueHandle_t audioEventQueue = NULL;
+
+// Engine state (only modified by the audio task)
+static volatile bool audioActive = false;
+static volatile bool audioRunning = false;
+static volatile uint32_t inputFill = 0; // Bytes waiting in the decoder's input buffer
+static volatile uint32_t inputSize = 0;
+static volatile uint32_t framesOut = 0; // PCM frames handed to I2S, for the stream health monitor
+static volatile uint32_t silentFrames = 0; // Consecutive decoded frames below AUDIO_SILENCE_LEVEL (dead air)
+static volatile uint32_t outputSampleRate = AUDIO_DEFAULT_SAMPLE_RATE;
+static int requestedVolume = -1; // Last volume sent to the task, to avoid flooding the queue
+static GainRamp volumeRamp;      // Output gain, applied to decoded PCM by the audio task
+static ToneControl tone;         // Bass/mid/treble, after the gain (audio task only)
+
+// Everything after the converter runs at ASRC_OUTPUT_RATE (audio task only)
+static Asrc asrc;
+static int16_t outputBlock[AUDIO_OUTPUT_BLOCK_FRAMES * 2];
+static volatile int32_t asrcCorrectionPpm = 0; // Set by updateAsrcControl() from loop()
+
+// Clock drift controller (loop() only)
+static unsigned long lastAsrcControl = 0;
+static bool asrcTracking = false;
+static float asrcErrorMs = 0;    // Smoothed relay fill minus target
+static float asrcIntegralPpm = 0;
+
+// Pause: fade out, then hold the decoder with its input buffer intact (audio task only)
+static bool pausePending = false;   // Fading out, the decoder pauses when the ramp is done
+static bool enginePaused = false;
+static bool libraryPaused = false;  // audio.pauseResume() was used and must be undone
+static int pausedVolume = 0;        // Volume to fade back in to
+
+// Start latency measurement, armed by a connect and completed by the PCM hook
+static volatile bool awaitingFirstFrame = false;
+static volatile bool awaitingFirstAudio = false;
+static unsigned long connectRequestTime = 0;
+static bool connectWarm = false;
+
+// First audible sample at the output (after the gain), armed by audioEngineWatchAudible()
+static volatile bool awaitingAudibleOutput = false;
+static volatile unsigned long audibleOutputTime = 0;
+
+// Fallback alarm tone: plays when the stream has no programme for fallbackDelayMs (audio task only)
+static FallbackTone fallbackTone;
+static bool fallbackArmed = false;
+static unsigned long fallbackDelayMs = 0;
+static unsigned long lastProgrammeMs = 0;  // Last decoded block that wasn't silence
+static unsigned long lastPcmMs = 0;        // Last decoded block of any kind
+static int16_t fallbackBlock[FALLBACK_BLOCK_FRAMES * 2];
+static uint32_t fallbackBlockOffset = 0;   // Bytes of fallbackBlock already written
+static uint32_t fallbackBlockBytes = 0;
+
+// Counters, written by the audio task and read from loop() / web server
+static AudioEngineStats engineStats = {};
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void postAudioEvent(AudioEventType type, const char* text) {
+  if (audioEventQueue == NULL) return;
+
+  AudioEvent event;
+  event.type = type;
+  strncpy(event.text, text ? text : "", sizeof(event.text) - 1);
+  event.text[sizeof(event.text) - 1] = '\0';
+
+  if (xQueueSend(audioEventQueue, &event, 0) != pdTRUE) {
+    portENTER_CRITICAL(&statsMux);
+    engineStats.eventsDropped++;
+    portEXIT_CRITICAL(&statsMux);
+  }
+}
+
+// The gain runs after the converter, at its fixed rate
+static uint32_t rampFrames(unsigned long ms) {
+  return (uint64_t)ASRC_OUTPUT_RATE * ms / 1000;
+}
+
+// Drop any pause state; a new connection or stop plays at the volume from before the pause
+static void clearPause() {
+  if (pausePending || enginePaused) {
+    gainRampSetTarget(volumeRamp, pausedVolume, 0);
+  }
+  pausePending = false;
+  enginePaused = false;
+  libraryPaused = false;
+}
+
+static void finishPause() {
+  // Only a running decoder can be paused; one still connecting just stays silent
+  if (audio.isRunning()) {
+    libraryPaused = audio.pauseResume();
+  }
+  pausePending = false;
+  enginePaused = true;
+}
+
+// Audio task: the library re-clocks I2S to each station's rate; put it back to the
+// converter's. It does so once per connect, while the output is silent anyway.
+static void pinI2sRate() {
+  float rate = i2s_get_clk((i2s_port_t)AUDIO_I2S_PORT);
+  if (fabsf(rate - ASRC_OUTPUT_RATE) < ASRC_OUTPUT_RATE / 100) return; // Within the clock divider's accuracy
+  i2s_set_clk((i2s_port_t)AUDIO_I2S_PORT, ASRC_OUTPUT_RATE, I2S_BITS_PER_SAMPLE_16BIT, I2S_CHANNEL_STEREO);
+  portENTER_CRITICAL(&statsMux);
+  engineStats.asrcI2sReclocks++;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+// Same first-audible check as the PCM hook, for output that doesn't come from the decoder
+static void checkAudibleOutput(const int16_t* buff, uint32_t frames) {
+  for (uint32_t i = 0; i < frames * 2; i++) {
+    if (buff[i] > AUDIO_AUDIBLE_THRESHOLD || buff[i] < -AUDIO_AUDIBLE_THRESHOLD) {
+      audibleOutputTime = millis() | 1; // 0 means not yet
+      awaitingAudibleOutput = false;
+      break;
+    }
+  }
+}
+
+// Audio task: start the tone once the stream has been quiet too long, and write
+// it to I2S ourselves while the decoder isn't producing PCM
+static void serviceFallbackTone() {
+  unsigned long now = millis();
+  if (fallbackArmed && !fallbackTone.active && now - lastProgrammeMs >= fallbackDelayMs) {
+    pinI2sRate();
+    fallbackToneStart(fallbackTone, ASRC_OUTPUT_RATE);
+    telemetryOutputRestarted(); // The decoder's last block is not an underrun
+    portENTER_CRITICAL(&statsMux);
+    engineStats.fallbackStarts++;
+    portEXIT_CRITICAL(&statsMux);
+    Serial.println("Audio engine: no programme from the stream, playing fallback tone");
+  }
+  if (!fallbackTone.active && fallbackBlockBytes == 0) return;
+  if (now - lastPcmMs < FALLBACK_DECODER_IDLE_MS) return; // The PCM hook mixes it in
+
+  // Never block: DMA space is taken as it frees up, a block at a time
+  while (true) {
+    if (fallbackBlockBytes == 0) {
+      if (!fallbackTone.active) return;
+      fallbackToneRender(fallbackTone, fallbackBlock, FALLBACK_BLOCK_FRAMES);
+      gainRampProcess(volumeRamp, fallbackBlock, FALLBACK_BLOCK_FRAMES);
+      toneControlProcess(tone, fallbackBlock, FALLBACK_BLOCK_FRAMES);
+      if (awaitingAudibleOutput) checkAudibleOutput(fallbackBlock, FALLBACK_BLOCK_FRAMES);
+      fallbackBlockOffset = 0;
+      fallbackBlockBytes = sizeof(fallbackBlock);
+    }
+    size_t written = 0;
+    i2s_write((i2s_port_t)AUDIO_I2S_PORT, (const uint8_t*)fallbackBlock + fallbackBlockOffset,
+              fallbackBlockBytes, &written, 0);
+    fallbackBlockOffset += written;
+    fallbackBlockBytes -= written;
+    if (fallbackBlockBytes > 0) return; // DMA queue full
+  }
+}
+
+// Audio task: the decoder is about to write to I2S; the rest of a direct block goes first
+static void flushFallbackBlock() {
+  if (fallbackBlockBytes == 0) return;
+  size_t written = 0;
+  i2s_write((i2s_port_t)AUDIO_I2S_PORT, (const uint8_t*)fallbackBlock + fallbackBlockOffset,
+            fallbackBlockBytes, &written, pdMS_TO_TICKS(20));
+  fallbackBlockBytes = 0;
+}
+
+static void stopFallbackTone() {
+  fallbackArmed = false;
+  fallbackTone.active = false;
+  fallbackBlockBytes = 0;
+}
+
+static void processAudioCommand(const AudioCommand& cmd) {
+  switch (cmd.type) {
+    case AUDIO_CMD_CONNECT:
+      clearPause();
+      silentFrames = 0;
+      loudnessReset();
+      audio.stopSong();
+      asrcConfigure(asrc, asrc.inputRate); // Don't start with the previous station's tail
+      telemetryOutputRestarted();
+      audioActive = true;
+      connectRequestTime = cmd.requestTime;
+      connectWarm = cmd.value != 0;
+      awaitingFirstFrame = true;
+      awaitingFirstAudio = true;
+      audio.connecttohost(cmd.url);
+      break;
+    case AUDIO_CMD_STOP:
+      clearPause();
+      stopFallbackTone();
+      audio.stopSong();
+      telemetryOutputRestarted();
+      audioActive = false;
+      awaitingFirstFrame = false;
+      awaitingFirstAudio = false;
+      break;
+    case AUDIO_CMD_SET_VOLUME:
+      if (pausePending || enginePaused) {
+        pausedVolume = cmd.value; // Applied on resume
+      } else {
+        gainRampSetTarget(volumeRamp, cmd.value, rampFrames(cmd.rampMs));
+      }
+      break;
+    case AUDIO_CMD_PAUSE:
+      if (!audioActive || pausePending || enginePaused) break;
+      pausedVolume = volumeRamp.volume;
+      gainRampSetTarget(volumeRamp, 0, rampFrames(GAIN_RAMP_MS));
+      pausePending = true;
+      break;
+    case AUDIO_CMD_RESUME:
+      if (enginePaused && libraryPaused) {
+        audio.pauseResume();
+      }
+      telemetryOutputRestarted();
+      if (pausePending || enginePaused) {
+        gainRampSetTarget(volumeRamp, pausedVolume, rampFrames(GAIN_RAMP_MS));
+      }
+      pausePending = false;
+      enginePaused = false;
+      libraryPaused = false;
+      break;
+    case AUDIO_CMD_SET_TONE:
+      toneControlConfigure(tone, cmd.toneGainDb, ASRC_OUTPUT_RATE);
+      break;
+    case AUDIO_CMD_SET_GAIN_OFFSET:
+      gainRampSetOffset(volumeRamp, cmd.value, rampFrames(cmd.rampMs));
+      break;
+    case AUDIO_CMD_ARM_FALLBACK:
+      if (cmd.value > 0) {
+        fallbackArmed = true;
+        fallbackDelayMs = cmd.value;
+        lastProgrammeMs = millis();
+      } else {
+        fallbackArmed = false;
+        fallbackToneFadeOut(fallbackTone, rampFrames(GAIN_RAMP_MS));
+      }
+      break;
+  }
+
+  portENTER_CRITICAL(&statsMux);
+  engineStats.commandsProcessed++;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+static void audioTask(void* param) {
+  unsigned long lastLoopEnd = micros();
+  bool lastLoopValid = false; // No gap to measure until the first loop after a (re)connect
+
+  for (;;) {
+    // Handle all pending commands first; connecting blocks for the connection setup
+    AudioCommand cmd;
+    bool handledCommand = false;
+    while (xQueueReceive(audioCommandQueue, &cmd, 0) == pdTRUE) {
+      processAudioCommand(cmd);
+      handledCommand = true;
+    }
+    if (handledCommand) {
+      lastLoopValid = false; // Connection setup is not a deadline miss
+    }
+
+    if (audioActive) {
+      unsigned long loopStart = micros();
+      telemetryLoopStarted();
+      audio.loop();
+      unsigned long loopEnd = micros();
+      audioRunning = audio.isRunning();
+      inputFill = audio.inBufferFilled();
+      inputSize = inputFill + audio.inBufferFree();
+      if (audio.getSampleRate() > 0) outputSampleRate = audio.getSampleRate();
+      if (pausePending && (!gainRampActive(volumeRamp) || !audioRunning)) {
+        finishPause();
+      }
+
+      unsigned long gap = loopStart - lastLoopEnd;
+      unsigned long duration = loopEnd - loopStart;
+
+      portENTER_CRITICAL(&statsMux);
+      engineStats.loopCount++;
+      if (lastLoopValid) {
+        if (gap > engineStats.maxLoopGapUs) engineStats.maxLoopGapUs = gap;
+        if (gap > AUDIO_LOOP_DEADLINE_US) engineStats.deadlineMisses++;
+      }
+      if (duration > engineStats.maxLoopDurationUs) engineStats.maxLoopDurationUs = duration;
+      portEXIT_CRITICAL(&statsMux);
+
+      lastLoopEnd = loopEnd;
+      lastLoopValid = true;
+    } else {
+      audioRunning = false;
+      inputFill = 0;
+      inputSize = 0;
+      lastLoopValid = false;
+    }
+
+    serviceFallbackTone();
+
+    // Yield one tick so lower priority tasks on this core (loop()) still run
+    vTaskDelay(1);
+  }
+}
+
+void initAudioEngine() {
+  audio.setPinout(I2S_BCLK, I2S_LRC, I2S_DOUT);
+
+  // Configure audio buffer and connection settings for better streaming stability
+  audio.setConnectionTimeout(30000, 5000); // 30s connect timeout, 5s data timeout
+  audio.forceMono(false); // Ensure proper stereo handling
+  audio.setVolume(AUDIO_LIBRARY_VOLUME);
+  gainRampInit(volumeRamp, 0);
+  toneControlInit(tone);
+  asrcInit(asrc, ASRC_OUTPUT_RATE);
+
+  audioCommandQueue = xQueueCreate(AUDIO_COMMAND_QUEUE_LENGTH, sizeof(AudioCommand));
+  audioEventQueue = xQueueCreate(AUDIO_EVENT_QUEUE_LENGTH, sizeof(AudioEvent));
+  if (audioCommandQueue == NULL || audioEventQueue == NULL) {
+    Serial.println("Failed to create audio engine queues");
+    return;
+  }
+
+  BaseType_t result = xTaskCreatePinnedToCore(audioTask, "audio", AUDIO_TASK_STACK_SIZE, NULL,
+                                              AUDIO_TASK_PRIORITY, &audioTaskHandle, AUDIO_TASK_CORE);
+  if (result != pdPASS) {
+    Serial.println("Failed to start audio engine task");
+    return;
+  }
+
+  Serial.print("Audio engine started on core ");
+  Serial.println(AUDIO_TASK_CORE);
+}
+
+static bool sendAudioCommand(const AudioCommand& cmd) {
+  if (audioCommandQueue == NULL) return false;
+
+  if (xQueueSend(audioCommandQueue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    portENTER_CRITICAL(&statsMux);
+    engineStats.commandsDropped++;
+    portEXIT_CRITICAL(&statsMux);
+    Serial.println("Audio command queue full - command dropped");
+    return false;
+  }
+  return true;
+}
+
+bool audioEngineConnect(const char* url, bool warmStart) {
+  AudioCommand cmd;
+  cmd.type = AUDIO_CMD_CONNECT;
+  cmd.value = warmStart ? 1 : 0;
+  cmd.rampMs = 0;
+  cmd.requestTime = millis();
+  strncpy(cmd.url, url, sizeof(cmd.url) - 1);
+  cmd.url[sizeof(cmd.url) - 1] = '\0';
+  return sendAudioCommand(cmd);
+}
+
+void audioEngineStop() {
+  AudioCommand cmd;
+  cmd.type = AUDIO_CMD_STOP;
+  cmd.value = 0;
+  cmd.rampMs = 0;
+  cmd.requestTime = millis();
+  cmd.url[0] = '\0';
+  sendAudioCommand(cmd);
+}
+
+void audioEngineSetVolume(int vol) {
+  // Encoder changes arrive in bursts - only queue real changes
+  if (vol == requestedVolume) return;
+  audioEngineFadeVolume(vol, GAIN_RAMP_MS);
+}
+
+// Ramp the output gain to vol over durationMs (0 = jump)
+void audioEngineFadeVolume(int vol, unsigned long durationMs) {
+  AudioCommand cmd;
+  cmd.type = AUDIO_CMD_SET_VOLUME;
+  cmd.value = vol;
+  cmd.rampMs = durationMs;
+  cmd.requestTime = millis();
+  cmd.url[0] = '\0';
+  if (sendAudioCommand(cmd)) {
+    requestedVolume = vol;
+  }
+}
+
+void audioEnginePause() {
+  AudioCommand cmd;
+  cmd.type = AUDIO_CMD_PAUSE;
+  cmd.value = 0;
+  cmd.rampMs = 0;
+  cmd.requestTime = millis();
+  cmd.url[0] = '\0';
+  sendAudioCommand(cmd);
+}
+
+void audioEngineResume() {
+  AudioCommand cmd;
+  cmd.type = AUDIO_CMD_RESUME;
+  cmd.value = 0;
+  cmd.rampMs = 0;
+  cmd.requestTime = millis();
+  cmd.url[0] = '\0';
+  sendAudioCommand(cmd);
+}
+
+// Coefficients are computed once on the audio task, not per block
+void audioEngineSetTone(const int8_t* gainDb) {
+  AudioCommand cmd;
+  cmd.type = AUDIO_CMD_SET_TONE;
+  cmd.value = 0;
+  cmd.rampMs = 0;
+  cmd.requestTime = millis();
+  cmd.url[0] = '\0';
+  memcpy(cmd.toneGainDb, gainDb, sizeof(cmd.toneGainDb));
+  sendAudioCommand(cmd);
+}
+
+// Loudness normalisation: shift the volume curve by offsetDb10 (0.1 dB units)
+void audioEngineSetGainOffset(int offsetDb10, unsigned long rampMs) {
+  AudioCommand cmd;
+  cmd.type = AUDIO_CMD_SET_GAIN_OFFSET;
+  cmd.value = offsetDb10;
+  cmd.rampMs = rampMs;
+  cmd.requestTime = millis();
+  cmd.url[0] = '\0';
+  sendAudioCommand(cmd);
+}
+
+// Alarms: play the fallback tone if the stream has no programme within delayMs
+// (and whenever it goes quiet that long afterwards); 0 disarms and fades it out
+void audioEngineArmFallback(unsigned long delayMs) {
+  AudioCommand cmd;
+  cmd.type = AUDIO_CMD_ARM_FALLBACK;
+  cmd.value = delayMs;
+  cmd.rampMs = 0;
+  cmd.requestTime = millis();
+  cmd.url[0] = '\0';
+  sendAudioCommand(cmd);
+}
+
+bool audioEngineIsRunning() {
+  return audioRunning;
+}
+
+// Note when the output next becomes audible, e.g. once an alarm fade starts
+void audioEngineWatchAudible() {
+  audibleOutputTime = 0;
+  awaitingAudibleOutput = true;
+}
+
+// millis() of the first audible output since audioEngineWatchAudible(), 0 if none yet
+unsigned long audioEngineAudibleAt() {
+  return audibleOutputTime;
+}
+
+uint32_t audioEngineFramesOut() {
+  return framesOut;
+}
+
+uint32_t audioEngineInputFill() {
+  return inputFill;
+}
+
+uint32_t audioEngineInputSize() {
+  return inputSize;
+}
+
+// How long the decoded audio has been silent, 0 while there is programme
+uint32_t audioEngineSilenceMs() {
+  return (uint64_t)silentFrames * 1000 / outputSampleRate;
+}
+
+bool pollAudioEvent(AudioEvent& event) {
+  if (audioEventQueue == NULL) return false;
+  return xQueueReceive(audioEventQueue, &event, 0) == pdTRUE;
+}
+
+void getAudioEngineStats(AudioEngineStats& stats) {
+  portENTER_CRITICAL(&statsMux);
+  stats = engineStats;
+  portEXIT_CRITICAL(&statsMux);
+
+  stats.fallbackActive = fallbackTone.active;
+  stats.asrcInputRate = asrc.inputRate;
+  stats.asrcCorrectionPpm = asrcCorrectionPpm;
+  if (audioTaskHandle != NULL) {
+    stats.stackHighWater = uxTaskGetStackHighWaterMark(audioTaskHandle);
+  }
+}
+
+// loop(): steer the converter ratio so the relay buffer holds its target level,
+// absorbing the difference between the station's clock and ours. Held at zero
+// while nothing is being fed live, and reset for every new connection.
+void updateAsrcControl() {
+  if (millis() - lastAsrcControl < ASRC_CONTROL_INTERVAL_MS) return;
+  lastAsrcControl = millis();
+
+  RelayStats relay;
+  getRelayStats(relay);
+  if (!relay.active || !relay.feeding) {
+    asrcTracking = false;
+    asrcIntegralPpm = 0;
+    asrcCorrectionPpm = 0;
+    return;
+  }
+  if (relay.paused || relay.behindLiveMs > 0) return; // Time-shifted playback, the fill says nothing about the clocks
+
+  float errorMs = (float)relay.fillMs - (float)relay.targetMs;
+  if (!asrcTracking) {
+    asrcErrorMs = errorMs;
+    asrcTracking = true;
+  } else {
+    asrcErrorMs += (errorMs - asrcErrorMs) / ASRC_FILL_SMOOTHING;
+  }
+  asrcIntegralPpm = constrain(asrcIntegralPpm + asrcErrorMs * ASRC_KI_PPM_PER_MS, -ASRC_MAX_PPM, ASRC_MAX_PPM);
+  float ppm = asrcErrorMs * ASRC_KP_PPM_PER_MS + asrcIntegralPpm;
+  asrcCorrectionPpm = (int32_t)lroundf(constrain(ppm, -ASRC_MAX_PPM, ASRC_MAX_PPM));
+}
+
+void printAudioEngineStats() {
+  AudioEngineStats stats;
+  getAudioEngineStats(stats);
+
+  Serial.print("Audio engine: loops=");
+  Serial.print(stats.loopCount);
+  Serial.print(" deadlineMisses=");
+  Serial.print(stats.deadlineMisses);
+  Serial.print(" maxGap=");
+  Serial.print(stats.maxLoopGapUs);
+  Serial.print("us maxLoop=");
+  Serial.print(stats.maxLoopDurationUs);
+  Serial.print("us commands=");
+  Serial.print(stats.commandsProcessed);
+  Serial.print(" dropped=");
+  Serial.print(stats.commandsDropped);
+  Serial.print(" stackFree=");
+  Serial.println(stats.stackHighWater);
+}
+
+static void recordFirstFrame() {
+  unsigned long latency = millis() - connectRequestTime;
+  awaitingFirstFrame = false;
+
+  portENTER_CRITICAL(&statsMux);
+  engineStats.lastFirstFrameMs = latency;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+static void recordFirstAudio() {
+  unsigned long latency = millis() - connectRequestTime;
+  awaitingFirstAudio = false;
+
+  portENTER_CRITICAL(&statsMux);
+  engineStats.lastStartMs = latency;
+  engineStats.lastStartWarm = connectWarm;
+  if (connectWarm) {
+    engineStats.warmStarts++;
+    engineStats.warmStartTotalMs += latency;
+  } else {
+    engineStats.coldStarts++;
+    engineStats.coldStartTotalMs += latency;
+  }
+  portEXIT_CRITICAL(&statsMux);
+
+  Serial.print("First audible sample ");
+  Serial.print(latency);
+  Serial.println(connectWarm ? "ms after request (standby)" : "ms after request (cold)");
+}
+
+// Dead-air check: mean energy of a subsampled block against AUDIO_SILENCE_LEVEL
+static bool isBlockSilent(const int16_t* buff, uint32_t frames) {
+  uint32_t sumSquares = 0;
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < frames; i += AUDIO_SILENCE_STRIDE) {
+    int32_t left = buff[i * 2];
+    int32_t right = buff[i * 2 + 1];
+    // Anything clearly above the threshold ends the check early
+    // (this also keeps the 32-bit sum from overflowing)
+    if (abs(left) > 8 * AUDIO_SILENCE_LEVEL || abs(right) > 8 * AUDIO_SILENCE_LEVEL) return false;
+    sumSquares += left * left + right * right;
+    count += 2;
+  }
+  return count == 0 || sumSquares < (uint32_t)AUDIO_SILENCE_LEVEL * AUDIO_SILENCE_LEVEL * count;
+}
+
+// Audio task: convert a decoded block to ASRC_OUTPUT_RATE, then mix in the
+// fallback tone, apply gain and tone control and write it to I2S ourselves
+static void convertAndOutput(const int16_t* buff, uint32_t frames) {
+  uint32_t rate = audio.getSampleRate();
+  if (rate > 0 && rate != asrc.inputRate) {
+    asrcConfigure(asrc, rate);
+    portENTER_CRITICAL(&statsMux);
+    engineStats.asrcRateChanges++;
+    portEXIT_CRITICAL(&statsMux);
+  }
+  asrcSetCorrection(asrc, asrcCorrectionPpm);
+  pinI2sRate();
+
+  uint32_t taken = 0;
+  while (taken < frames) {
+    taken += asrcWrite(asrc, buff + taken * 2, frames - taken);
+    uint32_t n;
+    while ((n = asrcRead(asrc, outputBlock, AUDIO_OUTPUT_BLOCK_FRAMES)) > 0) {
+      if (fallbackTone.active) fallbackToneMix(fallbackTone, outputBlock, n);
+      gainRampProcess(volumeRamp, outputBlock, n);
+      toneControlProcess(tone, outputBlock, n);
+      if (awaitingAudibleOutput) checkAudibleOutput(outputBlock, n);
+
+      // Blocks like the library's own write: I2S paces the decoder
+      size_t written = 0;
+      i2s_write((i2s_port_t)AUDIO_I2S_PORT, outputBlock, n * 4, &written, pdMS_TO_TICKS(AUDIO_I2S_WRITE_TIMEOUT_MS));
+      if (written < n * 4) {
+        portENTER_CRITICAL(&statsMux);
+        engineStats.asrcDroppedFrames += n - written / 4;
+        portEXIT_CRITICAL(&statsMux);
+      }
+    }
+  }
+}
+
+// PCM hook from the audio library, runs on the audio task before I2S output.
+// buff holds len interleaved stereo frames at the station's rate.
+void audio_process_extern(int16_t* buff, uint16_t len, bool* continueI2S) {
+  *continueI2S = false; // Converted and written to I2S below
+  framesOut += len;
+  telemetryBlockDecoded(outputSampleRate);
+
+  if (awaitingFirstFrame) recordFirstFrame();
+  if (awaitingFirstAudio) {
+    for (uint32_t i = 0; i < (uint32_t)len * 2; i++) {
+      if (buff[i] > AUDIO_AUDIBLE_THRESHOLD || buff[i] < -AUDIO_AUDIBLE_THRESHOLD) {
+        recordFirstAudio();
+        break;
+      }
+    }
+  }
+
+  bool silent = isBlockSilent(buff, len);
+  if (silent) {
+    silentFrames += len;
+  } else {
+    silentFrames = 0;
+  }
+
+  loudnessProcess(buff, len, outputSampleRate);
+  levelMeterProcess(buff, len); // Before the gain, so the meter shows the programme level
+
+  // Fallback tone: carried on the decoder output, faded out once there is programme
+  lastPcmMs = millis();
+  if (!silent) lastProgrammeMs = lastPcmMs;
+  flushFallbackBlock();
+  if (fallbackTone.active && !silent && fallbackTone.fadeStep == 0) {
+    fallbackToneFadeOut(fallbackTone, rampFrames(FALLBACK_CROSSFADE_MS));
+    portENTER_CRITICAL(&statsMux);
+    engineStats.fallbackHandovers++;
+    portEXIT_CRITICAL(&statsMux);
+  }
+
+  convertAndOutput(buff, len);
+}
+
+// Audio callback functions - these run on the audio engine task
+void audio_info(const char *info) {
+  Serial.print("info        "); Serial.println(info);
+  telemetryDecoderInfo(info);
+}
+void audio_id3data(const char *info) {
+  Serial.print("id3data     "); Serial.println(info);
+}
+void audio_eof_mp3(const char *info) {
+  Serial.print("eof_mp3     "); Serial.println(info);
+}
+void audio_showstation(const char *info) {
+  Serial.print("station     "); Serial.println(info);
+  postAudioEvent(AUDIO_EVENT_STATION, info);
+}
+void audio_showstreaminfo(const char *info) {
+  Serial.print("streaminfo  "); Serial.println(info);
+}
+void audio_showstreamtitle(const char *info) {
+  Serial.print("streamtitle "); Serial.println(info);
+  postAudioEvent(AUDIO_EVENT_TITLE, info);
+}
+void audio_bitrate(const char *info) {
+  Serial.print("bitrate     "); Serial.println(info);
+}
+void audio_commercial(const char *info) {
+  Serial.print("commercial  "); Serial.println(info);
+}
+void audio_icyurl(const char *info) {
+  Serial.print("icyurl      "); Serial.println(info);
+}
+void audio_lasthost(const char *info) {
+  Serial.print("lasthost    "); Serial.println(info);
+}
+void audio_eof_speech(const char *info) {
+  Serial.print("eof_speech  "); Serial.println(info);
+}
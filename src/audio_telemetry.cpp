@@ -0,0 +1,203 @@
+#include "audio_telemetry.h"
+#include "audio_engine.h"
+#include "stream_relay.h"
+
+// Audio task state
+static unsigned long loopStartUs = 0;
+static bool loopDecoded = false;        // A block was already timed in this audio.loop()
+static unsigned long lastBlockUs = 0;
+static bool lastBlockValid = false;     // No output gap to measure after a (re)start
+
+// loop() state
+static unsigned long lastUpdate = 0;
+static unsigned long secondStart = 0;
+static uint32_t secondMaxLoopMs = 0;
+static uint32_t lastBytesReceived = 0;
+static uint32_t lastUnderruns = 0;
+static uint32_t lastDecodeErrors = 0;
+static int historyHead = 0;             // Next slot to write
+
+// Counters, written by the audio task and loop(), read by the web server
+static AudioTelemetry telemetry = {};
+static portMUX_TYPE telemetryMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int decodeBucket(uint32_t us) {
+  int bucket = 0;
+  uint32_t v = us >> TELEMETRY_DECODE_FIRST_SHIFT;
+  while (v != 0 && bucket < TELEMETRY_DECODE_BUCKETS - 1) {
+    v >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+// Audio task: called right before audio.loop()
+void telemetryLoopStarted() {
+  loopStartUs = micros();
+  loopDecoded = false;
+}
+
+// Audio task: a decoded PCM block is about to be written to I2S.
+// Decode time is audio.loop() start to its first block; a gap between blocks
+// longer than the DMA queue means the I2S output ran dry.
+void telemetryBlockDecoded(uint32_t sampleRate) {
+  unsigned long now = micros();
+  bool timed = !loopDecoded;
+  uint32_t decodeUs = now - loopStartUs;
+  loopDecoded = true;
+
+  bool underrun = false;
+  if (lastBlockValid && sampleRate > 0) {
+    uint32_t dmaUs = (uint64_t)TELEMETRY_I2S_DMA_FRAMES * 1000000 / sampleRate;
+    underrun = now - lastBlockUs > dmaUs;
+  }
+  lastBlockUs = now;
+  lastBlockValid = true;
+
+  portENTER_CRITICAL(&telemetryMux);
+  if (timed) {
+    telemetry.decodeHistogram[decodeBucket(decodeUs)]++;
+    if (decodeUs > telemetry.decodeMaxUs) telemetry.decodeMaxUs = decodeUs;
+  }
+  if (underrun) telemetry.outputUnderruns++;
+  portEXIT_CRITICAL(&telemetryMux);
+}
+
+// Audio task: connect, stop and resume interrupt the output on purpose
+void telemetryOutputRestarted() {
+  lastBlockValid = false;
+}
+
+// Audio task: the library reports decoder problems through audio_info()
+void telemetryDecoderInfo(const char* info) {
+  if (strstr(info, "error") == NULL && strstr(info, "Error") == NULL &&
+      strstr(info, "syncword not found") == NULL) {
+    return;
+  }
+  portENTER_CRITICAL(&telemetryMux);
+  telemetry.decodeErrors++;
+  portEXIT_CRITICAL(&telemetryMux);
+}
+
+static void logUnderrunSecond(const TelemetrySample& sample) {
+  Serial.print("Telemetry: ");
+  Serial.print(sample.underruns);
+  Serial.print(" output underrun(s), input ");
+  Serial.print(sample.inputFillPct);
+  Serial.print("% relay ");
+  Serial.print(sample.relayFillMs);
+  Serial.print("ms ");
+  Serial.print(sample.kbps);
+  Serial.print("kbps, loop() max ");
+  Serial.print(sample.maxLoopMs);
+  Serial.println("ms");
+}
+
+// loop(): time loop() itself and take the per-second sample
+void updateAudioTelemetry() {
+  unsigned long now = millis();
+  if (lastUpdate != 0 && now - lastUpdate > secondMaxLoopMs) {
+    secondMaxLoopMs = now - lastUpdate;
+  }
+  lastUpdate = now;
+
+  unsigned long elapsed = now - secondStart;
+  if (elapsed < 1000) return;
+  secondStart = now;
+
+  RelayStats relay;
+  getRelayStats(relay);
+  bool running = audioEngineIsRunning();
+
+  portENTER_CRITICAL(&telemetryMux);
+  uint32_t underruns = telemetry.outputUnderruns;
+  uint32_t decodeErrors = telemetry.decodeErrors;
+  portEXIT_CRITICAL(&telemetryMux);
+
+  TelemetrySample sample;
+  sample.time = now;
+  uint32_t inputSize = audioEngineInputSize();
+  sample.inputFillPct = inputSize > 0 ? (uint64_t)audioEngineInputFill() * 100 / inputSize : 0;
+  sample.relayFillMs = relay.active ? min(relay.fillMs, (uint32_t)UINT16_MAX) : 0;
+  uint32_t bytesPerSecond = (relay.bytesReceived - lastBytesReceived) * 1000 / elapsed;
+  sample.kbps = min(bytesPerSecond * 8 / 1000, (uint32_t)UINT16_MAX);
+  sample.maxLoopMs = min(secondMaxLoopMs, (uint32_t)UINT16_MAX);
+  sample.underruns = min(underruns - lastUnderruns, (uint32_t)UINT8_MAX);
+  sample.decodeErrors = min(decodeErrors - lastDecodeErrors, (uint32_t)UINT8_MAX);
+
+  lastBytesReceived = relay.bytesReceived;
+  lastUnderruns = underruns;
+  lastDecodeErrors = decodeErrors;
+  uint32_t loopMs = secondMaxLoopMs;
+  secondMaxLoopMs = 0;
+
+  // Only playback is worth keeping in the history
+  if (!running && !relay.active) return;
+
+  portENTER_CRITICAL(&telemetryMux);
+  if (running) {
+    telemetry.fillHistogram[min(sample.inputFillPct / 10, TELEMETRY_FILL_BUCKETS - 1)]++;
+  }
+  telemetry.bytesPerSecond = bytesPerSecond;
+  if (loopMs > telemetry.maxLoopMs) telemetry.maxLoopMs = loopMs;
+  telemetry.history[historyHead] = sample;
+  historyHead = (historyHead + 1) % TELEMETRY_HISTORY_SECONDS;
+  if (telemetry.historyCount < TELEMETRY_HISTORY_SECONDS) telemetry.historyCount++;
+  portEXIT_CRITICAL(&telemetryMux);
+
+  if (sample.underruns > 0) logUnderrunSecond(sample);
+}
+
+void getAudioTelemetry(AudioTelemetry& out) {
+  portENTER_CRITICAL(&telemetryMux);
+  out = telemetry;
+  // Rotate the history so it reads oldest first
+  int start = (historyHead - telemetry.historyCount + TELEMETRY_HISTORY_SECONDS) % TELEMETRY_HISTORY_SECONDS;
+  for (int i = 0; i < telemetry.historyCount; i++) {
+    out.history[i] = telemetry.history[(start + i) % TELEMETRY_HISTORY_SECONDS];
+  }
+  portEXIT_CRITICAL(&telemetryMux);
+}
+
+void resetAudioTelemetry() {
+  portENTER_CRITICAL(&telemetryMux);
+  telemetry = {};
+  historyHead = 0;
+  lastUnderruns = 0;
+  lastDecodeErrors = 0;
+  portEXIT_CRITICAL(&telemetryMux);
+}
+
+void printAudioTelemetry() {
+  static AudioTelemetry t; // Too big for the loop() stack with the history
+  getAudioTelemetry(t);
+
+  Serial.print("Telemetry: decode us <");
+  for (int i = 0; i < TELEMETRY_DECODE_BUCKETS; i++) {
+    if (i > 0) Serial.print(i == TELEMETRY_DECODE_BUCKETS - 1 ? " >=" : " <");
+    Serial.print(1UL << (TELEMETRY_DECODE_FIRST_SHIFT + (i == TELEMETRY_DECODE_BUCKETS - 1 ? i - 1 : i)));
+    Serial.print(":");
+    Serial.print(t.decodeHistogram[i]);
+  }
+  Serial.print(" max=");
+  Serial.println(t.decodeMaxUs);
+
+  Serial.print("Telemetry: input fill %");
+  for (int i = 0; i < TELEMETRY_FILL_BUCKETS; i++) {
+    Serial.print(" ");
+    Serial.print(i * 10);
+    Serial.print(":");
+    Serial.print(t.fillHistogram[i]);
+  }
+  Serial.println();
+
+  Serial.print("Telemetry: underruns=");
+  Serial.print(t.outputUnderruns);
+  Serial.print(" decodeErrors=");
+  Serial.print(t.decodeErrors);
+  Serial.print(" bytesPerSecond=");
+  Serial.print(t.bytesPerSecond);
+  Serial.print(" maxLoop=");
+  Serial.print(t.maxLoopMs);
+  Serial.println("ms");
+}
@@ -2,15 +2,16 @@
 #include "config.h"
 #include "settings.h"
 #include "menu.h"
-#include "alarm.h"
 #include "wifi_config.h"
-#include "weather.h"
+#include "level_meter.h"
+#include "stream_relay.h"
+#include "alloc_counter.h"
 #include "Wire.h"
 #include "time.h"
 #include "WiFi.h"
 
 // Display variables
-LiquidCrystal_I2C lcd(LCD_ADDRESS, LCD_COLS, LCD_ROWS);
+LcdFramebuffer lcd(LCD_ADDRESS);
 unsigned long lastLcdUpdate = 0;
 bool isStreaming = false;
 String currentStreamName = "";
@@ -40,12 +41,20 @@ String temporaryMessage = "";
 unsigned long temporaryMessageStart = 0;
 unsigned long temporaryMessageDuration = 3000;
 
-// Variables to track what's currently displayed to avoid unnecessary updates
-String lastDisplayedLine0 = "";
-String lastDisplayedLine1 = "";
+// Screen mode of the last update, a change starts from a blank frame
 bool lastShowVolumeDisplay = false;
 bool lastInMenu = false;
 
+// Level meter state
+bool levelMeterVisible = false;
+unsigned long lastMeterFrame = 0;
+
+// Heap allocations while rendering, expected to stay at zero
+static DisplayFrameStats frameAllocStats = {};
+static portMUX_TYPE frameStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool renderLCD();
+
 // Custom characters for LCD display
 byte backspaceSymbol[8] = {
   0b00000,
@@ -114,16 +123,73 @@ byte upArrowSymbol[8] = {
   0b00000
 };
 
+// Level meter characters
+byte meterHalfSymbol[8] = {
+  0b11100,
+  0b11100,
+  0b11100,
+  0b11100,
+  0b11100,
+  0b11100,
+  0b11100,
+  0b00000
+};
 
-// Helper function to check if any alarms are enabled
-bool hasEnabledAlarms() {
-  for (int i = 0; i < MAX_ALARMS; i++) {
-    if (alarms[i].enabled) {
-      return true;
-    }
-  }
-  return false;
-}
+byte meterPeakSymbol[8] = {
+  0b00110,
+  0b00110,
+  0b00110,
+  0b00110,
+  0b00110,
+  0b00110,
+  0b00110,
+  0b00000
+};
+
+// More weather characters, previously letters for lack of CGRAM slots
+byte rainSymbol[8] = {
+  0b01110,
+  0b11111,
+  0b11111,
+  0b00000,
+  0b10101,
+  0b00000,
+  0b10101,
+  0b00000
+};
+
+byte snowSymbol[8] = {
+  0b00100,
+  0b10101,
+  0b01110,
+  0b00100,
+  0b01110,
+  0b10101,
+  0b00100,
+  0b00000
+};
+
+byte thunderSymbol[8] = {
+  0b00010,
+  0b00100,
+  0b01000,
+  0b11111,
+  0b00010,
+  0b00100,
+  0b01000,
+  0b00000
+};
+
+byte mistSymbol[8] = {
+  0b00000,
+  0b11111,
+  0b00000,
+  0b11111,
+  0b00000,
+  0b11111,
+  0b00000,
+  0b00000
+};
 
 void scanI2C() {
   Serial.println("Scanning for I2C devices...");
@@ -160,88 +226,81 @@ void setupLCD() {
   
   lcd.init();
   lcd.backlight();
-  lcd.clear();
   
-  // Create custom characters
-  lcd.createChar(0, backspaceSymbol);  // Character 0: backspace
-  lcd.createChar(1, degreeSymbol);     // Character 1: degree symbol
-  lcd.createChar(2, sunSymbol);        // Character 2: sun
-  lcd.createChar(3, cloudSymbol);      // Character 3: cloud
-  lcd.createChar(4, clockSymbol);      // Character 4: clock
-  lcd.createChar(5, upArrowSymbol);    // Character 5: up arrow
+  // Define custom characters with the ROM character shown if no CGRAM slot is free
+  lcd.defineGlyph(GLYPH_BACKSPACE, backspaceSymbol, '<');
+  lcd.defineGlyph(GLYPH_DEGREE, degreeSymbol, (char)0xDF); // ROM degree sign
+  lcd.defineGlyph(GLYPH_SUN, sunSymbol, '*');
+  lcd.defineGlyph(GLYPH_CLOUD, cloudSymbol, 'c');
+  lcd.defineGlyph(GLYPH_CLOCK, clockSymbol, 'A');
+  lcd.defineGlyph(GLYPH_UP_ARROW, upArrowSymbol, '^');
+  lcd.defineGlyph(GLYPH_METER_HALF, meterHalfSymbol, '|');
+  lcd.defineGlyph(GLYPH_METER_PEAK, meterPeakSymbol, '|');
+  lcd.defineGlyph(GLYPH_RAIN, rainSymbol, 'R');
+  lcd.defineGlyph(GLYPH_SNOW, snowSymbol, 'S');
+  lcd.defineGlyph(GLYPH_THUNDER, thunderSymbol, 'T');
+  lcd.defineGlyph(GLYPH_MIST, mistSymbol, 'M');
 
   // Test if LCD is responding
   lcd.setCursor(0, 0);
   lcd.print("OOSIE Radio");
   lcd.setCursor(0, 1);
   lcd.print("Starting...");
+  lcd.flush();
   
   Serial.println("LCD initialized with custom characters");
   delay(2000);
 }
 
-void updateLCDLine(int line, String content, bool center) {
-  // Pad or truncate content to exactly 16 characters
-  if (content.length() > 16) {
-    content = content.substring(0, 16);
-  }
+// Switch row 1 between text and the level meter bar
+static void showLevelMeter(bool show) {
+  if (show == levelMeterVisible) return;
   
-  if (center && content.length() < 16) {
-    int padding = (16 - content.length()) / 2;
-    String centeredContent = "";
-    for (int i = 0; i < padding; i++) centeredContent += " ";
-    centeredContent += content;
-    while (centeredContent.length() < 16) centeredContent += " ";
-    content = centeredContent;
-  } else {
-    // Pad with spaces to clear any remaining characters
-    while (content.length() < 16) content += " ";
-  }
-  
-  // Only update if content has changed
-  String* lastDisplayed = (line == 0) ? &lastDisplayedLine0 : &lastDisplayedLine1;
-  if (*lastDisplayed != content) {
-    lcd.setCursor(0, line);
-    lcd.print(content);
-    *lastDisplayed = content;
-  }
+  levelMeterVisible = show;
+  levelMeterSetActive(show);
 }
 
-bool isTrackScrollComplete(const String& fullText) {
-  if (fullText.length() <= 16) {
-    return true; // No scrolling needed, always complete
-  }
+// Draw one meter frame, at most every 1000 / LEVEL_METER_FPS ms
+static void updateLevelMeterBar() {
+  unsigned long now = millis();
+  if (now - lastMeterFrame < 1000 / LEVEL_METER_FPS) return;
+  lastMeterFrame = now;
+  
+  LevelMeterLevels levels;
+  levelMeterFrame(levels);
   
-  int maxPosition = fullText.length() - 16;
-  // Consider complete when we've scrolled through the text and paused at the end
-  return trackScrollPosition > maxPosition + 5; // Almost at reset point
+  uint8_t cells[LCD_COLS];
+  composeLevelMeterRow(levels, cells);
+  
+  // flush() sends only the cells that changed
+  lcd.setCursor(0, 1);
+  lcd.write(cells, LCD_COLS);
 }
 
-String getScrolledTrackText(const String& fullText) {
-  if (fullText.length() <= 16) {
-    // Text fits, no scrolling needed
-    trackScrollPosition = 0;
-    return fullText;
-  }
+void updateLCDLine(int line, const LcdLine& content, bool center) {
+  // Any text on row 1 replaces the level meter
+  if (line == 1) showLevelMeter(false);
   
-  // Check if it's time to scroll
-  if (millis() - lastTrackScroll >= 300) { // Scroll every 300ms (faster)
-    trackScrollPosition++;
-    lastTrackScroll = millis();
-    
-    // Reset scroll position when we reach the end
-    int maxPosition = fullText.length() - 16;
-    if (trackScrollPosition > maxPosition + 6) { // +6 for longer pause at end
-      trackScrollPosition = 0;
-    }
-  }
+  LcdLine text = content;
+  if (center) lineCenter(text);
+  linePad(text, LCD_COLS); // Clear any remaining characters
   
-  // Get the substring to display
-  if (trackScrollPosition <= fullText.length() - 16) {
-    return fullText.substring(trackScrollPosition, trackScrollPosition + 16);
-  } else {
-    // At the end, show the last 16 characters
-    return fullText.substring(fullText.length() - 16);
+  // Unchanged cells are skipped by flush()
+  lcd.setCursor(0, line);
+  lcd.write((const uint8_t*)text.text, text.length);
+}
+
+void updateLCDLine(int line, const char* content, bool center) {
+  LcdLine text;
+  lineClear(text);
+  lineAppend(text, content);
+  updateLCDLine(line, text, center);
+}
+
+// Rows composed by display_render.cpp
+static void writeRows(const DisplayRows& rows) {
+  for (int i = 0; i < LCD_ROWS; i++) {
+    updateLCDLine(i, rows.line[i], rows.center[i]);
   }
 }
 
@@ -253,23 +312,46 @@ void updateLCD() {
     return;
   }
   
+  // Regular screens are composed on the stack; count anything that still reaches the heap
+  allocCounterStart();
+  bool rendered = renderLCD();
+  uint32_t allocations = allocCounterStop();
+  
+  portENTER_CRITICAL(&frameStatsMux);
+  if (rendered) {
+    frameAllocStats.frames++;
+    frameAllocStats.lastAllocations = allocations;
+  }
+  frameAllocStats.allocations += allocations;
+  if (allocations > 0) frameAllocStats.framesWithAllocations++;
+  if (allocations > frameAllocStats.maxAllocations) frameAllocStats.maxAllocations = allocations;
+  portEXIT_CRITICAL(&frameStatsMux);
+}
+
+// Returns false when it was not time for a regular update
+static bool renderLCD() {
+  DisplayRows rows;
+  
   // Handle temporary message display
   if (showTemporaryMessage) {
     if (millis() - temporaryMessageStart >= temporaryMessageDuration) {
       // Timeout reached, hide temporary message
       showTemporaryMessage = false;
       lcd.clear();
-      lastDisplayedLine0 = "";
-      lastDisplayedLine1 = "";
       forceImmediateLcdUpdate = true;
     } else {
       // Show temporary message
-      updateLCDLine(0, "ALARM", true);
-      updateLCDLine(1, temporaryMessage, true);
-      return;
+      composeTemporaryMessage(rows);
+      writeRows(rows);
+      return true;
     }
   }
   
+  // The level meter refreshes at its own frame rate between regular updates
+  if (levelMeterVisible && !inMenu && !showVolumeDisplay) {
+    updateLevelMeterBar();
+  }
+  
   // Check if we need immediate update or if it's time for regular update
   // During time editing, update more frequently for blinking effect
   unsigned long updateInterval = LCD_UPDATE_INTERVAL;
@@ -277,7 +359,7 @@ void updateLCD() {
     updateInterval = 250; // Update every 250ms for smooth blinking
   }
   
-  if (!forceImmediateLcdUpdate && (millis() - lastLcdUpdate < updateInterval)) return;
+  if (!forceImmediateLcdUpdate && (millis() - lastLcdUpdate < updateInterval)) return false;
   
   lastLcdUpdate = millis();
   forceImmediateLcdUpdate = false;  // Reset the flag
@@ -287,325 +369,65 @@ void updateLCD() {
     showVolumeDisplay = false;
   }
   
-  // If transitioning between volume display and normal display, clear screen once
-  if (lastShowVolumeDisplay != showVolumeDisplay) {
+  // Start from a blank frame when switching between volume, menu and normal display;
+  // cells that end up unchanged are not sent again
+  if (lastShowVolumeDisplay != showVolumeDisplay || lastInMenu != inMenu) {
     lcd.clear();
-    lastDisplayedLine0 = "";
-    lastDisplayedLine1 = "";
     lastShowVolumeDisplay = showVolumeDisplay;
-  }
-  
-  // If transitioning into or out of menu mode, clear screen once
-  if (lastInMenu != inMenu) {
-    lcd.clear();
-    lastDisplayedLine0 = "";
-    lastDisplayedLine1 = "";
     lastInMenu = inMenu;
   }
   
   if (inMenu) {
     // For menu mode, use optimized display that only updates changed content
+    showLevelMeter(false);
     displayCurrentMenuOptimized();
-    return;
+    return true;
   }
   
   // Show volume display when adjusting volume outside menu
   if (showVolumeDisplay) {
-    updateLCDLine(0, "Volume", true);
-    updateLCDLine(1, "Level: " + String(volume), true);
-    return;
-  }
-  
-  struct tm timeinfo;
-  if(!getLocalTime(&timeinfo)){
-    return; // Skip update if time not available
-  }
-  
-  char timeStr[6];
-  strftime(timeStr, sizeof(timeStr), "%H:%M", &timeinfo);
-  
-  // Get weather string for display
-  String weatherStr = "";
-  if (weatherApiKey.length() == 0) {
-    weatherStr = ""; // No API key, show nothing
-  } else if (currentWeather.valid) {
-    weatherStr = formatTemperature(currentWeather.temperature) + currentWeather.icon;
-  } else {
-    weatherStr = "?" + String((char)1) + "C"; // ?°C using custom degree symbol
-  }
-  
-  // Time + Weather layout: "12:34 🕐 Z 22°C☀" with fixed positions for indicators
-  String timeWeatherLine = String(timeStr);
-  
-  // Add clock symbol (always reserve space for consistent positioning)
-  if (hasEnabledAlarms()) {
-    timeWeatherLine += " " + String((char)4); // Clock symbol (character 4)
-  } else {
-    timeWeatherLine += "  "; // Reserve 2 spaces (space + clock position)
-  }
-  
-  // Add sleep timer indicator (always reserve space for consistent positioning)
-  if (sleepTimerActive) {
-    timeWeatherLine += " Z";
-  } else {
-    timeWeatherLine += "  "; // Reserve 2 spaces (space + Z position)
-  }
-  
-  // Calculate spacing to right-align weather on 16-char display
-  int remainingSpace = 16 - timeWeatherLine.length() - weatherStr.length();
-  if (remainingSpace > 0) {
-    for (int i = 0; i < remainingSpace; i++) {
-      timeWeatherLine += " ";
-    }
-    timeWeatherLine += weatherStr;
-  } else {
-    // If everything doesn't fit, truncate weather
-    int maxWeatherLen = 16 - timeWeatherLine.length() - 1;
-    if (maxWeatherLen > 0) {
-      timeWeatherLine += " " + weatherStr.substring(0, maxWeatherLen);
-    }
+    composeVolumeScreen(rows);
+    writeRows(rows);
+    return true;
   }
   
-  // Check for active alarm or snoozing alarm first (highest priority display)
-  if (activeAlarmIndex >= 0) {
-    // Active alarm - show alarm info and controls
-    updateLCDLine(0, "ALARM " + String(activeAlarmIndex + 1) + "  STOP" + String((char)5), false); // Character 5 is up arrow
-    updateLCDLine(1, currentStreamName, true);
-    return;
-  }
-  
-  // Check for snoozing alarm
-  int snoozingIndex = getSnoozingAlarmIndex();
-  if (snoozingIndex >= 0) {
-    // Calculate remaining snooze time
-    unsigned long snoozeElapsed = millis() - alarms[snoozingIndex].snoozeStart;
-    unsigned long snoozeTotal = ALARM_SNOOZE_MINUTES * 60 * 1000;
-    if (snoozeElapsed < snoozeTotal) {
-      unsigned long remaining = (snoozeTotal - snoozeElapsed) / 1000; // Convert to seconds
-      int minutes = remaining / 60;
-      int seconds = remaining % 60;
-      char timeStr[6];
-      sprintf(timeStr, "%02d:%02d", minutes, seconds);
-      
-      // Show time on first line, snooze countdown on second line
-      updateLCDLine(0, timeWeatherLine, false);
-      updateLCDLine(1, "SNOOZE    " + String(timeStr), false);
-      return;
-    }
+  DisplayInputs inputs = {};
+  inputs.timeValid = getLocalTime(&inputs.time);
+  inputs.behindLive = streamBehindLive();
+  if (streamPaused || inputs.behindLive) {
+    RelayStats relay;
+    getRelayStats(relay);
+    inputs.behindLiveMs = relay.behindLiveMs;
   }
   
-  if (radioPowerOn && isStreaming) {
-    // Radio is on: Top line: Time + Weather
-    updateLCDLine(0, timeWeatherLine, false);
-    
-    // Bottom line: Alternate between station name and track info (if available)
-    String bottomLineText = currentStreamName;
-    
-    if (hasTrackInfo && currentTrackInfo.length() > 0) {
-      // Check if it's time to toggle display
-      bool shouldToggle = false;
-      
-      if (currentTrackInfo.length() <= 16) {
-        // Short track name - use 10 second timer
-        shouldToggle = (millis() - lastTrackToggle >= 10000);
-      } else {
-        // Long track name - wait for scroll to complete OR 20 seconds max
-        shouldToggle = (isTrackScrollComplete(currentTrackInfo) && (millis() - lastTrackToggle >= 5000)) ||
-                      (millis() - lastTrackToggle >= 20000);
-      }
-      
-      if (shouldToggle) {
-        showTrackInfo = !showTrackInfo;
-        lastTrackToggle = millis();
-        // Reset scroll position when switching display
-        trackScrollPosition = 0;
-        lastTrackScroll = millis();
-      }
-      
-      if (showTrackInfo) {
-        bottomLineText = getScrolledTrackText(currentTrackInfo);
-      }
-    } else {
-      // No track info available, always show station name
-      showTrackInfo = false;
-    }
-    
-    updateLCDLine(1, bottomLineText, !showTrackInfo); // Center station name, don't center scrolling track info
-  } else {
-    // Radio is off or not streaming: Top line: Time + Weather
-    updateLCDLine(0, timeWeatherLine, false);
-    // Bottom line: Show radio status
-    if (!radioPowerOn) {
-      updateLCDLine(1, "Radio OFF", true);
-    } else {
-      updateLCDLine(1, "", false); // Empty if on but not streaming
-    }
+  switch (composeMainScreen(rows, inputs)) {
+    case DISPLAY_ROWS_NONE:
+      break; // Skip update if time not available
+    case DISPLAY_ROWS_TEXT:
+      writeRows(rows);
+      break;
+    case DISPLAY_ROWS_LEVEL_METER:
+      // Bottom line: level meter (drawn by updateLevelMeterBar())
+      updateLCDLine(0, rows.line[0], rows.center[0]);
+      showLevelMeter(true);
+      break;
   }
+  return true;
 }
 
 void displayCurrentMenuOptimized() {
-  String line0 = "";
-  String line1 = "";
-  
-  switch (currentMenu) {
-    case MENU_SLEEP: {
-      line0 = "MENU: Sleep";
-      switch (currentSleepMenu) {
-        case SLEEP_MENU_BLANK:
-          line1 = ""; // Blank line
-          break;
-        case SLEEP_MENU_OFF:
-          line1 = "OFF";
-          break;
-        case SLEEP_MENU_15MIN:
-          line1 = "15 minutes";
-          break;
-        case SLEEP_MENU_30MIN:
-          line1 = "30 minutes";
-          break;
-        case SLEEP_MENU_60MIN:
-          line1 = "60 minutes";
-          break;
-        case SLEEP_MENU_90MIN:
-          line1 = "90 minutes";
-          break;
-        case SLEEP_MENU_5MIN:
-          line1 = "5 minutes";
-          break;
-      }
-      break;
-    }
-    case MENU_STREAMS: {
-      line0 = "MENU: Station";
-      String streamName = menuStreams[currentStream].name;
-      if (streamName.length() > 16) {
-        streamName = streamName.substring(0, 16);
-      }
-      line1 = streamName;
-      break;
-    }
-    case MENU_BRIGHTNESS: {
-      line0 = "MENU: Backlight";
-      line1 = "Mode: " + String(backlightAlwaysOn ? "ALWAYS ON" : "AUTO OFF");
-      break;
-    }
-    case MENU_WIFI: {
-      if (showingConfirmation) {
-        line0 = "Reset WiFi?";
-        line1 = confirmationChoice ? "> YES    NO" : "  YES  > NO";
-      } else {
-        line0 = "MENU: WiFi";
-        switch (currentWiFiMenu) {
-          case WIFI_MENU_IP: {
-            if (WiFi.status() == WL_CONNECTED) {
-              String ip = WiFi.localIP().toString();
-              if (ip.length() > 16) {
-                // Truncate IP if too long
-                ip = ip.substring(0, 16);
-              }
-              line1 = ip;
-            } else {
-              line1 = "Not connected";
-            }
-            break;
-          }
-          case WIFI_MENU_SSID: {
-            String displaySSID = ssid;
-            if (displaySSID.length() > 10) {
-              displaySSID = displaySSID.substring(0, 10);
-            }
-            line1 = "SSID: " + displaySSID;
-            break;
-          }
-          case WIFI_MENU_PASSWORD: {
-            line1 = "PASS: ";
-            if (password.length() > 0) {
-              line1 += "*****";
-            }
-            break;
-          }
-          case WIFI_MENU_RESET: {
-            line1 = "Reset WiFi";
-            break;
-          }
-        }
-      }
-      break;
-    }
-    case MENU_WEATHER: {
-      line0 = "MENU: Weather";
-      switch (currentWeatherMenu) {
-        case WEATHER_MENU_TEMPERATURE: {
-          line1 = "TEMP: ";
-          if (currentWeather.valid) {
-            line1 += String((int)currentWeather.temperature) + "C";
-          } else {
-            line1 += "--";
-          }
-          break;
-        }
-        case WEATHER_MENU_HUMIDITY: {
-          line1 = "HUM: ";
-          if (currentWeather.valid) {
-            line1 += String(currentWeather.humidity) + "%";
-          } else {
-            line1 += "--";
-          }
-          break;
-        }
-        case WEATHER_MENU_DESCRIPTION: {
-          line1 = "DESC: ";
-          if (currentWeather.valid) {
-            String desc = currentWeather.description;
-            if (desc.length() > 10) {
-              desc = desc.substring(0, 10);
-            }
-            line1 += desc;
-          } else {
-            line1 += "--";
-          }
-          break;
-        }
-        case WEATHER_MENU_API_KEY: {
-          line1 = "API: ";
-          if (weatherApiKey.length() > 0) {
-            line1 += "SET";
-          } else {
-            line1 += "NOT SET";
-          }
-          break;
-        }
-        case WEATHER_MENU_UPDATE: {
-          line1 = "Update Weather";
-          break;
-        }
-      }
-      break;
-    }
-    case MENU_SYSTEM: {
-      line0 = "MENU: System";
-      switch (currentSystemMenu) {
-        case SYSTEM_MENU_FIRMWARE: {
-          line1 = "Firm: ";
-          line1 += FIRMWARE_VERSION;
-          break;
-        }
-        case SYSTEM_MENU_UPDATE: {
-          line1 = "Update";
-          break;
-        }
-      }
-      break;
-    }
-    case MENU_ALARMS: {
-      // Alarm menu display is now handled by the dedicated displayAlarmMenu() function
-      displayAlarmMenu();
-      return; // Exit early since displayAlarmMenu() handles the entire display
+  DisplayInputs inputs = {};
+  if (currentMenu == MENU_WIFI && WiFi.status() == WL_CONNECTED) {
+    IPAddress ip = WiFi.localIP();
+    inputs.wifiConnected = true;
+    for (int i = 0; i < 4; i++) {
+      inputs.ip[i] = ip[i];
     }
   }
   
-  updateLCDLine(0, line0, false);
-  updateLCDLine(1, line1, false);
+  DisplayRows rows;
+  composeMenuScreen(rows, inputs);
+  writeRows(rows);
 }
 
 void showTemporaryLCDMessage(String message, unsigned long duration) {
@@ -622,3 +444,80 @@ void showTemporaryLCDMessage(String message, unsigned long duration) {
   }
 }
 
+void getDisplayFrameStats(DisplayFrameStats& stats) {
+  portENTER_CRITICAL(&frameStatsMux);
+  stats = frameAllocStats;
+  portEXIT_CRITICAL(&frameStatsMux);
+#ifdef ALLOC_COUNTER
+  stats.counting = true;
+#else
+  stats.counting = false;
+#endif
+}
+
+// I2C traffic of the framebuffer against rewriting each changed line in full
+void printLcdStats() {
+  LcdStats stats;
+  lcd.getStats(stats);
+  
+  Serial.print("LCD: I2C ");
+  Serial.print(stats.bytesPerSecond);
+  Serial.print(" B/s (whole lines: ");
+  Serial.print(stats.lineRewriteBytesPerSecond);
+  Serial.print(" B/s, peak ");
+  Serial.print(stats.peakBytesPerSecond);
+  Serial.print(" B/s) cells=");
+  Serial.print(stats.cellsWritten);
+  Serial.print(" moves=");
+  Serial.print(stats.cursorMoves);
+  Serial.print(" flushes=");
+  Serial.println(stats.flushes);
+  
+  Serial.print("LCD: frames ");
+  Serial.print(stats.framesWritten);
+  Serial.print("/");
+  Serial.print(stats.framesSubmitted);
+  Serial.print(" written (coalesced ");
+  Serial.print(stats.framesCoalesced);
+  Serial.print(", dropped ");
+  Serial.print(stats.commandsDropped);
+  Serial.print(") queue=");
+  Serial.print(stats.queueDepth);
+  Serial.print(" max=");
+  Serial.print(stats.maxQueueDepth);
+  Serial.print(" flush us avg=");
+  Serial.print(stats.avgFlushUs);
+  Serial.print(" max=");
+  Serial.println(stats.maxFlushUs);
+  
+  Serial.print("LCD: glyphs ");
+  Serial.print(stats.glyphs.resident);
+  Serial.print("/");
+  Serial.print(LCD_CGRAM_SLOTS);
+  Serial.print(" slots (");
+  Serial.print(stats.glyphs.defined);
+  Serial.print(" defined) uploads=");
+  Serial.print(stats.glyphs.uploads);
+  Serial.print(" (");
+  Serial.print(stats.glyphs.uploadsPerMinute);
+  Serial.print("/min) evictions=");
+  Serial.print(stats.glyphs.evictions);
+  Serial.print(" fallbacks=");
+  Serial.println(stats.glyphs.fallbacks);
+  
+  DisplayFrameStats frameStats;
+  getDisplayFrameStats(frameStats);
+  if (!frameStats.counting) {
+    Serial.println("LCD: heap allocations not counted (build the alloccount environment)");
+    return;
+  }
+  Serial.print("LCD: heap allocations ");
+  Serial.print(frameStats.allocations);
+  Serial.print(" in ");
+  Serial.print(frameStats.framesWithAllocations);
+  Serial.print("/");
+  Serial.print(frameStats.frames);
+  Serial.print(" frames (max ");
+  Serial.print(frameStats.maxAllocations);
+  Serial.println(" per frame)");
+}
@@ -0,0 +1,522 @@
+#include "display_render.h"
+#include "settings.h"
+#include "menu.h"
+#include "alarm.h"
+#include "weather.h"
+
+// Helper function to check if any alarms are enabled
+bool hasEnabledAlarms() {
+  for (int i = 0; i < MAX_ALARMS; i++) {
+    if (alarms[i].enabled) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Time-shift delay as "-m:ss"
+static void appendBehindLive(LcdLine& line, uint32_t behindLiveMs) {
+  unsigned long seconds = behindLiveMs / 1000;
+  lineAppendChar(line, '-');
+  lineAppendInt(line, seconds / 60);
+  lineAppendChar(line, ':');
+  lineAppendInt(line, seconds % 60, 2);
+}
+
+static bool isTrackScrollComplete(const String& fullText) {
+  if (fullText.length() <= 16) {
+    return true; // No scrolling needed, always complete
+  }
+  
+  int maxPosition = fullText.length() - 16;
+  // Consider complete when we've scrolled through the text and paused at the end
+  return trackScrollPosition > maxPosition + 5; // Almost at reset point
+}
+
+static void appendScrolledTrackText(LcdLine& line, const String& fullText) {
+  if (fullText.length() <= 16) {
+    // Text fits, no scrolling needed
+    trackScrollPosition = 0;
+    lineAppend(line, fullText.c_str());
+    return;
+  }
+  
+  // Check if it's time to scroll
+  if (millis() - lastTrackScroll >= 300) { // Scroll every 300ms (faster)
+    trackScrollPosition++;
+    lastTrackScroll = millis();
+    
+    // Reset scroll position when we reach the end
+    int maxPosition = fullText.length() - 16;
+    if (trackScrollPosition > maxPosition + 6) { // +6 for longer pause at end
+      trackScrollPosition = 0;
+    }
+  }
+  
+  // Show 16 characters from the scroll position, at the end the last 16
+  unsigned int start = trackScrollPosition;
+  if (start > fullText.length() - 16) start = fullText.length() - 16;
+  lineAppendN(line, fullText.c_str() + start, 16);
+}
+
+// Blank rows, not centered
+static void clearRows(DisplayRows& rows) {
+  for (int i = 0; i < LCD_ROWS; i++) {
+    lineClear(rows.line[i]);
+    rows.center[i] = false;
+  }
+}
+
+void composeTemporaryMessage(DisplayRows& rows) {
+  clearRows(rows);
+  lineAppend(rows.line[0], "ALARM");
+  lineAppend(rows.line[1], temporaryMessage.c_str());
+  rows.center[0] = true;
+  rows.center[1] = true;
+}
+
+// Shown when adjusting volume outside the menu
+void composeVolumeScreen(DisplayRows& rows) {
+  clearRows(rows);
+  lineAppend(rows.line[0], "Volume");
+  lineAppend(rows.line[1], "Level: ");
+  lineAppendInt(rows.line[1], volume);
+  rows.center[0] = true;
+  rows.center[1] = true;
+}
+
+// Clock, alarm, snooze and playback screens
+DisplayRowsContent composeMainScreen(DisplayRows& rows, const DisplayInputs& inputs) {
+  if (!inputs.timeValid) {
+    return DISPLAY_ROWS_NONE; // Skip update if time not available
+  }
+  
+  clearRows(rows);
+  LcdLine& line0 = rows.line[0];
+  LcdLine& line1 = rows.line[1];
+  
+  // Get weather for display
+  LcdLine weather;
+  lineClear(weather);
+  if (weatherApiKey.length() == 0) {
+    // No API key, show nothing
+  } else if (currentWeather.valid) {
+    lineAppendInt(weather, lroundf(currentWeather.temperature));
+    lineAppendGlyph(weather, GLYPH_DEGREE);
+    lineAppendChar(weather, 'C');
+    lineAppend(weather, currentWeather.icon.c_str());
+  } else {
+    lineAppendChar(weather, '?'); // ?°C using custom degree symbol
+    lineAppendGlyph(weather, GLYPH_DEGREE);
+    lineAppendChar(weather, 'C');
+  }
+  
+  // Time + Weather layout: "12:34 🕐 Z 22°C☀" with fixed positions for indicators
+  lineAppendInt(line0, inputs.time.tm_hour, 2);
+  lineAppendChar(line0, ':');
+  lineAppendInt(line0, inputs.time.tm_min, 2);
+  
+  // Add clock symbol (always reserve space for consistent positioning)
+  if (hasEnabledAlarms()) {
+    lineAppendChar(line0, ' ');
+    lineAppendGlyph(line0, GLYPH_CLOCK);
+  } else {
+    lineAppend(line0, "  "); // Reserve 2 spaces (space + clock position)
+  }
+  
+  // Add sleep timer indicator (always reserve space for consistent positioning)
+  lineAppend(line0, sleepTimerActive ? " Z" : "  ");
+  
+  // Right-align weather on the 16-char display, truncated if everything doesn't fit
+  lineRightAlign(line0, weather);
+  
+  // Check for active alarm or snoozing alarm first (highest priority display)
+  if (activeAlarmIndex >= 0) {
+    // Active alarm - show alarm info and controls
+    lineClear(line0);
+    lineAppend(line0, "ALARM ");
+    lineAppendInt(line0, activeAlarmIndex + 1);
+    lineAppend(line0, "  STOP");
+    lineAppendGlyph(line0, GLYPH_UP_ARROW);
+    lineAppend(line1, currentStreamName.c_str());
+    rows.center[1] = true;
+    return DISPLAY_ROWS_TEXT;
+  }
+  
+  // Check for snoozing alarm
+  int snoozingIndex = getSnoozingAlarmIndex();
+  if (snoozingIndex >= 0) {
+    // Calculate remaining snooze time
+    unsigned long snoozeElapsed = millis() - alarms[snoozingIndex].snoozeStart;
+    unsigned long snoozeTotal = ALARM_SNOOZE_MINUTES * 60 * 1000;
+    if (snoozeElapsed < snoozeTotal) {
+      unsigned long remaining = (snoozeTotal - snoozeElapsed) / 1000; // Convert to seconds
+      
+      // Show time on first line, snooze countdown on second line
+      lineAppend(line1, "SNOOZE    ");
+      lineAppendInt(line1, remaining / 60, 2);
+      lineAppendChar(line1, ':');
+      lineAppendInt(line1, remaining % 60, 2);
+      return DISPLAY_ROWS_TEXT;
+    }
+  }
+  
+  if (!radioPowerOn || !isStreaming) {
+    // Radio is off or not streaming: Bottom line: Show radio status, empty if on but not streaming
+    if (!radioPowerOn) {
+      lineAppend(line1, "Radio OFF");
+      rows.center[1] = true;
+    }
+    return DISPLAY_ROWS_TEXT;
+  }
+  
+  // Bottom line: pause state with the time-shift delay
+  if (streamPaused) {
+    lineAppend(line1, "PAUSED ");
+    appendBehindLive(line1, inputs.behindLiveMs);
+    rows.center[1] = true;
+    return DISPLAY_ROWS_TEXT;
+  }
+  
+  // Bottom line: level meter if enabled (drawn by display.cpp at its own frame rate)
+  if (levelMeterEnabled) {
+    return DISPLAY_ROWS_LEVEL_METER;
+  }
+  
+  // Bottom line: Alternate between station name and track info (if available)
+  if (hasTrackInfo && currentTrackInfo.length() > 0) {
+    // Check if it's time to toggle display
+    bool shouldToggle = false;
+    
+    if (currentTrackInfo.length() <= 16) {
+      // Short track name - use 10 second timer
+      shouldToggle = (millis() - lastTrackToggle >= 10000);
+    } else {
+      // Long track name - wait for scroll to complete OR 20 seconds max
+      shouldToggle = (isTrackScrollComplete(currentTrackInfo) && (millis() - lastTrackToggle >= 5000)) ||
+                    (millis() - lastTrackToggle >= 20000);
+    }
+    
+    if (shouldToggle) {
+      showTrackInfo = !showTrackInfo;
+      lastTrackToggle = millis();
+      // Reset scroll position when switching display
+      trackScrollPosition = 0;
+      lastTrackScroll = millis();
+    }
+  } else {
+    // No track info available, always show station name
+    showTrackInfo = false;
+  }
+  
+  if (showTrackInfo) {
+    appendScrolledTrackText(line1, currentTrackInfo);
+  } else {
+    // Playing behind live after a pause: show the delay in front of the station name
+    if (inputs.behindLive) {
+      appendBehindLive(line1, inputs.behindLiveMs);
+      lineAppendChar(line1, ' ');
+    }
+    lineAppend(line1, currentStreamName.c_str());
+  }
+  
+  rows.center[1] = !showTrackInfo; // Center station name, don't center scrolling track info
+  return DISPLAY_ROWS_TEXT;
+}
+
+// Alarm slot list and the settings of one slot
+static void composeAlarmMenu(LcdLine& line0, LcdLine& line1) {
+  if (!inAlarmSubMenu) {
+    // Main alarm menu - show "Alarms" on first line, the slot list on the second
+    lineAppend(line0, "Alarms");
+    
+    // Show current slot option (nothing for the blank navigation entry)
+    switch (currentAlarmMenu) {
+      case ALARM_MENU_SLOT1:
+        lineAppend(line1, "Slot 1/5");
+        if (alarms[0].enabled) lineAppend(line1, "    ON");
+        break;
+      case ALARM_MENU_SLOT2:
+        lineAppend(line1, "Slot 2/5");
+        if (alarms[1].enabled) lineAppend(line1, "    ON");
+        break;
+      case ALARM_MENU_SLOT3:
+        lineAppend(line1, "Slot 3/5");
+        if (alarms[2].enabled) lineAppend(line1, "    ON");
+        break;
+      case ALARM_MENU_SLOT4:
+        lineAppend(line1, "Slot 4/5");
+        if (alarms[3].enabled) lineAppend(line1, "    ON");
+        break;
+      case ALARM_MENU_SLOT5:
+        lineAppend(line1, "Slot 5/5");
+        if (alarms[4].enabled) lineAppend(line1, "    ON");
+        break;
+    }
+  } else {
+    // Sub-menu - show alarm slot and status on first line
+    switch (currentAlarmSubMenu) {
+      case ALARM_SUB_BACK:
+        lineAppendInt(line0, currentAlarmSlot + 1);
+        lineAppend(line0, ": ON");
+        lineAppend(line1, "< BACK");
+        break;
+      case ALARM_SUB_ENABLED:
+        lineAppendInt(line0, currentAlarmSlot + 1);
+        lineAppend(line0, ": Enable");
+        if (editingAlarmOption) lineAppend(line0, "    *");
+        lineAppend(line1, alarms[currentAlarmSlot].enabled ? "YES" : "NO");
+        break;
+      case ALARM_SUB_TIME:
+      {
+        lineAppendInt(line0, currentAlarmSlot + 1);
+        lineAppend(line0, ": Time");
+        if (editingAlarmOption) lineAppend(line0, "      *");
+        
+        // Check if we should show blinking (every 500ms)
+        bool showBlink = (millis() / 500) % 2 == 0;
+        
+        // Display hours with blinking if editing
+        if (editingTime && editingHours && !showBlink) {
+          lineAppend(line1, "  "); // Blank spaces for blinking hours
+        } else {
+          if (alarms[currentAlarmSlot].hour < 10) lineAppend(line1, "0");
+          lineAppendInt(line1, alarms[currentAlarmSlot].hour);
+        }
+        
+        lineAppend(line1, ":");
+        
+        // Display minutes with blinking if editing
+        if (editingTime && editingMinutes && !showBlink) {
+          lineAppend(line1, "  "); // Blank spaces for blinking minutes
+        } else {
+          if (alarms[currentAlarmSlot].minute < 10) lineAppend(line1, "0");
+          lineAppendInt(line1, alarms[currentAlarmSlot].minute);
+        }
+        break;
+      }
+      case ALARM_SUB_STATION:
+        lineAppendInt(line0, currentAlarmSlot + 1);
+        lineAppend(line0, ": Station");
+        if (editingAlarmOption) lineAppend(line0, "   *");
+        if (alarms[currentAlarmSlot].stationIndex < menuStreamCount) {
+          lineAppend(line1, menuStreams[alarms[currentAlarmSlot].stationIndex].name);
+        } else {
+          lineAppend(line1, "Unknown");
+        }
+        break;
+      case ALARM_SUB_SCHEDULE:
+        lineAppendInt(line0, currentAlarmSlot + 1);
+        lineAppend(line0, ": Schedule");
+        if (editingAlarmOption) lineAppend(line0, "  *");
+        switch (alarms[currentAlarmSlot].schedule) {
+          case ALARM_ONCE:
+            lineAppend(line1, "Once");
+            break;
+          case ALARM_DAILY:
+            lineAppend(line1, "Daily");
+            break;
+          case ALARM_WEEKDAYS:
+            lineAppend(line1, "Weekdays");
+            break;
+          case ALARM_WEEKENDS:
+            lineAppend(line1, "Weekends");
+            break;
+        }
+        break;
+      case ALARM_SUB_VOLUME:
+        lineAppendInt(line0, currentAlarmSlot + 1);
+        lineAppend(line0, ": Volume");
+        if (editingAlarmOption) lineAppend(line0, "    *");
+        lineAppendInt(line1, alarms[currentAlarmSlot].maxVolume);
+        break;
+      case ALARM_SUB_AUTO_OFF:
+        lineAppendInt(line0, currentAlarmSlot + 1);
+        lineAppend(line0, ": Auto Off");
+        if (editingAlarmOption) lineAppend(line0, "   *");
+        switch (alarms[currentAlarmSlot].autoOff) {
+          case AUTO_OFF_NO:
+            lineAppend(line1, "NO");
+            break;
+          case AUTO_OFF_5MIN:
+            lineAppend(line1, "5 minutes");
+            break;
+          case AUTO_OFF_15MIN:
+            lineAppend(line1, "15 minutes");
+            break;
+          case AUTO_OFF_30MIN:
+            lineAppend(line1, "30 minutes");
+            break;
+          case AUTO_OFF_60MIN:
+            lineAppend(line1, "60 minutes");
+            break;
+          case AUTO_OFF_90MIN:
+            lineAppend(line1, "90 minutes");
+            break;
+        }
+        break;
+    }
+  }
+}
+
+void composeMenuScreen(DisplayRows& rows, const DisplayInputs& inputs) {
+  clearRows(rows);
+  LcdLine& line0 = rows.line[0];
+  LcdLine& line1 = rows.line[1];
+  
+  switch (currentMenu) {
+    case MENU_SLEEP: {
+      lineAppend(line0, "MENU: Sleep");
+      switch (currentSleepMenu) {
+        case SLEEP_MENU_BLANK:
+          break; // Blank line
+        case SLEEP_MENU_OFF:
+          lineAppend(line1, "OFF");
+          break;
+        case SLEEP_MENU_15MIN:
+          lineAppend(line1, "15 minutes");
+          break;
+        case SLEEP_MENU_30MIN:
+          lineAppend(line1, "30 minutes");
+          break;
+        case SLEEP_MENU_60MIN:
+          lineAppend(line1, "60 minutes");
+          break;
+        case SLEEP_MENU_90MIN:
+          lineAppend(line1, "90 minutes");
+          break;
+        case SLEEP_MENU_5MIN:
+          lineAppend(line1, "5 minutes");
+          break;
+      }
+      break;
+    }
+    case MENU_STREAMS: {
+      lineAppend(line0, "MENU: Station");
+      lineAppend(line1, menuStreams[currentStream].name);
+      break;
+    }
+    case MENU_BRIGHTNESS: {
+      lineAppend(line0, "MENU: Backlight");
+      lineAppend(line1, "Mode: ");
+      lineAppend(line1, backlightAlwaysOn ? "ALWAYS ON" : "AUTO OFF");
+      break;
+    }
+    case MENU_WIFI: {
+      if (showingConfirmation) {
+        lineAppend(line0, "Reset WiFi?");
+        lineAppend(line1, confirmationChoice ? "> YES    NO" : "  YES  > NO");
+      } else {
+        lineAppend(line0, "MENU: WiFi");
+        switch (currentWiFiMenu) {
+          case WIFI_MENU_IP: {
+            if (inputs.wifiConnected) {
+              for (int i = 0; i < 4; i++) {
+                if (i > 0) lineAppendChar(line1, '.');
+                lineAppendInt(line1, inputs.ip[i]);
+              }
+            } else {
+              lineAppend(line1, "Not connected");
+            }
+            break;
+          }
+          case WIFI_MENU_SSID: {
+            lineAppend(line1, "SSID: ");
+            lineAppendN(line1, ssid.c_str(), 10);
+            break;
+          }
+          case WIFI_MENU_PASSWORD: {
+            lineAppend(line1, "PASS: ");
+            if (password.length() > 0) {
+              lineAppend(line1, "*****");
+            }
+            break;
+          }
+          case WIFI_MENU_RESET: {
+            lineAppend(line1, "Reset WiFi");
+            break;
+          }
+        }
+      }
+      break;
+    }
+    case MENU_WEATHER: {
+      lineAppend(line0, "MENU: Weather");
+      switch (currentWeatherMenu) {
+        case WEATHER_MENU_TEMPERATURE: {
+          lineAppend(line1, "TEMP: ");
+          if (currentWeather.valid) {
+            lineAppendInt(line1, (int)currentWeather.temperature);
+            lineAppendChar(line1, 'C');
+          } else {
+            lineAppend(line1, "--");
+          }
+          break;
+        }
+        case WEATHER_MENU_HUMIDITY: {
+          lineAppend(line1, "HUM: ");
+          if (currentWeather.valid) {
+            lineAppendInt(line1, currentWeather.humidity);
+            lineAppendChar(line1, '%');
+          } else {
+            lineAppend(line1, "--");
+          }
+          break;
+        }
+        case WEATHER_MENU_DESCRIPTION: {
+          lineAppend(line1, "DESC: ");
+          if (currentWeather.valid) {
+            lineAppendN(line1, currentWeather.description.c_str(), 10);
+          } else {
+            lineAppend(line1, "--");
+          }
+          break;
+        }
+        case WEATHER_MENU_API_KEY: {
+          lineAppend(line1, "API: ");
+          lineAppend(line1, weatherApiKey.length() > 0 ? "SET" : "NOT SET");
+          break;
+        }
+        case WEATHER_MENU_UPDATE: {
+          lineAppend(line1, "Update Weather");
+          break;
+        }
+      }
+      break;
+    }
+    case MENU_SYSTEM: {
+      lineAppend(line0, "MENU: System");
+      switch (currentSystemMenu) {
+        case SYSTEM_MENU_FIRMWARE: {
+          lineAppend(line1, "Firm: ");
+          lineAppend(line1, FIRMWARE_VERSION);
+          break;
+        }
+        case SYSTEM_MENU_UPDATE: {
+          lineAppend(line1, "Update");
+          break;
+        }
+      }
+      break;
+    }
+    case MENU_ALARMS: {
+      composeAlarmMenu(line0, line1);
+      break;
+    }
+  }
+}
+
+// Two steps per cell (half and full block), the peak as a marker
+void composeLevelMeterRow(const LevelMeterLevels& levels, uint8_t cells[LCD_COLS]) {
+  int bar = (int)((levels.rmsDb - LEVEL_METER_FLOOR_DB) * (LCD_COLS * 2) / -LEVEL_METER_FLOOR_DB + 0.5f);
+  int peak = (int)((levels.peakDb - LEVEL_METER_FLOOR_DB) * LCD_COLS / -LEVEL_METER_FLOOR_DB);
+  if (peak >= LCD_COLS) peak = LCD_COLS - 1;
+  
+  for (int i = 0; i < LCD_COLS; i++) {
+    int fill = bar - i * 2;
+    cells[i] = fill >= 2 ? METER_CHAR_FULL : (fill == 1 ? METER_CHAR_HALF : ' ');
+  }
+  if (levels.peakDb > LEVEL_METER_FLOOR_DB && cells[peak] == ' ') {
+    cells[peak] = METER_CHAR_PEAK;
+  }
+}
@@ -0,0 +1,170 @@
+#include "dsp_benchmark.h"
+#include "gain_ramp.h"
+#include "level_meter.h"
+#include "tone_control.h"
+#include "asrc.h"
+
+static int16_t benchBuffer[DSP_BENCHMARK_FRAMES * 2];
+
+static portMUX_TYPE benchmarkMux = portMUX_INITIALIZER_UNLOCKED;
+static DspBenchmarkReport report;  // Guarded by benchmarkMux
+
+// Deterministic full-scale noise, refilled before every run
+static void fillBenchBuffer() {
+  uint32_t seed = 12345;
+  for (int i = 0; i < DSP_BENCHMARK_FRAMES * 2; i++) {
+    seed = seed * 1664525 + 1013904223;
+    benchBuffer[i] = (int16_t)(seed >> 16);
+  }
+}
+
+static float cyclesPerSample(uint32_t cycles) {
+  return (float)cycles / (DSP_BENCHMARK_FRAMES * 2);
+}
+
+static float benchGainConstant() {
+  uint32_t best = UINT32_MAX;
+  GainRamp ramp;
+  gainRampInit(ramp, 60);
+
+  for (int run = 0; run < DSP_BENCHMARK_RUNS; run++) {
+    fillBenchBuffer();
+    uint32_t start = ESP.getCycleCount();
+    gainRampProcess(ramp, benchBuffer, DSP_BENCHMARK_FRAMES);
+    uint32_t cycles = ESP.getCycleCount() - start;
+    if (cycles < best) best = cycles;
+  }
+  return cyclesPerSample(best);
+}
+
+static float benchGainRamp() {
+  uint32_t best = UINT32_MAX;
+  GainRamp ramp;
+
+  for (int run = 0; run < DSP_BENCHMARK_RUNS; run++) {
+    fillBenchBuffer();
+    gainRampInit(ramp, 40);
+    gainRampSetTarget(ramp, 60, DSP_BENCHMARK_FRAMES * 4); // Still ramping at the end of the block
+    uint32_t start = ESP.getCycleCount();
+    gainRampProcess(ramp, benchBuffer, DSP_BENCHMARK_FRAMES);
+    uint32_t cycles = ESP.getCycleCount() - start;
+    if (cycles < best) best = cycles;
+  }
+  return cyclesPerSample(best);
+}
+
+// The measuring kernel only, the meter the audio task feeds is left alone
+static float benchLevelMeter() {
+  uint32_t best = UINT32_MAX;
+  fillBenchBuffer();
+
+  for (int run = 0; run < DSP_BENCHMARK_RUNS; run++) {
+    uint32_t rms, peak;
+    uint32_t start = ESP.getCycleCount();
+    levelMeterMeasure(benchBuffer, DSP_BENCHMARK_FRAMES, rms, peak);
+    uint32_t cycles = ESP.getCycleCount() - start;
+    if (cycles < best) best = cycles;
+  }
+  return cyclesPerSample(best);
+}
+
+static ToneControl benchTone; // Holds a 1 KB scratch buffer, kept off the stack
+
+static float benchToneControl() {
+  uint32_t best = UINT32_MAX;
+  const int8_t gains[TONE_BANDS] = {6, -3, 4}; // Every band active
+  toneControlInit(benchTone);
+  toneControlConfigure(benchTone, gains, 44100);
+
+  for (int run = 0; run < DSP_BENCHMARK_RUNS; run++) {
+    fillBenchBuffer();
+    uint32_t start = ESP.getCycleCount();
+    toneControlProcess(benchTone, benchBuffer, DSP_BENCHMARK_FRAMES);
+    uint32_t cycles = ESP.getCycleCount() - start;
+    if (cycles < best) best = cycles;
+  }
+  return cyclesPerSample(best);
+}
+
+static Asrc benchAsrc; // Table and history are several KB, kept off the stack
+static int16_t benchAsrcOut[256 * 2];
+
+// Cycles per input sample, so the load figures compare with the other kernels
+static float benchAsrcConvert(uint32_t inputRate) {
+  uint32_t best = UINT32_MAX;
+  asrcInit(benchAsrc, ASRC_OUTPUT_RATE);
+  asrcConfigure(benchAsrc, inputRate);
+  asrcSetCorrection(benchAsrc, DSP_BENCHMARK_PPM);
+
+  for (int run = 0; run < DSP_BENCHMARK_RUNS; run++) {
+    fillBenchBuffer();
+    uint32_t start = ESP.getCycleCount();
+    uint32_t done = 0;
+    while (done < DSP_BENCHMARK_FRAMES) {
+      done += asrcWrite(benchAsrc, benchBuffer + done * 2, DSP_BENCHMARK_FRAMES - done);
+      while (asrcRead(benchAsrc, benchAsrcOut, 256) > 0) {
+      }
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    if (cycles < best) best = cycles;
+  }
+  return cyclesPerSample(best);
+}
+
+static int runDspBenchmarks(DspBenchmarkResult* results, int maxResults) {
+  int count = 0;
+  if (count < maxResults) results[count++] = {"gainConstant", benchGainConstant()};
+  if (count < maxResults) results[count++] = {"gainRamp", benchGainRamp()};
+  if (count < maxResults) results[count++] = {"levelMeter", benchLevelMeter()};
+  if (count < maxResults) results[count++] = {"toneControl", benchToneControl()};
+  if (count < maxResults) results[count++] = {"asrc44to48", benchAsrcConvert(44100)};
+  if (count < maxResults) results[count++] = {"asrc48to48", benchAsrcConvert(48000)};
+
+  for (int i = 0; i < count; i++) {
+    Serial.print("DSP benchmark ");
+    Serial.print(results[i].name);
+    Serial.print(": ");
+    Serial.print(results[i].cyclesPerSample);
+    Serial.println(" cycles/sample");
+  }
+  return count;
+}
+
+static void benchmarkTask(void* param) {
+  DspBenchmarkResult results[DSP_BENCHMARK_MAX_RESULTS];
+  int count = runDspBenchmarks(results, DSP_BENCHMARK_MAX_RESULTS);
+
+  portENTER_CRITICAL(&benchmarkMux);
+  memcpy(report.results, results, sizeof(results));
+  report.count = count;
+  report.finishedAt = millis();
+  report.valid = true;
+  report.running = false;
+  portEXIT_CRITICAL(&benchmarkMux);
+  vTaskDelete(NULL);
+}
+
+// True when a run was started or is already under way
+bool startDspBenchmarks() {
+  portENTER_CRITICAL(&benchmarkMux);
+  bool running = report.running;
+  report.running = true;
+  portEXIT_CRITICAL(&benchmarkMux);
+  if (running) return true;
+
+  if (xTaskCreatePinnedToCore(benchmarkTask, "dspBenchmark", DSP_BENCHMARK_TASK_STACK, NULL,
+                              DSP_BENCHMARK_TASK_PRIORITY, NULL, DSP_BENCHMARK_TASK_CORE) != pdPASS) {
+    Serial.println("Failed to start DSP benchmark task");
+    portENTER_CRITICAL(&benchmarkMux);
+    report.running = false;
+    portEXIT_CRITICAL(&benchmarkMux);
+    return false;
+  }
+  return true;
+}
+
+void getDspBenchmarks(DspBenchmarkReport& out) {
+  portENTER_CRITICAL(&benchmarkMux);
+  out = report;
+  portEXIT_CRITICAL(&benchmarkMux);
+}
@@ -10,6 +10,9 @@ volatile bool encoderA_last;
 volatile unsigned long lastEncoderTime = 0;
 volatile int encoderCounter = 0;
 
+// Duration of the last short press reported by checkButtonPress()
+static unsigned long lastPressDuration = 0;
+
 void IRAM_ATTR handleEncoder() {
   unsigned long currentTime = millis();
   if (currentTime - lastEncoderTime < 5) return; // Debounce
@@ -91,6 +94,7 @@ bool checkButtonPress() {
     // Only report short press if it was less than long press duration and not already reported
     if (pressDuration < LONG_PRESS_DURATION && !shortPressReported) {
       Serial.println("Short button press detected!");
+      lastPressDuration = pressDuration;
       return true;
     }
   } else if (currentButtonState == LOW && buttonWasPressed && !shortPressReported) {
@@ -104,6 +108,11 @@ bool checkButtonPress() {
   return false;
 }
 
+// Held past HOLD_PRESS_DURATION but released before a long press
+bool lastButtonPressWasHold() {
+  return lastPressDuration >= HOLD_PRESS_DURATION;
+}
+
 bool checkLongButtonPress() {
   static unsigned long buttonPressStart = 0;
   static bool buttonWasPressed = false;
@@ -0,0 +1,121 @@
+#include "fallback_tone.h"
+
+struct FallbackToneStep {
+  uint16_t frequency;      // Hz, 0 = pause
+  uint16_t ms;
+};
+
+// Four short beeps and a pause, like a bedside alarm clock
+static const FallbackToneStep pattern[] = {
+  {880, 100}, {0, 100},
+  {880, 100}, {0, 100},
+  {880, 100}, {0, 100},
+  {880, 100}, {0, 600}
+};
+static const int patternLength = sizeof(pattern) / sizeof(pattern[0]);
+
+static const int16_t sineTable[1 << FALLBACK_TONE_SINE_BITS] = {
+  0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393, 7179, 7962, 8739,
+  9512, 10278, 11039, 11793, 12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+  18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811,
+  25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+  30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521,
+  32609, 32678, 32728, 32757, 32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+  32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571, 30273, 29956, 29621, 29268,
+  28898, 28510, 28105, 27683, 27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+  23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868, 18204, 17530, 16846, 16151,
+  15446, 14732, 14010, 13279, 12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+  6393, 5602, 4808, 4011, 3212, 2410, 1608, 804, 0, -804, -1608, -2410,
+  -3212, -4011, -4808, -5602, -6393, -7179, -7962, -8739, -9512, -10278, -11039, -11793,
+  -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159,
+  -20787, -21403, -22005, -22594, -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+  -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956, -30273, -30571, -30852, -31113,
+  -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+  -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285, -32137, -31971, -31785, -31580,
+  -31356, -31113, -30852, -30571, -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+  -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731, -23170, -22594, -22005, -21403,
+  -20787, -20159, -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+  -12539, -11793, -11039, -10278, -9512, -8739, -7962, -7179, -6393, -5602, -4808, -4011,
+  -3212, -2410, -1608, -804,
+};
+
+static void enterStep(FallbackTone& tone, int step) {
+  tone.step = step;
+  tone.stepFrames = (uint32_t)tone.sampleRate * pattern[step].ms / 1000;
+  if (pattern[step].frequency != 0) {
+    tone.phaseStep = (uint32_t)(((uint64_t)pattern[step].frequency << 32) / tone.sampleRate);
+  }
+}
+
+void fallbackToneStart(FallbackTone& tone, uint32_t sampleRate) {
+  tone.active = true;
+  tone.sampleRate = sampleRate;
+  tone.phase = 0;
+  tone.envelope = 0;
+  uint32_t edgeFrames = sampleRate * FALLBACK_TONE_EDGE_MS / 1000;
+  tone.envelopeStep = 32767 / (edgeFrames > 0 ? edgeFrames : 1);
+  tone.fade = 1 << 23;
+  tone.fadeStep = 0;
+  enterStep(tone, 0);
+}
+
+// Hand over to the stream: the tone fades out over frames and then stops
+void fallbackToneFadeOut(FallbackTone& tone, uint32_t frames) {
+  if (!tone.active || tone.fadeStep != 0) return;
+  tone.fadeStep = tone.fade / (int32_t)(frames > 0 ? frames : 1);
+  if (tone.fadeStep == 0) tone.fadeStep = 1;
+}
+
+// Next mono sample at the tone's crossfade weight
+static inline int32_t nextSample(FallbackTone& tone) {
+  if (tone.stepFrames == 0) {
+    enterStep(tone, (tone.step + 1) % patternLength);
+  }
+  tone.stepFrames--;
+
+  // Ramp the envelope towards on or off; the phase keeps running through pauses
+  if (pattern[tone.step].frequency != 0) {
+    tone.envelope = min(tone.envelope + tone.envelopeStep, (int32_t)32767);
+  } else {
+    tone.envelope = max(tone.envelope - tone.envelopeStep, (int32_t)0);
+  }
+  int32_t sample = 0;
+  if (tone.envelope > 0) {
+    sample = sineTable[tone.phase >> (32 - FALLBACK_TONE_SINE_BITS)];
+    sample = (sample * FALLBACK_TONE_LEVEL) >> 15;
+    sample = (sample * tone.envelope) >> 15;
+  }
+  tone.phase += tone.phaseStep;
+
+  if (tone.fadeStep != 0) {
+    tone.fade -= tone.fadeStep;
+    if (tone.fade <= 0) {
+      tone.fade = 0;
+      tone.active = false;
+    }
+  }
+  return (int32_t)(((int64_t)sample * tone.fade) >> 23);
+}
+
+// Fill an interleaved stereo block with the tone (output without a stream)
+void fallbackToneRender(FallbackTone& tone, int16_t* buff, uint32_t frames) {
+  for (uint32_t i = 0; i < frames; i++) {
+    int16_t sample = tone.active ? (int16_t)nextSample(tone) : 0;
+    buff[i * 2] = sample;
+    buff[i * 2 + 1] = sample;
+  }
+}
+
+// Blend the tone into decoded PCM: the stream gets the weight the tone doesn't have
+void fallbackToneMix(FallbackTone& tone, int16_t* buff, uint32_t frames) {
+  for (uint32_t i = 0; i < frames && tone.active; i++) {
+    int32_t streamWeight = (1 << 23) - tone.fade;
+    int32_t sample = nextSample(tone);
+    for (int c = 0; c < 2; c++) {
+      int32_t v = (int32_t)(((int64_t)buff[i * 2 + c] * streamWeight) >> 23) + sample;
+      if (v > 32767) v = 32767;
+      else if (v < -32768) v = -32768;
+      buff[i * 2 + c] = (int16_t)v;
+    }
+  }
+}
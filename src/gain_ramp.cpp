@@ -0,0 +1,120 @@
+#include "gain_ramp.h"
+
+// Q15 gain for each volume step: 0 is mute, 1..80 span GAIN_RANGE_DB evenly in dB
+static const uint16_t volumeTable[GAIN_VOLUME_MAX + 1] = {
+      0,   111,   120,   129,   138,   148,   160,   171,   184,   198,
+    213,   229,   246,   264,   284,   305,   328,   352,   378,   407,
+    437,   470,   505,   542,   583,   626,   673,   723,   777,   835,
+    897,   964,  1036,  1114,  1197,  1286,  1382,  1485,  1596,  1715,
+   1843,  1980,  2128,  2287,  2457,  2641,  2838,  3049,  3277,  3521,
+   3784,  4066,  4370,  4696,  5046,  5423,  5827,  6262,  6729,  7231,
+   7771,  8350,  8973,  9643, 10362, 11135, 11966, 12859, 13818, 14849,
+  15957, 17147, 18427, 19802, 21279, 22867, 24573, 26406, 28376, 30493,
+  32768
+};
+
+static int clampVolume(int vol) {
+  if (vol < 0) return 0;
+  if (vol > GAIN_VOLUME_MAX) return GAIN_VOLUME_MAX;
+  return vol;
+}
+
+int32_t gainForVolume(int vol) {
+  return volumeTable[clampVolume(vol)];
+}
+
+// Gain between two table entries, so long fades stay logarithmic
+static int32_t gainAtPosition(int32_t position) {
+  int index = position >> GAIN_POSITION_SHIFT;
+  if (index >= GAIN_VOLUME_MAX) return volumeTable[GAIN_VOLUME_MAX];
+
+  int32_t frac = (position >> (GAIN_POSITION_SHIFT - 16)) & 0xFFFF;
+  int32_t low = volumeTable[index];
+  int32_t high = volumeTable[index + 1];
+  return low + (((high - low) * frac) >> 16);
+}
+
+// Volume step plus offset, kept between volume 1 and unity; volume 0 stays mute
+static int32_t targetPosition(int vol, int32_t offset) {
+  if (vol == 0) return 0;
+  int64_t position = ((int64_t)vol << GAIN_POSITION_SHIFT) + offset;
+  if (position < (1 << GAIN_POSITION_SHIFT)) return 1 << GAIN_POSITION_SHIFT;
+  if (position > ((int64_t)GAIN_VOLUME_MAX << GAIN_POSITION_SHIFT)) return GAIN_VOLUME_MAX << GAIN_POSITION_SHIFT;
+  return (int32_t)position;
+}
+
+void gainRampInit(GainRamp& ramp, int vol) {
+  ramp.volume = clampVolume(vol);
+  ramp.offset = 0;
+  ramp.position = ramp.volume << GAIN_POSITION_SHIFT;
+  ramp.target = ramp.position;
+  ramp.step = 0;
+  ramp.gain = gainForVolume(vol);
+}
+
+// Move to vol over the given number of frames (0 = immediately)
+void gainRampSetTarget(GainRamp& ramp, int vol, uint32_t frames) {
+  ramp.volume = clampVolume(vol);
+  ramp.target = targetPosition(ramp.volume, ramp.offset);
+  if (frames == 0 || ramp.target == ramp.position) {
+    ramp.position = ramp.target;
+    ramp.step = 0;
+    ramp.gain = gainAtPosition(ramp.position);
+    return;
+  }
+
+  int64_t step = ((int64_t)ramp.target - ramp.position) / (int64_t)frames;
+  if (step == 0) step = ramp.target > ramp.position ? 1 : -1;
+  ramp.step = (int32_t)step;
+}
+
+// Shift every volume step by offsetDb10 (0.1 dB units), e.g. to even out station loudness
+void gainRampSetOffset(GainRamp& ramp, int offsetDb10, uint32_t frames) {
+  ramp.offset = (int32_t)((int64_t)offsetDb10 * ((GAIN_VOLUME_MAX - 1) << GAIN_POSITION_SHIFT) / (GAIN_RANGE_DB * 10));
+  gainRampSetTarget(ramp, ramp.volume, frames);
+}
+
+bool gainRampActive(const GainRamp& ramp) {
+  return ramp.position != ramp.target;
+}
+
+// Apply the gain to frames of interleaved stereo PCM in place. The gain is
+// interpolated linearly from its value at the start of the block to its value
+// at the end, which is at most a block (a few ms) between table lookups.
+void gainRampProcess(GainRamp& ramp, int16_t* buff, uint32_t frames) {
+  if (frames == 0) return;
+
+  int32_t startGain = ramp.gain;
+  if (ramp.position != ramp.target) {
+    int64_t next = (int64_t)ramp.position + (int64_t)ramp.step * frames;
+    if ((ramp.step > 0 && next >= ramp.target) || (ramp.step < 0 && next <= ramp.target)) {
+      next = ramp.target;
+    }
+    ramp.position = (int32_t)next;
+    ramp.gain = gainAtPosition(ramp.position);
+  }
+  int32_t endGain = ramp.gain;
+  uint32_t samples = frames * 2;
+
+  if (startGain == endGain) {
+    if (endGain == GAIN_UNITY) return;
+    if (endGain == 0) {
+      memset(buff, 0, samples * sizeof(int16_t));
+      return;
+    }
+    for (uint32_t i = 0; i < samples; i++) {
+      buff[i] = (int16_t)((buff[i] * endGain) >> 15);
+    }
+    return;
+  }
+
+  // Gain in Q30 (Q15 with 15 extra fraction bits) so small per-frame steps aren't lost
+  int32_t gain = startGain << 15;
+  int32_t delta = ((endGain - startGain) << 15) / (int32_t)frames;
+  for (uint32_t i = 0; i < samples; i += 2) {
+    int32_t g = gain >> 15;
+    buff[i] = (int16_t)((buff[i] * g) >> 15);
+    buff[i + 1] = (int16_t)((buff[i + 1] * g) >> 15);
+    gain += delta;
+  }
+}
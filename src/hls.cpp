@@ -0,0 +1,274 @@
+#include "hls.h"
+
+// ---------------------------------------------------------------------------
+// m3u8 playlists
+
+void hlsPlaylistBegin(HlsPlaylist& playlist) {
+  playlist.valid = false;
+  playlist.master = false;
+  playlist.endList = false;
+  playlist.unsupported = false;
+  playlist.targetDurationMs = 0;
+  playlist.mediaSequence = 0;
+  playlist.first = 0;
+  playlist.count = 0;
+  playlist.variantUri[0] = '\0';
+  playlist.variantBandwidth = 0;
+  playlist.nextSequence = 0;
+  playlist.pendingDurationMs = 0;
+  playlist.pendingDiscontinuity = false;
+  playlist.pendingBandwidth = -1;
+  playlist.lineLength = 0;
+  playlist.keepOldest = false;
+  playlist.keepFrom = 0;
+}
+
+// Keep the first segments from sequence on instead of the newest ones
+void hlsPlaylistKeepFrom(HlsPlaylist& playlist, uint32_t sequence) {
+  playlist.keepOldest = true;
+  playlist.keepFrom = sequence;
+}
+
+// Prefer the best variant within HLS_MAX_VARIANT_BANDWIDTH, else the smallest one
+static void offerVariant(HlsPlaylist& playlist, uint32_t bandwidth, const char* uri) {
+  bool fits = bandwidth <= HLS_MAX_VARIANT_BANDWIDTH;
+  bool currentFits = playlist.variantBandwidth <= HLS_MAX_VARIANT_BANDWIDTH;
+  bool take = playlist.variantUri[0] == '\0' ||
+              (fits && (!currentFits || bandwidth > playlist.variantBandwidth)) ||
+              (!fits && !currentFits && bandwidth < playlist.variantBandwidth);
+  if (!take) return;
+
+  strncpy(playlist.variantUri, uri, sizeof(playlist.variantUri) - 1);
+  playlist.variantUri[sizeof(playlist.variantUri) - 1] = '\0';
+  playlist.variantBandwidth = bandwidth;
+}
+
+static void addSegment(HlsPlaylist& playlist, const char* uri) {
+  if (playlist.keepOldest && (playlist.nextSequence < playlist.keepFrom || playlist.count == HLS_MAX_SEGMENTS)) {
+    playlist.nextSequence++;
+    playlist.pendingDurationMs = 0;
+    playlist.pendingDiscontinuity = false;
+    return;
+  }
+
+  int slot;
+  if (playlist.count < HLS_MAX_SEGMENTS) {
+    slot = (playlist.first + playlist.count) % HLS_MAX_SEGMENTS;
+    playlist.count++;
+  } else {
+    slot = playlist.first; // Only the newest entries matter for live playback
+    playlist.first = (playlist.first + 1) % HLS_MAX_SEGMENTS;
+  }
+
+  HlsSegment& segment = playlist.segments[slot];
+  segment.sequence = playlist.nextSequence++;
+  segment.durationMs = playlist.pendingDurationMs;
+  segment.discontinuity = playlist.pendingDiscontinuity;
+  strncpy(segment.uri, uri, sizeof(segment.uri) - 1);
+  segment.uri[sizeof(segment.uri) - 1] = '\0';
+
+  playlist.pendingDurationMs = 0;
+  playlist.pendingDiscontinuity = false;
+}
+
+static void parseLine(HlsPlaylist& playlist, char* line) {
+  while (*line == ' ' || *line == '\t') line++;
+  if (*line == '\0') return;
+
+  if (*line != '#') {
+    if (playlist.pendingBandwidth >= 0) {
+      offerVariant(playlist, playlist.pendingBandwidth, line);
+      playlist.pendingBandwidth = -1;
+    } else {
+      addSegment(playlist, line);
+    }
+    return;
+  }
+
+  if (strncmp(line, "#EXTM3U", 7) == 0) {
+    playlist.valid = true;
+  } else if (strncmp(line, "#EXTINF:", 8) == 0) {
+    playlist.pendingDurationMs = (uint32_t)(atof(line + 8) * 1000.0f);
+  } else if (strncmp(line, "#EXT-X-TARGETDURATION:", 22) == 0) {
+    playlist.targetDurationMs = atoi(line + 22) * 1000;
+  } else if (strncmp(line, "#EXT-X-MEDIA-SEQUENCE:", 22) == 0) {
+    playlist.mediaSequence = strtoul(line + 22, NULL, 10);
+    playlist.nextSequence = playlist.mediaSequence;
+  } else if (strncmp(line, "#EXT-X-DISCONTINUITY", 20) == 0 &&
+             strncmp(line, "#EXT-X-DISCONTINUITY-SEQUENCE", 29) != 0) {
+    playlist.pendingDiscontinuity = true;
+  } else if (strncmp(line, "#EXT-X-ENDLIST", 14) == 0) {
+    playlist.endList = true;
+  } else if (strncmp(line, "#EXT-X-STREAM-INF:", 18) == 0) {
+    playlist.master = true;
+    const char* bandwidth = strstr(line, "BANDWIDTH=");
+    // AVERAGE-BANDWIDTH= also contains BANDWIDTH=, make sure it is the plain attribute
+    while (bandwidth != NULL && bandwidth > line && *(bandwidth - 1) == '-') {
+      bandwidth = strstr(bandwidth + 1, "BANDWIDTH=");
+    }
+    playlist.pendingBandwidth = bandwidth ? strtoul(bandwidth + 10, NULL, 10) : 0;
+  } else if (strncmp(line, "#EXT-X-MAP:", 11) == 0) {
+    playlist.unsupported = true; // fMP4 segments
+  } else if (strncmp(line, "#EXT-X-KEY:", 11) == 0 && strstr(line, "METHOD=NONE") == NULL) {
+    playlist.unsupported = true; // Encrypted segments
+  }
+}
+
+// Feed the playlist body as it arrives; lines may be split across calls
+void hlsPlaylistFeed(HlsPlaylist& playlist, const char* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    char c = data[i];
+    if (c == '\n') {
+      playlist.line[playlist.lineLength] = '\0';
+      parseLine(playlist, playlist.line);
+      playlist.lineLength = 0;
+    } else if (c != '\r' && playlist.lineLength < sizeof(playlist.line) - 1) {
+      playlist.line[playlist.lineLength++] = c;
+    }
+  }
+}
+
+void hlsPlaylistEnd(HlsPlaylist& playlist) {
+  if (playlist.lineLength > 0) {
+    playlist.line[playlist.lineLength] = '\0';
+    parseLine(playlist, playlist.line);
+    playlist.lineLength = 0;
+  }
+}
+
+// index 0 is the oldest segment kept
+const HlsSegment* hlsPlaylistSegment(const HlsPlaylist& playlist, int index) {
+  if (index < 0 || index >= playlist.count) return NULL;
+  return &playlist.segments[(playlist.first + index) % HLS_MAX_SEGMENTS];
+}
+
+const HlsSegment* hlsPlaylistFind(const HlsPlaylist& playlist, uint32_t sequence) {
+  for (int i = 0; i < playlist.count; i++) {
+    const HlsSegment* segment = hlsPlaylistSegment(playlist, i);
+    if (segment->sequence == sequence) return segment;
+  }
+  return NULL;
+}
+
+// Packed audio segments start with an ID3 tag (timestamps) the decoder doesn't need
+size_t hlsId3TagLength(const uint8_t* data, size_t len) {
+  if (len < 10 || memcmp(data, "ID3", 3) != 0) return 0;
+  size_t size = ((size_t)(data[6] & 0x7F) << 21) | ((size_t)(data[7] & 0x7F) << 14) |
+                ((size_t)(data[8] & 0x7F) << 7) | (data[9] & 0x7F);
+  size_t footer = (data[5] & 0x10) ? 10 : 0;
+  return 10 + size + footer;
+}
+
+// ---------------------------------------------------------------------------
+// MPEG-TS: PAT -> PMT -> first audio PID -> PES payload
+
+void tsDemuxReset(TsDemuxer& demux) {
+  demux.fill = 0;
+  demux.pmtPid = TS_PID_NONE;
+  demux.audioPid = TS_PID_NONE;
+  demux.streamType = 0;
+}
+
+static bool isAudioStreamType(uint8_t type) {
+  return type == 0x0F || type == 0x03 || type == 0x04; // ADTS AAC, MPEG-1/2 audio
+}
+
+// PSI section in a packet payload, after the pointer field. Returns NULL if it doesn't fit.
+static const uint8_t* psiSection(const uint8_t* payload, size_t size, size_t& sectionLength) {
+  if (size < 1 || payload[0] >= size - 1) return NULL;
+  const uint8_t* section = payload + 1 + payload[0];
+  size_t remaining = size - 1 - payload[0];
+  if (remaining < 3) return NULL;
+  sectionLength = ((section[1] & 0x0F) << 8) | section[2];
+  if (sectionLength + 3 > remaining) return NULL; // Tables spanning packets aren't used for radio
+  return section;
+}
+
+static void parsePat(TsDemuxer& demux, const uint8_t* payload, size_t size) {
+  size_t length;
+  const uint8_t* section = psiSection(payload, size, length);
+  if (section == NULL || section[0] != 0x00) return;
+
+  // Programs from byte 8 up to the CRC
+  for (size_t i = 8; i + 4 <= length + 3 - 4; i += 4) {
+    uint16_t program = (section[i] << 8) | section[i + 1];
+    if (program != 0) {
+      demux.pmtPid = ((section[i + 2] & 0x1F) << 8) | section[i + 3];
+      return;
+    }
+  }
+}
+
+static void parsePmt(TsDemuxer& demux, const uint8_t* payload, size_t size) {
+  size_t length;
+  const uint8_t* section = psiSection(payload, size, length);
+  if (section == NULL || section[0] != 0x02 || length < 13) return;
+
+  size_t programInfoLength = ((section[10] & 0x0F) << 8) | section[11];
+  size_t end = length + 3 - 4;
+  for (size_t i = 12 + programInfoLength; i + 5 <= end;) {
+    uint8_t type = section[i];
+    uint16_t pid = ((section[i + 1] & 0x1F) << 8) | section[i + 2];
+    size_t infoLength = ((section[i + 3] & 0x0F) << 8) | section[i + 4];
+    if (isAudioStreamType(type)) {
+      demux.audioPid = pid;
+      demux.streamType = type;
+      return;
+    }
+    i += 5 + infoLength;
+  }
+}
+
+// Demux TS into the audio elementary stream. A packet may be completed by
+// this call, so out must hold len + TS_PACKET_SIZE bytes.
+size_t tsDemux(TsDemuxer& demux, const uint8_t* data, size_t len, uint8_t* out) {
+  size_t written = 0;
+
+  for (size_t pos = 0; pos < len;) {
+    if (demux.fill == 0 && data[pos] != 0x47) {
+      pos++; // Resync on the next sync byte
+      continue;
+    }
+    size_t n = min(len - pos, (size_t)(TS_PACKET_SIZE - demux.fill));
+    memcpy(demux.packet + demux.fill, data + pos, n);
+    demux.fill += n;
+    pos += n;
+    if (demux.fill < TS_PACKET_SIZE) break;
+    demux.fill = 0;
+
+    const uint8_t* packet = demux.packet;
+    bool unitStart = packet[1] & 0x40;
+    uint16_t pid = ((packet[1] & 0x1F) << 8) | packet[2];
+    uint8_t adaptation = (packet[3] >> 4) & 0x03;
+    if (!(adaptation & 0x01)) continue; // No payload
+
+    size_t offset = 4;
+    if (adaptation & 0x02) offset += 1 + packet[4];
+    if (offset >= TS_PACKET_SIZE) continue;
+    const uint8_t* payload = packet + offset;
+    size_t size = TS_PACKET_SIZE - offset;
+
+    if (pid == 0x0000) {
+      if (unitStart) parsePat(demux, payload, size);
+    } else if (pid == demux.pmtPid) {
+      if (unitStart) parsePmt(demux, payload, size);
+    } else if (pid == demux.audioPid) {
+      if (unitStart) {
+        // PES header: start code, stream id, length, flags, header data length
+        if (size < 9 || payload[0] != 0 || payload[1] != 0 || payload[2] != 1) continue;
+        size_t header = 9 + payload[8];
+        if (header >= size) continue;
+        payload += header;
+        size -= header;
+      }
+      memcpy(out + written, payload, size);
+      written += size;
+    }
+  }
+  return written;
+}
+
+const char* tsDemuxContentType(const TsDemuxer& demux) {
+  if (demux.audioPid == TS_PID_NONE) return NULL;
+  return demux.streamType == 0x0F ? "audio/aac" : "audio/mpeg";
+}
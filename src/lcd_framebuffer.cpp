@@ -0,0 +1,358 @@
+#include "lcd_framebuffer.h"
+
+static portMUX_TYPE lcdStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+LcdFramebuffer::LcdFramebuffer(uint8_t address)
+  : col(0), row(0), cursorWanted(false), submittedValid(false), framePending(false), totalFlushUs(0),
+    device(address), queue(NULL), deviceCol(-1), deviceRow(-1), cursorShown(false),
+    countedBytes(0), windowBytes(0), windowLineBytes(0), windowStart(0) {
+  memset(cells, ' ', sizeof(cells));
+  memset(shown, ' ', sizeof(shown));
+  memset(&submitted, 0, sizeof(submitted));
+  memset(&pending, 0, sizeof(pending));
+  memset(&stats, 0, sizeof(stats));
+}
+
+// Called once from setup(); the LCD is cleared and timed before the writer task takes over the bus
+void LcdFramebuffer::init() {
+  if (!device.init()) {
+    Serial.println("LCD backpack not answering on I2C");
+  }
+  device.benchmark(stats.benchmark);
+  Serial.print("LCD: I2C at ");
+  Serial.print(stats.benchmark.busHz / 1000);
+  Serial.print(" kHz, full screen ");
+  Serial.print(stats.benchmark.fullScreenUs);
+  Serial.print(" us (LiquidCrystal_I2C style: ");
+  Serial.print(stats.benchmark.libraryFullScreenUs);
+  Serial.println(" us)");
+  
+  countedBytes = device.bytesSent();
+  memset(cells, ' ', sizeof(cells));
+  memset(shown, ' ', sizeof(shown));
+  col = 0;
+  row = 0;
+  deviceCol = 0;
+  deviceRow = 0;
+  windowStart = millis();
+
+  queue = xQueueCreate(LCD_QUEUE_LENGTH, sizeof(LcdCommand));
+  if (queue == NULL) {
+    Serial.println("Failed to create LCD queue - writing from loop()");
+    return;
+  }
+  if (xTaskCreatePinnedToCore(writerTask, "lcdWriter", LCD_TASK_STACK, this,
+                              LCD_TASK_PRIORITY, NULL, LCD_TASK_CORE) != pdPASS) {
+    Serial.println("Failed to start LCD writer task - writing from loop()");
+    vQueueDelete(queue);
+    queue = NULL;
+  }
+}
+
+// Blank the frame; the LCD itself is only touched by the writer task
+void LcdFramebuffer::clear() {
+  memset(cells, ' ', sizeof(cells));
+  col = 0;
+  row = 0;
+}
+
+void LcdFramebuffer::home() {
+  col = 0;
+  row = 0;
+}
+
+void LcdFramebuffer::setCursor(uint8_t newCol, uint8_t newRow) {
+  col = newCol;
+  row = newRow < LCD_ROWS ? newRow : LCD_ROWS - 1;
+}
+
+// Like the LCD, text past the last column is not shown and does not wrap
+size_t LcdFramebuffer::write(uint8_t value) {
+  if (col < LCD_COLS) cells[row][col] = value;
+  if (col < 255) col++;
+  return 1;
+}
+
+// Hand the frame to the writer task; returns without touching the bus
+void LcdFramebuffer::flush() {
+  LcdFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  memcpy(frame.cells, cells, sizeof(frame.cells));
+  frame.cursorCol = col;
+  frame.cursorRow = row;
+  frame.cursorOn = cursorWanted;
+  if (!cursorWanted) { // The write position only matters for the hardware cursor
+    frame.cursorCol = 0;
+    frame.cursorRow = 0;
+  }
+  bool changed = !submittedValid || memcmp(&frame, &submitted, sizeof(frame)) != 0;
+  if (changed) {
+    submitted = frame;
+    submittedValid = true;
+    frame.uploadCount = glyphs.resolve(frame.cells, frame.uploads);
+  }
+
+  LcdGlyphStats glyphStats;
+  bool glyphStatsChanged = glyphs.takeStats(glyphStats);
+  if (!changed) {
+    if (glyphStatsChanged) {
+      portENTER_CRITICAL(&lcdStatsMux);
+      stats.glyphs = glyphStats;
+      portEXIT_CRITICAL(&lcdStatsMux);
+    }
+    return;
+  }
+
+  bool sendToken;
+  portENTER_CRITICAL(&lcdStatsMux);
+  // Uploads of a frame the task has not taken yet still have to reach the LCD
+  for (uint8_t i = 0; i < pending.uploadCount; i++) {
+    bool reloaded = false;
+    for (uint8_t j = 0; j < frame.uploadCount && !reloaded; j++) {
+      reloaded = frame.uploads[j].slot == pending.uploads[i].slot;
+    }
+    if (!reloaded) frame.uploads[frame.uploadCount++] = pending.uploads[i];
+  }
+  pending = frame;
+  if (glyphStatsChanged) stats.glyphs = glyphStats;
+  sendToken = !framePending;
+  framePending = true;
+  stats.framesSubmitted++;
+  if (!sendToken) stats.framesCoalesced++;
+  portEXIT_CRITICAL(&lcdStatsMux);
+
+  if (sendToken) {
+    LcdCommand cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = LCD_CMD_FRAME;
+    sendCommand(cmd);
+  }
+}
+
+void LcdFramebuffer::defineGlyph(uint8_t code, const uint8_t bitmap[8], char fallback) {
+  glyphs.define(code, bitmap, fallback);
+}
+
+void LcdFramebuffer::backlight() {
+  LcdCommand cmd;
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = LCD_CMD_BACKLIGHT;
+  cmd.on = true;
+  sendCommand(cmd);
+}
+
+void LcdFramebuffer::noBacklight() {
+  LcdCommand cmd;
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = LCD_CMD_BACKLIGHT;
+  cmd.on = false;
+  sendCommand(cmd);
+}
+
+void LcdFramebuffer::cursor() {
+  cursorWanted = true;
+}
+
+void LcdFramebuffer::noCursor() {
+  cursorWanted = false;
+}
+
+// Without the writer task (it failed to start) commands run in the caller
+void LcdFramebuffer::sendCommand(const LcdCommand& cmd) {
+  if (queue == NULL) {
+    runCommand(cmd);
+    return;
+  }
+
+  if (xQueueSend(queue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    portENTER_CRITICAL(&lcdStatsMux);
+    stats.commandsDropped++;
+    if (cmd.type == LCD_CMD_FRAME) framePending = false;
+    portEXIT_CRITICAL(&lcdStatsMux);
+    submittedValid = false; // Submit the frame again on the next flush()
+    Serial.println("LCD queue full - command dropped");
+    return;
+  }
+
+  uint32_t depth = uxQueueMessagesWaiting(queue);
+  portENTER_CRITICAL(&lcdStatsMux);
+  if (depth > stats.maxQueueDepth) stats.maxQueueDepth = depth;
+  portEXIT_CRITICAL(&lcdStatsMux);
+}
+
+// Writer task: the only code that talks to the LCD once init() is done
+void LcdFramebuffer::writerTask(void* arg) {
+  LcdFramebuffer* lcd = (LcdFramebuffer*)arg;
+  LcdCommand cmd;
+
+  while (true) {
+    if (xQueueReceive(lcd->queue, &cmd, pdMS_TO_TICKS(LCD_STATS_WINDOW_MS)) != pdTRUE) {
+      lcd->countBytes(0); // Close the per-second window while nothing changes
+      continue;
+    }
+    lcd->runCommand(cmd);
+  }
+}
+
+void LcdFramebuffer::runCommand(const LcdCommand& cmd) {
+  switch (cmd.type) {
+    case LCD_CMD_FRAME: {
+      LcdFrame frame;
+      portENTER_CRITICAL(&lcdStatsMux);
+      frame = pending;
+      pending.uploadCount = 0;
+      framePending = false;
+      portEXIT_CRITICAL(&lcdStatsMux);
+
+      uint32_t start = micros();
+      writeFrame(frame);
+      uint32_t elapsed = micros() - start;
+
+      portENTER_CRITICAL(&lcdStatsMux);
+      stats.framesWritten++;
+      stats.lastFlushUs = elapsed;
+      if (elapsed > stats.maxFlushUs) stats.maxFlushUs = elapsed;
+      totalFlushUs += elapsed;
+      portEXIT_CRITICAL(&lcdStatsMux);
+      break;
+    }
+    case LCD_CMD_BACKLIGHT:
+      device.backlight(cmd.on);
+      countBytes(LCD_LIBRARY_BYTES_PER_EXPANDER);
+      break;
+  }
+}
+
+// Send the runs of cells that differ from what the LCD shows, batched into as few
+// I2C transactions as the Wire buffer allows. With CGRAM uploads, cells moving to
+// a reloaded slot are written after the upload and everything else before it, so
+// no cell shows an old bitmap in between.
+void LcdFramebuffer::writeFrame(const LcdFrame& frame) {
+  uint32_t lineBytes = 0;
+  uint32_t written = 0;
+  uint32_t moves = 0;
+
+  // The previous updateLCDLine() rewrote a changed line from column 0
+  for (uint8_t r = 0; r < LCD_ROWS; r++) {
+    if (memcmp(frame.cells[r], shown[r], LCD_COLS) != 0) {
+      lineBytes += (1 + LCD_COLS) * LCD_LIBRARY_BYTES_PER_COMMAND;
+    }
+  }
+
+  uint8_t reloaded = 0;
+  for (uint8_t i = 0; i < frame.uploadCount; i++) {
+    reloaded |= 1 << frame.uploads[i].slot;
+  }
+  writeRuns(frame, reloaded, written, moves);
+
+  if (frame.uploadCount > 0) {
+    for (uint8_t i = 0; i < frame.uploadCount; i++) {
+      device.createChar(frame.uploads[i].slot, frame.uploads[i].bitmap);
+    }
+    // CGRAM writes leave the address counter in CGRAM, the next run must set the cursor
+    deviceCol = -1;
+    deviceRow = -1;
+    lineBytes += frame.uploadCount * 9 * LCD_LIBRARY_BYTES_PER_COMMAND;
+    writeRuns(frame, 0, written, moves);
+  }
+
+  // Leave the address counter where the cursor should blink
+  if (frame.cursorOn && frame.cursorCol < LCD_COLS && (deviceRow != frame.cursorRow || deviceCol != frame.cursorCol)) {
+    device.setCursor(frame.cursorCol, frame.cursorRow);
+    deviceRow = frame.cursorRow;
+    deviceCol = frame.cursorCol;
+    moves++;
+  }
+  if (frame.cursorOn != cursorShown) {
+    device.cursor(frame.cursorOn);
+    cursorShown = frame.cursorOn;
+    lineBytes += LCD_LIBRARY_BYTES_PER_COMMAND;
+  }
+  device.send();
+
+  portENTER_CRITICAL(&lcdStatsMux);
+  if (device.bytesSent() != countedBytes) stats.flushes++;
+  stats.cellsWritten += written;
+  stats.cursorMoves += moves;
+  portEXIT_CRITICAL(&lcdStatsMux);
+  countBytes(lineBytes);
+}
+
+// Queue the changed runs, leaving out cells that show one of the deferred slots
+void LcdFramebuffer::writeRuns(const LcdFrame& frame, uint8_t deferredSlots, uint32_t& written, uint32_t& moves) {
+  for (uint8_t r = 0; r < LCD_ROWS; r++) {
+    uint8_t c = 0;
+    while (c < LCD_COLS) {
+      if (!cellChanged(frame, r, c, deferredSlots)) {
+        c++;
+        continue;
+      }
+
+      // Extend the run over short unchanged gaps
+      uint8_t start = c;
+      uint8_t end = c + 1;
+      uint8_t gap = 0;
+      for (uint8_t i = end; i < LCD_COLS; i++) {
+        if (cellChanged(frame, r, i, deferredSlots)) {
+          end = i + 1;
+          gap = 0;
+        } else if (++gap > LCD_FLUSH_MAX_GAP) {
+          break;
+        }
+      }
+      if (deviceRow != r || deviceCol != start) {
+        device.setCursor(start, r);
+        moves++;
+      }
+      // A gap cell may itself be deferred, it gets what the LCD already shows
+      for (uint8_t i = start; i < end; i++) {
+        uint8_t value = cellChanged(frame, r, i, deferredSlots) ? frame.cells[r][i] : shown[r][i];
+        device.write(value);
+        shown[r][i] = value;
+      }
+      written += end - start;
+      deviceRow = r;
+      deviceCol = end;
+      c = end;
+    }
+  }
+}
+
+// Differs from what the LCD shows and is not waiting for its CGRAM slot
+bool LcdFramebuffer::cellChanged(const LcdFrame& frame, uint8_t r, uint8_t c, uint8_t deferredSlots) {
+  uint8_t value = frame.cells[r][c];
+  if (value == shown[r][c]) return false;
+  return !(value < LCD_CGRAM_SLOTS && (deferredSlots & (1 << value)));
+}
+
+// Writer task: takes the bytes the backend sent since the last call and closes
+// the per-second window
+void LcdFramebuffer::countBytes(uint32_t lineBytes) {
+  uint32_t bytes = device.bytesSent() - countedBytes;
+  countedBytes += bytes;
+  windowBytes += bytes;
+  windowLineBytes += lineBytes;
+
+  unsigned long now = millis();
+  portENTER_CRITICAL(&lcdStatsMux);
+  stats.i2cBytes += bytes;
+  if (now - windowStart >= LCD_STATS_WINDOW_MS) {
+    uint32_t elapsed = now - windowStart;
+    stats.bytesPerSecond = (uint64_t)windowBytes * 1000 / elapsed;
+    stats.lineRewriteBytesPerSecond = (uint64_t)windowLineBytes * 1000 / elapsed;
+    if (stats.bytesPerSecond > stats.peakBytesPerSecond) stats.peakBytesPerSecond = stats.bytesPerSecond;
+    windowBytes = 0;
+    windowLineBytes = 0;
+    windowStart = now;
+  }
+  portEXIT_CRITICAL(&lcdStatsMux);
+}
+
+void LcdFramebuffer::getStats(LcdStats& out) {
+  uint32_t depth = queue != NULL ? uxQueueMessagesWaiting(queue) : 0;
+  portENTER_CRITICAL(&lcdStatsMux);
+  out = stats;
+  out.avgFlushUs = stats.framesWritten > 0 ? totalFlushUs / stats.framesWritten : 0;
+  portEXIT_CRITICAL(&lcdStatsMux);
+  out.queueDepth = depth;
+}
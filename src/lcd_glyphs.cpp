@@ -0,0 +1,134 @@
+#include "lcd_glyphs.h"
+
+LcdGlyphs::LcdGlyphs()
+  : definedMask(0), frameStamp(0), statsChanged(false), windowUploads(0), windowStart(0) {
+  memset(bitmaps, 0, sizeof(bitmaps));
+  memset(fallbacks, ' ', sizeof(fallbacks));
+  memset(slotGlyph, LCD_SLOT_FREE, sizeof(slotGlyph));
+  memset(slotUsed, 0, sizeof(slotUsed));
+  memset(&stats, 0, sizeof(stats));
+}
+
+void LcdGlyphs::define(uint8_t code, const uint8_t bitmap[8], char fallback) {
+  if (code < LCD_GLYPH_FIRST || code >= LCD_GLYPH_FIRST + LCD_GLYPH_COUNT) return;
+  uint8_t glyph = code - LCD_GLYPH_FIRST;
+  memcpy(bitmaps[glyph], bitmap, 8);
+  fallbacks[glyph] = fallback;
+  definedMask |= 1 << glyph;
+
+  // A redefined glyph is uploaded again the next time it is shown
+  for (uint8_t s = 0; s < LCD_CGRAM_SLOTS; s++) {
+    if (slotGlyph[s] == glyph) slotGlyph[s] = LCD_SLOT_FREE;
+  }
+
+  stats.defined = 0;
+  for (uint8_t g = 0; g < LCD_GLYPH_COUNT; g++) {
+    if (definedMask & (1 << g)) stats.defined++;
+  }
+  statsChanged = true;
+}
+
+// Free slot first, then the one shown least recently outside this frame
+uint8_t LcdGlyphs::allocateSlot(uint16_t slotsInFrame) {
+  uint8_t best = LCD_SLOT_FREE;
+  uint32_t bestAge = 0;
+  for (uint8_t s = 0; s < LCD_CGRAM_SLOTS; s++) {
+    if (slotsInFrame & (1 << s)) continue;
+    if (slotGlyph[s] == LCD_SLOT_FREE) return s;
+    uint32_t age = frameStamp - slotUsed[s];
+    if (best == LCD_SLOT_FREE || age > bestAge) {
+      best = s;
+      bestAge = age;
+    }
+  }
+  return best;
+}
+
+uint8_t LcdGlyphs::resolve(uint8_t cells[LCD_ROWS][LCD_COLS], LcdGlyphUpload uploads[LCD_CGRAM_SLOTS]) {
+  frameStamp++;
+
+  uint16_t shown = 0;
+  for (uint8_t r = 0; r < LCD_ROWS; r++) {
+    for (uint8_t c = 0; c < LCD_COLS; c++) {
+      uint8_t code = cells[r][c];
+      if (code >= LCD_GLYPH_FIRST && code < LCD_GLYPH_FIRST + LCD_GLYPH_COUNT) {
+        shown |= 1 << (code - LCD_GLYPH_FIRST);
+      }
+    }
+  }
+  if (shown == 0) return 0;
+  uint16_t wanted = shown & definedMask;
+
+  // Glyphs already loaded keep their slots, so newcomers cannot evict them
+  uint8_t glyphSlot[LCD_GLYPH_COUNT];
+  memset(glyphSlot, LCD_SLOT_FREE, sizeof(glyphSlot));
+  uint16_t slotsInFrame = 0;
+  for (uint8_t s = 0; s < LCD_CGRAM_SLOTS; s++) {
+    uint8_t glyph = slotGlyph[s];
+    if (glyph != LCD_SLOT_FREE && (wanted & (1 << glyph))) {
+      glyphSlot[glyph] = s;
+      slotUsed[s] = frameStamp;
+      slotsInFrame |= 1 << s;
+    }
+  }
+
+  uint8_t count = 0;
+  for (uint8_t g = 0; g < LCD_GLYPH_COUNT; g++) {
+    if (!(wanted & (1 << g)) || glyphSlot[g] != LCD_SLOT_FREE) continue;
+
+    uint8_t s = allocateSlot(slotsInFrame);
+    if (s == LCD_SLOT_FREE) {
+      stats.fallbacks++;
+      statsChanged = true;
+      continue;
+    }
+    if (slotGlyph[s] != LCD_SLOT_FREE) {
+      stats.evictions++;
+    } else {
+      stats.resident++;
+    }
+    slotGlyph[s] = g;
+    slotUsed[s] = frameStamp;
+    slotsInFrame |= 1 << s;
+    glyphSlot[g] = s;
+
+    uploads[count].slot = s;
+    memcpy(uploads[count].bitmap, bitmaps[g], 8);
+    count++;
+  }
+  if (count > 0) {
+    stats.uploads += count;
+    windowUploads += count;
+    statsChanged = true;
+  }
+
+  // Undefined codes are blank
+  for (uint8_t r = 0; r < LCD_ROWS; r++) {
+    for (uint8_t c = 0; c < LCD_COLS; c++) {
+      uint8_t code = cells[r][c];
+      if (code < LCD_GLYPH_FIRST || code >= LCD_GLYPH_FIRST + LCD_GLYPH_COUNT) continue;
+      uint8_t glyph = code - LCD_GLYPH_FIRST;
+      if (glyphSlot[glyph] != LCD_SLOT_FREE) {
+        cells[r][c] = glyphSlot[glyph];
+      } else {
+        cells[r][c] = fallbacks[glyph];
+      }
+    }
+  }
+  return count;
+}
+
+// Also closes the per-minute window
+bool LcdGlyphs::takeStats(LcdGlyphStats& out) {
+  unsigned long now = millis();
+  if (now - windowStart >= LCD_GLYPH_STATS_WINDOW_MS) {
+    stats.uploadsPerMinute = (uint64_t)windowUploads * 60000 / (now - windowStart);
+    windowUploads = 0;
+    windowStart = now;
+    statsChanged = true;
+  }
+  if (!statsChanged) return false;
+  out = stats;
+  statsChanged = false;
+  return true;
+}
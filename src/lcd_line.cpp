@@ -0,0 +1,73 @@
+#include "lcd_line.h"
+
+void lineClear(LcdLine& line) {
+  line.length = 0;
+}
+
+void lineAppend(LcdLine& line, const char* text) {
+  while (*text != '\0' && line.length < LCD_LINE_CAPACITY) {
+    line.text[line.length++] = *text++;
+  }
+}
+
+// At most length characters of text, which may be longer or shorter
+void lineAppendN(LcdLine& line, const char* text, size_t length) {
+  for (size_t i = 0; i < length && text[i] != '\0' && line.length < LCD_LINE_CAPACITY; i++) {
+    line.text[line.length++] = text[i];
+  }
+}
+
+void lineAppendChar(LcdLine& line, char c) {
+  if (line.length < LCD_LINE_CAPACITY) line.text[line.length++] = c;
+}
+
+// Logical glyph code (GLYPH_*, 0x10-0x1F), resolved to a CGRAM slot on flush
+void lineAppendGlyph(LcdLine& line, uint8_t glyph) {
+  lineAppendChar(line, (char)glyph);
+}
+
+// Decimal, zero padded to minDigits
+void lineAppendInt(LcdLine& line, long value, uint8_t minDigits) {
+  char digits[12];
+  int count = 0;
+  unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0 && count < (int)sizeof(digits));
+  while (count < minDigits && count < (int)sizeof(digits)) digits[count++] = '0';
+
+  if (value < 0) lineAppendChar(line, '-');
+  while (count > 0) lineAppendChar(line, digits[--count]);
+}
+
+void lineAppendLine(LcdLine& line, const LcdLine& other) {
+  for (uint8_t i = 0; i < other.length && line.length < LCD_LINE_CAPACITY; i++) {
+    line.text[line.length++] = other.text[i];
+  }
+}
+
+// Spaces up to column
+void linePad(LcdLine& line, uint8_t column) {
+  if (column > LCD_LINE_CAPACITY) column = LCD_LINE_CAPACITY;
+  while (line.length < column) line.text[line.length++] = ' ';
+}
+
+// Place right against the last column; if it does not fit, keep one space and cut it
+void lineRightAlign(LcdLine& line, const LcdLine& right) {
+  if (line.length + right.length <= LCD_LINE_CAPACITY) {
+    linePad(line, LCD_LINE_CAPACITY - right.length);
+  } else {
+    lineAppendChar(line, ' ');
+  }
+  lineAppendLine(line, right);
+}
+
+// Shift the text to the middle of the display, the odd space goes to the right
+void lineCenter(LcdLine& line) {
+  uint8_t padding = (LCD_LINE_CAPACITY - line.length) / 2;
+  if (padding == 0) return;
+  memmove(line.text + padding, line.text, line.length);
+  memset(line.text, ' ', padding);
+  line.length += padding;
+}
@@ -0,0 +1,198 @@
+#include "lcd_pcf8574.h"
+#include "config.h"
+#include "Wire.h"
+
+// HD44780 instructions
+#define LCD_CMD_CLEAR 0x01
+#define LCD_CMD_ENTRY_MODE 0x04
+#define LCD_ENTRY_INCREMENT 0x02
+#define LCD_CMD_DISPLAY_CONTROL 0x08
+#define LCD_DISPLAY_ON 0x04
+#define LCD_CURSOR_ON 0x02
+#define LCD_CMD_FUNCTION_SET 0x20
+#define LCD_FUNCTION_2LINE 0x08
+#define LCD_CMD_SET_CGRAM 0x40
+#define LCD_CMD_SET_DDRAM 0x80
+
+static const uint8_t rowOffsets[] = {0x00, 0x40, 0x14, 0x54};
+
+LcdPcf8574::LcdPcf8574(uint8_t address)
+  : address(address), backlightPin(LCD_PIN_BACKLIGHT), displayControl(LCD_DISPLAY_ON), mode(0),
+    padBytes(0), clockHz(LCD_I2C_STANDARD_HZ), sentBytes(0), batchLength(0) {
+}
+
+bool LcdPcf8574::init() {
+  Wire.setClock(LCD_I2C_STANDARD_HZ);
+  clockHz = LCD_I2C_STANDARD_HZ;
+  padBytes = 0;
+  Wire.beginTransmission(address);
+  if (Wire.endTransmission() != 0) return false;
+
+  mode = 0;
+  writeExpander(backlightPin);
+  delay(50);
+
+  // Into 4-bit mode from any state: three times 8-bit function set, then 4-bit
+  const uint8_t wakeup[] = {0x30, 0x30, 0x30, 0x20};
+  const uint16_t waitUs[] = {4500, 4500, 150, 150};
+  for (int i = 0; i < 4; i++) {
+    queueExpander(wakeup[i] | backlightPin | LCD_PIN_EN);
+    queueExpander(wakeup[i] | backlightPin);
+    send();
+    delayMicroseconds(waitUs[i]);
+  }
+
+  queueByte(LCD_CMD_FUNCTION_SET | LCD_FUNCTION_2LINE, 0);
+  queueByte(LCD_CMD_DISPLAY_CONTROL | displayControl, 0);
+  queueByte(LCD_CMD_ENTRY_MODE | LCD_ENTRY_INCREMENT, 0);
+  clear();
+
+  // Fast mode only if the expander reads back what was written at that speed
+  if (probe(LCD_I2C_FAST_HZ)) {
+    clockHz = LCD_I2C_FAST_HZ;
+  } else {
+    Wire.setClock(LCD_I2C_STANDARD_HZ);
+  }
+
+  // Space the nibbles of consecutive bytes by at least LCD_EXEC_US
+  uint32_t byteUs = 9000000UL / clockHz;
+  uint32_t spacing = (LCD_EXEC_US + byteUs - 1) / byteUs;
+  padBytes = spacing > 2 ? spacing - 2 : 0;
+  return true;
+}
+
+// Write two patterns with E low and read the port back
+bool LcdPcf8574::probe(uint32_t hz) {
+  Wire.setClock(hz);
+  const uint8_t patterns[] = {0xA0, 0x50};
+  bool ok = true;
+  for (int i = 0; i < 2 && ok; i++) {
+    uint8_t pins = patterns[i] | backlightPin;
+    Wire.beginTransmission(address);
+    Wire.write(pins);
+    ok = Wire.endTransmission() == 0;
+    sentBytes += 2;
+    if (ok) {
+      ok = Wire.requestFrom(address, (uint8_t)1) == 1 && Wire.read() == pins;
+      sentBytes += 2;
+    }
+  }
+  writeExpander(backlightPin);
+  return ok;
+}
+
+void LcdPcf8574::clear() {
+  queueByte(LCD_CMD_CLEAR, 0);
+  send();
+  delayMicroseconds(LCD_CLEAR_US);
+}
+
+void LcdPcf8574::setCursor(uint8_t col, uint8_t row) {
+  if (row >= LCD_ROWS) row = LCD_ROWS - 1;
+  queueByte(LCD_CMD_SET_DDRAM | (col + rowOffsets[row]), 0);
+}
+
+void LcdPcf8574::write(uint8_t value) {
+  queueByte(value, LCD_PIN_RS);
+}
+
+// Leaves the address counter in CGRAM, set the cursor before writing text
+void LcdPcf8574::createChar(uint8_t location, const uint8_t charmap[8]) {
+  queueByte(LCD_CMD_SET_CGRAM | ((location & 0x7) << 3), 0);
+  for (int i = 0; i < 8; i++) {
+    queueByte(charmap[i], LCD_PIN_RS);
+  }
+}
+
+void LcdPcf8574::backlight(bool on) {
+  send();
+  backlightPin = on ? LCD_PIN_BACKLIGHT : 0;
+  writeExpander(mode | backlightPin);
+}
+
+void LcdPcf8574::cursor(bool on) {
+  displayControl = LCD_DISPLAY_ON | (on ? LCD_CURSOR_ON : 0);
+  queueByte(LCD_CMD_DISPLAY_CONTROL | displayControl, 0);
+}
+
+// Both nibbles of one LCD byte, data latched on the falling edge of E
+void LcdPcf8574::queueByte(uint8_t value, uint8_t newMode) {
+  uint8_t needed = 4 + padBytes + (newMode != mode ? 1 : 0);
+  if (batchLength + needed > LCD_I2C_BATCH_BYTES) send();
+
+  if (newMode != mode) { // RS settles before E rises
+    mode = newMode;
+    queueExpander(mode | backlightPin);
+  }
+  uint8_t high = (value & 0xF0) | mode | backlightPin;
+  uint8_t low = ((value << 4) & 0xF0) | mode | backlightPin;
+  queueExpander(high | LCD_PIN_EN);
+  queueExpander(high);
+  queueExpander(low | LCD_PIN_EN);
+  queueExpander(low);
+  for (uint8_t i = 0; i < padBytes; i++) {
+    queueExpander(low);
+  }
+}
+
+void LcdPcf8574::queueExpander(uint8_t pins) {
+  if (batchLength >= LCD_I2C_BATCH_BYTES) send();
+  batch[batchLength++] = pins;
+}
+
+void LcdPcf8574::send() {
+  if (batchLength == 0) return;
+  Wire.beginTransmission(address);
+  Wire.write(batch, batchLength);
+  Wire.endTransmission();
+  sentBytes += batchLength + 1;
+  batchLength = 0;
+}
+
+void LcdPcf8574::writeExpander(uint8_t pins) {
+  Wire.beginTransmission(address);
+  Wire.write(pins);
+  Wire.endTransmission();
+  sentBytes += 2;
+}
+
+// What LiquidCrystal_I2C does: three transactions per nibble, with its delays
+void LcdPcf8574::writeLibraryStyle(uint8_t value, uint8_t newMode) {
+  mode = newMode;
+  uint8_t nibbles[] = {(uint8_t)(value & 0xF0), (uint8_t)((value << 4) & 0xF0)};
+  for (int i = 0; i < 2; i++) {
+    uint8_t pins = nibbles[i] | mode | backlightPin;
+    writeExpander(pins);
+    writeExpander(pins | LCD_PIN_EN);
+    delayMicroseconds(1);
+    writeExpander(pins);
+    delayMicroseconds(50);
+  }
+}
+
+// Average time to rewrite every cell with a space, each row from column 0
+uint32_t LcdPcf8574::timeFullScreen(bool libraryStyle) {
+  uint32_t start = micros();
+  for (int frame = 0; frame < LCD_BENCHMARK_FRAMES; frame++) {
+    for (uint8_t row = 0; row < LCD_ROWS; row++) {
+      if (libraryStyle) {
+        writeLibraryStyle(LCD_CMD_SET_DDRAM | rowOffsets[row], 0);
+        for (uint8_t col = 0; col < LCD_COLS; col++) writeLibraryStyle(' ', LCD_PIN_RS);
+      } else {
+        setCursor(0, row);
+        for (uint8_t col = 0; col < LCD_COLS; col++) write(' ');
+      }
+    }
+    send();
+  }
+  return (micros() - start) / LCD_BENCHMARK_FRAMES;
+}
+
+// Run on a blank screen, before anything is shown
+void LcdPcf8574::benchmark(LcdBenchmark& result) {
+  Wire.setClock(LCD_I2C_STANDARD_HZ);
+  result.libraryFullScreenUs = timeFullScreen(true);
+  Wire.setClock(clockHz);
+  result.fullScreenUs = timeFullScreen(false);
+  result.busHz = clockHz;
+}
@@ -0,0 +1,83 @@
+#include "level_meter.h"
+#include "freertos/FreeRTOS.h"
+
+// Largest block RMS and peak since the display last read them (linear, 0-32768)
+static volatile bool meterActive = false;
+static uint32_t blockRmsMax = 0;
+static uint32_t blockPeakMax = 0;
+static portMUX_TYPE meterMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Display-side ballistics (display code only)
+static float rmsDb = LEVEL_METER_FLOOR_DB;
+static float peakDb = LEVEL_METER_FLOOR_DB;
+static int peakHold = 0;
+
+void levelMeterSetActive(bool active) {
+  meterActive = active;
+}
+
+bool levelMeterIsActive() {
+  return meterActive;
+}
+
+// RMS and peak (linear, 0-32768) of a block of interleaved stereo PCM, without
+// touching the meter. One pass with no branches besides the max, so the
+// compiler can unroll it.
+void levelMeterMeasure(const int16_t* buff, uint32_t frames, uint32_t& rms, uint32_t& peak) {
+  uint32_t samples = frames * 2;
+  uint64_t sumSquares = 0;
+  int32_t largest = 0;
+  for (uint32_t i = 0; i < samples; i++) {
+    int32_t s = buff[i];
+    sumSquares += (uint32_t)(s * s);
+    int32_t a = s < 0 ? -s : s;
+    largest = a > largest ? a : largest;
+  }
+  rms = samples > 0 ? (uint32_t)sqrtf((float)(sumSquares / samples)) : 0;
+  peak = largest;
+}
+
+// Runs on the audio task for every decoded block
+void levelMeterProcess(const int16_t* buff, uint32_t frames) {
+  if (!meterActive || frames == 0) return;
+
+  uint32_t rms, peak;
+  levelMeterMeasure(buff, frames, rms, peak);
+
+  portENTER_CRITICAL(&meterMux);
+  if (rms > blockRmsMax) blockRmsMax = rms;
+  if (peak > blockPeakMax) blockPeakMax = peak;
+  portEXIT_CRITICAL(&meterMux);
+}
+
+static float toDb(uint32_t level) {
+  if (level == 0) return LEVEL_METER_FLOOR_DB;
+  float db = 20.0f * log10f(level / 32768.0f);
+  return db < LEVEL_METER_FLOOR_DB ? LEVEL_METER_FLOOR_DB : db;
+}
+
+// Called once per display frame (LEVEL_METER_FPS): rises instantly, decays slowly
+void levelMeterFrame(LevelMeterLevels& levels) {
+  portENTER_CRITICAL(&meterMux);
+  uint32_t rms = blockRmsMax;
+  uint32_t peak = blockPeakMax;
+  blockRmsMax = 0;
+  blockPeakMax = 0;
+  portEXIT_CRITICAL(&meterMux);
+
+  float newRms = toDb(rms);
+  rmsDb = max(newRms, rmsDb - LEVEL_METER_RMS_DECAY_DB);
+
+  float newPeak = toDb(peak);
+  if (newPeak >= peakDb) {
+    peakDb = newPeak;
+    peakHold = LEVEL_METER_PEAK_HOLD_FRAMES;
+  } else if (peakHold > 0) {
+    peakHold--;
+  } else {
+    peakDb = max(newPeak, peakDb - LEVEL_METER_PEAK_DECAY_DB);
+  }
+
+  levels.rmsDb = rmsDb;
+  levels.peakDb = peakDb;
+}
@@ -0,0 +1,133 @@
+#include "loudness.h"
+#include "menu.h"
+#include "settings.h"
+#include "audio_engine.h"
+#include <math.h>
+
+// Audio task state
+static int32_t lowPass = 0;           // Q8, the high-pass output is input minus this
+static uint64_t blockSum = 0;
+static uint32_t blockFrames = 0;
+
+// Finished blocks waiting for loop()
+static float pendingPower = 0;        // Sum of the gated block mean squares
+static uint32_t pendingBlocks = 0;
+static portMUX_TYPE loudnessMux = portMUX_INITIALIZER_UNLOCKED;
+
+// loop() state
+static int measuredStream = -1;       // Station the blocks are credited to, -1 = none
+static unsigned long settleUntil = 0;
+static bool dirty = false;
+static unsigned long lastSave = 0;
+
+static const float fullScalePower = 32768.0f * 32768.0f;
+static const float gatePower = fullScalePower * powf(10.0f, LOUDNESS_GATE_DB / 10.0f);
+
+// Audio task: measure decoded PCM before any gain is applied
+void loudnessProcess(const int16_t* buff, uint32_t frames, uint32_t sampleRate) {
+  uint32_t blockLength = sampleRate * LOUDNESS_BLOCK_MS / 1000;
+  int32_t lp = lowPass;
+  uint64_t sum = blockSum;
+  uint32_t count = blockFrames;
+
+  for (uint32_t i = 0; i < frames; i++) {
+    int32_t mono = (buff[i * 2] + buff[i * 2 + 1]) >> 1;
+    lp += ((mono << 8) - lp) >> LOUDNESS_HIGHPASS_SHIFT;
+    uint32_t hp = abs(mono - (lp >> 8));
+    sum += hp * hp;
+    count++;
+
+    if (count >= blockLength) {
+      float power = (float)sum / count;
+      if (power >= gatePower) {
+        portENTER_CRITICAL(&loudnessMux);
+        pendingPower += power;
+        pendingBlocks++;
+        portEXIT_CRITICAL(&loudnessMux);
+      }
+      sum = 0;
+      count = 0;
+    }
+  }
+
+  lowPass = lp;
+  blockSum = sum;
+  blockFrames = count;
+}
+
+// Audio task: a new connection starts a fresh block
+void loudnessReset() {
+  lowPass = 0;
+  blockSum = 0;
+  blockFrames = 0;
+}
+
+// loop(): credit the following blocks to streamIndex (-1 for URLs outside the list)
+void loudnessStationChanged(int streamIndex) {
+  measuredStream = streamIndex;
+  settleUntil = millis() + LOUDNESS_SETTLE_MS;
+}
+
+// Gain offset in 0.1 dB that brings the station to the target loudness
+int loudnessOffsetDb10(int streamIndex) {
+  if (!loudnessNormalization || streamIndex < 0 || streamIndex >= menuStreamCount) return 0;
+  const RadioStream& stream = menuStreams[streamIndex];
+  if (stream.loudnessBlocks < LOUDNESS_MIN_BLOCKS) return 0;
+
+  float offset = LOUDNESS_TARGET_DB - stream.loudnessDb;
+  offset = constrain(offset, -LOUDNESS_MAX_CUT_DB, LOUDNESS_MAX_BOOST_DB);
+  return (int)lroundf(offset * 10.0f);
+}
+
+// Apply the current offset to whatever is playing, e.g. after the setting changed
+void loudnessReapply(unsigned long rampMs) {
+  audioEngineSetGainOffset(loudnessOffsetDb10(measuredStream), rampMs);
+}
+
+// loop(): fold finished blocks into the playing station's estimate
+void updateLoudness() {
+  portENTER_CRITICAL(&loudnessMux);
+  float power = pendingPower;
+  uint32_t blocks = pendingBlocks;
+  pendingPower = 0;
+  pendingBlocks = 0;
+  portEXIT_CRITICAL(&loudnessMux);
+
+  if (blocks == 0 || measuredStream < 0 || measuredStream >= menuStreamCount) return;
+  if ((long)(millis() - settleUntil) < 0 || streamPaused) return;
+  if (blocks > LOUDNESS_MAX_BLOCKS) { // loop() was held up for minutes
+    power = power * LOUDNESS_MAX_BLOCKS / blocks;
+    blocks = LOUDNESS_MAX_BLOCKS;
+  }
+
+  // Running mean in the power domain: exact until LOUDNESS_MAX_BLOCKS, then exponential
+  RadioStream& stream = menuStreams[measuredStream];
+  uint32_t weight = min((uint32_t)stream.loudnessBlocks, (uint32_t)LOUDNESS_MAX_BLOCKS - blocks);
+  float estimate = stream.loudnessBlocks > 0 ? powf(10.0f, stream.loudnessDb / 10.0f) * fullScalePower : 0;
+  estimate = (estimate * weight + power) / (weight + blocks);
+
+  bool wasKnown = stream.loudnessBlocks >= LOUDNESS_MIN_BLOCKS;
+  stream.loudnessDb = 10.0f * log10f(estimate / fullScalePower);
+  stream.loudnessBlocks = weight + blocks;
+  dirty = true;
+
+  // First usable estimate for this station: fade to it instead of waiting for the next connect
+  if (!wasKnown && stream.loudnessBlocks >= LOUDNESS_MIN_BLOCKS && measuredStream == playingStream) {
+    Serial.print("Loudness: ");
+    Serial.print(stream.name);
+    Serial.print(" measures ");
+    Serial.print(stream.loudnessDb);
+    Serial.println(" dBFS");
+    loudnessReapply(LOUDNESS_RAMP_MS);
+  }
+}
+
+// loop(): persist learned estimates, rate limited to spare the flash
+void saveLoudnessIfDirty(bool force) {
+  if (!dirty) return;
+  if (!force && millis() - lastSave < LOUDNESS_SAVE_INTERVAL_MS) return;
+
+  dirty = false;
+  lastSave = millis();
+  saveMenuStreamsToFile();
+}
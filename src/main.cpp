@@ -1,7 +1,6 @@
 //ESP32 Internet Radio - Modular Version
 #include "Arduino.h"
 #include "WiFi.h"
-#include "Audio.h"
 #include "SPIFFS.h"
 #include "config.h"
 #include "settings.h"
@@ -13,13 +12,57 @@
 #include "webserver.h"
 #include "weather.h"
 #include "ota_update.h"
+#include "audio_engine.h"
+#include "stream_relay.h"
+#include "stream_health.h"
+#include "resolve_cache.h"
+#include "tls_session.h"
+#include "audio_telemetry.h"
+#include "loudness.h"
+#include "station_variants.h"
 
-// Audio object
-Audio audio;
+// Standby station prediction
+int lastPlayedStream = -1;
+int standbyCandidate = -1;
+unsigned long standbyCandidateSince = 0;
 
-// Stream health and reconnection variables
-unsigned long lastStreamReconnect = 0;
-const unsigned long STREAM_RECONNECT_INTERVAL = 15 * 60 * 1000; // 15 minutes
+// Time-shift: only relayed streams can be paused, the relay keeps buffering meanwhile
+bool streamRelayed = false;
+bool streamPaused = false;
+
+// Audio engine statistics logging
+unsigned long lastAudioStatsLog = 0;
+const unsigned long AUDIO_STATS_LOG_INTERVAL = 5 * 60 * 1000; // 5 minutes
+
+void handleAudioEvents();
+
+// URL played through /play-url instead of a station from the list (empty otherwise)
+String adHocUrl = "";
+
+// Nothing playing since boot or the last stopStream()
+static bool playbackStopped = true;
+
+// Hand url to the decoder, through the PSRAM relay when possible
+static void startStreamUrl(const String& url) {
+  if (playbackStopped) {
+    recordPlaybackBaseline(); // What the sleep heap check expects back after stopping
+    playbackStopped = false;
+  }
+  // Route the stream through the PSRAM relay; HLS playlists need its playlist buffers,
+  // without them they go straight to the decoder
+  bool hls = url.indexOf(".m3u8") != -1;
+  if (relayAvailable() && (!hls || relayHlsAvailable())) {
+    bool warm = false;
+    const char* localUrl = relayStart(url.c_str(), &warm);
+    audioEngineConnect(localUrl, warm);
+    streamRelayed = true;
+  } else {
+    relayStop();
+    audioEngineConnect(url.c_str());
+    streamRelayed = false;
+  }
+  streamPaused = false;
+}
 
 // Helper function to ensure clean stream connection
 void connectToStream(int streamIndex) {
@@ -28,45 +71,158 @@ void connectToStream(int streamIndex) {
     return;
   }
 
-  audio.stopSong();
-  delay(100);
-  
   // Connect to the new stream
   Serial.print("Connecting to stream: ");
   Serial.println(menuStreams[streamIndex].name);
   Serial.print("URL: ");
-  Serial.println(menuStreams[streamIndex].url);
+  Serial.println(stationStreamUrl(streamIndex));
+  
+  String baseUrl = stationStreamUrl(streamIndex); // The bitrate variant currently chosen for it
+  adHocUrl = "";
+  startStreamUrl(baseUrl);
   
-  // Build a cache-busting URL by appending a unique query parameter
-  ////////// cache-busting - START ///////////////////////////////////
-  String baseUrl = menuStreams[streamIndex].url;
-  String cacheBuster = "?nocache=" + String(millis());
+  // Even out station loudness; applied before the new stream produces audio
+  loudnessStationChanged(streamIndex);
+  audioEngineSetGainOffset(loudnessOffsetDb10(streamIndex), 0);
 
-  // If the URL already has a query string, use '&' instead of '?'
-  if (baseUrl.indexOf('?') != -1) {
-    cacheBuster = "&nocache=" + String(millis());
+  if (playingStream != streamIndex) {
+    lastPlayedStream = playingStream;
   }
-
-  String streamUrl = baseUrl + cacheBuster;
-  Serial.print("Final stream URL: ");
-  Serial.println(streamUrl);
-
-  audio.connecttohost(streamUrl.c_str());
-  ////////// cache-busting - End ///////////////////////////////////
-    //audio.connecttohost(menuStreams[streamIndex].url);
-
   currentStream = streamIndex;
   playingStream = streamIndex;
   isStreaming = true;
   currentStreamName = menuStreams[streamIndex].name;
   
-  // Reset stream reconnection timer
-  lastStreamReconnect = millis();
+  // Watch the new connection and reconnect only if it stalls
+  streamHealthConnected();
   
   Serial.print("Connected to: ");
   Serial.println(menuStreams[streamIndex].name);
 }
 
+// Play a URL that is not in the station list, e.g. a local test stream
+void playUrl(const char* url) {
+  Serial.print("Connecting to URL: ");
+  Serial.println(url);
+
+  adHocUrl = url;
+  startStreamUrl(adHocUrl);
+  loudnessStationChanged(-1); // Not a station, nothing to learn or apply
+  audioEngineSetGainOffset(0, 0);
+  isStreaming = true;
+  currentStreamName = adHocUrl;
+  streamHealthConnected();
+}
+
+// Reconnect whatever is playing, station or ad-hoc URL
+void reconnectStream() {
+  if (adHocUrl.length() > 0) {
+    playUrl(adHocUrl.c_str());
+  } else {
+    connectToStream(playingStream);
+  }
+}
+
+// Stop playback and the upstream connection behind it
+void stopStream() {
+  audioEngineStop();
+  relayStop();
+  streamHealthStopped();
+  streamRelayed = false;
+  streamPaused = false;
+  adHocUrl = "";
+  loudnessStationChanged(-1);
+  saveLoudnessIfDirty(true);
+  playbackStopped = true;
+}
+
+// Pause live radio; the relay keeps receiving so playback can resume from the same point
+void pauseStream() {
+  if (!streamRelayed || streamPaused) return;
+  relayPause();
+  audioEnginePause();
+  streamPaused = true;
+  forceImmediateLcdUpdate = true;
+  Serial.println("Stream paused");
+}
+
+void resumeStream() {
+  if (!streamPaused) return;
+  relayResume();
+  audioEngineResume();
+  streamPaused = false;
+  forceImmediateLcdUpdate = true;
+  Serial.println("Stream resumed");
+}
+
+// Skip the time-shifted audio, no reconnect needed
+void returnToLive() {
+  if (!streamRelayed) return;
+  relayGoLive();
+  if (streamPaused) {
+    audioEngineResume();
+    streamPaused = false;
+  }
+  forceImmediateLcdUpdate = true;
+}
+
+bool streamBehindLive() {
+  if (!streamRelayed) return false;
+  RelayStats relay;
+  getRelayStats(relay);
+  return relay.behindLiveMs >= 1000;
+}
+
+// Time-shift on a hold press outside the menu: resumes when paused, returns to
+// live when playing behind, otherwise pauses. Returns true when the press was used;
+// anything else treats it like a short press.
+bool handleTimeShiftHold() {
+  if (inMenu || activeAlarmIndex >= 0) return false;
+  
+  if (streamPaused) {
+    resumeStream();
+    return true;
+  }
+  if (!radioPowerOn || !isStreaming || !streamRelayed) return false;
+  
+  if (streamBehindLive()) {
+    returnToLive();
+  } else {
+    pauseStream();
+  }
+  return true;
+}
+
+// Keep the station most likely to be picked next buffering on the standby connection:
+// the highlighted entry while scrolling the stream menu, otherwise the last played station
+void updateStandbyStream() {
+  if (!radioPowerOn || !isStreaming || menuStreamCount < 2) return;
+  if (alarmPrewarmActive()) return; // The standby slot holds the upcoming alarm station
+  if (stationVariantSwitchPending()) return; // ...or the next bitrate variant of this one
+
+  int candidate;
+  if (inMenu && currentMenu == MENU_STREAMS) {
+    candidate = (currentStream != playingStream) ? currentStream : (playingStream + 1) % menuStreamCount;
+  } else if (lastPlayedStream >= 0 && lastPlayedStream < menuStreamCount && lastPlayedStream != playingStream) {
+    candidate = lastPlayedStream;
+  } else {
+    candidate = (playingStream + 1) % menuStreamCount;
+  }
+
+  // Don't reconnect on every encoder step while the user is still scrolling
+  if (candidate != standbyCandidate) {
+    standbyCandidate = candidate;
+    standbyCandidateSince = millis();
+    return;
+  }
+  if (millis() - standbyCandidateSince < STANDBY_SETTLE_MS) return;
+
+  const char* url = stationStreamUrl(candidate); // Polled every loop(), so no String copy
+  if (relayHlsAvailable() || strstr(url, ".m3u8") == NULL) {
+    relayPrepareStandby(url);
+  }
+}
+
 void setup() {
   Serial.begin(115200);
   Serial.println("ESP32-S3 Internet Radio Starting...");
@@ -130,14 +286,13 @@ void setup() {
       // System will restart automatically when settings are saved
       while (true) {
         showHotspotInstructions(); // Continuously cycle through instructions
+        lcd.flush();
         delay(100); // Small delay to prevent excessive LCD updates
         // Keep the hotspot running and web server responding
       }
     } else {
       // User chose manual configuration
       Serial.println("Starting manual WiFi configuration...");
-      // Create custom character for backspace before WiFi config
-      lcd.createChar(0, backspaceSymbol);
       configureWiFi();
     }
   }
@@ -174,14 +329,13 @@ void setup() {
       // System will restart automatically when settings are saved
       while (true) {
         showHotspotInstructions(); // Continuously cycle through instructions
+        lcd.flush();
         delay(100); // Small delay to prevent excessive LCD updates
         // Keep the hotspot running and web server responding
       }
     } else {
       // User chose manual configuration
       Serial.println("Starting manual WiFi configuration...");
-      // Create custom character for backspace before WiFi config
-      lcd.createChar(0, backspaceSymbol);
       configureWiFi();
     
       // Try connecting again with new credentials
@@ -230,23 +384,27 @@ void setup() {
   // Initialize weather module
   initWeather();
   
+  // Per-host TLS session cache, shared by the OTA and stream clients
+  initTlsSessionCache();
+  
   // Initialize OTA update system
   initOTA();
   
   // Load streams from JSON file for menu system
   loadMenuStreamsFromFile();
+  loadResolveCache();
   
   // Initialize alarm system
   initializeAlarms();
   alarmSystemActive = true;
   
-  audio.setPinout(I2S_BCLK, I2S_LRC, I2S_DOUT);
-  
-  // Configure audio buffer and connection settings for better streaming stability
-  audio.setConnectionTimeout(30000, 5000); // 30s connect timeout, 5s data timeout
-  audio.forceMono(false); // Ensure proper stereo handling
-  
-  audio.setVolume(volume);
+  // Start the audio engine task (owns the decoder and I2S output)
+  initAudioEngine();
+  audioEngineSetVolume(volume);
+  audioEngineSetTone(toneGainDb);
+  setRelayPrebuffer(prebufferMinMs, prebufferMaxMs);
+  setRelayHlsPrefetch(hlsPrefetchSegments);
+  initStreamRelay();
   
   // Only start streaming if radio is powered on
   if (radioPowerOn && menuStreamCount > 0) {
@@ -270,8 +428,14 @@ void loop() {
     exitMenu();
   }
   
-  // Handle button press (menu navigation)
-  if (checkButtonPress()) {
+  // Handle button press (menu navigation). A hold press (HOLD_PRESS_DURATION) controls
+  // time-shift while a relayed station plays; short presses always reach the menu.
+  bool buttonPressed = checkButtonPress();
+  if (buttonPressed && lastButtonPressWasHold() && handleTimeShiftHold()) {
+    buttonPressed = false;
+  }
+  
+  if (buttonPressed) {
     lastMenuActivity = millis();
     
     // Check if an alarm is currently ringing
@@ -355,10 +519,10 @@ void loop() {
       radioJustTurnedOn = false;
       waitingForStreamStart = false;
       radioTurnOnTime = 0;
-      audio.stopSong();
+      stopStream();
       isStreaming = false;
       if (sleepTimerActive) {
-        sleepTimerActive = false; // Cancel sleep timer when manually turning off radio
+        cancelSleepTimer(); // Cancel sleep timer when manually turning off radio
         Serial.println("Streaming stopped - Sleep timer cancelled");
       } else {
         Serial.println("Streaming stopped");
@@ -401,7 +565,7 @@ void loop() {
   
   // Handle volume change (only when not in menu)
   if (volume != lastVolume && !inMenu) {
-    audio.setVolume(volume);
+    audioEngineSetVolume(volume);
     Serial.print("Volume: ");
     Serial.println(volume);
     lastVolume = volume;
@@ -419,9 +583,22 @@ void loop() {
     lastStream = currentStream;
   }
   
-  // Process audio (only when radio is on)
-  if (radioPowerOn) {
-    audio.loop();
+  // Apply station and track updates reported by the audio engine task
+  handleAudioEvents();
+  
+  // Sample the audio pipeline once per second (also times loop() itself)
+  updateAudioTelemetry();
+  updateLoudness();
+  
+  // Keep the sample-rate converter locked to the station's clock
+  updateAsrcControl();
+  
+  // Log audio engine health periodically while playing
+  if (radioPowerOn && (millis() - lastAudioStatsLog >= AUDIO_STATS_LOG_INTERVAL)) {
+    lastAudioStatsLog = millis();
+    printAudioEngineStats();
+    printAudioTelemetry();
+    printLcdStats();
   }
   
   // Handle web server
@@ -487,83 +664,68 @@ void loop() {
     }
   }
   
-  // Periodic stream reconnection to prevent 30-minute timeouts
-  if (radioPowerOn && isStreaming && 
-      (millis() - lastStreamReconnect >= STREAM_RECONNECT_INTERVAL)) {
-    Serial.println("Preventive stream reconnection (25 min)");
-    connectToStream(currentStream);
+  // Reconnect the stream only when the health monitor sees a real stall
+  checkStreamHealth();
+  
+  // Persist newly resolved station URLs and learned station loudness
+  saveResolveCacheIfDirty();
+  saveLoudnessIfDirty();
+  
+  // Step to a lower bitrate variant while the buffer keeps draining, back up once stable
+  if (radioPowerOn && isStreaming && streamRelayed && !streamPaused && adHocUrl.length() == 0 &&
+      !alarmPrewarmActive() && !streamBehindLive()) {
+    updateStationVariants(playingStream);
+  } else {
+    updateStationVariants(-1);
   }
   
+  // Keep the next likely station buffering
+  updateStandbyStream();
+  
   // Check sleep timer
   checkSleepTimer();
   
   // Check alarms
   checkAlarms();
   
-  // Update LCD display
+  // Update LCD display, then hand the frame to the LCD writer task
   updateLCD();
+  lcd.flush();
 }
 
-// Audio callback functions
-void audio_info(const char *info) {
-  Serial.print("info        "); Serial.println(info);
-}
-void audio_id3data(const char *info) {
-  Serial.print("id3data     "); Serial.println(info);
-}
-void audio_eof_mp3(const char *info) {
-  Serial.print("eof_mp3     "); Serial.println(info);
-}
-void audio_showstation(const char *info) {
-  Serial.print("station     "); Serial.println(info);
-  
-  // If we were waiting for stream to start after turning on radio
-  if (waitingForStreamStart && radioJustTurnedOn) {
-    Serial.println("Stream started - beginning auto-off timer");
-    waitingForStreamStart = false;
-    radioJustTurnedOn = false;
-    lastActivity = millis(); // Start the 5-second timer now
-  }
-  
-  // Reset track info when station changes
-  hasTrackInfo = false;
-  showTrackInfo = false;
-  currentTrackInfo = "";
-}
-void audio_showstreaminfo(const char *info) {
-  Serial.print("streaminfo  "); Serial.println(info);
-}
-void audio_showstreamtitle(const char *info) {
-  Serial.print("streamtitle "); Serial.println(info);
-  
-  // Update track info for display
-  if (info && strlen(info) > 0) {
-    currentTrackInfo = String(info);
-    hasTrackInfo = true;
-    // Reset the toggle timer to immediately show new track info
-    lastTrackToggle = millis() - 10000;
-    showTrackInfo = true;
-    // Reset scroll position for new track
-    trackScrollPosition = 0;
-    lastTrackScroll = millis();
-    forceImmediateLcdUpdate = true;
-  } else {
-    hasTrackInfo = false;
-    showTrackInfo = false;
+// Station and track updates from the audio engine task
+void handleAudioEvents() {
+  AudioEvent event;
+  while (pollAudioEvent(event)) {
+    if (event.type == AUDIO_EVENT_STATION) {
+      // If we were waiting for stream to start after turning on radio
+      if (waitingForStreamStart && radioJustTurnedOn) {
+        Serial.println("Stream started - beginning auto-off timer");
+        waitingForStreamStart = false;
+        radioJustTurnedOn = false;
+        lastActivity = millis(); // Start the 5-second timer now
+      }
+      
+      // Reset track info when station changes
+      hasTrackInfo = false;
+      showTrackInfo = false;
+      currentTrackInfo = "";
+    } else if (event.type == AUDIO_EVENT_TITLE) {
+      // Update track info for display
+      if (strlen(event.text) > 0) {
+        currentTrackInfo = String(event.text);
+        hasTrackInfo = true;
+        // Reset the toggle timer to immediately show new track info
+        lastTrackToggle = millis() - 10000;
+        showTrackInfo = true;
+        // Reset scroll position for new track
+        trackScrollPosition = 0;
+        lastTrackScroll = millis();
+        forceImmediateLcdUpdate = true;
+      } else {
+        hasTrackInfo = false;
+        showTrackInfo = false;
+      }
+    }
   }
 }
-void audio_bitrate(const char *info) {
-  Serial.print("bitrate     "); Serial.println(info);
-}
-void audio_commercial(const char *info) {
-  Serial.print("commercial  "); Serial.println(info);
-}
-void audio_icyurl(const char *info) {
-  Serial.print("icyurl      "); Serial.println(info);
-}
-void audio_lasthost(const char *info) {
-  Serial.print("lasthost    "); Serial.println(info);
-}
-void audio_eof_speech(const char *info) {
-  Serial.print("eof_speech  "); Serial.println(info);
-}
\ No newline at end of file
@@ -4,11 +4,13 @@
 #include "display.h"
 #include "alarm.h"
 #include "ota_update.h"
-#include "Audio.h"
 #include "WiFi.h"
 #include "ArduinoJson.h"
 #include "SPIFFS.h"
 #include "weather.h"
+#include "station_variants.h"
+#include "audio_engine.h"
+#include "stream_relay.h"
 
 // Menu variables
 MenuState currentMenu = MENU_SLEEP;
@@ -36,13 +38,18 @@ unsigned long sleepTimerStart = 0;
 unsigned long sleepTimerDuration = 0;
 bool sleepTimerActive = false;
 
+// Sleep timer fade-out
+static bool sleepFading = false;
+static int sleepFadeVolume = 0;            // Volume the fade started from; turning the knob restarts it
+static unsigned long sleepFadeMs = 0;
+static bool sleepHeapCheckPending = false;
+static unsigned long sleepStoppedAt = 0;
+static SleepTimerStats sleepStats = {};
+
 // Dynamic stream storage for menu system
 RadioStream menuStreams[MAX_MENU_STREAMS];
 int menuStreamCount = 0;
 
-// External audio object (defined in main.cpp)
-extern Audio audio;
-
 void createDefaultStreamsFile() {
   DynamicJsonDocument doc(2048);
   JsonArray array = doc.to<JsonArray>();
@@ -87,6 +94,11 @@ void loadDefaultStreamsToMemory() {
   strcpy(menuStreams[3].url, "https://edge.iono.fm/xice/330_medium.aac");
   strcpy(menuStreams[4].name, "RSG");
   strcpy(menuStreams[4].url, "https://28553.live.streamtheworld.com/RSGAAC.aac");
+  stationVariantsClear();
+  for (int i = 0; i < menuStreamCount; i++) {
+    menuStreams[i].loudnessBlocks = 0;
+    stationVariantsFinish(i, menuStreams[i].url);
+  }
   Serial.println("Default streams loaded to memory as fallback");
 }
 
@@ -104,7 +116,7 @@ void loadMenuStreamsFromFile() {
     }
   }
   
-  DynamicJsonDocument doc(2048);
+  DynamicJsonDocument doc(8192);
   DeserializationError error = deserializeJson(doc, file);
   file.close();
   
@@ -115,6 +127,7 @@ void loadMenuStreamsFromFile() {
   }
   
   menuStreamCount = 0;
+  stationVariantsClear();
   JsonArray array = doc.as<JsonArray>();
   for (JsonObject stream : array) {
     if (menuStreamCount >= MAX_MENU_STREAMS) break;
@@ -127,6 +140,12 @@ void loadMenuStreamsFromFile() {
       menuStreams[menuStreamCount].name[16] = '\0'; // Ensure null termination
       strncpy(menuStreams[menuStreamCount].url, url, 255);
       menuStreams[menuStreamCount].url[255] = '\0'; // Ensure null termination
+      menuStreams[menuStreamCount].loudnessDb = stream["loudness"] | 0.0f;
+      menuStreams[menuStreamCount].loudnessBlocks = stream["loudnessBlocks"] | 0;
+      for (JsonVariant variant : stream["variants"].as<JsonArray>()) {
+        stationVariantsAdd(menuStreamCount, variant.as<const char*>());
+      }
+      stationVariantsFinish(menuStreamCount, menuStreams[menuStreamCount].url);
       menuStreamCount++;
     }
   }
@@ -136,6 +155,36 @@ void loadMenuStreamsFromFile() {
   Serial.println(" streams for menu from JSON file");
 }
 
+// Write the station list back, including what has been learned about each station
+void saveMenuStreamsToFile() {
+  DynamicJsonDocument doc(8192);
+  JsonArray array = doc.to<JsonArray>();
+  
+  for (int i = 0; i < menuStreamCount; i++) {
+    JsonObject stream = array.createNestedObject();
+    stream["name"] = menuStreams[i].name;
+    stream["url"] = menuStreams[i].url;
+    if (menuStreams[i].loudnessBlocks > 0) {
+      stream["loudness"] = roundf(menuStreams[i].loudnessDb * 100.0f) / 100.0f;
+      stream["loudnessBlocks"] = menuStreams[i].loudnessBlocks;
+    }
+    if (stationVariantUrl(i, 0) != NULL) {
+      JsonArray variants = stream.createNestedArray("variants");
+      for (int level = 0; level < stationVariantCount(i); level++) {
+        variants.add(stationVariantUrl(i, level));
+      }
+    }
+  }
+  
+  File file = SPIFFS.open("/streams.json", "w");
+  if (file) {
+    serializeJson(doc, file);
+    file.close();
+  } else {
+    Serial.println("Failed to save streams file");
+  }
+}
+
 void enterMenu() {
   inMenu = true;
   lastMenuActivity = millis();
@@ -251,130 +300,6 @@ void printCurrentMenu() {
   }
 }
 
-void displayCurrentMenu() {
-  switch (currentMenu) {
-    case MENU_SLEEP: {
-      lcd.setCursor(0, 0);
-      lcd.print("MENU: Sleep");
-      lcd.setCursor(0, 1);
-      switch (currentSleepMenu) {
-        case SLEEP_MENU_BLANK:
-          lcd.print("                "); // Print blank line (16 spaces)
-          break;
-        case SLEEP_MENU_OFF:
-          lcd.print("OFF");
-          break;
-        case SLEEP_MENU_15MIN:
-          lcd.print("15 minutes");
-          break;
-        case SLEEP_MENU_30MIN:
-          lcd.print("30 minutes");
-          break;
-        case SLEEP_MENU_60MIN:
-          lcd.print("60 minutes");
-          break;
-        case SLEEP_MENU_90MIN:
-          lcd.print("90 minutes");
-          break;
-        case SLEEP_MENU_5MIN:
-          lcd.print("5 minutes");
-          break;
-      }
-      break;
-    }
-    case MENU_STREAMS: {
-      lcd.setCursor(0, 0);
-      lcd.print("MENU: Station");
-      lcd.setCursor(0, 1);
-      if (menuStreamCount > 0) {
-        String streamName = menuStreams[currentStream].name;
-        if (streamName.length() > 16) {
-          streamName = streamName.substring(0, 16);
-        }
-        lcd.print(streamName);
-      } else {
-        lcd.print("No streams");
-      }
-      break;
-    }
-    case MENU_BRIGHTNESS: {
-      lcd.setCursor(0, 0);
-      lcd.print("MENU: Backlight");
-      lcd.setCursor(0, 1);
-      lcd.print("Mode: ");
-      lcd.print(backlightAlwaysOn ? "ALWAYS ON" : "AUTO OFF");
-      break;
-    }
-    case MENU_WIFI: {
-      if (showingConfirmation) {
-        lcd.setCursor(0, 0);
-        lcd.print("Reset WiFi?");
-        lcd.setCursor(0, 1);
-        lcd.print(confirmationChoice ? "> YES    NO" : "  YES  > NO");
-      } else {
-        lcd.setCursor(0, 0);
-        lcd.print("MENU: WiFi");
-        lcd.setCursor(0, 1);
-        switch (currentWiFiMenu) {
-          case WIFI_MENU_IP: {
-            if (WiFi.status() == WL_CONNECTED) {
-              String ip = WiFi.localIP().toString();
-              if (ip.length() > 16) {
-                // Truncate IP if too long
-                ip = ip.substring(0, 16);
-              }
-              lcd.print(ip);
-            } else {
-              lcd.print("Not connected");
-            }
-            break;
-          }
-          case WIFI_MENU_SSID: {
-            lcd.print("SSID: ");
-            String displaySSID = ssid;
-            if (displaySSID.length() > 10) {
-              displaySSID = displaySSID.substring(0, 10);
-            }
-            lcd.print(displaySSID);
-            break;
-          }
-          case WIFI_MENU_PASSWORD: {
-            lcd.print("PASS: ");
-            if (password.length() > 0) {
-              lcd.print("*****");
-            }
-            break;
-          }
-          case WIFI_MENU_RESET: {
-            lcd.print("Reset WiFi");
-            break;
-          }
-        }
-      }
-      break;
-    }
-    case MENU_WEATHER: {
-      // Weather menu display is now handled in display.cpp
-      break;
-    }
-    case MENU_SYSTEM: {
-      lcd.setCursor(0, 0);
-      lcd.print("MENU: System");
-      lcd.setCursor(0, 1);
-      switch (currentSystemMenu) {
-        case SYSTEM_MENU_FIRMWARE:
-          lcd.print("Firm: ");
-          lcd.print(FIRMWARE_VERSION);
-          break;
-        case SYSTEM_MENU_UPDATE:
-          lcd.print("Update");
-          break;
-      }
-      break;
-    }
-  }
-}
-
 void selectStream() {
   if (menuStreamCount == 0) {
     Serial.println("No streams available to select");
@@ -407,6 +332,7 @@ void resetWiFiSettings() {
   lcd.print("WiFi Reset");
   lcd.setCursor(0, 1);
   lcd.print("Rebooting...");
+  lcd.flush();
   delay(2000);
   
   Serial.println("WiFi settings reset - rebooting");
@@ -651,6 +577,7 @@ void handleSystemMenuButtonPress() {
       lcd.print("Checking for");
       lcd.setCursor(0, 1);
       lcd.print("updates...");
+      lcd.flush();
       delay(1000);
       
       OTAResult result = checkForUpdate();
@@ -662,6 +589,7 @@ void handleSystemMenuButtonPress() {
         lcd.print("Firmware");
         lcd.setCursor(0, 1);
         lcd.print("Up to Date");
+        lcd.flush();
         delay(2000);
         exitMenu();
       } else if (result == OTA_SUCCESS) {
@@ -671,6 +599,7 @@ void handleSystemMenuButtonPress() {
         lcd.print("Update found!");
         lcd.setCursor(0, 1);
         lcd.print("Installing...");
+        lcd.flush();
         delay(1000);
         
         // Download and install update
@@ -684,6 +613,7 @@ void handleSystemMenuButtonPress() {
           lcd.print("Update Failed");
           lcd.setCursor(0, 1);
           lcd.print("Try again later");
+          lcd.flush();
           delay(3000);
           exitMenu();
         }
@@ -694,6 +624,7 @@ void handleSystemMenuButtonPress() {
         lcd.print("Update Error");
         lcd.setCursor(0, 1);
         lcd.print("Check WiFi");
+        lcd.flush();
         delay(3000);
         exitMenu();
       }
@@ -709,7 +640,7 @@ void handleSleepMenuButtonPress() {
       break;
     case SLEEP_MENU_OFF:
       // Turn off sleep timer
-      sleepTimerActive = false;
+      cancelSleepTimer();
       Serial.println("Sleep timer turned OFF");
       exitMenu(); // Exit menu after action
       break;
@@ -736,171 +667,132 @@ void handleSleepMenuButtonPress() {
   }
 }
 
+static void stopSleepFade(bool restoreVolume) {
+  if (sleepFading && restoreVolume) {
+    audioEngineFadeVolume(volume, SLEEP_FADE_RESTORE_MS);
+  }
+  sleepFading = false;
+}
+
 void setSleepTimer(int minutes) {
+  stopSleepFade(true); // Setting a new time undoes a fade already under way
   sleepTimerStart = millis();
   sleepTimerDuration = minutes * 60 * 1000; // Convert minutes to milliseconds
   sleepTimerActive = true;
   
+  // Fade over the last sleepFadeMinutes, or the whole timer if it is shorter
+  sleepFadeMs = min((unsigned long)sleepFadeMinutes * 60000UL, sleepTimerDuration);
+  
   Serial.print("Sleep timer set for ");
   Serial.print(minutes);
   Serial.println(" minutes");
 }
 
-void checkSleepTimer() {
-  if (sleepTimerActive && (millis() - sleepTimerStart >= sleepTimerDuration)) {
-    // Timer expired - turn off radio
-    Serial.println("Sleep timer expired - turning off radio");
-    radioPowerOn = false;
-    audio.stopSong();
-    sleepTimerActive = false;
-    forceImmediateLcdUpdate = true;
+// Turn the timer off, e.g. from the menu or when the radio is switched off by hand
+void cancelSleepTimer() {
+  sleepTimerActive = false;
+  stopSleepFade(true);
+}
+
+bool sleepTimerFading() {
+  return sleepFading;
+}
+
+// Free memory with nothing playing, what the sleep heap check expects to get back
+void recordPlaybackBaseline() {
+  sleepStats.heapBaseline = ESP.getFreeHeap();
+  sleepStats.psramBaseline = ESP.getFreePsram();
+}
+
+// A few seconds after the sleep timer turned the radio off, everything the stream held should be back
+static void checkSleepHeap() {
+  if (!sleepHeapCheckPending || millis() - sleepStoppedAt < SLEEP_HEAP_CHECK_DELAY_MS) return;
+  sleepHeapCheckPending = false;
+  if (radioPowerOn) return; // Switched back on already, nothing to compare
+  
+  RelayStats relay;
+  getRelayStats(relay);
+  uint32_t previous = sleepStats.heapAfter;
+  sleepStats.heapAfter = ESP.getFreeHeap();
+  sleepStats.largestBlockAfter = ESP.getMaxAllocHeap();
+  sleepStats.psramAfter = ESP.getFreePsram();
+  sleepStats.driftBytes = sleepStats.checks > 0 ? (int32_t)sleepStats.heapAfter - (int32_t)previous : 0;
+  bool baseline = sleepStats.heapBaseline > 0;
+  sleepStats.heapDeltaBytes = baseline ? (int32_t)sleepStats.heapAfter - (int32_t)sleepStats.heapBaseline : 0;
+  sleepStats.psramDeltaBytes = baseline ? (int32_t)sleepStats.psramAfter - (int32_t)sleepStats.psramBaseline : 0;
+  sleepStats.connectionsClosed = !relay.active && !relay.upstreamConnected && !relay.standbyConnected &&
+                                 relay.ringFill == 0 && !audioEngineIsRunning();
+  sleepStats.released = sleepStats.connectionsClosed &&
+                        sleepStats.heapDeltaBytes >= -SLEEP_HEAP_SLACK_BYTES &&
+                        sleepStats.psramDeltaBytes >= -SLEEP_HEAP_SLACK_BYTES;
+  sleepStats.checks++;
+  
+  Serial.print("Sleep heap check: ");
+  Serial.print(sleepStats.heapAfter);
+  Serial.print(" bytes free (");
+  Serial.print(sleepStats.heapDeltaBytes);
+  Serial.print(" against the baseline, largest block ");
+  Serial.print(sleepStats.largestBlockAfter);
+  Serial.print(", ");
+  Serial.print(sleepStats.driftBytes);
+  Serial.print(" since the last sleep), PSRAM ");
+  Serial.print(sleepStats.psramAfter);
+  Serial.print(" (");
+  Serial.print(sleepStats.psramDeltaBytes);
+  Serial.println(")");
+  if (!sleepStats.connectionsClosed) {
+    Serial.println("Sleep heap check: connections STILL OPEN");
+  } else if (!sleepStats.released) {
+    Serial.println("Sleep heap check: memory not back to the baseline");
+  }
+  if (sleepStats.driftBytes < -SLEEP_HEAP_DRIFT_WARN_BYTES) {
+    Serial.println("Sleep heap check: free heap keeps shrinking - possible leak");
   }
 }
 
-void displayAlarmMenu() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
+void checkSleepTimer() {
+  checkSleepHeap();
+  if (!sleepTimerActive) return;
   
-  if (!inAlarmSubMenu) {
-    // Main alarm menu - show slot list
-    if (currentAlarmMenu == ALARM_MENU_BLANK) {
-      lcd.print("Alarms");
-      lcd.setCursor(0, 1);
-      lcd.print("                "); // Blank line for navigation
-      return;
-    }
-    
-    // Show "Alarms" on first line
-    lcd.print("Alarms");
-    lcd.setCursor(0, 1);
-    
-    // Show current slot option
-    switch (currentAlarmMenu) {
-      case ALARM_MENU_SLOT1:
-        lcd.print("Slot 1/5");
-        if (alarms[0].enabled) lcd.print("    ON");
-        break;
-      case ALARM_MENU_SLOT2:
-        lcd.print("Slot 2/5");
-        if (alarms[1].enabled) lcd.print("    ON");
-        break;
-      case ALARM_MENU_SLOT3:
-        lcd.print("Slot 3/5");
-        if (alarms[2].enabled) lcd.print("    ON");
-        break;
-      case ALARM_MENU_SLOT4:
-        lcd.print("Slot 4/5");
-        if (alarms[3].enabled) lcd.print("    ON");
-        break;
-      case ALARM_MENU_SLOT5:
-        lcd.print("Slot 5/5");
-        if (alarms[4].enabled) lcd.print("    ON");
-        break;
-    }
-  } else {
-    // Sub-menu - show alarm slot and status on first line
-    switch (currentAlarmSubMenu) {
-      case ALARM_SUB_BACK:
-        lcd.print(String(currentAlarmSlot + 1) + ": ON");
-        lcd.setCursor(0, 1);
-        lcd.print("< BACK");
-        break;
-      case ALARM_SUB_ENABLED:
-        lcd.print(String(currentAlarmSlot + 1) + ": Enable");
-        if (editingAlarmOption) lcd.print("    *");
-        lcd.setCursor(0, 1);
-        lcd.print(alarms[currentAlarmSlot].enabled ? "YES" : "NO");
-        break;
-      case ALARM_SUB_TIME:
-      {
-        lcd.print(String(currentAlarmSlot + 1) + ": Time");
-        if (editingAlarmOption) lcd.print("      *");
-        lcd.setCursor(0, 1);
-        
-        // Check if we should show blinking (every 500ms)
-        bool showBlink = (millis() / 500) % 2 == 0;
-        
-        // Display hours with blinking if editing
-        if (editingTime && editingHours && !showBlink) {
-          lcd.print("  "); // Blank spaces for blinking hours
-        } else {
-          if (alarms[currentAlarmSlot].hour < 10) lcd.print("0");
-          lcd.print(alarms[currentAlarmSlot].hour);
-        }
-        
-        lcd.print(":");
-        
-        // Display minutes with blinking if editing
-        if (editingTime && editingMinutes && !showBlink) {
-          lcd.print("  "); // Blank spaces for blinking minutes
-        } else {
-          if (alarms[currentAlarmSlot].minute < 10) lcd.print("0");
-          lcd.print(alarms[currentAlarmSlot].minute);
-        }
-        break;
-      }
-      case ALARM_SUB_STATION:
-        lcd.print(String(currentAlarmSlot + 1) + ": Station");
-        if (editingAlarmOption) lcd.print("   *");
-        lcd.setCursor(0, 1);
-        if (alarms[currentAlarmSlot].stationIndex < menuStreamCount) {
-          lcd.print(menuStreams[alarms[currentAlarmSlot].stationIndex].name);
-        } else {
-          lcd.print("Unknown");
-        }
-        break;
-      case ALARM_SUB_SCHEDULE:
-        lcd.print(String(currentAlarmSlot + 1) + ": Schedule");
-        if (editingAlarmOption) lcd.print("  *");
-        lcd.setCursor(0, 1);
-        switch (alarms[currentAlarmSlot].schedule) {
-          case ALARM_ONCE:
-            lcd.print("Once");
-            break;
-          case ALARM_DAILY:
-            lcd.print("Daily");
-            break;
-          case ALARM_WEEKDAYS:
-            lcd.print("Weekdays");
-            break;
-          case ALARM_WEEKENDS:
-            lcd.print("Weekends");
-            break;
-        }
-        break;
-      case ALARM_SUB_VOLUME:
-        lcd.print(String(currentAlarmSlot + 1) + ": Volume");
-        if (editingAlarmOption) lcd.print("    *");
-        lcd.setCursor(0, 1);
-        lcd.print(alarms[currentAlarmSlot].maxVolume);
-        break;
-      case ALARM_SUB_AUTO_OFF:
-        lcd.print(String(currentAlarmSlot + 1) + ": Auto Off");
-        if (editingAlarmOption) lcd.print("   *");
-        lcd.setCursor(0, 1);
-        switch (alarms[currentAlarmSlot].autoOff) {
-          case AUTO_OFF_NO:
-            lcd.print("NO");
-            break;
-          case AUTO_OFF_5MIN:
-            lcd.print("5 minutes");
-            break;
-          case AUTO_OFF_15MIN:
-            lcd.print("15 minutes");
-            break;
-          case AUTO_OFF_30MIN:
-            lcd.print("30 minutes");
-            break;
-          case AUTO_OFF_60MIN:
-            lcd.print("60 minutes");
-            break;
-          case AUTO_OFF_90MIN:
-            lcd.print("90 minutes");
-            break;
-        }
-        break;
+  unsigned long elapsed = millis() - sleepTimerStart;
+  
+  // Start the fade once its window is reached. The audio task ramps the gain over
+  // what is left, so zero is reached when the timer expires however late this runs.
+  if (sleepFadeMs > 0 && !sleepFading && radioPowerOn && activeAlarmIndex < 0 &&
+      elapsed + sleepFadeMs >= sleepTimerDuration && elapsed < sleepTimerDuration) {
+    sleepFadeVolume = volume;
+    sleepFading = true;
+    audioEngineFadeVolume(0, sleepTimerDuration - elapsed);
+  } else if (sleepFading) {
+    if (activeAlarmIndex >= 0) {
+      stopSleepFade(false); // The alarm sets its own volume
+    } else if (volume != sleepFadeVolume && elapsed < sleepTimerDuration) {
+      // The knob was turned during the fade: fade again from there over what is left
+      sleepFadeVolume = volume;
+      audioEngineFadeVolume(0, sleepTimerDuration - elapsed);
     }
   }
+  if (elapsed < sleepTimerDuration) return;
+  
+  // Timer expired - turn off radio; after a fade the gain is already at zero
+  bool faded = sleepFading;
+  Serial.println(faded ? "Sleep timer expired - faded out, turning off radio" : "Sleep timer expired - turning off radio");
+  if (faded) sleepStats.fades++;
+  else sleepStats.hardStops++;
+  
+  radioPowerOn = false;
+  stopStream();
+  sleepTimerActive = false;
+  stopSleepFade(false);
+  audioEngineFadeVolume(volume, 0); // Nothing playing now; the next start is at the listener's volume
+  forceImmediateLcdUpdate = true;
+  
+  sleepHeapCheckPending = true;
+  sleepStoppedAt = millis();
+}
+
+void getSleepTimerStats(SleepTimerStats& stats) {
+  stats = sleepStats;
 }
 
 void handleAlarmMenuButtonPress() {
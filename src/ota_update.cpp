@@ -5,6 +5,7 @@
 #include "HTTPClient.h"
 #include "ArduinoJson.h"
 #include "Update.h"
+#include "tls_session.h"
 
 // Version comparison helper
 bool isNewerVersion(const String& current, const String& latest) {
@@ -70,8 +71,9 @@ String getLatestVersion() {
     return "";
   }
   
+  TlsSessionClient tls;
   HTTPClient http;
-  http.begin(GITHUB_API_URL);
+  http.begin(tls, GITHUB_API_URL);
   http.addHeader("User-Agent", "ESP32-Clock-Radio");
   
   int httpResponseCode = http.GET();
@@ -133,6 +135,7 @@ OTAResult checkForUpdate() {
   lcd.print("Checking for");
   lcd.setCursor(0, 1);
   lcd.print("updates...");
+  lcd.flush();
   
   if (WiFi.status() != WL_CONNECTED) {
     Serial.println("WiFi not connected");
@@ -167,40 +170,41 @@ OTAResult checkForUpdate() {
 }
 
 void displayUpdateProgress(int percentage) {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Updating...");
-  lcd.setCursor(0, 1);
-  lcd.print(percentage);
-  lcd.print("%");
+  // If percentage is 100%, show completion
+  if (percentage >= 100) {
+    updateLCDLine(0, "Update Complete");
+    updateLCDLine(1, "Rebooting...");
+    lcd.flush();
+    return;
+  }
   
   // Simple progress bar
   int barLength = 12; // Leave space for percentage
-  int filledLength = (percentage * barLength) / 100;
-  String progressBar = "";
-  for (int i = 0; i < filledLength; i++) {
-    progressBar += "#";
-  }
-  for (int i = filledLength; i < barLength; i++) {
-    progressBar += "-";
+  int filledLength = (max(percentage, 0) * barLength) / 100;
+  LcdLine bar, percent;
+  lineClear(bar);
+  for (int i = 0; i < barLength; i++) {
+    lineAppendChar(bar, i < filledLength ? '#' : '-');
   }
+  lineClear(percent);
+  lineAppendInt(percent, percentage);
+  lineAppendChar(percent, '%');
+  lineRightAlign(bar, percent);
   
-  // If percentage is 100%, show completion
-  if (percentage >= 100) {
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("Update Complete");
-    lcd.setCursor(0, 1);
-    lcd.print("Rebooting...");
-  }
+  updateLCDLine(0, "Updating...");
+  updateLCDLine(1, bar);
+  
+  // Called from the download loop, not from loop()
+  lcd.flush();
 }
 
 bool downloadAndInstallUpdate() {
   Serial.println("Starting firmware download and installation...");
   
   // Get the latest release info
+  TlsSessionClient tls;
   HTTPClient http;
-  http.begin(GITHUB_API_URL);
+  http.begin(tls, GITHUB_API_URL);
   http.addHeader("User-Agent", "ESP32-Clock-Radio");
   
   int httpResponseCode = http.GET();
@@ -280,7 +284,7 @@ bool downloadAndInstallUpdate() {
   Serial.println(downloadUrl);
   
   // Download and install firmware
-  http.begin(downloadUrl);
+  http.begin(tls, downloadUrl);
   http.addHeader("User-Agent", "ESP32-Clock-Radio");
   http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);  // Follow redirects automatically
   
@@ -0,0 +1,155 @@
+#include "resolve_cache.h"
+#include "SPIFFS.h"
+#include <ArduinoJson.h>
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Entries live in PSRAM; the relay fetch task reads them, loop() persists them
+static ResolvedUrl* entries = NULL;
+static int entryCount = 0;
+static bool dirty = false;
+static SemaphoreHandle_t cacheMutex = NULL;
+
+static int findEntry(const char* stationUrl) {
+  for (int i = 0; i < entryCount; i++) {
+    if (strcmp(entries[i].stationUrl, stationUrl) == 0) return i;
+  }
+  return -1;
+}
+
+void loadResolveCache() {
+  if (entries == NULL) {
+    entries = (ResolvedUrl*)heap_caps_malloc(sizeof(ResolvedUrl) * RESOLVE_CACHE_ENTRIES,
+                                             MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    cacheMutex = xSemaphoreCreateMutex();
+    if (entries == NULL || cacheMutex == NULL) {
+      Serial.println("Resolve cache disabled - allocation failed");
+      entries = NULL;
+      return;
+    }
+  }
+  entryCount = 0;
+
+  File file = SPIFFS.open(RESOLVE_CACHE_FILE, "r");
+  if (!file) {
+    Serial.println("No resolved URL cache yet");
+    return;
+  }
+
+  DynamicJsonDocument doc(12288);
+  DeserializationError error = deserializeJson(doc, file);
+  file.close();
+
+  if (error) {
+    Serial.println("Failed to parse resolved URL cache, starting empty");
+    return;
+  }
+
+  JsonArray array = doc.as<JsonArray>();
+  for (JsonObject item : array) {
+    if (entryCount >= RESOLVE_CACHE_ENTRIES) break;
+
+    const char* station = item["station"];
+    const char* media = item["media"];
+    if (station && media) {
+      strncpy(entries[entryCount].stationUrl, station, RESOLVE_CACHE_URL_LENGTH - 1);
+      entries[entryCount].stationUrl[RESOLVE_CACHE_URL_LENGTH - 1] = '\0';
+      strncpy(entries[entryCount].mediaUrl, media, RESOLVE_CACHE_URL_LENGTH - 1);
+      entries[entryCount].mediaUrl[RESOLVE_CACHE_URL_LENGTH - 1] = '\0';
+      entries[entryCount].lastUsed = 0;
+      entryCount++;
+    }
+  }
+
+  Serial.print("Loaded ");
+  Serial.print(entryCount);
+  Serial.println(" resolved stream URLs");
+}
+
+// Called from loop() so the relay task never touches the filesystem
+void saveResolveCacheIfDirty() {
+  if (entries == NULL || !dirty) return;
+
+  DynamicJsonDocument doc(12288);
+  JsonArray array = doc.to<JsonArray>();
+
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  for (int i = 0; i < entryCount; i++) {
+    JsonObject item = array.createNestedObject();
+    item["station"] = entries[i].stationUrl;
+    item["media"] = entries[i].mediaUrl;
+  }
+  dirty = false;
+  xSemaphoreGive(cacheMutex);
+
+  File file = SPIFFS.open(RESOLVE_CACHE_FILE, "w");
+  if (!file) {
+    Serial.println("Failed to write resolved URL cache");
+    return;
+  }
+  serializeJson(doc, file);
+  file.close();
+}
+
+bool resolveCacheLookup(const char* stationUrl, char* mediaUrl, size_t size) {
+  if (entries == NULL) return false;
+
+  bool found = false;
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  int index = findEntry(stationUrl);
+  if (index >= 0) {
+    strncpy(mediaUrl, entries[index].mediaUrl, size - 1);
+    mediaUrl[size - 1] = '\0';
+    entries[index].lastUsed = millis();
+    found = true;
+  }
+  xSemaphoreGive(cacheMutex);
+  return found;
+}
+
+void resolveCacheStore(const char* stationUrl, const char* mediaUrl) {
+  if (entries == NULL) return;
+
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  int index = findEntry(stationUrl);
+  if (index < 0) {
+    if (entryCount < RESOLVE_CACHE_ENTRIES) {
+      index = entryCount++;
+    } else {
+      // Replace the least recently used station
+      index = 0;
+      for (int i = 1; i < entryCount; i++) {
+        if (entries[i].lastUsed < entries[index].lastUsed) index = i;
+      }
+    }
+    strncpy(entries[index].stationUrl, stationUrl, RESOLVE_CACHE_URL_LENGTH - 1);
+    entries[index].stationUrl[RESOLVE_CACHE_URL_LENGTH - 1] = '\0';
+    entries[index].mediaUrl[0] = '\0';
+  }
+
+  if (strcmp(entries[index].mediaUrl, mediaUrl) != 0) {
+    strncpy(entries[index].mediaUrl, mediaUrl, RESOLVE_CACHE_URL_LENGTH - 1);
+    entries[index].mediaUrl[RESOLVE_CACHE_URL_LENGTH - 1] = '\0';
+    dirty = true;
+  }
+  entries[index].lastUsed = millis();
+  xSemaphoreGive(cacheMutex);
+}
+
+void resolveCacheInvalidate(const char* stationUrl) {
+  if (entries == NULL) return;
+
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  int index = findEntry(stationUrl);
+  if (index >= 0) {
+    entries[index] = entries[entryCount - 1];
+    entryCount--;
+    dirty = true;
+  }
+  xSemaphoreGive(cacheMutex);
+}
+
+int resolveCacheCount() {
+  return entryCount;
+}
@@ -1,6 +1,10 @@
 #include "settings.h"
 #include "config.h"
 #include "EEPROM.h"
+#include "stream_relay.h"
+#include "menu.h"
+
+static_assert(sizeof(Settings) <= EEPROM_SIZE, "Settings do not fit in EEPROM_SIZE");
 
 // Global settings variables
 String ssid = "";
@@ -10,6 +14,15 @@ volatile int volume = 5;
 int currentStream = 0;
 bool backlightAlwaysOn = true;
 bool radioPowerOn = true;
+int prebufferMinMs = PREBUFFER_MIN_MS_DEFAULT;
+int prebufferMaxMs = PREBUFFER_MAX_MS_DEFAULT;
+bool levelMeterEnabled = false;
+int backupStream = -1;
+int8_t toneGainDb[TONE_BANDS] = {0};
+bool loudnessNormalization = true;
+int alarmPrewarmSeconds = ALARM_PREWARM_DEFAULT_SECONDS;
+int hlsPrefetchSegments = HLS_PREFETCH_DEFAULT;
+int sleepFadeMinutes = SLEEP_FADE_DEFAULT_MINUTES;
 
 // Global alarm variables
 Alarm alarms[5];
@@ -42,10 +55,124 @@ void saveSettings() {
     settings.alarms[i] = alarms[i];
   }
   
+  settings.prebufferMinMs = prebufferMinMs;
+  settings.prebufferMaxMs = prebufferMaxMs;
+  settings.levelMeterEnabled = levelMeterEnabled;
+  settings.backupStream = backupStream;
+  memcpy(settings.toneGainDb, toneGainDb, sizeof(settings.toneGainDb));
+  settings.loudnessNormalization = loudnessNormalization;
+  settings.alarmPrewarmSeconds = alarmPrewarmSeconds;
+  settings.hlsPrefetchSegments = hlsPrefetchSegments;
+  settings.sleepFadeMinutes = sleepFadeMinutes;
+  
   EEPROM.put(0, settings);
   EEPROM.commit();
 }
 
+// Load and validate alarms (layout unchanged since version 6)
+static void loadAlarms(const Settings& settings) {
+  for (int i = 0; i < 5; i++) {
+    alarms[i] = settings.alarms[i];
+    
+    // Validate alarm data to prevent corruption
+    if (alarms[i].hour < 0 || alarms[i].hour > 23) {
+      Serial.print("Alarm ");
+      Serial.print(i + 1);
+      Serial.println(" hour corrupted, resetting to defaults");
+      alarms[i] = Alarm();
+      snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
+    }
+    
+    if (alarms[i].minute < 0 || alarms[i].minute > 59) {
+      Serial.print("Alarm ");
+      Serial.print(i + 1);
+      Serial.println(" minute corrupted, resetting to defaults");
+      alarms[i] = Alarm();
+      snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
+    }
+    
+    if (alarms[i].maxVolume < 1 || alarms[i].maxVolume > 80) {
+      Serial.print("Alarm ");
+      Serial.print(i + 1);
+      Serial.println(" volume corrupted, resetting to defaults");
+      alarms[i] = Alarm();
+      snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
+    }
+    
+    if (alarms[i].schedule < 0 || alarms[i].schedule >= ALARM_SCHEDULE_COUNT) {
+      Serial.print("Alarm ");
+      Serial.print(i + 1);
+      Serial.println(" schedule corrupted, resetting to defaults");
+      alarms[i] = Alarm();
+      snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
+    }
+    
+    if (alarms[i].autoOff < 0 || alarms[i].autoOff >= AUTO_OFF_COUNT) {
+      Serial.print("Alarm ");
+      Serial.print(i + 1);
+      Serial.println(" auto-off corrupted, resetting to defaults");
+      alarms[i] = Alarm();
+      snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
+    }
+  }
+}
+
+// Load the fields appended in version 7, falling back to defaults
+static void loadStreamSettings(const Settings& settings) {
+  if (settings.version >= 7) {
+    prebufferMinMs = settings.prebufferMinMs;
+    prebufferMaxMs = settings.prebufferMaxMs;
+  } else {
+    prebufferMinMs = PREBUFFER_MIN_MS_DEFAULT;
+    prebufferMaxMs = PREBUFFER_MAX_MS_DEFAULT;
+  }
+  
+  if (prebufferMaxMs < 500 || prebufferMaxMs > PREBUFFER_LIMIT_MS) prebufferMaxMs = PREBUFFER_MAX_MS_DEFAULT;
+  if (prebufferMinMs < 0 || prebufferMinMs > prebufferMaxMs) prebufferMinMs = min(PREBUFFER_MIN_MS_DEFAULT, prebufferMaxMs);
+}
+
+// Load the fields appended in version 8
+static void loadDisplaySettings(const Settings& settings) {
+  levelMeterEnabled = settings.version >= 8 ? settings.levelMeterEnabled : false;
+}
+
+// Load the fields appended in version 9
+static void loadFailoverSettings(const Settings& settings) {
+  backupStream = settings.version >= 9 ? settings.backupStream : -1;
+  if (backupStream < -1 || backupStream >= MAX_MENU_STREAMS) backupStream = -1;
+}
+
+// Load the fields appended in version 10
+static void loadToneSettings(const Settings& settings) {
+  for (int i = 0; i < TONE_BANDS; i++) {
+    toneGainDb[i] = settings.version >= 10 ? settings.toneGainDb[i] : 0;
+    if (toneGainDb[i] < -TONE_GAIN_MAX_DB || toneGainDb[i] > TONE_GAIN_MAX_DB) toneGainDb[i] = 0;
+  }
+}
+
+// Load the fields appended in version 11
+static void loadLoudnessSettings(const Settings& settings) {
+  loudnessNormalization = settings.version >= 11 ? settings.loudnessNormalization : true;
+}
+
+// Load the fields appended in version 12
+static void loadAlarmPrewarmSettings(const Settings& settings) {
+  alarmPrewarmSeconds = settings.version >= 12 ? settings.alarmPrewarmSeconds : ALARM_PREWARM_DEFAULT_SECONDS;
+  if (alarmPrewarmSeconds > ALARM_PREWARM_MAX_SECONDS) alarmPrewarmSeconds = ALARM_PREWARM_DEFAULT_SECONDS;
+}
+
+// Load the fields appended in version 13
+static void loadHlsSettings(const Settings& settings) {
+  hlsPrefetchSegments = settings.version >= 13 ? settings.hlsPrefetchSegments : HLS_PREFETCH_DEFAULT;
+  if (hlsPrefetchSegments < 1 || hlsPrefetchSegments > HLS_PREFETCH_MAX) hlsPrefetchSegments = HLS_PREFETCH_DEFAULT;
+}
+
+// Load the fields appended in version 14
+static void loadSleepFadeSettings(const Settings& settings) {
+  sleepFadeMinutes = settings.version >= 14 ? settings.sleepFadeMinutes : SLEEP_FADE_DEFAULT_MINUTES;
+  if (sleepFadeMinutes > SLEEP_FADE_MAX_MINUTES) sleepFadeMinutes = SLEEP_FADE_DEFAULT_MINUTES;
+}
+
 void loadSettings() {
   Settings settings;
   EEPROM.get(0, settings);
@@ -66,50 +193,15 @@ void loadSettings() {
     weatherApiKey = String(settings.weatherApiKey);
     
     // Load alarms
-    for (int i = 0; i < 5; i++) {
-      alarms[i] = settings.alarms[i];
-      
-      // Validate alarm data to prevent corruption
-      if (alarms[i].hour < 0 || alarms[i].hour > 23) {
-        Serial.print("Alarm ");
-        Serial.print(i + 1);
-        Serial.println(" hour corrupted, resetting to defaults");
-        alarms[i] = Alarm();
-        snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
-      }
-      
-      if (alarms[i].minute < 0 || alarms[i].minute > 59) {
-        Serial.print("Alarm ");
-        Serial.print(i + 1);
-        Serial.println(" minute corrupted, resetting to defaults");
-        alarms[i] = Alarm();
-        snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
-      }
-      
-      if (alarms[i].maxVolume < 1 || alarms[i].maxVolume > 80) {
-        Serial.print("Alarm ");
-        Serial.print(i + 1);
-        Serial.println(" volume corrupted, resetting to defaults");
-        alarms[i] = Alarm();
-        snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
-      }
-      
-      if (alarms[i].schedule < 0 || alarms[i].schedule >= ALARM_SCHEDULE_COUNT) {
-        Serial.print("Alarm ");
-        Serial.print(i + 1);
-        Serial.println(" schedule corrupted, resetting to defaults");
-        alarms[i] = Alarm();
-        snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
-      }
-      
-      if (alarms[i].autoOff < 0 || alarms[i].autoOff >= AUTO_OFF_COUNT) {
-        Serial.print("Alarm ");
-        Serial.print(i + 1);
-        Serial.println(" auto-off corrupted, resetting to defaults");
-        alarms[i] = Alarm();
-        snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
-      }
-    }
+    loadAlarms(settings);
+    loadStreamSettings(settings);
+    loadDisplaySettings(settings);
+    loadFailoverSettings(settings);
+    loadToneSettings(settings);
+    loadLoudnessSettings(settings);
+    loadAlarmPrewarmSettings(settings);
+    loadHlsSettings(settings);
+    loadSleepFadeSettings(settings);
     
     // Validate loaded values
     if (volume < 0) volume = 5;
@@ -132,6 +224,33 @@ void loadSettings() {
     Serial.println(password.length() > 0 ? "[Configured]" : "Not configured");
     Serial.print("  Weather API Key: ");
     Serial.println(weatherApiKey.length() > 0 ? "[Configured]" : "Not configured");
+    Serial.print("  Prebuffer: ");
+    Serial.print(prebufferMinMs);
+    Serial.print("-");
+    Serial.print(prebufferMaxMs);
+    Serial.println("ms");
+    Serial.print("  HLS Prefetch: ");
+    Serial.print(hlsPrefetchSegments);
+    Serial.println(" segments");
+    Serial.print("  Level Meter: ");
+    Serial.println(levelMeterEnabled ? "true" : "false");
+    Serial.print("  Backup Station: ");
+    Serial.println(backupStream);
+    Serial.print("  Alarm Pre-warm: ");
+    Serial.print(alarmPrewarmSeconds);
+    Serial.println("s");
+    Serial.print("  Sleep Fade: ");
+    Serial.print(sleepFadeMinutes);
+    Serial.println(" min");
+    Serial.print("  Loudness Normalization: ");
+    Serial.println(loudnessNormalization ? "true" : "false");
+    Serial.print("  Tone: ");
+    for (int i = 0; i < TONE_BANDS; i++) {
+      Serial.print(toneBandName(i));
+      Serial.print(" ");
+      Serial.print(toneGainDb[i]);
+      Serial.print(i < TONE_BANDS - 1 ? "dB, " : "dB\n");
+    }
     
     // Debug alarm data
     Serial.println("  Alarm status:");
@@ -179,11 +298,24 @@ void loadSettings() {
       Serial.println("Using default settings");
     }
     
-    // Initialize alarms with defaults
-    for (int i = 0; i < 5; i++) {
-      alarms[i] = Alarm();  // Uses constructor defaults
-      snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
+    // Alarms keep their layout from version 6 on; older versions start fresh
+    if (settings.version >= 6 && settings.version < SETTINGS_VERSION) {
+      loadAlarms(settings);
+      Serial.println("Migrated alarms from older version");
+    } else {
+      for (int i = 0; i < 5; i++) {
+        alarms[i] = Alarm();  // Uses constructor defaults
+        snprintf(alarms[i].label, sizeof(alarms[i].label), "Alarm %d", i + 1);
+      }
     }
+    loadStreamSettings(settings);
+    loadDisplaySettings(settings);
+    loadFailoverSettings(settings);
+    loadToneSettings(settings);
+    loadLoudnessSettings(settings);
+    loadAlarmPrewarmSettings(settings);
+    loadHlsSettings(settings);
+    loadSleepFadeSettings(settings);
     
     // Save the updated settings
     saveSettings();
@@ -0,0 +1,267 @@
+#include "station_variants.h"
+#include "menu.h"
+#include "stream_relay.h"
+#include "esp_heap_caps.h"
+
+struct StationVariantList {
+  uint8_t count;             // 0 = no variants, the station URL is played as is
+  bool listed;               // From /streams.json (saved back), not derived
+  uint8_t defaultLevel;      // The configured station URL
+  uint8_t level;             // Current choice, kept while the radio runs
+  uint8_t badLevels;         // Variants that never connected, skipped from now on
+  char urls[VARIANT_MAX][VARIANT_URL_LENGTH];
+};
+
+static StationVariantList* lists = NULL; // MAX_MENU_STREAMS entries in PSRAM
+static const char* const variantSuffixes[VARIANT_MAX] = {"_low", "_medium", "_high"};
+
+// loop() state
+static int adaptStation = -1;
+static unsigned long lastSample = 0;
+static unsigned long lastChange = 0;     // Station start or last switch
+static unsigned long lastTrouble = 0;    // Last underrun or draining period
+static uint32_t lastUnderruns = 0;
+static uint32_t lastFillMs = 0;
+static int drainSeconds = 0;
+static int pendingLevel = -1;
+static unsigned long pendingSince = 0;
+static uint32_t pendingOpens = 0;        // relay standbyOpens when the variant was requested
+static VariantStats counters = {};
+
+static StationVariantList* listFor(int station) {
+  if (lists == NULL || station < 0 || station >= MAX_MENU_STREAMS) return NULL;
+  return &lists[station];
+}
+
+// Called before the station list is (re)loaded
+void stationVariantsClear() {
+  if (lists == NULL) {
+    lists = (StationVariantList*)heap_caps_malloc(sizeof(StationVariantList) * MAX_MENU_STREAMS, MALLOC_CAP_SPIRAM);
+    if (lists == NULL) {
+      Serial.println("Station variants disabled - could not allocate PSRAM");
+      return;
+    }
+  }
+  memset(lists, 0, sizeof(StationVariantList) * MAX_MENU_STREAMS);
+  adaptStation = -1;
+  pendingLevel = -1;
+}
+
+// Variants listed in /streams.json, lowest bitrate first
+void stationVariantsAdd(int station, const char* url) {
+  StationVariantList* list = listFor(station);
+  if (list == NULL || url == NULL || url[0] == '\0' || list->count >= VARIANT_MAX) return;
+  strncpy(list->urls[list->count], url, VARIANT_URL_LENGTH - 1);
+  list->urls[list->count][VARIANT_URL_LENGTH - 1] = '\0';
+  list->count++;
+  list->listed = true;
+}
+
+// Start of a _low/_medium/_high suffix right before the extension (or the end of the path)
+static const char* findSuffix(const char* url, int& level) {
+  const char* query = strchr(url, '?');
+  const char* end = query ? query : url + strlen(url);
+  for (const char* p = end; p > url && *(p - 1) != '/'; p--) {
+    if (*(p - 1) == '.') {
+      end = p - 1;
+      break;
+    }
+  }
+  for (int i = 0; i < VARIANT_MAX; i++) {
+    size_t len = strlen(variantSuffixes[i]);
+    if ((size_t)(end - url) > len && strncmp(end - len, variantSuffixes[i], len) == 0) {
+      level = i;
+      return end - len;
+    }
+  }
+  return NULL;
+}
+
+// The station's URL is known: derive the variants if none were listed and
+// start from the configured URL
+void stationVariantsFinish(int station, const char* url) {
+  StationVariantList* list = listFor(station);
+  if (list == NULL) return;
+
+  int level;
+  const char* suffix;
+  if (list->count == 0 && (suffix = findSuffix(url, level)) != NULL) {
+    const char* rest = suffix + strlen(variantSuffixes[level]);
+    for (int i = 0; i < VARIANT_MAX; i++) {
+      snprintf(list->urls[i], VARIANT_URL_LENGTH, "%.*s%s%s", (int)(suffix - url), url, variantSuffixes[i], rest);
+    }
+    list->count = VARIANT_MAX;
+  }
+
+  int configured = -1;
+  for (int i = 0; i < list->count; i++) {
+    if (strcmp(list->urls[i], url) == 0) configured = i;
+  }
+  if (list->count > 0 && configured < 0) {
+    Serial.print("Variants: ");
+    Serial.print(url);
+    Serial.println(" is not in its own variant list, variants ignored");
+  }
+  if (configured < 0 || list->count < 2) {
+    list->count = 0;
+    list->listed = false;
+    return;
+  }
+  list->defaultLevel = configured;
+  list->level = configured;
+}
+
+int stationVariantCount(int station) {
+  StationVariantList* list = listFor(station);
+  return list ? list->count : 0;
+}
+
+// Listed variants (to save back), NULL for derived ones
+const char* stationVariantUrl(int station, int level) {
+  StationVariantList* list = listFor(station);
+  if (list == NULL || !list->listed || level < 0 || level >= list->count) return NULL;
+  return list->urls[level];
+}
+
+// What to connect to for this station right now
+const char* stationStreamUrl(int station) {
+  StationVariantList* list = listFor(station);
+  if (list != NULL && list->count > 0) return list->urls[list->level];
+  return menuStreams[station].url;
+}
+
+bool stationVariantSwitchPending() {
+  return pendingLevel >= 0;
+}
+
+static void restartAdaptation(int station, const RelayStats& relay) {
+  adaptStation = station;
+  lastChange = millis();
+  lastTrouble = lastChange;
+  lastUnderruns = relay.underruns;
+  lastFillMs = relay.fillMs;
+  drainSeconds = 0;
+  pendingLevel = -1;
+}
+
+static int nextLevel(const StationVariantList& list, int step) {
+  for (int level = list.level + step; level >= 0 && level < list.count; level += step) {
+    if ((list.badLevels & (1 << level)) == 0) return level;
+  }
+  return -1;
+}
+
+// Buffer the variant on the standby connection first
+static void requestSwitch(int station, const StationVariantList& list, int level, const RelayStats& relay) {
+  pendingLevel = level;
+  pendingSince = millis();
+  pendingOpens = relay.standbyOpens;
+  relayPrepareStandby("");  // Make sure the variant gets a fresh standby connection
+  relayPrepareStandby(list.urls[level]);
+
+  Serial.print("Variants: ");
+  Serial.print(menuStreams[station].name);
+  Serial.print(level < list.level ? " buffer draining, preparing " : " stable, preparing ");
+  Serial.println(list.urls[level]);
+}
+
+static void completeSwitch(int station, StationVariantList& list, bool warm) {
+  bool down = pendingLevel < list.level;
+  list.level = pendingLevel;
+  pendingLevel = -1;
+  if (down) counters.stepsDown++;
+  else counters.stepsUp++;
+  if (warm) counters.warmSwitches++;
+  else counters.coldSwitches++;
+
+  Serial.print(down ? "Variants: stepping down to " : "Variants: stepping up to ");
+  Serial.print(list.urls[list.level]);
+  Serial.println(warm ? " (buffered)" : " (not fully buffered)");
+
+  // Same station, so the warm standby swap takes over and the display stays put
+  connectToStream(station);
+  lastChange = millis();
+  drainSeconds = 0;
+}
+
+static void abandonSwitch(StationVariantList& list, bool connected) {
+  Serial.print("Variants: ");
+  Serial.print(list.urls[pendingLevel]);
+  Serial.println(connected ? " too slow to buffer, staying" : " did not connect, skipping it from now on");
+  if (!connected) list.badLevels |= 1 << pendingLevel;
+  counters.abandoned++;
+  pendingLevel = -1;
+  lastChange = millis();
+  relayPrepareStandby(""); // Hand the standby slot back to the next likely station
+}
+
+// loop(): adapt the playing station (-1 while nothing adaptable plays), once per second
+void updateStationVariants(int station) {
+  unsigned long now = millis();
+  if (now - lastSample < 1000) return;
+  lastSample = now;
+
+  StationVariantList* list = listFor(station);
+  if (list == NULL || list->count == 0) {
+    adaptStation = -1;
+    pendingLevel = -1;
+    return;
+  }
+
+  RelayStats relay;
+  getRelayStats(relay);
+  if (station != adaptStation) {
+    restartAdaptation(station, relay);
+    return;
+  }
+
+  // Draining: below the prebuffer target and still falling
+  bool underrun = relay.underruns != lastUnderruns;
+  lastUnderruns = relay.underruns;
+  if (relay.feeding && relay.fillMs < relay.targetMs && relay.fillMs < lastFillMs) {
+    drainSeconds++;
+  } else if (relay.fillMs >= relay.targetMs) {
+    drainSeconds = 0;
+  }
+  lastFillMs = relay.fillMs;
+  bool draining = underrun || drainSeconds >= VARIANT_DRAIN_SECONDS;
+  if (draining) lastTrouble = now;
+
+  if (pendingLevel >= 0) {
+    bool down = pendingLevel < list->level;
+    bool connected = relay.standbyOpens != pendingOpens && relay.standbyConnected;
+    bool expired = now - pendingSince >= VARIANT_SWITCH_TIMEOUT_MS;
+    if (connected && relay.standbyFillMs >= relay.targetMs) {
+      completeSwitch(station, *list, true);
+    } else if (down && connected && (underrun || expired)) {
+      completeSwitch(station, *list, false); // Some audio buffered beats starving on the current variant
+    } else if (expired) {
+      abandonSwitch(*list, connected);
+    }
+    return;
+  }
+
+  if (draining) {
+    drainSeconds = 0;
+    int level = nextLevel(*list, -1);
+    if (level >= 0) requestSwitch(station, *list, level, relay);
+  } else if (list->level < list->defaultLevel && now - lastChange >= VARIANT_STABLE_MS &&
+             now - lastTrouble >= VARIANT_STABLE_MS) {
+    int level = nextLevel(*list, 1);
+    if (level >= 0 && level <= list->defaultLevel) {
+      requestSwitch(station, *list, level, relay);
+    } else {
+      lastChange = now;
+    }
+  }
+}
+
+void getVariantStats(VariantStats& stats) {
+  stats = counters;
+  StationVariantList* list = listFor(adaptStation);
+  stats.station = list ? adaptStation : -1;
+  stats.level = list ? list->level : 0;
+  stats.defaultLevel = list ? list->defaultLevel : 0;
+  stats.count = list ? list->count : 0;
+  stats.pendingLevel = pendingLevel;
+}
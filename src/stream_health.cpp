@@ -0,0 +1,272 @@
+#include "stream_health.h"
+#include "stream_relay.h"
+#include "audio_engine.h"
+#include "menu.h"
+#include "settings.h"
+
+// Monitor state (loop() only)
+static bool monitoring = false;        // A stream is supposed to be playing
+static bool hadAudio = false;          // Decoder produced output since the last connect
+static unsigned long connectTime = 0;
+static unsigned long playingSince = 0;
+static unsigned long lastOutputTime = 0;
+static unsigned long lastHealthCheck = 0;
+static uint32_t lastFrames = 0;
+static bool reconnectPending = false;
+static unsigned long reconnectAt = 0;
+static unsigned long recoveryStart = 0;
+static unsigned long deadAirStart = 0;
+static int deadAirStream = -1;
+
+// Counters, updated from loop() and the relay fetch task
+static StreamHealthStats healthStats = {};
+static portMUX_TYPE healthMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* reasonNames[RECONNECT_REASON_COUNT] = {
+  "upstreamClosed", "upstreamStalled", "decoderStalled", "startTimeout", "deadAir"
+};
+
+const char* reconnectReasonName(int reason) {
+  if (reason < 0 || reason >= RECONNECT_REASON_COUNT) return "none";
+  return reasonNames[reason];
+}
+
+// Exponential backoff with jitter so a failing host isn't hammered and
+// several radios on the same network don't retry in lockstep
+unsigned long streamHealthBackoffMs(uint32_t failures) {
+  uint32_t shift = min(failures, (uint32_t)6);
+  unsigned long delayMs = min((unsigned long)HEALTH_BACKOFF_BASE_MS << shift, (unsigned long)HEALTH_BACKOFF_MAX_MS);
+  return delayMs / 2 + esp_random() % (delayMs / 2 + 1);
+}
+
+void streamHealthReconnectStarted(ReconnectReason reason) {
+  portENTER_CRITICAL(&healthMux);
+  healthStats.reasons[reason].count++;
+  bool first = !healthStats.recovering;
+  if (first) {
+    healthStats.recovering = true;
+    healthStats.recoveringReason = reason;
+    recoveryStart = millis();
+  }
+  portEXIT_CRITICAL(&healthMux);
+
+  Serial.print("Stream health: reconnecting (");
+  Serial.print(reconnectReasonName(reason));
+  Serial.println(")");
+}
+
+void streamHealthConnectFailed() {
+  portENTER_CRITICAL(&healthMux);
+  healthStats.failedAttempts++;
+  portEXIT_CRITICAL(&healthMux);
+}
+
+static void finishRecovery() {
+  unsigned long duration = 0;
+  int reason = -1;
+
+  portENTER_CRITICAL(&healthMux);
+  if (healthStats.recovering) {
+    reason = healthStats.recoveringReason;
+    duration = millis() - recoveryStart;
+    ReconnectReasonStats& r = healthStats.reasons[reason];
+    r.recovered++;
+    r.totalDurationMs += duration;
+    if (duration > r.maxDurationMs) r.maxDurationMs = duration;
+    healthStats.recovering = false;
+  }
+  portEXIT_CRITICAL(&healthMux);
+
+  if (reason >= 0) {
+    Serial.print("Stream health: recovered from ");
+    Serial.print(reconnectReasonName(reason));
+    Serial.print(" after ");
+    Serial.print(duration);
+    Serial.println("ms");
+  }
+}
+
+static void startDeadAir(unsigned long silentMs) {
+  deadAirStart = millis() - silentMs;
+  deadAirStream = playingStream;
+
+  portENTER_CRITICAL(&healthMux);
+  healthStats.deadAir = true;
+  healthStats.deadAirEvents++;
+  portEXIT_CRITICAL(&healthMux);
+
+  Serial.print("Stream health: dead air on ");
+  Serial.print(menuStreams[playingStream].name);
+  Serial.print(" (silent for ");
+  Serial.print(silentMs);
+  Serial.println("ms)");
+}
+
+static void endDeadAir(const char* how) {
+  if (!healthStats.deadAir) return;
+
+  unsigned long duration = millis() - deadAirStart;
+  portENTER_CRITICAL(&healthMux);
+  healthStats.deadAir = false;
+  healthStats.deadAirTotalMs += duration;
+  healthStats.lastDeadAirMs = duration;
+  if (duration > healthStats.deadAirMaxMs) healthStats.deadAirMaxMs = duration;
+  portEXIT_CRITICAL(&healthMux);
+
+  Serial.print("Stream health: dead air ended (");
+  Serial.print(how);
+  Serial.print(") after ");
+  Serial.print(duration);
+  Serial.println("ms");
+}
+
+// Switch to the configured backup station; false when there is none to switch to
+static bool failoverToBackup() {
+  if (backupStream < 0 || backupStream >= menuStreamCount || backupStream == playingStream) {
+    return false;
+  }
+
+  Serial.print("Stream health: failing over from ");
+  Serial.print(menuStreams[playingStream].name);
+  Serial.print(" to backup ");
+  Serial.println(menuStreams[backupStream].name);
+
+  portENTER_CRITICAL(&healthMux);
+  healthStats.failovers++;
+  healthStats.consecutiveFailures = 0;
+  healthStats.currentBackoffMs = 0;
+  portEXIT_CRITICAL(&healthMux);
+
+  connectToStream(backupStream);
+  return true;
+}
+
+static void scheduleReconnect(ReconnectReason reason) {
+  // The last reconnect didn't help - try the backup station instead of another retry
+  if (healthStats.consecutiveFailures >= HEALTH_FAILOVER_RECONNECTS && failoverToBackup()) {
+    return;
+  }
+
+  streamHealthReconnectStarted(reason);
+
+  unsigned long backoff = streamHealthBackoffMs(healthStats.consecutiveFailures);
+  healthStats.consecutiveFailures++;
+  healthStats.currentBackoffMs = backoff;
+  reconnectPending = true;
+  reconnectAt = millis() + backoff;
+
+  Serial.print("Stream health: next connect in ");
+  Serial.print(backoff);
+  Serial.println("ms");
+}
+
+// Called by connectToStream() for every new connection
+void streamHealthConnected() {
+  monitoring = true;
+  hadAudio = false;
+  reconnectPending = false;
+  connectTime = millis();
+  lastOutputTime = connectTime;
+  lastFrames = audioEngineFramesOut();
+}
+
+void streamHealthStopped() {
+  monitoring = false;
+  reconnectPending = false;
+  endDeadAir("stopped");
+
+  portENTER_CRITICAL(&healthMux);
+  healthStats.recovering = false;
+  healthStats.consecutiveFailures = 0;
+  healthStats.currentBackoffMs = 0;
+  portEXIT_CRITICAL(&healthMux);
+}
+
+void checkStreamHealth() {
+  if (!monitoring) return;
+
+  unsigned long now = millis();
+  if (now - lastHealthCheck < HEALTH_CHECK_INTERVAL) return;
+  lastHealthCheck = now;
+
+  if (reconnectPending) {
+    if ((long)(now - reconnectAt) >= 0) {
+      reconnectStream();
+    }
+    return;
+  }
+
+  RelayStats relay;
+  getRelayStats(relay);
+  bool relayed = relay.active;
+
+  // Paused on purpose - restart the stall timer so resuming gets a fresh window
+  if (relayed && relay.paused) {
+    lastOutputTime = now;
+    lastFrames = audioEngineFramesOut();
+    return;
+  }
+
+  // Decoder output is the ground truth: any new PCM frames mean the stream is alive
+  uint32_t frames = audioEngineFramesOut();
+  if (frames != lastFrames) {
+    lastFrames = frames;
+    lastOutputTime = now;
+    if (!hadAudio) {
+      hadAudio = true;
+      playingSince = now;
+    }
+    // Dead air: the stream plays, but only silence
+    uint32_t silentMs = audioEngineSilenceMs();
+    if (silentMs >= HEALTH_DEAD_AIR_MS) {
+      if (!healthStats.deadAir) startDeadAir(silentMs);
+      scheduleReconnect(RECONNECT_DEAD_AIR);
+      return;
+    }
+    bool audible = silentMs < HEALTH_AUDIBLE_MS;
+    if (audible) {
+      endDeadAir(playingStream == deadAirStream ? "programme back" : "backup station");
+    }
+
+    // Through the relay the buffer may hide an outage - recovered means connected again.
+    // After dead air it also has to be audible again.
+    if ((!relayed || relay.upstreamConnected) && !healthStats.deadAir) {
+      finishRecovery();
+    }
+    if (healthStats.consecutiveFailures > 0 && now - playingSince > HEALTH_STABLE_MS) {
+      healthStats.consecutiveFailures = 0;
+      healthStats.currentBackoffMs = 0;
+    }
+    return;
+  }
+
+  if (!hadAudio) {
+    if (now - connectTime < HEALTH_START_TIMEOUT_MS) return;
+    // An unreachable upstream is already being retried by the relay with backoff,
+    // until it has been down long enough to give the backup station a go
+    if (relayed && !relay.upstreamConnected) {
+      if (now - connectTime >= HEALTH_UNREACHABLE_MS) failoverToBackup();
+      return;
+    }
+    scheduleReconnect(RECONNECT_START_TIMEOUT);
+    return;
+  }
+
+  if (now - lastOutputTime < HEALTH_DECODER_STALL_MS) return;
+
+  if (relayed) {
+    // Buffered data that the decoder is not consuming means the decoder is stuck;
+    // an empty buffer means the relay is waiting on (and reconnecting) the upstream
+    if (relay.upstreamConnected && relay.fillMs >= relay.targetMs) {
+      scheduleReconnect(RECONNECT_DECODER_STALLED);
+    }
+  } else {
+    scheduleReconnect(audioEngineIsRunning() ? RECONNECT_UPSTREAM_STALLED : RECONNECT_UPSTREAM_CLOSED);
+  }
+}
+
+void getStreamHealthStats(StreamHealthStats& stats) {
+  portENTER_CRITICAL(&healthMux);
+  stats = healthStats;
+  portEXIT_CRITICAL(&healthMux);
+}
@@ -0,0 +1,1835 @@
+#include "stream_relay.h"
+#include "stream_ring.h"
+#include "audio_engine.h"
+#include "stream_health.h"
+#include "resolve_cache.h"
+#include "tls_session.h"
+#include "hls.h"
+#include "esp_heap_caps.h"
+#include <WiFi.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+// Commands for the fetch task
+enum RelayCommandType {
+  RELAY_CMD_START = 0,
+  RELAY_CMD_STOP = 1,
+  RELAY_CMD_STANDBY = 2
+};
+
+struct RelayCommand {
+  RelayCommandType type;
+  uint32_t session;
+  unsigned long requestTime;
+  char url[256];
+};
+
+// Upstream connection state (fetch task)
+enum UpstreamState {
+  UPSTREAM_IDLE = 0,
+  UPSTREAM_CONNECTING = 1,
+  UPSTREAM_STREAMING = 2
+};
+
+// Decoder connection state (serve task)
+enum DecoderState {
+  DECODER_NONE = 0,
+  DECODER_REQUEST = 1,     // Reading the decoder's HTTP request
+  DECODER_WAIT_UPSTREAM = 2,
+  DECODER_PREBUFFER = 3,   // Holding data back until the target is buffered
+  DECODER_FEEDING = 4
+};
+
+struct ParsedUrl {
+  bool secure;
+  char host[128];
+  uint16_t port;
+  char path[256];
+};
+
+struct ResponseInfo {
+  int status;
+  char location[256];
+  char contentType[48];
+  char icyName[64];
+  int icyBitrate;
+  int icyMetaInt;
+  int32_t contentLength;     // -1 if not sent
+  bool chunked;
+  bool connectionClose;      // Server won't keep the connection open after this response
+};
+
+// HLS playback of a channel (fetch task). The connection stays open between
+// requests; fetched segments are remembered by where they end in the ring.
+struct HlsChannel {
+  HlsPlaylist* playlist;     // PSRAM, NULL if there was no room
+  char playlistUrl[256];     // Media playlist
+  bool started;              // nextSequence is valid
+  uint32_t nextSequence;     // Next segment to fetch
+  uint32_t playlistEnd;      // One past the newest segment at the last load
+  unsigned long nextRefresh;
+  unsigned long lastGrowth;  // Live playlist last gained a segment
+  bool ended;                // Finished playlist, everything fetched
+
+  // Kept-alive connection and the response body being read
+  char host[128];
+  uint16_t port;
+  bool secure;
+  bool closeAfterBody;
+  int32_t bodyRemaining;     // -1 = until the connection closes
+  bool chunked;
+  uint32_t chunkRemaining;
+  bool chunkEnd;             // CRLF after the chunk data still to read
+
+  // Segment being fetched
+  bool fetching;
+  uint32_t segmentSequence;
+  uint32_t segmentDurationMs;
+  uint32_t segmentBytes;     // Audio bytes stored
+  unsigned long segmentRequested;
+  bool segmentStarted;       // ID3 check done
+  bool containerKnown;
+  bool segmentTs;
+  size_t segmentSkip;        // ID3 bytes still to drop
+  char segmentType[48];      // Content-Type of a packed audio segment
+  uint8_t failures;          // Consecutive failed fetches
+  TsDemuxer demux;
+
+  uint32_t queueEnds[HLS_QUEUE_LENGTH]; // ring.totalWritten at the end of each fetched segment
+  int queueCount;
+};
+
+// One upstream connection and its ring. channels[activeChannel] feeds the decoder,
+// the other one is the standby kept warm for the next likely station.
+struct UpstreamChannel {
+  StreamRing ring;
+  UpstreamState state;
+  bool standby;              // Keep only the newest target worth of audio, hold titles back
+  volatile bool ready;       // Headers parsed, audio is flowing into the ring
+  uint32_t session;
+  char url[256];
+  WiFiClient plainClient;
+  TlsSessionClient secureClient;     // Resumes TLS sessions per host
+  WiFiClient* client;
+  unsigned long nextConnectAttempt;
+  unsigned long connectedAt;
+  uint32_t failures;         // Consecutive failed connects/drops, drives the backoff
+  unsigned long requestTime; // relayStart() time while waiting for the first audio byte
+  bool awaitingFirstByte;
+  unsigned long lastDataTime;
+  bool gapValid;
+
+  // Stream properties (strings guarded by relayMux)
+  char contentType[48];
+  char name[64];
+  char lastTitle[128];
+  volatile uint32_t bitrateKbps;
+
+  // ICY metadata stripping
+  int icyMetaInt;
+  size_t audioUntilMeta;
+  size_t metaRemaining;
+  char metaBuffer[256];
+  size_t metaLength;
+
+  bool hls;                  // Station is an HLS playlist
+  HlsChannel hlsState;
+};
+
+static UpstreamChannel channels[2];
+static volatile int activeChannel = 0;
+static bool available = false;
+static bool standbyAvailable = false;
+static QueueHandle_t relayCommandQueue = NULL;
+static TaskHandle_t fetchTaskHandle = NULL;
+static TaskHandle_t serveTaskHandle = NULL;
+static uint8_t fetchBuffer[RELAY_CHUNK_SIZE];
+static uint8_t demuxBuffer[RELAY_CHUNK_SIZE + TS_PACKET_SIZE];
+static bool hlsAvailable = false;
+static volatile int hlsPrefetch = HLS_PREFETCH_DEFAULT;
+static portMUX_TYPE relayMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Sessions: relayStart() bumps requestedSession, the fetch task hands it to the active channel
+static volatile uint32_t requestedSession = 0;
+static char localUrl[64];
+static char standbyUrl[256];  // Last standby request, only touched from loop()
+
+// Adaptive prebuffer (serve task owns the target, limits set from loop())
+static volatile uint32_t prebufferMinMs = PREBUFFER_MIN_MS_DEFAULT;
+static volatile uint32_t prebufferMaxMs = PREBUFFER_MAX_MS_DEFAULT;
+static volatile uint32_t targetMs = PREBUFFER_INITIAL_MS;
+static volatile uint32_t windowMaxGapMs = 0;
+static unsigned long lastUnderrunTime = 0;
+static unsigned long lastTargetCheck = 0;
+
+// Time-shift: shiftRing always holds audio older than the active channel's ring.
+// The serve task moves and plays the data, loop() sets the requests and keeps the delay.
+static StreamRing shiftRing;
+static bool timeShiftAvailable = false;
+static volatile bool paused = false;
+static volatile bool goLiveRequested = false;
+static unsigned long pauseStartTime = 0;
+static unsigned long shiftDelayMs = 0;  // Pause time accumulated since the last live point
+
+// Counters
+static RelayStats relayStats = {};
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t msToBytes(uint32_t ms, uint32_t kbps) {
+  return ms * kbps / 8;
+}
+
+static uint32_t bytesToMs(uint32_t bytes, uint32_t kbps) {
+  if (kbps == 0) return 0;
+  return (uint32_t)((uint64_t)bytes * 8 / kbps);
+}
+
+// ---------------------------------------------------------------------------
+// URL and HTTP helpers
+
+static bool parseStreamUrl(const char* url, ParsedUrl& out) {
+  const char* p = url;
+  if (strncasecmp(p, "https://", 8) == 0) {
+    out.secure = true;
+    out.port = 443;
+    p += 8;
+  } else if (strncasecmp(p, "http://", 7) == 0) {
+    out.secure = false;
+    out.port = 80;
+    p += 7;
+  } else {
+    return false;
+  }
+
+  const char* hostEnd = p;
+  while (*hostEnd && *hostEnd != '/' && *hostEnd != ':' && *hostEnd != '?') hostEnd++;
+  size_t hostLen = hostEnd - p;
+  if (hostLen == 0 || hostLen >= sizeof(out.host)) return false;
+  memcpy(out.host, p, hostLen);
+  out.host[hostLen] = '\0';
+
+  p = hostEnd;
+  if (*p == ':') {
+    out.port = (uint16_t)atoi(p + 1);
+    while (*p && *p != '/' && *p != '?') p++;
+  }
+
+  if (*p == '\0') {
+    strcpy(out.path, "/");
+  } else if (*p == '?') {
+    snprintf(out.path, sizeof(out.path), "/%s", p);
+  } else {
+    strncpy(out.path, p, sizeof(out.path) - 1);
+    out.path[sizeof(out.path) - 1] = '\0';
+  }
+  return out.port != 0;
+}
+
+// Resolve a Location header against the URL that produced it
+static void resolveLocation(char* url, size_t urlSize, const ParsedUrl& base, const char* location) {
+  if (strncasecmp(location, "http://", 7) == 0 || strncasecmp(location, "https://", 8) == 0) {
+    strncpy(url, location, urlSize - 1);
+    url[urlSize - 1] = '\0';
+    return;
+  }
+
+  const char* scheme = base.secure ? "https" : "http";
+  if (location[0] == '/') {
+    snprintf(url, urlSize, "%s://%s:%u%s", scheme, base.host, base.port, location);
+  } else {
+    // Relative to the directory of the current path
+    char dir[256];
+    strncpy(dir, base.path, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = '\0';
+    char* slash = strrchr(dir, '/');
+    if (slash) *(slash + 1) = '\0';
+    snprintf(url, urlSize, "%s://%s:%u%s%s", scheme, base.host, base.port, dir, location);
+  }
+}
+
+// Read one header line (without CRLF). Returns length, or -1 on timeout/disconnect.
+static int readLine(WiFiClient& client, char* buf, size_t size, unsigned long deadline) {
+  size_t len = 0;
+  while ((long)(deadline - millis()) > 0) {
+    if (client.available() <= 0) {
+      if (!client.connected()) return -1;
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
+    }
+    int c = client.read();
+    if (c < 0) continue;
+    if (c == '\n') {
+      buf[len] = '\0';
+      return (int)len;
+    }
+    if (c != '\r' && len < size - 1) {
+      buf[len++] = (char)c;
+    }
+  }
+  return -1;
+}
+
+static void copyHeaderValue(const char* line, size_t nameLen, char* dst, size_t dstSize) {
+  const char* value = line + nameLen;
+  while (*value == ' ') value++;
+  strncpy(dst, value, dstSize - 1);
+  dst[dstSize - 1] = '\0';
+}
+
+static bool readResponseHeaders(WiFiClient& client, ResponseInfo& info) {
+  unsigned long deadline = millis() + RELAY_HEADER_TIMEOUT_MS;
+  char line[256];
+
+  memset(&info, 0, sizeof(info));
+  info.contentLength = -1;
+  if (readLine(client, line, sizeof(line), deadline) < 0) return false;
+
+  // "HTTP/1.1 200 OK" or "ICY 200 OK"
+  const char* space = strchr(line, ' ');
+  if (space == NULL) return false;
+  info.status = atoi(space + 1);
+  info.connectionClose = strncmp(line, "HTTP/1.1", 8) != 0;
+
+  for (;;) {
+    int len = readLine(client, line, sizeof(line), deadline);
+    if (len < 0) return false;
+    if (len == 0) return true; // End of headers
+
+    if (strncasecmp(line, "location:", 9) == 0) {
+      copyHeaderValue(line, 9, info.location, sizeof(info.location));
+    } else if (strncasecmp(line, "content-type:", 13) == 0) {
+      copyHeaderValue(line, 13, info.contentType, sizeof(info.contentType));
+      char* semicolon = strchr(info.contentType, ';');
+      if (semicolon) *semicolon = '\0';
+    } else if (strncasecmp(line, "icy-name:", 9) == 0) {
+      copyHeaderValue(line, 9, info.icyName, sizeof(info.icyName));
+    } else if (strncasecmp(line, "icy-br:", 7) == 0) {
+      info.icyBitrate = atoi(line + 7);
+    } else if (strncasecmp(line, "icy-metaint:", 12) == 0) {
+      info.icyMetaInt = atoi(line + 12);
+    } else if (strncasecmp(line, "content-length:", 15) == 0) {
+      info.contentLength = atol(line + 15);
+    } else if (strncasecmp(line, "transfer-encoding:", 18) == 0) {
+      info.chunked = strstr(line + 18, "chunked") != NULL;
+    } else if (strncasecmp(line, "connection:", 11) == 0) {
+      if (strstr(line + 11, "close") != NULL) info.connectionClose = true;
+      else if (strstr(line + 11, "keep-alive") != NULL) info.connectionClose = false;
+    }
+  }
+}
+
+static bool pathEndsWith(const char* path, const char* ext) {
+  const char* end = strchr(path, '?');
+  size_t len = end ? (size_t)(end - path) : strlen(path);
+  size_t extLen = strlen(ext);
+  return len >= extLen && strncasecmp(path + len - extLen, ext, extLen) == 0;
+}
+
+static bool isPlaylist(const ResponseInfo& info, const ParsedUrl& target) {
+  if (strstr(info.contentType, "mpegurl") || strstr(info.contentType, "scpls") ||
+      strstr(info.contentType, "x-pls")) {
+    return true;
+  }
+  return pathEndsWith(target.path, ".m3u") || pathEndsWith(target.path, ".pls");
+}
+
+// Pick the first stream URL out of an m3u or pls playlist body; hls is set for HLS playlists
+static bool readPlaylistUrl(WiFiClient& client, char* url, size_t urlSize, bool& hls) {
+  unsigned long deadline = millis() + RELAY_HEADER_TIMEOUT_MS;
+  char line[256];
+
+  for (int lines = 0; lines < 64; lines++) {
+    int len = readLine(client, line, sizeof(line), deadline);
+    if (len < 0) break;
+
+    char* entry = line;
+    while (*entry == ' ' || *entry == '\t') entry++;
+    if (strncmp(entry, "#EXT-X-", 7) == 0) {
+      hls = true;
+      return false;
+    }
+    if (strncasecmp(entry, "file", 4) == 0) {
+      char* equals = strchr(entry, '=');
+      if (equals) entry = equals + 1;
+    }
+    if (strncasecmp(entry, "http://", 7) == 0 || strncasecmp(entry, "https://", 8) == 0) {
+      strncpy(url, entry, urlSize - 1);
+      url[urlSize - 1] = '\0';
+      return true;
+    }
+  }
+
+  Serial.println("Relay: no stream URL found in playlist");
+  return false;
+}
+
+static void inferContentType(const char* path, char* dst, size_t size) {
+  const char* type = "audio/mpeg";
+  if (pathEndsWith(path, ".aac")) type = "audio/aac";
+  else if (pathEndsWith(path, ".ogg") || pathEndsWith(path, ".opus")) type = "application/ogg";
+  else if (pathEndsWith(path, ".flac")) type = "audio/flac";
+  strncpy(dst, type, size - 1);
+  dst[size - 1] = '\0';
+}
+
+// ---------------------------------------------------------------------------
+// Fetch task: upstream connections, ICY stripping, ring writes
+
+static UpstreamChannel& activeCh() {
+  return channels[activeChannel];
+}
+
+static UpstreamChannel& standbyCh() {
+  return channels[1 - activeChannel];
+}
+
+static void closeChannel(UpstreamChannel& ch) {
+  if (ch.client != NULL) {
+    ch.client->stop();
+    ch.client = NULL;
+  }
+  ch.ready = false;
+  ch.awaitingFirstByte = false;
+  ch.state = UPSTREAM_IDLE;
+  ch.url[0] = '\0';
+  ch.lastTitle[0] = '\0';
+  ch.hls = false;
+  ch.hlsState.started = false;
+  ch.hlsState.fetching = false;
+  ch.hlsState.queueCount = 0;
+  ch.hlsState.host[0] = '\0';
+  streamRingReset(ch.ring);
+}
+
+static void openChannel(UpstreamChannel& ch, const char* url, bool standby) {
+  closeChannel(ch);
+  strncpy(ch.url, url, sizeof(ch.url) - 1);
+  ch.url[sizeof(ch.url) - 1] = '\0';
+  ch.standby = standby;
+  ch.state = UPSTREAM_CONNECTING;
+  ch.failures = 0;
+  ch.nextConnectAttempt = millis();
+}
+
+// Connect to startUrl, following redirects and playlists until a media stream answers.
+// The URL that finally served the media is left in url. An HLS playlist ends the
+// search with hlsPlaylist set and its URL in url.
+static bool connectMedia(UpstreamChannel& ch, char* url, size_t urlSize, bool& hlsPlaylist) {
+
+  for (int hop = 0; hop <= RELAY_MAX_REDIRECTS; hop++) {
+    ParsedUrl target;
+    if (!parseStreamUrl(url, target)) {
+      Serial.print("Relay: invalid URL ");
+      Serial.println(url);
+      return false;
+    }
+    if (pathEndsWith(target.path, ".m3u8")) {
+      ch.client = NULL;
+      hlsPlaylist = true;
+      return false;
+    }
+
+    if (target.secure) {
+      ch.client = &ch.secureClient;
+    } else {
+      ch.client = &ch.plainClient;
+    }
+
+    if (!ch.client->connect(target.host, target.port)) {
+      Serial.print("Relay: connection failed to ");
+      Serial.println(target.host);
+      ch.client = NULL;
+      return false;
+    }
+
+    char request[512];
+    int requestLen;
+    bool defaultPort = (target.secure && target.port == 443) || (!target.secure && target.port == 80);
+    if (defaultPort) {
+      requestLen = snprintf(request, sizeof(request),
+                            "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: OOSIE-Radio\r\n"
+                            "Icy-MetaData: 1\r\nAccept: */*\r\nConnection: close\r\n\r\n",
+                            target.path, target.host);
+    } else {
+      requestLen = snprintf(request, sizeof(request),
+                            "GET %s HTTP/1.0\r\nHost: %s:%u\r\nUser-Agent: OOSIE-Radio\r\n"
+                            "Icy-MetaData: 1\r\nAccept: */*\r\nConnection: close\r\n\r\n",
+                            target.path, target.host, target.port);
+    }
+    ch.client->write((const uint8_t*)request, min(requestLen, (int)sizeof(request) - 1));
+
+    ResponseInfo info;
+    if (!readResponseHeaders(*ch.client, info)) {
+      Serial.println("Relay: no response from server");
+      ch.client->stop();
+      ch.client = NULL;
+      return false;
+    }
+
+    if (info.status >= 300 && info.status < 400 && info.location[0] != '\0') {
+      resolveLocation(url, urlSize, target, info.location);
+      Serial.print("Relay: redirected to ");
+      Serial.println(url);
+      ch.client->stop();
+      continue;
+    }
+
+    if (info.status != 200) {
+      Serial.print("Relay: HTTP status ");
+      Serial.println(info.status);
+      ch.client->stop();
+      ch.client = NULL;
+      return false;
+    }
+
+    if (isPlaylist(info, target)) {
+      bool hls = false;
+      bool found = readPlaylistUrl(*ch.client, url, urlSize, hls);
+      ch.client->stop();
+      if (!found) {
+        ch.client = NULL;
+        hlsPlaylist = hls; // Played from url, which is still the playlist
+        return false;
+      }
+      Serial.print("Relay: playlist entry ");
+      Serial.println(url);
+      continue;
+    }
+
+    // Media stream - publish its properties for the serve task
+    portENTER_CRITICAL(&relayMux);
+    if (info.contentType[0] != '\0') {
+      strncpy(ch.contentType, info.contentType, sizeof(ch.contentType) - 1);
+      ch.contentType[sizeof(ch.contentType) - 1] = '\0';
+    } else {
+      inferContentType(target.path, ch.contentType, sizeof(ch.contentType));
+    }
+    strncpy(ch.name, info.icyName, sizeof(ch.name) - 1);
+    ch.name[sizeof(ch.name) - 1] = '\0';
+    portEXIT_CRITICAL(&relayMux);
+    ch.bitrateKbps = info.icyBitrate > 0 ? info.icyBitrate : RELAY_DEFAULT_BITRATE_KBPS;
+
+    ch.icyMetaInt = info.icyMetaInt;
+    ch.audioUntilMeta = ch.icyMetaInt;
+    ch.metaRemaining = 0;
+    ch.metaLength = 0;
+
+    Serial.print(ch.standby ? "Relay: standby streaming " : "Relay: streaming ");
+    Serial.print(ch.contentType);
+    Serial.print(" at ");
+    Serial.print(ch.bitrateKbps);
+    Serial.println(" kbps");
+    return true;
+  }
+
+  Serial.println("Relay: too many redirects");
+  if (ch.client != NULL) {
+    ch.client->stop();
+    ch.client = NULL;
+  }
+  return false;
+}
+
+static void recordConnectLatency(bool cached, unsigned long started) {
+  unsigned long latency = millis() - started;
+  portENTER_CRITICAL(&statsMux);
+  if (cached) {
+    relayStats.cachedConnects++;
+    relayStats.cachedConnectTotalMs += latency;
+  } else {
+    relayStats.resolvedConnects++;
+    relayStats.resolvedConnectTotalMs += latency;
+  }
+  portEXIT_CRITICAL(&statsMux);
+
+  Serial.print(cached ? "Relay: connected via cached URL in " : "Relay: connected via full resolution in ");
+  Serial.print(latency);
+  Serial.println("ms");
+}
+
+static bool openHls(UpstreamChannel& ch, char* url, size_t urlSize);
+
+// A media stream, or an HLS playlist played segment by segment
+static bool openMedia(UpstreamChannel& ch, char* url, size_t urlSize) {
+  bool hlsPlaylist = false;
+  ch.hls = false;
+  if (connectMedia(ch, url, urlSize, hlsPlaylist)) return true;
+  if (!hlsPlaylist) return false;
+  if (!hlsAvailable) {
+    Serial.println("Relay: HLS playlists need PSRAM for the playlist");
+    return false;
+  }
+  return openHls(ch, url, urlSize);
+}
+
+// Go straight to the cached media URL when there is one, fall back to resolving the station URL
+static bool openUpstream(UpstreamChannel& ch) {
+  char url[256];
+  unsigned long started = millis();
+
+  if (resolveCacheLookup(ch.url, url, sizeof(url))) {
+    if (openMedia(ch, url, sizeof(url))) {
+      recordConnectLatency(true, started);
+      return true;
+    }
+    Serial.println("Relay: cached URL failed, resolving station URL");
+    resolveCacheInvalidate(ch.url);
+    portENTER_CRITICAL(&statsMux);
+    relayStats.cacheFallbacks++;
+    portEXIT_CRITICAL(&statsMux);
+    started = millis();
+  }
+
+  strncpy(url, ch.url, sizeof(url) - 1);
+  url[sizeof(url) - 1] = '\0';
+  if (!openMedia(ch, url, sizeof(url))) return false;
+
+  recordConnectLatency(false, started);
+  if (strcmp(url, ch.url) != 0) {
+    resolveCacheStore(ch.url, url);
+  }
+  return true;
+}
+
+// Extract StreamTitle='...'; from an ICY metadata block
+static void handleIcyMetadata(UpstreamChannel& ch) {
+  ch.metaBuffer[ch.metaLength] = '\0';
+  const char* start = strstr(ch.metaBuffer, "StreamTitle='");
+  if (start == NULL) return;
+  start += 13;
+  const char* end = strstr(start, "';");
+  if (end == NULL) end = start + strlen(start);
+
+  size_t len = min((size_t)(end - start), sizeof(ch.lastTitle) - 1);
+  portENTER_CRITICAL(&relayMux);
+  memcpy(ch.lastTitle, start, len);
+  ch.lastTitle[len] = '\0';
+  portEXIT_CRITICAL(&relayMux);
+
+  // A standby station's title is posted when it is swapped in
+  if (!ch.standby) {
+    Serial.print("streamtitle "); Serial.println(ch.lastTitle);
+    postAudioEvent(AUDIO_EVENT_TITLE, ch.lastTitle);
+  }
+}
+
+static void recordFirstByte(UpstreamChannel& ch) {
+  ch.awaitingFirstByte = false;
+  portENTER_CRITICAL(&statsMux);
+  relayStats.lastFirstByteMs = millis() - ch.requestTime;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+static void storeAudio(UpstreamChannel& ch, const uint8_t* data, size_t len) {
+  size_t written = streamRingWrite(ch.ring, data, len);
+  portENTER_CRITICAL(&statsMux);
+  relayStats.bytesReceived += written;
+  portEXIT_CRITICAL(&statsMux);
+  if (ch.awaitingFirstByte && written > 0) recordFirstByte(ch);
+}
+
+// Split the upstream bytes into audio (to the ring) and ICY metadata blocks
+static void storeStreamBytes(UpstreamChannel& ch, const uint8_t* data, size_t len) {
+  if (ch.icyMetaInt <= 0) {
+    storeAudio(ch, data, len);
+    return;
+  }
+
+  size_t pos = 0;
+  while (pos < len) {
+    if (ch.metaRemaining > 0) {
+      size_t n = min(len - pos, ch.metaRemaining);
+      size_t keep = min(n, sizeof(ch.metaBuffer) - 1 - ch.metaLength);
+      memcpy(ch.metaBuffer + ch.metaLength, data + pos, keep);
+      ch.metaLength += keep;
+      ch.metaRemaining -= n;
+      pos += n;
+      if (ch.metaRemaining == 0) {
+        handleIcyMetadata(ch);
+        ch.audioUntilMeta = ch.icyMetaInt;
+      }
+    } else if (ch.audioUntilMeta == 0) {
+      // Metadata length byte, in units of 16 bytes
+      ch.metaRemaining = data[pos++] * 16;
+      ch.metaLength = 0;
+      if (ch.metaRemaining == 0) ch.audioUntilMeta = ch.icyMetaInt;
+    } else {
+      size_t n = min(len - pos, ch.audioUntilMeta);
+      storeAudio(ch, data + pos, n);
+      ch.audioUntilMeta -= n;
+      pos += n;
+    }
+  }
+}
+
+static void upstreamLost(UpstreamChannel& ch, ReconnectReason reason) {
+  if (ch.standby) {
+    Serial.print("Relay: standby upstream lost (");
+    Serial.print(reconnectReasonName(reason));
+    Serial.println(")");
+  } else {
+    streamHealthReconnectStarted(reason);
+  }
+
+  if (ch.client != NULL) {
+    ch.client->stop();
+    ch.client = NULL;
+  }
+  ch.ready = false;
+  ch.state = UPSTREAM_CONNECTING;
+  ch.nextConnectAttempt = millis() + streamHealthBackoffMs(ch.failures);
+  ch.failures++;
+}
+
+// Standby keeps a sliding window of the newest audio, ready to play from live
+static void trimStandby(UpstreamChannel& ch) {
+  if (!ch.standby) return;
+  size_t limit = msToBytes(targetMs, ch.bitrateKbps) + RELAY_CHUNK_SIZE;
+  size_t fill = streamRingFill(ch.ring);
+  if (fill > limit) {
+    streamRingDiscard(ch.ring, fill - limit);
+  }
+}
+
+// Returns true when data was moved, so the task only sleeps when both channels are idle
+static bool pumpUpstream(UpstreamChannel& ch) {
+  unsigned long now = millis();
+  int avail = ch.client->available();
+
+  if (avail <= 0) {
+    if (!ch.client->connected()) {
+      upstreamLost(ch, RECONNECT_UPSTREAM_CLOSED);
+    } else if (now - ch.lastDataTime > RELAY_DATA_TIMEOUT_MS) {
+      upstreamLost(ch, RECONNECT_UPSTREAM_STALLED);
+    }
+    return false;
+  }
+
+  // Ring full - stop reading and let TCP flow control hold the server back
+  if (streamRingSpace(ch.ring) < RELAY_CHUNK_SIZE) {
+    ch.lastDataTime = now;
+    ch.gapValid = false; // A throttled pause says nothing about network jitter
+    return false;
+  }
+
+  int n = ch.client->read(fetchBuffer, min(avail, RELAY_CHUNK_SIZE));
+  if (n <= 0) return false;
+
+  if (ch.gapValid && !ch.standby) {
+    uint32_t gap = now - ch.lastDataTime;
+    if (gap > windowMaxGapMs) windowMaxGapMs = gap;
+  }
+  ch.lastDataTime = now;
+  ch.gapValid = true;
+  if (ch.failures > 0 && now - ch.connectedAt > HEALTH_STABLE_MS) {
+    ch.failures = 0; // Streaming steadily again, next drop retries quickly
+  }
+
+  storeStreamBytes(ch, fetchBuffer, n);
+  trimStandby(ch);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// HLS: the playlist is followed here and segments are fetched one after the
+// other over a kept-alive connection, prefetching up to hlsPrefetch segments
+// ahead of the decoder. Refreshes go between segment downloads on the same
+// connection, on their own schedule.
+
+static void hlsDisconnect(UpstreamChannel& ch) {
+  if (ch.client != NULL) {
+    ch.client->stop();
+    ch.client = NULL;
+  }
+  ch.hlsState.host[0] = '\0';
+}
+
+// Send a GET, reusing the open connection when it goes to the same server
+static bool hlsRequest(UpstreamChannel& ch, const ParsedUrl& target, ResponseInfo& info) {
+  HlsChannel& hls = ch.hlsState;
+  bool reuse = ch.client != NULL && ch.client->connected() && !hls.closeAfterBody &&
+               hls.secure == target.secure && hls.port == target.port && strcmp(hls.host, target.host) == 0;
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (!reuse) {
+      hlsDisconnect(ch);
+      if (target.secure) {
+        ch.client = &ch.secureClient;
+      } else {
+        ch.client = &ch.plainClient;
+      }
+      if (!ch.client->connect(target.host, target.port)) {
+        Serial.print("Relay: connection failed to ");
+        Serial.println(target.host);
+        ch.client = NULL;
+        return false;
+      }
+      strncpy(hls.host, target.host, sizeof(hls.host) - 1);
+      hls.host[sizeof(hls.host) - 1] = '\0';
+      hls.port = target.port;
+      hls.secure = target.secure;
+    }
+
+    char request[512];
+    int requestLen;
+    bool defaultPort = (target.secure && target.port == 443) || (!target.secure && target.port == 80);
+    if (defaultPort) {
+      requestLen = snprintf(request, sizeof(request),
+                            "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: OOSIE-Radio\r\n"
+                            "Accept: */*\r\nConnection: keep-alive\r\n\r\n",
+                            target.path, target.host);
+    } else {
+      requestLen = snprintf(request, sizeof(request),
+                            "GET %s HTTP/1.1\r\nHost: %s:%u\r\nUser-Agent: OOSIE-Radio\r\n"
+                            "Accept: */*\r\nConnection: keep-alive\r\n\r\n",
+                            target.path, target.host, target.port);
+    }
+    ch.client->write((const uint8_t*)request, min(requestLen, (int)sizeof(request) - 1));
+
+    portENTER_CRITICAL(&statsMux);
+    relayStats.hlsRequests++;
+    if (reuse) relayStats.hlsReusedRequests++;
+    portEXIT_CRITICAL(&statsMux);
+
+    if (readResponseHeaders(*ch.client, info)) {
+      hls.chunked = info.chunked;
+      hls.chunkRemaining = 0;
+      hls.chunkEnd = false;
+      hls.bodyRemaining = info.chunked ? -1 : info.contentLength;
+      // Without a length the body ends with the connection
+      hls.closeAfterBody = info.connectionClose || (!info.chunked && info.contentLength < 0);
+      return true;
+    }
+    if (!reuse) break;
+    reuse = false; // The server dropped the idle connection, try a fresh one
+  }
+
+  Serial.println("Relay: no response from server");
+  hlsDisconnect(ch);
+  return false;
+}
+
+// GET url, following redirects; url is left at the address that answered
+static bool hlsGet(UpstreamChannel& ch, char* url, size_t urlSize, ResponseInfo& info) {
+  for (int hop = 0; hop <= RELAY_MAX_REDIRECTS; hop++) {
+    ParsedUrl target;
+    if (!parseStreamUrl(url, target)) {
+      Serial.print("Relay: invalid URL ");
+      Serial.println(url);
+      return false;
+    }
+    if (!hlsRequest(ch, target, info)) return false;
+
+    if (info.status >= 300 && info.status < 400 && info.location[0] != '\0') {
+      hlsDisconnect(ch); // Don't bother reading the redirect body
+      resolveLocation(url, urlSize, target, info.location);
+      continue;
+    }
+    if (info.status != 200) {
+      Serial.print("Relay: HTTP status ");
+      Serial.println(info.status);
+      hlsDisconnect(ch);
+      return false;
+    }
+    return true;
+  }
+
+  Serial.println("Relay: too many redirects");
+  hlsDisconnect(ch);
+  return false;
+}
+
+// Read from the response body without waiting for data.
+// Returns the bytes read, 0 if none have arrived yet, -1 at the end of the body, -2 on failure.
+static int hlsReadBody(UpstreamChannel& ch, uint8_t* buf, size_t size) {
+  HlsChannel& hls = ch.hlsState;
+  WiFiClient& client = *ch.client;
+
+  if (hls.chunked && hls.chunkRemaining == 0) {
+    if (client.available() <= 0) return client.connected() ? 0 : -2;
+    // Size lines are short and arrive with the data, reading them may block briefly
+    unsigned long deadline = millis() + RELAY_HEADER_TIMEOUT_MS;
+    char line[32];
+    if (hls.chunkEnd && readLine(client, line, sizeof(line), deadline) < 0) return -2;
+    hls.chunkEnd = false;
+    if (readLine(client, line, sizeof(line), deadline) < 0) return -2;
+    hls.chunkRemaining = strtoul(line, NULL, 16);
+    if (hls.chunkRemaining == 0) {
+      int len;
+      while ((len = readLine(client, line, sizeof(line), deadline)) > 0) {} // Trailers
+      return len < 0 ? -2 : -1;
+    }
+  } else if (!hls.chunked && hls.bodyRemaining == 0) {
+    return -1;
+  }
+
+  int avail = client.available();
+  if (avail <= 0) {
+    if (client.connected()) return 0;
+    return (!hls.chunked && hls.bodyRemaining < 0) ? -1 : -2;
+  }
+
+  size_t n = min((size_t)avail, size);
+  if (hls.chunked) n = min(n, (size_t)hls.chunkRemaining);
+  else if (hls.bodyRemaining > 0) n = min(n, (size_t)hls.bodyRemaining);
+  int got = client.read(buf, n);
+  if (got <= 0) return 0;
+
+  if (hls.chunked) {
+    hls.chunkRemaining -= got;
+    if (hls.chunkRemaining == 0) hls.chunkEnd = true;
+  } else if (hls.bodyRemaining > 0) {
+    hls.bodyRemaining -= got;
+  }
+  return got;
+}
+
+// Fetch and parse a playlist into ch.hlsState.playlist. A refresh keeps the
+// segments from keepFrom on instead of the newest ones.
+static bool hlsFetchPlaylist(UpstreamChannel& ch, char* url, size_t urlSize, bool keepOldest, uint32_t keepFrom) {
+  HlsChannel& hls = ch.hlsState;
+  HlsPlaylist& playlist = *hls.playlist;
+
+  portENTER_CRITICAL(&statsMux);
+  relayStats.hlsPlaylistLoads++;
+  portEXIT_CRITICAL(&statsMux);
+
+  hlsPlaylistBegin(playlist);
+  if (keepOldest) hlsPlaylistKeepFrom(playlist, keepFrom);
+
+  ResponseInfo info;
+  if (!hlsGet(ch, url, urlSize, info)) return false;
+
+  unsigned long deadline = millis() + RELAY_HEADER_TIMEOUT_MS;
+  for (;;) {
+    int n = hlsReadBody(ch, fetchBuffer, sizeof(fetchBuffer));
+    if (n == -1) break;
+    if (n == -2 || (long)(millis() - deadline) > 0) {
+      Serial.println("Relay: HLS playlist download failed");
+      hlsDisconnect(ch);
+      return false;
+    }
+    if (n == 0) {
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
+    }
+    hlsPlaylistFeed(playlist, (const char*)fetchBuffer, n);
+  }
+  hlsPlaylistEnd(playlist);
+  if (hls.closeAfterBody) hlsDisconnect(ch);
+
+  if (!playlist.valid) {
+    Serial.println("Relay: not an HLS playlist");
+    return false;
+  }
+  return true;
+}
+
+static uint32_t hlsTargetMs(const HlsPlaylist& playlist) {
+  return playlist.targetDurationMs > 0 ? playlist.targetDurationMs : HLS_DEFAULT_TARGET_MS;
+}
+
+// Catch up with the live window and schedule the next refresh: a target duration
+// after the playlist grew, half of one if it didn't (RFC 8216 6.3.4)
+static void hlsPlaylistLoaded(UpstreamChannel& ch) {
+  HlsChannel& hls = ch.hlsState;
+  const HlsPlaylist& playlist = *hls.playlist;
+  unsigned long now = millis();
+
+  const HlsSegment* oldest = hlsPlaylistSegment(playlist, 0);
+  if (oldest != NULL && (int32_t)(oldest->sequence - hls.nextSequence) > 0) {
+    uint32_t skipped = oldest->sequence - hls.nextSequence;
+    Serial.print("Relay: HLS skipped ");
+    Serial.print(skipped);
+    Serial.println(" segment(s) that left the live window");
+    portENTER_CRITICAL(&statsMux);
+    relayStats.hlsSkipped += skipped;
+    portEXIT_CRITICAL(&statsMux);
+    hls.nextSequence = oldest->sequence;
+    tsDemuxReset(hls.demux);
+  }
+
+  bool grew = playlist.nextSequence != hls.playlistEnd;
+  if (grew) {
+    hls.playlistEnd = playlist.nextSequence;
+    hls.lastGrowth = now;
+  }
+  if (playlist.endList) {
+    hls.nextRefresh = now; // Only reloaded to page past the kept segments
+  } else {
+    hls.nextRefresh = now + (grew ? hlsTargetMs(playlist) : hlsTargetMs(playlist) / 2);
+  }
+}
+
+static bool hlsRefreshPlaylist(UpstreamChannel& ch) {
+  HlsChannel& hls = ch.hlsState;
+  char url[256];
+  strcpy(url, hls.playlistUrl);
+
+  if (!hlsFetchPlaylist(ch, url, sizeof(url), true, hls.nextSequence) || hls.playlist->master) {
+    hls.nextRefresh = millis() + HLS_REFRESH_RETRY_MS;
+    portENTER_CRITICAL(&statsMux);
+    relayStats.hlsFailures++;
+    portEXIT_CRITICAL(&statsMux);
+    return false;
+  }
+  hlsPlaylistLoaded(ch);
+  return true;
+}
+
+// Start playing the HLS playlist at url (left at the media playlist, for the resolve
+// cache). Reconnecting to the same playlist continues after the last fetched segment.
+static bool openHls(UpstreamChannel& ch, char* url, size_t urlSize) {
+  HlsChannel& hls = ch.hlsState;
+  HlsPlaylist& playlist = *hls.playlist;
+
+  ch.hls = true;
+  ch.client = NULL;
+  ch.icyMetaInt = 0;
+  hls.host[0] = '\0';
+  hls.closeAfterBody = false;
+  hls.fetching = false;
+  hls.failures = 0;
+
+  if (!hlsFetchPlaylist(ch, url, urlSize, false, 0)) return false;
+
+  uint32_t bandwidth = 0;
+  if (playlist.master) {
+    if (playlist.variantUri[0] == '\0') {
+      Serial.println("Relay: HLS master playlist lists no variants");
+      return false;
+    }
+    ParsedUrl base;
+    char variant[256];
+    if (!parseStreamUrl(url, base)) return false;
+    resolveLocation(variant, sizeof(variant), base, playlist.variantUri);
+    bandwidth = playlist.variantBandwidth;
+    strncpy(url, variant, urlSize - 1);
+    url[urlSize - 1] = '\0';
+    Serial.print("Relay: HLS variant ");
+    Serial.print(bandwidth / 1000);
+    Serial.print(" kbps ");
+    Serial.println(url);
+
+    if (!hlsFetchPlaylist(ch, url, urlSize, false, 0)) return false;
+    if (playlist.master) {
+      Serial.println("Relay: HLS variant is another master playlist");
+      return false;
+    }
+  }
+  if (playlist.unsupported) {
+    Serial.println("Relay: encrypted and fMP4 HLS streams are not supported");
+    return false;
+  }
+
+  bool resume = hls.started && strcmp(hls.playlistUrl, url) == 0;
+  if (!resume) {
+    hls.ended = false;
+    hls.playlistEnd = 0;
+    hls.queueCount = 0;
+    tsDemuxReset(hls.demux);
+    // Live playback starts a few segments from the end, VOD at the beginning
+    uint32_t liveStart = playlist.nextSequence - min(playlist.nextSequence - playlist.mediaSequence,
+                                                     (uint32_t)HLS_LIVE_START_SEGMENTS);
+    hls.nextSequence = playlist.endList ? playlist.mediaSequence : liveStart;
+    hls.started = true;
+    // Corrected from the size of the first segment
+    ch.bitrateKbps = bandwidth > 0 ? bandwidth / 1000 : RELAY_DEFAULT_BITRATE_KBPS;
+    portENTER_CRITICAL(&relayMux);
+    ch.contentType[0] = '\0'; // Known once the first segment arrives
+    ch.name[0] = '\0';
+    portEXIT_CRITICAL(&relayMux);
+  }
+  strncpy(hls.playlistUrl, url, sizeof(hls.playlistUrl) - 1);
+  hls.playlistUrl[sizeof(hls.playlistUrl) - 1] = '\0';
+  hls.lastGrowth = millis();
+  hlsPlaylistLoaded(ch);
+
+  Serial.print(ch.standby ? "Relay: standby HLS " : "Relay: HLS ");
+  Serial.print(playlist.endList ? "playlist, " : "live playlist, ");
+  Serial.print(hlsTargetMs(playlist) / 1000);
+  Serial.print("s segments, starting at #");
+  Serial.println(hls.nextSequence);
+  return true;
+}
+
+// The segment's audio has been fetched: remember where it ends in the ring
+static void finishSegment(UpstreamChannel& ch) {
+  HlsChannel& hls = ch.hlsState;
+  uint32_t fetchMs = millis() - hls.segmentRequested;
+
+  hls.fetching = false;
+  hls.failures = 0;
+  if (hls.closeAfterBody) hlsDisconnect(ch);
+  if (hls.queueCount < HLS_QUEUE_LENGTH) {
+    hls.queueEnds[hls.queueCount++] = ch.ring.totalWritten;
+  }
+  hls.nextSequence = hls.segmentSequence + 1;
+  if (hls.segmentDurationMs > 0 && hls.segmentBytes > 0) {
+    ch.bitrateKbps = max((uint32_t)((uint64_t)hls.segmentBytes * 8 / hls.segmentDurationMs), (uint32_t)1);
+  }
+
+  portENTER_CRITICAL(&statsMux);
+  relayStats.hlsSegments++;
+  relayStats.hlsLastFetchMs = fetchMs;
+  relayStats.hlsFetchTotalMs += fetchMs;
+  if (fetchMs > relayStats.hlsMaxFetchMs) relayStats.hlsMaxFetchMs = fetchMs;
+  if (hls.segmentDurationMs > 0 && fetchMs > hls.segmentDurationMs) relayStats.hlsSlowFetches++;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+static void segmentFailed(UpstreamChannel& ch) {
+  HlsChannel& hls = ch.hlsState;
+  hls.fetching = false;
+  hlsDisconnect(ch);
+
+  Serial.print("Relay: HLS segment #");
+  Serial.print(hls.segmentSequence);
+  Serial.println(" failed");
+  portENTER_CRITICAL(&statsMux);
+  relayStats.hlsFailures++;
+  portEXIT_CRITICAL(&statsMux);
+
+  // Part of it is already in the ring, fetching it again would repeat that audio
+  if (hls.segmentBytes > 0) {
+    if (hls.queueCount < HLS_QUEUE_LENGTH) {
+      hls.queueEnds[hls.queueCount++] = ch.ring.totalWritten;
+    }
+    hls.nextSequence = hls.segmentSequence + 1;
+  }
+  if (++hls.failures >= HLS_SEGMENT_RETRIES) {
+    hls.failures = 0;
+    upstreamLost(ch, RECONNECT_UPSTREAM_CLOSED);
+  }
+}
+
+static bool startSegment(UpstreamChannel& ch, const HlsSegment& segment) {
+  HlsChannel& hls = ch.hlsState;
+  ParsedUrl base;
+  char url[256];
+  if (!parseStreamUrl(hls.playlistUrl, base)) return false;
+  resolveLocation(url, sizeof(url), base, segment.uri);
+
+  hls.segmentSequence = segment.sequence;
+  hls.segmentDurationMs = segment.durationMs;
+  hls.segmentBytes = 0;
+  hls.segmentRequested = millis();
+  if (segment.discontinuity) tsDemuxReset(hls.demux);
+  hls.demux.fill = 0; // Segments hold whole packets
+
+  ResponseInfo info;
+  if (!hlsGet(ch, url, sizeof(url), info)) {
+    segmentFailed(ch);
+    return true;
+  }
+
+  hls.fetching = true;
+  hls.segmentStarted = false;
+  hls.containerKnown = false;
+  hls.segmentSkip = 0;
+  if (strncmp(info.contentType, "audio/", 6) == 0) {
+    strncpy(hls.segmentType, info.contentType, sizeof(hls.segmentType) - 1);
+    hls.segmentType[sizeof(hls.segmentType) - 1] = '\0';
+  } else {
+    inferContentType(url, hls.segmentType, sizeof(hls.segmentType));
+  }
+  ch.lastDataTime = millis();
+  ch.gapValid = false; // The wait for a free queue slot isn't network jitter
+  return true;
+}
+
+// Drop a packed segment's ID3 tag and demux TS, then store the audio
+static void storeSegmentBytes(UpstreamChannel& ch, const uint8_t* data, size_t len) {
+  HlsChannel& hls = ch.hlsState;
+
+  if (!hls.segmentStarted) {
+    hls.segmentStarted = true;
+    hls.segmentSkip = hlsId3TagLength(data, len);
+  }
+  if (hls.segmentSkip > 0) {
+    size_t n = min(len, hls.segmentSkip);
+    hls.segmentSkip -= n;
+    data += n;
+    len -= n;
+    if (len == 0) return;
+  }
+  if (!hls.containerKnown) {
+    hls.containerKnown = true;
+    hls.segmentTs = data[0] == 0x47; // TS sync byte
+  }
+  if (hls.segmentTs) {
+    len = tsDemux(hls.demux, data, len, demuxBuffer);
+    data = demuxBuffer;
+    if (len == 0) return;
+  }
+
+  // The first audio tells the serve task what to announce to the decoder
+  if (!ch.ready) {
+    const char* type = hls.segmentTs ? tsDemuxContentType(hls.demux) : hls.segmentType;
+    portENTER_CRITICAL(&relayMux);
+    strncpy(ch.contentType, type, sizeof(ch.contentType) - 1);
+    ch.contentType[sizeof(ch.contentType) - 1] = '\0';
+    portEXIT_CRITICAL(&relayMux);
+    ch.ready = true;
+    Serial.print(ch.standby ? "Relay: standby streaming " : "Relay: streaming ");
+    Serial.print(type);
+    Serial.println(hls.segmentTs ? " from HLS TS segments" : " from HLS segments");
+  }
+
+  hls.segmentBytes += len;
+  storeAudio(ch, data, len);
+}
+
+static bool pumpSegment(UpstreamChannel& ch) {
+  unsigned long now = millis();
+
+  // Ring full - leave the rest of the segment in the socket
+  if (streamRingSpace(ch.ring) < RELAY_CHUNK_SIZE + TS_PACKET_SIZE) {
+    ch.lastDataTime = now;
+    ch.gapValid = false;
+    return false;
+  }
+
+  int n = hlsReadBody(ch, fetchBuffer, sizeof(fetchBuffer));
+  if (n == -1) {
+    finishSegment(ch);
+    return true;
+  }
+  if (n == -2) {
+    segmentFailed(ch);
+    return false;
+  }
+  if (n == 0) {
+    if (now - ch.lastDataTime > RELAY_DATA_TIMEOUT_MS) segmentFailed(ch);
+    return false;
+  }
+
+  if (ch.gapValid && !ch.standby) {
+    uint32_t gap = now - ch.lastDataTime;
+    if (gap > windowMaxGapMs) windowMaxGapMs = gap;
+  }
+  ch.lastDataTime = now;
+  ch.gapValid = true;
+  if (ch.failures > 0 && now - ch.connectedAt > HEALTH_STABLE_MS) {
+    ch.failures = 0;
+  }
+
+  storeSegmentBytes(ch, fetchBuffer, n);
+  trimStandby(ch);
+  return true;
+}
+
+// Returns true when data was moved, like pumpUpstream
+static bool pumpHls(UpstreamChannel& ch) {
+  HlsChannel& hls = ch.hlsState;
+  const HlsPlaylist& playlist = *hls.playlist;
+  unsigned long now = millis();
+
+  // Segments whose audio has left the ring no longer count towards the prefetch
+  uint32_t readPos = ch.ring.totalWritten - streamRingFill(ch.ring);
+  while (hls.queueCount > 0 && (int32_t)(readPos - hls.queueEnds[0]) >= 0) {
+    hls.queueCount--;
+    memmove(hls.queueEnds, hls.queueEnds + 1, hls.queueCount * sizeof(hls.queueEnds[0]));
+  }
+
+  if (hls.fetching) return pumpSegment(ch);
+  if (hls.ended) return false;
+
+  const HlsSegment* segment = hlsPlaylistFind(playlist, hls.nextSequence);
+  bool refreshDue = (long)(now - hls.nextRefresh) >= 0;
+  if (playlist.endList) {
+    if (segment == NULL) {
+      if ((int32_t)(hls.nextSequence - playlist.nextSequence) >= 0) {
+        hls.ended = true;
+        Serial.println("Relay: HLS playlist finished");
+        return false;
+      }
+      // Past the segments kept from the last load
+      if (refreshDue) hlsRefreshPlaylist(ch);
+      return refreshDue;
+    }
+  } else {
+    if (refreshDue) {
+      hlsRefreshPlaylist(ch);
+      return true;
+    }
+    if (now - hls.lastGrowth > HLS_STALL_TARGETS * hlsTargetMs(playlist)) {
+      Serial.println("Relay: HLS playlist stopped growing");
+      upstreamLost(ch, RECONNECT_UPSTREAM_STALLED);
+      return false;
+    }
+  }
+
+  if (segment == NULL || hls.queueCount >= hlsPrefetch) return false;
+  return startSegment(ch, *segment);
+}
+
+static bool serviceChannel(UpstreamChannel& ch) {
+  switch (ch.state) {
+    case UPSTREAM_CONNECTING:
+      if ((long)(millis() - ch.nextConnectAttempt) < 0) return false;
+      if (openUpstream(ch)) {
+        ch.state = UPSTREAM_STREAMING;
+        ch.connectedAt = millis();
+        ch.lastDataTime = ch.connectedAt;
+        ch.gapValid = false;
+        ch.ready = !ch.hls; // HLS: once the first segment shows its format
+        portENTER_CRITICAL(&statsMux);
+        relayStats.upstreamConnects++;
+        portEXIT_CRITICAL(&statsMux);
+      } else {
+        unsigned long backoff = streamHealthBackoffMs(ch.failures);
+        ch.failures++;
+        ch.nextConnectAttempt = millis() + backoff;
+        if (!ch.standby) streamHealthConnectFailed();
+        portENTER_CRITICAL(&statsMux);
+        relayStats.upstreamFailures++;
+        portEXIT_CRITICAL(&statsMux);
+        Serial.print("Relay: retrying in ");
+        Serial.print(backoff);
+        Serial.println("ms");
+      }
+      return true;
+    case UPSTREAM_STREAMING:
+      return ch.hls ? pumpHls(ch) : pumpUpstream(ch);
+    default:
+      return false;
+  }
+}
+
+static void startActive(const RelayCommand& cmd) {
+  UpstreamChannel& standby = standbyCh();
+  bool warm = standbyAvailable && standby.state != UPSTREAM_IDLE && strcmp(standby.url, cmd.url) == 0;
+
+  // The outgoing station stays connected as the new standby (last played)
+  if (standbyAvailable) {
+    activeChannel = 1 - activeChannel;
+    UpstreamChannel& previous = standbyCh();
+    previous.standby = true;
+    previous.session = 0;
+    if (previous.state == UPSTREAM_IDLE || strcmp(previous.url, cmd.url) == 0) {
+      closeChannel(previous); // Reconnecting the same station needs no standby copy
+    }
+  }
+
+  UpstreamChannel& ch = activeCh();
+  if (warm) {
+    ch.standby = false;
+    if (ch.lastTitle[0] != '\0') {
+      postAudioEvent(AUDIO_EVENT_TITLE, ch.lastTitle);
+    }
+    Serial.print("Relay: standby swapped in, ");
+    Serial.print(bytesToMs(streamRingFill(ch.ring), ch.bitrateKbps));
+    Serial.println("ms buffered");
+  } else {
+    openChannel(ch, cmd.url, false);
+  }
+  ch.session = cmd.session;
+  ch.requestTime = cmd.requestTime;
+  ch.awaitingFirstByte = true;
+  if (warm && streamRingFill(ch.ring) > 0) recordFirstByte(ch); // Already buffered
+
+  portENTER_CRITICAL(&statsMux);
+  if (warm) relayStats.standbyHits++;
+  else relayStats.standbyMisses++;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+static void processRelayCommand(const RelayCommand& cmd) {
+  switch (cmd.type) {
+    case RELAY_CMD_START:
+      startActive(cmd);
+      break;
+    case RELAY_CMD_STANDBY: {
+      if (!standbyAvailable) break;
+      UpstreamChannel& standby = standbyCh();
+      if (cmd.url[0] == '\0') {
+        closeChannel(standby);
+      } else if (strcmp(activeCh().url, cmd.url) != 0 &&
+                 (standby.state == UPSTREAM_IDLE || strcmp(standby.url, cmd.url) != 0)) {
+        Serial.print("Relay: standby -> ");
+        Serial.println(cmd.url);
+        openChannel(standby, cmd.url, true);
+        portENTER_CRITICAL(&statsMux);
+        relayStats.standbyOpens++;
+        portEXIT_CRITICAL(&statsMux);
+      }
+      break;
+    }
+    case RELAY_CMD_STOP:
+      closeChannel(channels[0]);
+      closeChannel(channels[1]);
+      break;
+  }
+}
+
+static void relayFetchTask(void* param) {
+  for (;;) {
+    // Block while idle, only poll for commands while a stream is active
+    RelayCommand cmd;
+    bool idle = channels[0].state == UPSTREAM_IDLE && channels[1].state == UPSTREAM_IDLE;
+    if (xQueueReceive(relayCommandQueue, &cmd, idle ? portMAX_DELAY : 0) == pdTRUE) {
+      processRelayCommand(cmd);
+      continue;
+    }
+
+    // The playing station always gets serviced first
+    bool busy = serviceChannel(activeCh());
+    if (standbyAvailable) {
+      busy |= serviceChannel(standbyCh());
+    }
+    if (!busy) {
+      vTaskDelay(pdMS_TO_TICKS(5));
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Serve task: local HTTP endpoint for the decoder, prebuffer gating
+
+static void setFeeding(bool feeding) {
+  portENTER_CRITICAL(&statsMux);
+  relayStats.feeding = feeding;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+static void recordUnderrun() {
+  uint32_t newTarget = min((uint32_t)(targetMs * 3 / 2), (uint32_t)prebufferMaxMs);
+  targetMs = max(newTarget, (uint32_t)prebufferMinMs);
+  lastUnderrunTime = millis();
+
+  portENTER_CRITICAL(&statsMux);
+  relayStats.underruns++;
+  portEXIT_CRITICAL(&statsMux);
+
+  Serial.print("Relay: underrun, prebuffer target now ");
+  Serial.print(targetMs);
+  Serial.println("ms");
+}
+
+// Keep the target above the observed network jitter and shrink it while playback is stable
+static void adaptTarget() {
+  unsigned long now = millis();
+  if (now - lastTargetCheck < 1000) return;
+  lastTargetCheck = now;
+
+  uint32_t minMs = prebufferMinMs;
+  uint32_t maxMs = prebufferMaxMs;
+  uint32_t jitterFloor = windowMaxGapMs * 3 / 2;
+  uint32_t target = targetMs;
+
+  if (jitterFloor > target) {
+    target = jitterFloor;
+  } else if (now - lastUnderrunTime > PREBUFFER_STABLE_PERIOD_MS) {
+    target = max(target * 9 / 10, jitterFloor);
+    lastUnderrunTime = now; // Restart the stable period
+    windowMaxGapMs = 0;     // And the jitter window
+  }
+
+  if (target < minMs) target = minMs;
+  if (target > maxMs) target = maxMs;
+  targetMs = target;
+}
+
+static void sendResponseHeaders(WiFiClient& decoder, UpstreamChannel& ch) {
+  char contentType[48];
+  char name[64];
+  portENTER_CRITICAL(&relayMux);
+  strcpy(contentType, ch.contentType);
+  strcpy(name, ch.name);
+  portEXIT_CRITICAL(&relayMux);
+
+  char response[256];
+  int len = snprintf(response, sizeof(response),
+                     "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nicy-name: %s\r\nicy-br: %lu\r\n"
+                     "Connection: close\r\n\r\n",
+                     contentType, name, (unsigned long)ch.bitrateKbps);
+  decoder.write((const uint8_t*)response, min(len, (int)sizeof(response) - 1));
+}
+
+// Move the oldest audio out of a nearly full relay ring so the upstream never has to wait.
+// It goes to the end of the time-shift ring, which only ever holds older audio.
+static void spillToTimeShift(UpstreamChannel& ch, uint8_t* buffer, size_t size) {
+  if (!timeShiftAvailable) return;
+
+  while (streamRingFill(ch.ring) > TIMESHIFT_SPILL_LEVEL) {
+    size_t n = streamRingRead(ch.ring, buffer, size);
+    if (n == 0) break;
+    streamRingWriteOverwrite(shiftRing, buffer, n);
+  }
+}
+
+// Drop everything but the newest prebuffer target
+static void jumpToLive(UpstreamChannel& ch) {
+  streamRingReset(shiftRing);
+  size_t keep = msToBytes(targetMs, ch.bitrateKbps);
+  size_t fill = streamRingFill(ch.ring);
+  if (fill > keep) {
+    streamRingDiscard(ch.ring, fill - keep);
+  }
+  Serial.println("Relay: back to live");
+}
+
+static void relayServeTask(void* param) {
+  WiFiServer localServer(RELAY_PORT, 1);
+  WiFiClient decoder;
+  DecoderState state = DECODER_NONE;
+  uint32_t decoderSession = 0;
+  unsigned long stateSince = 0;
+  char request[128];
+  size_t requestLen = 0;
+  static uint8_t serveBuffer[RELAY_CHUNK_SIZE];
+
+  localServer.begin();
+
+  for (;;) {
+    // Accept the decoder; only loopback clients may use the relay
+    if (localServer.hasClient()) {
+      WiFiClient incoming = localServer.available();
+      if (incoming.remoteIP() == IPAddress(127, 0, 0, 1)) {
+        decoder.stop();
+        decoder = incoming;
+        state = DECODER_REQUEST;
+        stateSince = millis();
+        requestLen = 0;
+        setFeeding(false);
+        streamRingReset(shiftRing); // Time-shifted audio belongs to the previous session
+      } else {
+        incoming.stop();
+      }
+    }
+
+    if (state != DECODER_NONE && state != DECODER_REQUEST) {
+      if (!decoder.connected() || decoderSession != requestedSession) {
+        decoder.stop();
+        state = DECODER_NONE;
+        setFeeding(false);
+      }
+    }
+
+    // Resolve the channel once per pass; a swap shows up as a session change
+    UpstreamChannel& ch = activeCh();
+    bool sessionReady = ch.session == decoderSession && ch.ready;
+
+    if (state >= DECODER_PREBUFFER && ch.session == decoderSession) {
+      if (goLiveRequested) {
+        goLiveRequested = false;
+        jumpToLive(ch);
+      }
+      spillToTimeShift(ch, serveBuffer, sizeof(serveBuffer));
+    }
+    // Older, time-shifted audio plays first
+    StreamRing& source = streamRingFill(shiftRing) > 0 ? shiftRing : ch.ring;
+    size_t buffered = streamRingFill(shiftRing) + streamRingFill(ch.ring);
+
+    switch (state) {
+      case DECODER_NONE:
+        vTaskDelay(pdMS_TO_TICKS(20));
+        break;
+
+      case DECODER_REQUEST: {
+        while (decoder.available() > 0 && requestLen < sizeof(request) - 1) {
+          request[requestLen++] = (char)decoder.read();
+        }
+        request[requestLen] = '\0';
+
+        // Only the request line matters: GET /stream/<session> HTTP/1.x
+        char* lineEnd = strstr(request, "\r\n");
+        if (lineEnd != NULL) {
+          const char* path = strstr(request, "/stream/");
+          decoderSession = (path != NULL && path < lineEnd) ? strtoul(path + 8, NULL, 10) : 0;
+          if (decoderSession == 0 || decoderSession != requestedSession) {
+            decoder.stop();
+            state = DECODER_NONE;
+          } else {
+            state = DECODER_WAIT_UPSTREAM;
+            stateSince = millis();
+          }
+        } else if (millis() - stateSince > 2000 || requestLen >= sizeof(request) - 1) {
+          decoder.stop();
+          state = DECODER_NONE;
+        } else {
+          vTaskDelay(pdMS_TO_TICKS(5));
+        }
+        break;
+      }
+
+      case DECODER_WAIT_UPSTREAM:
+        if (sessionReady) {
+          sendResponseHeaders(decoder, ch);
+          state = DECODER_PREBUFFER;
+          stateSince = millis();
+        } else if (millis() - stateSince > RELAY_UPSTREAM_WAIT_MS) {
+          Serial.println("Relay: upstream not ready, closing decoder connection");
+          decoder.stop();
+          state = DECODER_NONE;
+        } else {
+          vTaskDelay(pdMS_TO_TICKS(20));
+        }
+        break;
+
+      case DECODER_PREBUFFER:
+        if (sessionReady && !paused && buffered >= msToBytes(targetMs, ch.bitrateKbps)) {
+          Serial.print("Relay: prebuffered ");
+          Serial.print(bytesToMs(buffered, ch.bitrateKbps));
+          Serial.print("ms in ");
+          Serial.print(millis() - stateSince);
+          Serial.println("ms");
+          state = DECODER_FEEDING;
+          setFeeding(true);
+        } else {
+          vTaskDelay(pdMS_TO_TICKS(20));
+        }
+        break;
+
+      case DECODER_FEEDING: {
+        if (ch.session != decoderSession) {
+          vTaskDelay(pdMS_TO_TICKS(5));
+          break;
+        }
+        if (paused) {
+          // The decoder is paused too; the upstream keeps filling the rings
+          vTaskDelay(pdMS_TO_TICKS(20));
+          break;
+        }
+        adaptTarget();
+
+        uint32_t decoderFill = audioEngineInputFill();
+        if (decoderFill >= RELAY_DECODER_LOW_WATER) {
+          vTaskDelay(pdMS_TO_TICKS(5));
+          break;
+        }
+
+        size_t count = streamRingPeek(source, serveBuffer, sizeof(serveBuffer));
+        if (count == 0) {
+          if (decoderFill < RELAY_DECODER_EMPTY) {
+            // Both buffers are dry - playback has stopped, so rebuild a bigger cushion
+            recordUnderrun();
+            state = DECODER_PREBUFFER;
+            stateSince = millis();
+            setFeeding(false);
+          }
+          vTaskDelay(pdMS_TO_TICKS(5));
+          break;
+        }
+
+        size_t sent = decoder.write(serveBuffer, count);
+        if (sent > 0) {
+          streamRingConsume(source, sent);
+        }
+        vTaskDelay(pdMS_TO_TICKS(2));
+        break;
+      }
+    }
+  }
+}
+
+// The relay could not start: give its PSRAM back. A fetch task that did start
+// blocks on the empty queue for good, as nothing is sent while !available.
+static void releaseRelayBuffers() {
+  streamRingRelease(channels[0].ring);
+  streamRingRelease(channels[1].ring);
+  streamRingRelease(shiftRing);
+  for (int i = 0; i < 2; i++) {
+    heap_caps_free(channels[i].hlsState.playlist);
+    channels[i].hlsState.playlist = NULL;
+  }
+  standbyAvailable = false;
+  hlsAvailable = false;
+  timeShiftAvailable = false;
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+
+void initStreamRelay() {
+  if (!streamRingInit(channels[0].ring, RELAY_RING_SIZE)) {
+    Serial.println("Stream relay disabled - could not allocate PSRAM buffer");
+    return;
+  }
+  standbyAvailable = streamRingInit(channels[1].ring, RELAY_RING_SIZE);
+  if (!standbyAvailable) {
+    Serial.println("Standby stream disabled - could not allocate PSRAM buffer");
+  }
+
+  // Both channels or neither can follow HLS playlists
+  channels[0].hlsState.playlist = (HlsPlaylist*)heap_caps_malloc(sizeof(HlsPlaylist), MALLOC_CAP_SPIRAM);
+  channels[1].hlsState.playlist = (HlsPlaylist*)heap_caps_malloc(sizeof(HlsPlaylist), MALLOC_CAP_SPIRAM);
+  hlsAvailable = channels[0].hlsState.playlist != NULL && channels[1].hlsState.playlist != NULL;
+  if (!hlsAvailable) {
+    Serial.println("HLS disabled - could not allocate PSRAM for the playlists");
+  }
+
+  timeShiftAvailable = streamRingInit(shiftRing, TIMESHIFT_RING_SIZE);
+  if (!timeShiftAvailable) {
+    Serial.println("Time-shift limited to the relay buffer - could not allocate PSRAM buffer");
+  }
+
+  relayCommandQueue = xQueueCreate(4, sizeof(RelayCommand));
+  if (relayCommandQueue == NULL) {
+    Serial.println("Failed to create stream relay queue");
+    releaseRelayBuffers();
+    return;
+  }
+
+  if (xTaskCreatePinnedToCore(relayFetchTask, "relayFetch", RELAY_FETCH_TASK_STACK, NULL,
+                              RELAY_TASK_PRIORITY, &fetchTaskHandle, RELAY_TASK_CORE) != pdPASS ||
+      xTaskCreatePinnedToCore(relayServeTask, "relayServe", RELAY_SERVE_TASK_STACK, NULL,
+                              RELAY_TASK_PRIORITY, &serveTaskHandle, RELAY_TASK_CORE) != pdPASS) {
+    Serial.println("Failed to start stream relay tasks");
+    releaseRelayBuffers();
+    return;
+  }
+
+  available = true;
+  Serial.print("Stream relay started, buffer ");
+  Serial.print(RELAY_RING_SIZE / 1024);
+  Serial.print(standbyAvailable ? "KB x2 (with standby)" : "KB");
+  if (timeShiftAvailable) {
+    Serial.print(" + ");
+    Serial.print(TIMESHIFT_RING_SIZE / 1024);
+    Serial.print("KB time-shift");
+  }
+  Serial.println(" in PSRAM");
+}
+
+bool relayAvailable() {
+  return available;
+}
+
+static void sendRelayCommand(RelayCommandType type, uint32_t session, const char* url) {
+  RelayCommand cmd;
+  cmd.type = type;
+  cmd.session = session;
+  cmd.requestTime = millis();
+  strncpy(cmd.url, url, sizeof(cmd.url) - 1);
+  cmd.url[sizeof(cmd.url) - 1] = '\0';
+
+  if (xQueueSend(relayCommandQueue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    Serial.println("Relay command queue full - command dropped");
+  }
+}
+
+// Start relaying url; returns the local URL the decoder should connect to.
+// warm is set when url was the prepared standby station.
+const char* relayStart(const char* url, bool* warm) {
+  if (warm != NULL) *warm = available && standbyUrl[0] != '\0' && strcmp(standbyUrl, url) == 0;
+  if (!available) return url;
+
+  uint32_t session = ++requestedSession;
+  sendRelayCommand(RELAY_CMD_START, session, url);
+  paused = false;
+  shiftDelayMs = 0;
+  standbyUrl[0] = '\0'; // The fetch task keeps the outgoing station as standby
+
+  portENTER_CRITICAL(&statsMux);
+  relayStats.active = true;
+  portEXIT_CRITICAL(&statsMux);
+
+  snprintf(localUrl, sizeof(localUrl), "http://127.0.0.1:%d/stream/%lu", RELAY_PORT,
+           (unsigned long)session);
+  return localUrl;
+}
+
+void relayStop() {
+  if (!available) return;
+
+  sendRelayCommand(RELAY_CMD_STOP, ++requestedSession, ""); // New session invalidates the decoder
+  standbyUrl[0] = '\0';
+  paused = false;
+  shiftDelayMs = 0;
+
+  portENTER_CRITICAL(&statsMux);
+  relayStats.active = false;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+// Keep a muted, buffered connection to url so selecting it later starts instantly
+void relayPrepareStandby(const char* url) {
+  if (!available || !standbyAvailable) return;
+  if (strcmp(standbyUrl, url) == 0) return;
+
+  strncpy(standbyUrl, url, sizeof(standbyUrl) - 1);
+  standbyUrl[sizeof(standbyUrl) - 1] = '\0';
+  sendRelayCommand(RELAY_CMD_STANDBY, 0, url);
+}
+
+// Stop feeding the decoder; the upstream keeps buffering into the time-shift ring
+void relayPause() {
+  if (!available || paused) return;
+  paused = true;
+  pauseStartTime = millis();
+}
+
+// Continue from where playback was paused
+void relayResume() {
+  if (!paused) return;
+  shiftDelayMs += millis() - pauseStartTime;
+  paused = false;
+}
+
+// Skip the time-shifted audio and play the newest buffered audio again
+void relayGoLive() {
+  if (!available) return;
+  goLiveRequested = true;
+  paused = false;
+  shiftDelayMs = 0;
+}
+
+void setRelayPrebuffer(int minMs, int maxMs) {
+  if (minMs < 0) minMs = 0;
+  if (maxMs < minMs) maxMs = minMs;
+  prebufferMinMs = minMs;
+  prebufferMaxMs = maxMs;
+
+  uint32_t target = targetMs;
+  if (target < (uint32_t)minMs) target = minMs;
+  if (target > (uint32_t)maxMs) target = maxMs;
+  targetMs = target;
+}
+
+void setRelayHlsPrefetch(int segments) {
+  hlsPrefetch = constrain(segments, 1, HLS_PREFETCH_MAX);
+}
+
+// HLS stations can only be played through the relay
+bool relayHlsAvailable() {
+  return available && hlsAvailable;
+}
+
+void getRelayStats(RelayStats& stats) {
+  portENTER_CRITICAL(&statsMux);
+  stats = relayStats;
+  portEXIT_CRITICAL(&statsMux);
+
+  UpstreamChannel& ch = activeCh();
+  stats.upstreamConnected = ch.ready;
+  stats.ringFill = streamRingFill(ch.ring);
+  stats.ringCapacity = ch.ring.capacity;
+  stats.bitrateKbps = ch.bitrateKbps;
+  stats.fillMs = bytesToMs(stats.ringFill, stats.bitrateKbps);
+  stats.targetMs = targetMs;
+  stats.targetBytes = msToBytes(stats.targetMs, stats.bitrateKbps);
+  stats.minMs = prebufferMinMs;
+  stats.maxMs = prebufferMaxMs;
+  stats.maxGapMs = windowMaxGapMs;
+
+  UpstreamChannel& standby = standbyCh();
+  stats.standbyConnected = standbyAvailable && standby.ready;
+  stats.standbyFillMs = standbyAvailable ? bytesToMs(streamRingFill(standby.ring), standby.bitrateKbps) : 0;
+
+  // Delay behind live is the pause time, limited by what is still buffered
+  stats.paused = paused;
+  stats.timeShiftFill = streamRingFill(shiftRing);
+  stats.timeShiftCapacity = timeShiftAvailable ? TIMESHIFT_RING_SIZE : 0;
+  stats.timeShiftMaxMs = bytesToMs(stats.timeShiftCapacity + RELAY_RING_SIZE, stats.bitrateKbps);
+  stats.timeShiftDropped = shiftRing.totalDropped;
+  unsigned long delayMs = shiftDelayMs + (paused ? millis() - pauseStartTime : 0);
+  stats.behindLiveMs = min((uint32_t)delayMs, bytesToMs(stats.timeShiftFill + stats.ringFill, stats.bitrateKbps));
+
+  stats.hlsActive = ch.hls && ch.state != UPSTREAM_IDLE;
+  stats.hlsQueueDepth = stats.hlsActive ? ch.hlsState.queueCount : 0;
+  stats.hlsFetching = stats.hlsActive && ch.hlsState.fetching;
+  stats.hlsPrefetch = hlsPrefetch;
+}
@@ -0,0 +1,170 @@
+#include "stream_ring.h"
+#include "esp_heap_caps.h"
+
+bool streamRingInit(StreamRing& ring, size_t capacity) {
+  ring.data = (uint8_t*)heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (ring.data == NULL) {
+    ring.capacity = 0;
+    ring.mutex = NULL;
+    return false;
+  }
+
+  ring.capacity = capacity;
+  ring.mutex = xSemaphoreCreateMutex();
+  if (ring.mutex == NULL) {
+    heap_caps_free(ring.data);
+    ring.data = NULL;
+    ring.capacity = 0;
+    return false;
+  }
+
+  ring.readPos = 0;
+  ring.writePos = 0;
+  ring.fill = 0;
+  ring.totalWritten = 0;
+  ring.totalRead = 0;
+  ring.totalDropped = 0;
+  return true;
+}
+
+void streamRingRelease(StreamRing& ring) {
+  if (ring.data != NULL) {
+    heap_caps_free(ring.data);
+    ring.data = NULL;
+  }
+  if (ring.mutex != NULL) {
+    vSemaphoreDelete(ring.mutex);
+    ring.mutex = NULL;
+  }
+  ring.capacity = 0;
+  ring.readPos = 0;
+  ring.writePos = 0;
+  ring.fill = 0;
+}
+
+void streamRingReset(StreamRing& ring) {
+  if (ring.mutex == NULL) return;
+
+  xSemaphoreTake(ring.mutex, portMAX_DELAY);
+  ring.readPos = 0;
+  ring.writePos = 0;
+  ring.fill = 0;
+  xSemaphoreGive(ring.mutex);
+}
+
+// Copy into the ring at writePos; caller holds the mutex and has checked space
+static void copyIn(StreamRing& ring, const uint8_t* src, size_t len) {
+  size_t first = min(len, ring.capacity - ring.writePos);
+  memcpy(ring.data + ring.writePos, src, first);
+  if (len > first) {
+    memcpy(ring.data, src + first, len - first);
+  }
+  ring.writePos = (ring.writePos + len) % ring.capacity;
+  ring.fill += len;
+  ring.totalWritten += len;
+}
+
+// Copy out of the ring from readPos without consuming; caller holds the mutex
+static void copyOut(const StreamRing& ring, uint8_t* dst, size_t len) {
+  size_t first = min(len, ring.capacity - ring.readPos);
+  memcpy(dst, ring.data + ring.readPos, first);
+  if (len > first) {
+    memcpy(dst + first, ring.data, len - first);
+  }
+}
+
+static void consume(StreamRing& ring, size_t len) {
+  ring.readPos = (ring.readPos + len) % ring.capacity;
+  ring.fill -= len;
+}
+
+size_t streamRingWrite(StreamRing& ring, const uint8_t* src, size_t len) {
+  if (ring.mutex == NULL) return 0;
+
+  xSemaphoreTake(ring.mutex, portMAX_DELAY);
+  size_t count = min(len, ring.capacity - ring.fill);
+  if (count > 0) {
+    copyIn(ring, src, count);
+  }
+  xSemaphoreGive(ring.mutex);
+  return count;
+}
+
+size_t streamRingWriteOverwrite(StreamRing& ring, const uint8_t* src, size_t len) {
+  if (ring.mutex == NULL) return 0;
+
+  // Only the newest capacity bytes can be kept
+  if (len > ring.capacity) {
+    src += len - ring.capacity;
+    len = ring.capacity;
+  }
+
+  xSemaphoreTake(ring.mutex, portMAX_DELAY);
+  size_t space = ring.capacity - ring.fill;
+  if (len > space) {
+    size_t drop = len - space;
+    consume(ring, drop);
+    ring.totalDropped += drop;
+  }
+  copyIn(ring, src, len);
+  xSemaphoreGive(ring.mutex);
+  return len;
+}
+
+size_t streamRingPeek(StreamRing& ring, uint8_t* dst, size_t len) {
+  if (ring.mutex == NULL) return 0;
+
+  xSemaphoreTake(ring.mutex, portMAX_DELAY);
+  size_t count = min(len, ring.fill);
+  if (count > 0) {
+    copyOut(ring, dst, count);
+  }
+  xSemaphoreGive(ring.mutex);
+  return count;
+}
+
+size_t streamRingRead(StreamRing& ring, uint8_t* dst, size_t len) {
+  if (ring.mutex == NULL) return 0;
+
+  xSemaphoreTake(ring.mutex, portMAX_DELAY);
+  size_t count = min(len, ring.fill);
+  if (count > 0) {
+    copyOut(ring, dst, count);
+    consume(ring, count);
+    ring.totalRead += count;
+  }
+  xSemaphoreGive(ring.mutex);
+  return count;
+}
+
+// Consume bytes already taken with streamRingPeek(); they count as read
+size_t streamRingConsume(StreamRing& ring, size_t len) {
+  if (ring.mutex == NULL) return 0;
+
+  xSemaphoreTake(ring.mutex, portMAX_DELAY);
+  size_t count = min(len, ring.fill);
+  consume(ring, count);
+  ring.totalRead += count;
+  xSemaphoreGive(ring.mutex);
+  return count;
+}
+
+// Throw away the oldest bytes unread; they count as dropped
+size_t streamRingDiscard(StreamRing& ring, size_t len) {
+  if (ring.mutex == NULL) return 0;
+
+  xSemaphoreTake(ring.mutex, portMAX_DELAY);
+  size_t count = min(len, ring.fill);
+  consume(ring, count);
+  ring.totalDropped += count;
+  xSemaphoreGive(ring.mutex);
+  return count;
+}
+
+size_t streamRingFill(const StreamRing& ring) {
+  return ring.fill;
+}
+
+size_t streamRingSpace(const StreamRing& ring) {
+  return ring.capacity - ring.fill;
+}
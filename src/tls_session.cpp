@@ -0,0 +1,387 @@
+#include "tls_session.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include <errno.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_internal.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/net_sockets.h"
+
+struct TlsSessionClient::Context {
+  mbedtls_net_context net;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context drbg;
+  bool closed;   // Peer closed or an error occurred; buffered data can still be read
+};
+
+// Saved sessions, one per host:port, kept in PSRAM
+struct CachedSession {
+  char host[64];
+  uint16_t port;
+  bool valid;
+  unsigned long lastUsed;
+  mbedtls_ssl_session session;
+};
+
+static CachedSession* sessionCache = NULL;
+static SemaphoreHandle_t cacheMutex = NULL;
+static TlsHandshakeStats tlsStats = {};
+static portMUX_TYPE tlsStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void initTlsSessionCache() {
+  if (sessionCache != NULL) return;
+
+  sessionCache = (CachedSession*)heap_caps_calloc(TLS_SESSION_CACHE_SIZE, sizeof(CachedSession),
+                                                  MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  cacheMutex = xSemaphoreCreateMutex();
+  if (sessionCache == NULL || cacheMutex == NULL) {
+    Serial.println("TLS session cache disabled - allocation failed");
+    sessionCache = NULL;
+    return;
+  }
+
+  for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+    mbedtls_ssl_session_init(&sessionCache[i].session);
+  }
+}
+
+static int findSession(const char* host, uint16_t port) {
+  for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+    if (sessionCache[i].valid && sessionCache[i].port == port && strcmp(sessionCache[i].host, host) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Offer the saved session for host in the next handshake
+static bool restoreSession(const char* host, uint16_t port, mbedtls_ssl_context* ssl) {
+  if (sessionCache == NULL) return false;
+
+  bool offered = false;
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  int index = findSession(host, port);
+  if (index >= 0 && mbedtls_ssl_set_session(ssl, &sessionCache[index].session) == 0) {
+    sessionCache[index].lastUsed = millis();
+    offered = true;
+  }
+  xSemaphoreGive(cacheMutex);
+  return offered;
+}
+
+static void saveSession(const char* host, uint16_t port, const mbedtls_ssl_context* ssl) {
+  if (sessionCache == NULL || strlen(host) >= sizeof(sessionCache[0].host)) return;
+
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  int index = findSession(host, port);
+  if (index < 0) {
+    // Free slot, or the least recently used host
+    index = 0;
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+      if (!sessionCache[i].valid) {
+        index = i;
+        break;
+      }
+      if (sessionCache[i].lastUsed < sessionCache[index].lastUsed) index = i;
+    }
+  }
+
+  CachedSession& entry = sessionCache[index];
+  mbedtls_ssl_session_free(&entry.session);
+  mbedtls_ssl_session_init(&entry.session);
+  entry.valid = mbedtls_ssl_get_session(ssl, &entry.session) == 0;
+  strcpy(entry.host, host);
+  entry.port = port;
+  entry.lastUsed = millis();
+  xSemaphoreGive(cacheMutex);
+}
+
+static void forgetSession(const char* host, uint16_t port) {
+  if (sessionCache == NULL) return;
+
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  int index = findSession(host, port);
+  if (index >= 0) {
+    mbedtls_ssl_session_free(&sessionCache[index].session);
+    mbedtls_ssl_session_init(&sessionCache[index].session);
+    sessionCache[index].valid = false;
+  }
+  xSemaphoreGive(cacheMutex);
+}
+
+static void recordHandshake(bool ok, bool resumed, unsigned long duration) {
+  portENTER_CRITICAL(&tlsStatsMux);
+  if (!ok) {
+    tlsStats.failedHandshakes++;
+  } else {
+    tlsStats.lastHandshakeMs = duration;
+    tlsStats.lastResumed = resumed;
+    if (resumed) {
+      tlsStats.resumedHandshakes++;
+      tlsStats.resumedTotalMs += duration;
+    } else {
+      tlsStats.fullHandshakes++;
+      tlsStats.fullTotalMs += duration;
+    }
+  }
+  portEXIT_CRITICAL(&tlsStatsMux);
+}
+
+// Non-blocking TCP connect with timeout; the socket stays non-blocking for mbedtls
+static int openSocket(const char* host, uint16_t port, int32_t timeoutMs) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    return -1;
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) return -1;
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  addr.sin_port = htons(port);
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  int res = ::connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+  if (res < 0 && errno != EINPROGRESS) {
+    close(fd);
+    return -1;
+  }
+
+  fd_set fdset;
+  FD_ZERO(&fdset);
+  FD_SET(fd, &fdset);
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  if (select(fd + 1, NULL, &fdset, NULL, &tv) <= 0) {
+    close(fd);
+    return -1;
+  }
+
+  int sockErr = 0;
+  socklen_t errLen = sizeof(sockErr);
+  getsockopt(fd, SOL_SOCKET, SO_ERROR, &sockErr, &errLen);
+  if (sockErr != 0) {
+    close(fd);
+    return -1;
+  }
+
+  int noDelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  return fd;
+}
+
+TlsSessionClient::TlsSessionClient() : ctx(NULL), peeked(-1) {
+}
+
+TlsSessionClient::~TlsSessionClient() {
+  stop();
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port, TLS_CONNECT_TIMEOUT_MS);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port) {
+  return connect(host, port, TLS_CONNECT_TIMEOUT_MS);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port, int32_t timeout) {
+  stop();
+
+  int fd = openSocket(host, port, timeout > 0 ? timeout : TLS_CONNECT_TIMEOUT_MS);
+  if (fd < 0) return 0;
+
+  ctx = (Context*)calloc(1, sizeof(Context));
+  if (ctx == NULL) {
+    close(fd);
+    return 0;
+  }
+  ctx->net.fd = fd;
+  mbedtls_ssl_init(&ctx->ssl);
+  mbedtls_ssl_config_init(&ctx->conf);
+  mbedtls_entropy_init(&ctx->entropy);
+  mbedtls_ctr_drbg_init(&ctx->drbg);
+
+  static const char personal[] = "tls_session";
+  if (mbedtls_ctr_drbg_seed(&ctx->drbg, mbedtls_entropy_func, &ctx->entropy,
+                            (const unsigned char*)personal, sizeof(personal) - 1) != 0 ||
+      mbedtls_ssl_config_defaults(&ctx->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_conf_authmode(&ctx->conf, MBEDTLS_SSL_VERIFY_NONE);
+  mbedtls_ssl_conf_rng(&ctx->conf, mbedtls_ctr_drbg_random, &ctx->drbg);
+#ifdef MBEDTLS_SSL_SESSION_TICKETS
+  mbedtls_ssl_conf_session_tickets(&ctx->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+  if (mbedtls_ssl_setup(&ctx->ssl, &ctx->conf) != 0 || mbedtls_ssl_set_hostname(&ctx->ssl, host) != 0) {
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_set_bio(&ctx->ssl, &ctx->net, mbedtls_net_send, mbedtls_net_recv, NULL);
+
+  // Step the handshake ourselves so we can see whether the server accepted the saved session
+  unsigned long start = millis();
+  bool offered = restoreSession(host, port, &ctx->ssl);
+  bool resumed = false;
+  while (ctx->ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+    int ret = mbedtls_ssl_handshake_step(&ctx->ssl);
+    if (ctx->ssl.handshake != NULL && ctx->ssl.handshake->resume) {
+      resumed = true;
+    }
+    if (ret == 0) continue;
+
+    if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+        millis() - start > TLS_HANDSHAKE_TIMEOUT_MS) {
+      Serial.print("TLS handshake with ");
+      Serial.print(host);
+      Serial.print(" failed: -0x");
+      Serial.println(-ret, HEX);
+      if (offered) forgetSession(host, port); // Don't offer a session the server chokes on
+      recordHandshake(false, false, 0);
+      stop();
+      return 0;
+    }
+    vTaskDelay(1);
+  }
+
+  unsigned long duration = millis() - start;
+  recordHandshake(true, resumed, duration);
+  saveSession(host, port, &ctx->ssl);
+
+  Serial.print(resumed ? "TLS session resumed with " : "TLS full handshake with ");
+  Serial.print(host);
+  Serial.print(" in ");
+  Serial.print(duration);
+  Serial.println("ms");
+  return 1;
+}
+
+size_t TlsSessionClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t TlsSessionClient::write(const uint8_t* buf, size_t size) {
+  if (ctx == NULL || ctx->closed) return 0;
+
+  size_t written = 0;
+  unsigned long start = millis();
+  while (written < size) {
+    int ret = mbedtls_ssl_write(&ctx->ssl, buf + written, size - written);
+    if (ret > 0) {
+      written += ret;
+      continue;
+    }
+    if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+        millis() - start > TLS_IO_TIMEOUT_MS) {
+      ctx->closed = true;
+      break;
+    }
+    vTaskDelay(1);
+  }
+  return written;
+}
+
+int TlsSessionClient::available() {
+  int count = peeked >= 0 ? 1 : 0;
+  if (ctx == NULL) return count;
+
+  if (!ctx->closed) {
+    // Pull the next record into mbedtls' buffer without consuming it
+    int ret = mbedtls_ssl_read(&ctx->ssl, NULL, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      ctx->closed = true;
+    }
+  }
+  return count + mbedtls_ssl_get_bytes_avail(&ctx->ssl);
+}
+
+int TlsSessionClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsSessionClient::read(uint8_t* buf, size_t size) {
+  if (size == 0) return 0;
+
+  size_t count = 0;
+  if (peeked >= 0) {
+    buf[count++] = (uint8_t)peeked;
+    peeked = -1;
+    if (count == size) return count;
+  }
+  if (ctx == NULL) return count > 0 ? (int)count : -1;
+
+  int ret = mbedtls_ssl_read(&ctx->ssl, buf + count, size - count);
+  if (ret > 0) return count + ret;
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    ctx->closed = true;
+  }
+  return count > 0 ? (int)count : -1;
+}
+
+int TlsSessionClient::peek() {
+  if (peeked < 0) {
+    uint8_t b;
+    if (ctx != NULL && mbedtls_ssl_read(&ctx->ssl, &b, 1) == 1) {
+      peeked = b;
+    }
+  }
+  return peeked;
+}
+
+void TlsSessionClient::flush() {
+}
+
+void TlsSessionClient::stop() {
+  peeked = -1;
+  if (ctx == NULL) return;
+
+  if (!ctx->closed && ctx->ssl.state == MBEDTLS_SSL_HANDSHAKE_OVER) {
+    mbedtls_ssl_close_notify(&ctx->ssl);
+  }
+  if (ctx->net.fd >= 0) {
+    close(ctx->net.fd);
+  }
+  mbedtls_ssl_free(&ctx->ssl);
+  mbedtls_ssl_config_free(&ctx->conf);
+  mbedtls_ctr_drbg_free(&ctx->drbg);
+  mbedtls_entropy_free(&ctx->entropy);
+  free(ctx);
+  ctx = NULL;
+}
+
+uint8_t TlsSessionClient::connected() {
+  if (ctx == NULL) return peeked >= 0;
+  return !ctx->closed || available() > 0;
+}
+
+TlsSessionClient::operator bool() {
+  return connected();
+}
+
+void getTlsHandshakeStats(TlsHandshakeStats& stats) {
+  portENTER_CRITICAL(&tlsStatsMux);
+  stats = tlsStats;
+  portEXIT_CRITICAL(&tlsStatsMux);
+
+  stats.cachedSessions = 0;
+  if (sessionCache != NULL) {
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+      if (sessionCache[i].valid) stats.cachedSessions++;
+    }
+  }
+}
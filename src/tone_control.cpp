@@ -0,0 +1,149 @@
+#include "tone_control.h"
+#include <math.h>
+
+struct ToneBandConfig {
+  const char* name;
+  ToneBandType type;
+  float frequency;
+  float q;
+};
+
+static const ToneBandConfig bandConfig[TONE_BANDS] = {
+  {"bass", TONE_LOW_SHELF, 120.0f, 0.707f},
+  {"mid", TONE_PEAKING, 1000.0f, 0.7f},
+  {"treble", TONE_HIGH_SHELF, 8000.0f, 0.707f}
+};
+
+const char* toneBandName(int band) {
+  if (band < 0 || band >= TONE_BANDS) return "";
+  return bandConfig[band].name;
+}
+
+static int32_t toFixed(float coefficient) {
+  return (int32_t)lroundf(coefficient * (float)(1L << TONE_COEF_SHIFT));
+}
+
+// RBJ audio EQ cookbook biquads, normalised by a0
+static void computeBand(ToneBand& band, const ToneBandConfig& config, int gainDb, uint32_t sampleRate) {
+  float a = powf(10.0f, gainDb / 40.0f);
+  float w0 = 2.0f * (float)M_PI * config.frequency / sampleRate;
+  float cosw = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * config.q);
+  float sqrtA2alpha = 2.0f * sqrtf(a) * alpha;
+  float b0, b1, b2, a0, a1, a2;
+
+  switch (config.type) {
+    case TONE_LOW_SHELF:
+      b0 = a * ((a + 1) - (a - 1) * cosw + sqrtA2alpha);
+      b1 = 2 * a * ((a - 1) - (a + 1) * cosw);
+      b2 = a * ((a + 1) - (a - 1) * cosw - sqrtA2alpha);
+      a0 = (a + 1) + (a - 1) * cosw + sqrtA2alpha;
+      a1 = -2 * ((a - 1) + (a + 1) * cosw);
+      a2 = (a + 1) + (a - 1) * cosw - sqrtA2alpha;
+      break;
+    case TONE_HIGH_SHELF:
+      b0 = a * ((a + 1) + (a - 1) * cosw + sqrtA2alpha);
+      b1 = -2 * a * ((a - 1) + (a + 1) * cosw);
+      b2 = a * ((a + 1) + (a - 1) * cosw - sqrtA2alpha);
+      a0 = (a + 1) - (a - 1) * cosw + sqrtA2alpha;
+      a1 = 2 * ((a - 1) - (a + 1) * cosw);
+      a2 = (a + 1) - (a - 1) * cosw - sqrtA2alpha;
+      break;
+    default: // TONE_PEAKING
+      b0 = 1 + alpha * a;
+      b1 = -2 * cosw;
+      b2 = 1 - alpha * a;
+      a0 = 1 + alpha / a;
+      a1 = -2 * cosw;
+      a2 = 1 - alpha / a;
+      break;
+  }
+
+  band.b0 = toFixed(b0 / a0);
+  band.b1 = toFixed(b1 / a0);
+  band.b2 = toFixed(b2 / a0);
+  band.a1 = toFixed(a1 / a0);
+  band.a2 = toFixed(a2 / a0);
+}
+
+void toneControlInit(ToneControl& tone) {
+  memset(&tone, 0, sizeof(tone));
+}
+
+// Recompute the coefficients; called on settings and sample rate changes only
+void toneControlConfigure(ToneControl& tone, const int8_t* gainDb, uint32_t sampleRate) {
+  tone.sampleRate = sampleRate;
+  tone.active = false;
+
+  for (int i = 0; i < TONE_BANDS; i++) {
+    int gain = constrain(gainDb[i], -TONE_GAIN_MAX_DB, TONE_GAIN_MAX_DB);
+    tone.gainDb[i] = gain;
+
+    ToneBand& band = tone.bands[i];
+    if (gain == 0 || sampleRate == 0) {
+      band.active = false;
+      continue;
+    }
+    if (!band.active) {
+      memset(tone.state[i], 0, sizeof(tone.state[i])); // Don't resume from stale history
+    }
+    computeBand(band, bandConfig[i], gain, sampleRate);
+    band.active = true;
+    tone.active = true;
+  }
+}
+
+// Direct form I over an interleaved stereo block, history kept in registers
+static void processBand(const ToneBand& band, ToneBandState* state, int32_t* x, uint32_t frames) {
+  const int64_t round = 1LL << (TONE_COEF_SHIFT - 1);
+  int32_t lx1 = state[0].x1, lx2 = state[0].x2, ly1 = state[0].y1, ly2 = state[0].y2;
+  int32_t rx1 = state[1].x1, rx2 = state[1].x2, ry1 = state[1].y1, ry2 = state[1].y2;
+
+  for (uint32_t i = 0; i < frames; i++) {
+    int32_t left = x[i * 2];
+    int64_t acc = round + (int64_t)band.b0 * left + (int64_t)band.b1 * lx1 + (int64_t)band.b2 * lx2
+                  - (int64_t)band.a1 * ly1 - (int64_t)band.a2 * ly2;
+    int32_t outLeft = (int32_t)(acc >> TONE_COEF_SHIFT);
+    lx2 = lx1; lx1 = left;
+    ly2 = ly1; ly1 = outLeft;
+    x[i * 2] = outLeft;
+
+    int32_t right = x[i * 2 + 1];
+    acc = round + (int64_t)band.b0 * right + (int64_t)band.b1 * rx1 + (int64_t)band.b2 * rx2
+          - (int64_t)band.a1 * ry1 - (int64_t)band.a2 * ry2;
+    int32_t outRight = (int32_t)(acc >> TONE_COEF_SHIFT);
+    rx2 = rx1; rx1 = right;
+    ry2 = ry1; ry1 = outRight;
+    x[i * 2 + 1] = outRight;
+  }
+
+  state[0].x1 = lx1; state[0].x2 = lx2; state[0].y1 = ly1; state[0].y2 = ly2;
+  state[1].x1 = rx1; state[1].x2 = rx2; state[1].y1 = ry1; state[1].y2 = ry2;
+}
+
+void toneControlProcess(ToneControl& tone, int16_t* buff, uint32_t frames) {
+  if (!tone.active) return; // Flat: nothing to do
+
+  const int32_t round = 1 << (TONE_SAMPLE_SHIFT - 1);
+  while (frames > 0) {
+    uint32_t n = frames < TONE_BLOCK_FRAMES ? frames : TONE_BLOCK_FRAMES;
+    uint32_t samples = n * 2;
+
+    for (uint32_t i = 0; i < samples; i++) {
+      tone.scratch[i] = (int32_t)buff[i] << TONE_SAMPLE_SHIFT;
+    }
+    for (int b = 0; b < TONE_BANDS; b++) {
+      if (tone.bands[b].active) processBand(tone.bands[b], tone.state[b], tone.scratch, n);
+    }
+    // Boosts can exceed full scale, saturate instead of wrapping
+    for (uint32_t i = 0; i < samples; i++) {
+      int32_t v = (tone.scratch[i] + round) >> TONE_SAMPLE_SHIFT;
+      if (v > 32767) v = 32767;
+      else if (v < -32768) v = -32768;
+      buff[i] = (int16_t)v;
+    }
+
+    buff += samples;
+    frames -= n;
+  }
+}
@@ -1,5 +1,6 @@
 #include "weather.h"
 #include "settings.h"
+#include "display.h"
 #include <asyncHTTPrequest.h>
 #include <ArduinoJson.h>
 #include <WiFi.h>
@@ -164,22 +165,22 @@ bool fetchWeatherData() {
 
 String getWeatherIcon(const String& iconCode) {
   // Map OpenWeatherMap icon codes to simple characters for LCD display
-  // Using custom characters: 2=sun, 3=cloud, R=rain, S=snow, M=mist
-  if (iconCode.startsWith("01")) return String((char)2); // clear sky (sun)
-  if (iconCode.startsWith("02")) return String((char)3); // few clouds (cloud)
-  if (iconCode.startsWith("03")) return String((char)3); // scattered clouds
-  if (iconCode.startsWith("04")) return String((char)3); // broken clouds
-  if (iconCode.startsWith("09")) return "R"; // shower rain
-  if (iconCode.startsWith("10")) return "R"; // rain
-  if (iconCode.startsWith("11")) return "T"; // thunderstorm
-  if (iconCode.startsWith("13")) return "S"; // snow
-  if (iconCode.startsWith("50")) return "M"; // mist
+  // Using custom characters, loaded into the LCD when shown
+  if (iconCode.startsWith("01")) return String((char)GLYPH_SUN); // clear sky
+  if (iconCode.startsWith("02")) return String((char)GLYPH_CLOUD); // few clouds
+  if (iconCode.startsWith("03")) return String((char)GLYPH_CLOUD); // scattered clouds
+  if (iconCode.startsWith("04")) return String((char)GLYPH_CLOUD); // broken clouds
+  if (iconCode.startsWith("09")) return String((char)GLYPH_RAIN); // shower rain
+  if (iconCode.startsWith("10")) return String((char)GLYPH_RAIN); // rain
+  if (iconCode.startsWith("11")) return String((char)GLYPH_THUNDER); // thunderstorm
+  if (iconCode.startsWith("13")) return String((char)GLYPH_SNOW); // snow
+  if (iconCode.startsWith("50")) return String((char)GLYPH_MIST); // mist
   return "?"; // unknown
 }
 
 String formatTemperature(float temp) {
-  // Format temperature with custom degree symbol (character 1)
-  return String((int)round(temp)) + String((char)1) + "C";
+  // Format temperature with the custom degree symbol
+  return String((int)round(temp)) + String((char)GLYPH_DEGREE) + "C";
 }
 
 void forceWeatherUpdate() {
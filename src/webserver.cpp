@@ -1,7 +1,19 @@
 #include "webserver.h"
 #include "settings.h"
+#include "display.h"
+#include "menu.h"
 #include "weather.h"
 #include "wifi_config.h"
+#include "audio_engine.h"
+#include "stream_relay.h"
+#include "stream_health.h"
+#include "resolve_cache.h"
+#include "tls_session.h"
+#include "dsp_benchmark.h"
+#include "audio_telemetry.h"
+#include "loudness.h"
+#include "alarm.h"
+#include "station_variants.h"
 #include <WiFi.h>
 #include <ArduinoJson.h>
 #include <SPIFFS.h>
@@ -707,7 +719,7 @@ void initWebServer() {
     server.on("/update-streams", HTTP_POST, [](AsyncWebServerRequest *request) {
         // Empty handler - actual processing in body handler
     }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-        DynamicJsonDocument doc(2048);
+        DynamicJsonDocument doc(8192);
         DeserializationError error = deserializeJson(doc, (char*)data);
         
         if (error) {
@@ -715,6 +727,25 @@ void initWebServer() {
             return;
         }
         
+        // Keep the loudness learned and the variants listed for stations that stay in the list
+        for (JsonObject stream : doc.as<JsonArray>()) {
+            const char* url = stream["url"];
+            for (int i = 0; url && i < menuStreamCount; i++) {
+                if (strcmp(menuStreams[i].url, url) != 0) continue;
+                if (menuStreams[i].loudnessBlocks > 0) {
+                    stream["loudness"] = roundf(menuStreams[i].loudnessDb * 100.0f) / 100.0f;
+                    stream["loudnessBlocks"] = menuStreams[i].loudnessBlocks;
+                }
+                if (!stream.containsKey("variants") && stationVariantUrl(i, 0) != NULL) {
+                    JsonArray variants = stream.createNestedArray("variants");
+                    for (int level = 0; level < stationVariantCount(i); level++) {
+                        variants.add(stationVariantUrl(i, level));
+                    }
+                }
+                break;
+            }
+        }
+        
         // Save to file
         File file = SPIFFS.open("/streams.json", "w");
         if (file) {
@@ -868,6 +899,636 @@ void initWebServer() {
         }
     });
     
+    // Audio engine diagnostics
+    server.on("/audio-stats", HTTP_GET, [](AsyncWebServerRequest *request) {
+        AudioEngineStats stats;
+        getAudioEngineStats(stats);
+        
+        DynamicJsonDocument doc(6144);
+        doc["running"] = audioEngineIsRunning();
+        doc["loopCount"] = stats.loopCount;
+        doc["deadlineMisses"] = stats.deadlineMisses;
+        doc["deadlineUs"] = AUDIO_LOOP_DEADLINE_US;
+        doc["maxLoopGapUs"] = stats.maxLoopGapUs;
+        doc["maxLoopDurationUs"] = stats.maxLoopDurationUs;
+        doc["commandsProcessed"] = stats.commandsProcessed;
+        doc["commandsDropped"] = stats.commandsDropped;
+        doc["eventsDropped"] = stats.eventsDropped;
+        doc["stackHighWater"] = stats.stackHighWater;
+        
+        RelayStats relay;
+        getRelayStats(relay);
+        
+        JsonObject start = doc.createNestedObject("startLatency");
+        start["lastFirstByteMs"] = relay.lastFirstByteMs;
+        start["lastFirstFrameMs"] = stats.lastFirstFrameMs;
+        start["lastMs"] = stats.lastStartMs;
+        start["lastWarm"] = stats.lastStartWarm;
+        start["warmCount"] = stats.warmStarts;
+        start["warmAvgMs"] = stats.warmStarts > 0 ? stats.warmStartTotalMs / stats.warmStarts : 0;
+        start["coldCount"] = stats.coldStarts;
+        start["coldAvgMs"] = stats.coldStarts > 0 ? stats.coldStartTotalMs / stats.coldStarts : 0;
+        
+        AlarmStartStats alarmStart;
+        getAlarmStartStats(alarmStart);
+        JsonObject alarm = start.createNestedObject("alarm");
+        alarm["count"] = alarmStart.alarms;
+        alarm["prewarmed"] = alarmStart.prewarmed;
+        alarm["silent"] = alarmStart.silent;
+        alarm["lastMs"] = alarmStart.lastLatencyMs;
+        alarm["lastPrewarmed"] = alarmStart.lastPrewarmed;
+        alarm["maxMs"] = alarmStart.maxLatencyMs;
+        alarm["fallbackActive"] = stats.fallbackActive;
+        alarm["fallbackStarts"] = stats.fallbackStarts;
+        alarm["fallbackHandovers"] = stats.fallbackHandovers;
+        
+        JsonObject asrcObj = doc.createNestedObject("asrc");
+        asrcObj["outputRate"] = ASRC_OUTPUT_RATE;
+        asrcObj["inputRate"] = stats.asrcInputRate;
+        asrcObj["correctionPpm"] = stats.asrcCorrectionPpm;
+        asrcObj["rateChanges"] = stats.asrcRateChanges;
+        asrcObj["i2sReclocks"] = stats.asrcI2sReclocks;
+        asrcObj["droppedFrames"] = stats.asrcDroppedFrames;
+        
+        JsonObject buffer = doc.createNestedObject("buffer");
+        buffer["enabled"] = relayAvailable();
+        buffer["active"] = relay.active;
+        buffer["upstreamConnected"] = relay.upstreamConnected;
+        buffer["feeding"] = relay.feeding;
+        buffer["fillBytes"] = relay.ringFill;
+        buffer["capacityBytes"] = relay.ringCapacity;
+        buffer["fillMs"] = relay.fillMs;
+        buffer["targetMs"] = relay.targetMs;
+        buffer["targetBytes"] = relay.targetBytes;
+        buffer["minMs"] = relay.minMs;
+        buffer["maxMs"] = relay.maxMs;
+        buffer["underruns"] = relay.underruns;
+        buffer["bitrateKbps"] = relay.bitrateKbps;
+        buffer["bytesReceived"] = relay.bytesReceived;
+        buffer["maxGapMs"] = relay.maxGapMs;
+        buffer["upstreamConnects"] = relay.upstreamConnects;
+        buffer["upstreamFailures"] = relay.upstreamFailures;
+        buffer["standbyConnected"] = relay.standbyConnected;
+        buffer["standbyFillMs"] = relay.standbyFillMs;
+        buffer["standbyHits"] = relay.standbyHits;
+        buffer["standbyMisses"] = relay.standbyMisses;
+        
+        JsonObject hls = buffer.createNestedObject("hls");
+        hls["active"] = relay.hlsActive;
+        hls["queueDepth"] = relay.hlsQueueDepth;
+        hls["prefetch"] = relay.hlsPrefetch;
+        hls["fetching"] = relay.hlsFetching;
+        hls["segments"] = relay.hlsSegments;
+        hls["lastFetchMs"] = relay.hlsLastFetchMs;
+        hls["avgFetchMs"] = relay.hlsSegments > 0 ? relay.hlsFetchTotalMs / relay.hlsSegments : 0;
+        hls["maxFetchMs"] = relay.hlsMaxFetchMs;
+        hls["slowFetches"] = relay.hlsSlowFetches;
+        hls["playlistLoads"] = relay.hlsPlaylistLoads;
+        hls["requests"] = relay.hlsRequests;
+        hls["reusedRequests"] = relay.hlsReusedRequests;
+        hls["skippedSegments"] = relay.hlsSkipped;
+        hls["failures"] = relay.hlsFailures;
+        
+        VariantStats variantStats;
+        getVariantStats(variantStats);
+        JsonObject variants = buffer.createNestedObject("variants");
+        variants["station"] = variantStats.station;
+        variants["count"] = variantStats.count;
+        variants["level"] = variantStats.level;
+        variants["defaultLevel"] = variantStats.defaultLevel;
+        variants["pendingLevel"] = variantStats.pendingLevel;
+        variants["url"] = variantStats.station >= 0 ? stationStreamUrl(variantStats.station) : "";
+        variants["stepsDown"] = variantStats.stepsDown;
+        variants["stepsUp"] = variantStats.stepsUp;
+        variants["warmSwitches"] = variantStats.warmSwitches;
+        variants["coldSwitches"] = variantStats.coldSwitches;
+        variants["abandoned"] = variantStats.abandoned;
+        
+        JsonObject shift = doc.createNestedObject("timeShift");
+        shift["paused"] = relay.paused;
+        shift["behindLiveMs"] = relay.behindLiveMs;
+        shift["bufferBytes"] = relay.timeShiftFill;
+        shift["capacityBytes"] = relay.timeShiftCapacity;
+        shift["maxMs"] = relay.timeShiftMaxMs;
+        shift["droppedBytes"] = relay.timeShiftDropped;
+        shift["psramBytes"] = relay.timeShiftCapacity + RELAY_RING_SIZE * 2;
+        
+        JsonObject cache = doc.createNestedObject("resolveCache");
+        cache["entries"] = resolveCacheCount();
+        cache["cachedConnects"] = relay.cachedConnects;
+        cache["cachedAvgMs"] = relay.cachedConnects > 0 ? relay.cachedConnectTotalMs / relay.cachedConnects : 0;
+        cache["resolvedConnects"] = relay.resolvedConnects;
+        cache["resolvedAvgMs"] = relay.resolvedConnects > 0 ? relay.resolvedConnectTotalMs / relay.resolvedConnects : 0;
+        cache["fallbacks"] = relay.cacheFallbacks;
+        
+        TlsHandshakeStats tls;
+        getTlsHandshakeStats(tls);
+        JsonObject tlsObj = doc.createNestedObject("tls");
+        tlsObj["fullHandshakes"] = tls.fullHandshakes;
+        tlsObj["fullAvgMs"] = tls.fullHandshakes > 0 ? tls.fullTotalMs / tls.fullHandshakes : 0;
+        tlsObj["resumedHandshakes"] = tls.resumedHandshakes;
+        tlsObj["resumedAvgMs"] = tls.resumedHandshakes > 0 ? tls.resumedTotalMs / tls.resumedHandshakes : 0;
+        tlsObj["failedHandshakes"] = tls.failedHandshakes;
+        tlsObj["lastMs"] = tls.lastHandshakeMs;
+        tlsObj["lastResumed"] = tls.lastResumed;
+        tlsObj["cachedSessions"] = tls.cachedSessions;
+        
+        StreamHealthStats health;
+        getStreamHealthStats(health);
+        JsonObject healthObj = doc.createNestedObject("health");
+        healthObj["recovering"] = health.recovering;
+        healthObj["failedAttempts"] = health.failedAttempts;
+        healthObj["consecutiveFailures"] = health.consecutiveFailures;
+        healthObj["backoffMs"] = health.currentBackoffMs;
+        JsonObject reasons = healthObj.createNestedObject("reconnects");
+        for (int i = 0; i < RECONNECT_REASON_COUNT; i++) {
+            JsonObject reason = reasons.createNestedObject(reconnectReasonName(i));
+            reason["count"] = health.reasons[i].count;
+            reason["recovered"] = health.reasons[i].recovered;
+            reason["avgDurationMs"] = health.reasons[i].recovered > 0 ? health.reasons[i].totalDurationMs / health.reasons[i].recovered : 0;
+            reason["maxDurationMs"] = health.reasons[i].maxDurationMs;
+        }
+        JsonObject deadAir = healthObj.createNestedObject("deadAir");
+        deadAir["active"] = health.deadAir;
+        deadAir["silentMs"] = audioEngineSilenceMs();
+        deadAir["events"] = health.deadAirEvents;
+        deadAir["totalMs"] = health.deadAirTotalMs;
+        deadAir["maxMs"] = health.deadAirMaxMs;
+        deadAir["lastMs"] = health.lastDeadAirMs;
+        healthObj["failovers"] = health.failovers;
+        
+        SleepTimerStats sleep;
+        getSleepTimerStats(sleep);
+        JsonObject sleepObj = doc.createNestedObject("sleepTimer");
+        sleepObj["active"] = sleepTimerActive;
+        sleepObj["fading"] = sleepTimerFading();
+        sleepObj["fades"] = sleep.fades;
+        sleepObj["hardStops"] = sleep.hardStops;
+        sleepObj["heapChecks"] = sleep.checks;
+        sleepObj["heapBaseline"] = sleep.heapBaseline;
+        sleepObj["heapAfter"] = sleep.heapAfter;
+        sleepObj["heapDeltaBytes"] = sleep.heapDeltaBytes;
+        sleepObj["largestBlockAfter"] = sleep.largestBlockAfter;
+        sleepObj["psramBaseline"] = sleep.psramBaseline;
+        sleepObj["psramAfter"] = sleep.psramAfter;
+        sleepObj["psramDeltaBytes"] = sleep.psramDeltaBytes;
+        sleepObj["heapDriftBytes"] = sleep.driftBytes;
+        sleepObj["connectionsClosed"] = sleep.connectionsClosed;
+        sleepObj["released"] = sleep.released;
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    // Audio pipeline histograms and the last minute of per-second samples
+    server.on("/audio-telemetry", HTTP_GET, [](AsyncWebServerRequest *request) {
+        static AudioTelemetry telemetry; // Too big for the async_tcp stack
+        getAudioTelemetry(telemetry);
+        
+        DynamicJsonDocument doc(12288);
+        JsonObject decode = doc.createNestedObject("decodeUs");
+        JsonArray decodeBuckets = decode.createNestedArray("bucketUpperUs");
+        JsonArray decodeCounts = decode.createNestedArray("counts");
+        for (int i = 0; i < TELEMETRY_DECODE_BUCKETS; i++) {
+            if (i < TELEMETRY_DECODE_BUCKETS - 1) {
+                decodeBuckets.add(1UL << (TELEMETRY_DECODE_FIRST_SHIFT + i));
+            }
+            decodeCounts.add(telemetry.decodeHistogram[i]);
+        }
+        decode["maxUs"] = telemetry.decodeMaxUs;
+        
+        JsonArray fill = doc.createNestedArray("inputFillPct");
+        for (int i = 0; i < TELEMETRY_FILL_BUCKETS; i++) {
+            fill.add(telemetry.fillHistogram[i]);
+        }
+        
+        doc["outputUnderruns"] = telemetry.outputUnderruns;
+        doc["decodeErrors"] = telemetry.decodeErrors;
+        doc["bytesPerSecond"] = telemetry.bytesPerSecond;
+        doc["maxLoopMs"] = telemetry.maxLoopMs;
+        doc["uptimeMs"] = millis();
+        
+        // Column arrays keep the history compact
+        JsonObject history = doc.createNestedObject("history");
+        JsonArray time = history.createNestedArray("time");
+        JsonArray inputFill = history.createNestedArray("inputFillPct");
+        JsonArray relayFill = history.createNestedArray("relayFillMs");
+        JsonArray kbps = history.createNestedArray("kbps");
+        JsonArray maxLoop = history.createNestedArray("maxLoopMs");
+        JsonArray underruns = history.createNestedArray("underruns");
+        JsonArray errors = history.createNestedArray("decodeErrors");
+        for (int i = 0; i < telemetry.historyCount; i++) {
+            const TelemetrySample& sample = telemetry.history[i];
+            time.add(sample.time);
+            inputFill.add(sample.inputFillPct);
+            relayFill.add(sample.relayFillMs);
+            kbps.add(sample.kbps);
+            maxLoop.add(sample.maxLoopMs);
+            underruns.add(sample.underruns);
+            errors.add(sample.decodeErrors);
+        }
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    server.on("/reset-audio-telemetry", HTTP_POST, [](AsyncWebServerRequest *request) {
+        resetAudioTelemetry();
+        request->send(200, "application/json", "{\"success\":true}");
+    });
+    
+    // PCM kernel benchmarks (cycles per sample, measured on this CPU). They run in a
+    // background task: the first request (or ?run=1) starts them and gets 202,
+    // later requests get the last results
+    server.on("/dsp-benchmark", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DspBenchmarkReport report;
+        getDspBenchmarks(report);
+        if (!report.running && (!report.valid || request->hasParam("run"))) {
+            if (!startDspBenchmarks()) {
+                request->send(503, "application/json", "{\"error\":\"Could not start benchmark task\"}");
+                return;
+            }
+            report.running = true;
+        }
+        if (!report.valid) {
+            request->send(202, "application/json", "{\"running\":true}");
+            return;
+        }
+        
+        DynamicJsonDocument doc(1024);
+        doc["running"] = report.running;
+        doc["ageMs"] = millis() - report.finishedAt;
+        doc["cpuMhz"] = ESP.getCpuFreqMHz();
+        doc["frames"] = DSP_BENCHMARK_FRAMES;
+        JsonObject kernels = doc.createNestedObject("cyclesPerSample");
+        JsonObject load = doc.createNestedObject("cpuPercentAt44k"); // 44.1 kHz stereo
+        for (int i = 0; i < report.count; i++) {
+            kernels[report.results[i].name] = report.results[i].cyclesPerSample;
+            load[report.results[i].name] = report.results[i].cyclesPerSample * 88200.0f / (ESP.getCpuFreqMHz() * 10000.0f);
+        }
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(report.running ? 202 : 200, "application/json", response);
+    });
+    
+    // LCD framebuffer: I2C traffic actually sent and what whole-line rewrites would cost
+    server.on("/display-stats", HTTP_GET, [](AsyncWebServerRequest *request) {
+        LcdStats stats;
+        lcd.getStats(stats);
+        
+        DynamicJsonDocument doc(1024);
+        doc["i2cBytes"] = stats.i2cBytes;
+        doc["bytesPerSecond"] = stats.bytesPerSecond;
+        doc["lineRewriteBytesPerSecond"] = stats.lineRewriteBytesPerSecond;
+        doc["peakBytesPerSecond"] = stats.peakBytesPerSecond;
+        doc["cellsWritten"] = stats.cellsWritten;
+        doc["cursorMoves"] = stats.cursorMoves;
+        doc["flushes"] = stats.flushes;
+        
+        JsonObject writer = doc.createNestedObject("writer");
+        writer["framesSubmitted"] = stats.framesSubmitted;
+        writer["framesCoalesced"] = stats.framesCoalesced;
+        writer["framesWritten"] = stats.framesWritten;
+        writer["commandsDropped"] = stats.commandsDropped;
+        writer["queueDepth"] = stats.queueDepth;
+        writer["maxQueueDepth"] = stats.maxQueueDepth;
+        writer["queueLength"] = LCD_QUEUE_LENGTH;
+        writer["lastFlushUs"] = stats.lastFlushUs;
+        writer["avgFlushUs"] = stats.avgFlushUs;
+        writer["maxFlushUs"] = stats.maxFlushUs;
+        
+        // Full-screen rewrite timed at boot, batched against one transaction per expander write
+        JsonObject bench = doc.createNestedObject("benchmark");
+        bench["busHz"] = stats.benchmark.busHz;
+        bench["fullScreenUs"] = stats.benchmark.fullScreenUs;
+        bench["libraryFullScreenUs"] = stats.benchmark.libraryFullScreenUs;
+        
+        // CGRAM slots handed out to custom characters on demand
+        JsonObject glyphs = doc.createNestedObject("glyphs");
+        glyphs["defined"] = stats.glyphs.defined;
+        glyphs["resident"] = stats.glyphs.resident;
+        glyphs["slots"] = LCD_CGRAM_SLOTS;
+        glyphs["uploads"] = stats.glyphs.uploads;
+        glyphs["uploadsPerMinute"] = stats.glyphs.uploadsPerMinute;
+        glyphs["evictions"] = stats.glyphs.evictions;
+        glyphs["fallbacks"] = stats.glyphs.fallbacks;
+        
+        // Heap allocations while composing the regular screens, expected to stay at zero
+        DisplayFrameStats frameStats;
+        getDisplayFrameStats(frameStats);
+        JsonObject frames = doc.createNestedObject("frameAllocations");
+        frames["counting"] = frameStats.counting;
+        frames["frames"] = frameStats.frames;
+        frames["allocations"] = frameStats.allocations;
+        frames["framesWithAllocations"] = frameStats.framesWithAllocations;
+        frames["maxAllocations"] = frameStats.maxAllocations;
+        frames["lastAllocations"] = frameStats.lastAllocations;
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    // Time-shift control: {"action": "pause" | "resume" | "live"}
+    server.on("/timeshift", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(128);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        String action = doc["action"] | "";
+        if (action == "pause") {
+            pauseStream();
+        } else if (action == "resume") {
+            resumeStream();
+        } else if (action == "live") {
+            returnToLive();
+        } else {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Unknown action\"}");
+            return;
+        }
+        request->send(200, "application/json", "{\"success\":true}");
+    });
+    
+    // Play a URL that is not in the station list: {"url": "http://..."}
+    server.on("/play-url", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(512);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        String url = doc["url"] | "";
+        if (!url.startsWith("http://") && !url.startsWith("https://")) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid URL\"}");
+            return;
+        }
+        
+        playUrl(url.c_str());
+        request->send(200, "application/json", "{\"success\":true}");
+    });
+    
+    // Failover settings endpoints
+    server.on("/get-failover-settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(256);
+        doc["backupStream"] = backupStream;
+        doc["backupName"] = (backupStream >= 0 && backupStream < menuStreamCount) ? menuStreams[backupStream].name : "";
+        doc["deadAirMs"] = HEALTH_DEAD_AIR_MS;
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    server.on("/update-failover-settings", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(128);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        int newBackup = doc["backupStream"] | backupStream;
+        if (newBackup < -1 || newBackup >= menuStreamCount) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid backup station\"}");
+            return;
+        }
+        
+        backupStream = newBackup;
+        saveSettings(); // Save to EEPROM
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Failover settings saved\"}");
+    });
+    
+    // Display settings endpoints
+    server.on("/get-display-settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(128);
+        doc["levelMeter"] = levelMeterEnabled;
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    server.on("/update-display-settings", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(128);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        levelMeterEnabled = doc["levelMeter"] | levelMeterEnabled;
+        forceImmediateLcdUpdate = true;
+        saveSettings(); // Save to EEPROM
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Display settings saved\"}");
+    });
+    
+    // Tone control endpoints: {"bass": dB, "mid": dB, "treble": dB}
+    server.on("/get-tone-settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(256);
+        for (int i = 0; i < TONE_BANDS; i++) {
+            doc[toneBandName(i)] = toneGainDb[i];
+        }
+        doc["maxDb"] = TONE_GAIN_MAX_DB;
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    server.on("/update-tone-settings", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(256);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        int8_t gains[TONE_BANDS];
+        for (int i = 0; i < TONE_BANDS; i++) {
+            int gain = doc[toneBandName(i)] | (int)toneGainDb[i];
+            if (gain < -TONE_GAIN_MAX_DB || gain > TONE_GAIN_MAX_DB) {
+                request->send(400, "application/json", "{\"success\":false,\"message\":\"Tone gain out of range\"}");
+                return;
+            }
+            gains[i] = gain;
+        }
+        
+        memcpy(toneGainDb, gains, sizeof(toneGainDb));
+        audioEngineSetTone(toneGainDb);
+        saveSettings(); // Save to EEPROM
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Tone settings saved\"}");
+    });
+    
+    // Loudness normalisation: on/off plus what has been learned per station
+    server.on("/get-loudness-settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(4096);
+        doc["enabled"] = loudnessNormalization;
+        doc["targetDb"] = LOUDNESS_TARGET_DB;
+        JsonArray stations = doc.createNestedArray("stations");
+        for (int i = 0; i < menuStreamCount; i++) {
+            JsonObject station = stations.createNestedObject();
+            station["name"] = menuStreams[i].name;
+            station["measuredSeconds"] = menuStreams[i].loudnessBlocks * LOUDNESS_BLOCK_MS / 1000;
+            if (menuStreams[i].loudnessBlocks > 0) {
+                station["loudnessDb"] = roundf(menuStreams[i].loudnessDb * 10.0f) / 10.0f;
+            }
+            station["offsetDb"] = loudnessOffsetDb10(i) / 10.0f;
+        }
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    server.on("/update-loudness-settings", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(128);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        loudnessNormalization = doc["enabled"] | loudnessNormalization;
+        loudnessReapply(LOUDNESS_RAMP_MS);
+        saveSettings(); // Save to EEPROM
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Loudness settings saved\"}");
+    });
+    
+    // Alarm pre-warm: seconds before an alarm that its station is connected muted
+    server.on("/get-alarm-settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(128);
+        doc["prewarmSeconds"] = alarmPrewarmSeconds;
+        doc["prewarmMaxSeconds"] = ALARM_PREWARM_MAX_SECONDS;
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    server.on("/update-alarm-settings", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(128);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        int seconds = doc["prewarmSeconds"] | alarmPrewarmSeconds;
+        if (seconds < 0 || seconds > ALARM_PREWARM_MAX_SECONDS) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"prewarmSeconds must be 0-120\"}");
+            return;
+        }
+        alarmPrewarmSeconds = seconds;
+        saveSettings(); // Save to EEPROM
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Alarm settings saved\"}");
+    });
+    
+    // Sleep timer: minutes at the end of the timer over which the radio fades out
+    server.on("/get-sleep-settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(128);
+        doc["fadeMinutes"] = sleepFadeMinutes;
+        doc["fadeMaxMinutes"] = SLEEP_FADE_MAX_MINUTES;
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    server.on("/update-sleep-settings", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(128);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        int minutes = doc["fadeMinutes"] | sleepFadeMinutes;
+        if (minutes < 0 || minutes > SLEEP_FADE_MAX_MINUTES) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"fadeMinutes must be 0-30\"}");
+            return;
+        }
+        sleepFadeMinutes = minutes; // Used from the next time the timer is set
+        saveSettings(); // Save to EEPROM
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Sleep settings saved\"}");
+    });
+    
+    // Stream buffer settings endpoints
+    server.on("/get-buffer-settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+        DynamicJsonDocument doc(256);
+        doc["prebufferMinMs"] = prebufferMinMs;
+        doc["prebufferMaxMs"] = prebufferMaxMs;
+        doc["limitMs"] = PREBUFFER_LIMIT_MS;
+        doc["hlsPrefetchSegments"] = hlsPrefetchSegments;
+        doc["hlsPrefetchMax"] = HLS_PREFETCH_MAX;
+        
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    server.on("/update-buffer-settings", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Empty handler - actual processing in body handler
+    }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        DynamicJsonDocument doc(256);
+        DeserializationError error = deserializeJson(doc, (char*)data, len);
+        
+        if (error) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+            return;
+        }
+        
+        int newMin = doc["prebufferMinMs"] | prebufferMinMs;
+        int newMax = doc["prebufferMaxMs"] | prebufferMaxMs;
+        if (newMin < 0 || newMax < 500 || newMax > PREBUFFER_LIMIT_MS || newMin > newMax) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid prebuffer range\"}");
+            return;
+        }
+        int newPrefetch = doc["hlsPrefetchSegments"] | hlsPrefetchSegments;
+        if (newPrefetch < 1 || newPrefetch > HLS_PREFETCH_MAX) {
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid HLS prefetch\"}");
+            return;
+        }
+        
+        prebufferMinMs = newMin;
+        prebufferMaxMs = newMax;
+        hlsPrefetchSegments = newPrefetch;
+        setRelayPrebuffer(prebufferMinMs, prebufferMaxMs);
+        setRelayHlsPrefetch(hlsPrefetchSegments);
+        saveSettings(); // Save to EEPROM
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Buffer settings saved\"}");
+    });
+    
     server.begin();
     Serial.println("Web server started");
     Serial.print("Open http://");
@@ -887,7 +1548,7 @@ void loadStreamsFromFile() {
         return;
     }
     
-    DynamicJsonDocument doc(2048);
+    DynamicJsonDocument doc(8192);
     DeserializationError error = deserializeJson(doc, file);
     file.close();
     
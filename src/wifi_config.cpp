@@ -74,7 +74,7 @@ void updateWiFiConfigDisplay() {
     // Replace character at cursor position with selected character
     if (selectedChar == charsetSize - 1) {
       // Show backspace symbol at cursor position
-      displaySSID.setCharAt(charIndex, char(0));  // Custom character 0 (backspace)
+      displaySSID.setCharAt(charIndex, (char)GLYPH_BACKSPACE);
     } else {
       displaySSID.setCharAt(charIndex, charset[selectedChar]);
     }
@@ -109,7 +109,7 @@ void updateWiFiConfigDisplay() {
     // Replace character at cursor position with selected character
     if (selectedChar == charsetSize - 1) {
       // Show backspace symbol at cursor position
-      displayPwd.setCharAt(charIndex, char(0));  // Custom character 0 (backspace)
+      displayPwd.setCharAt(charIndex, (char)GLYPH_BACKSPACE);
     } else {
       displayPwd.setCharAt(charIndex, charset[selectedChar]);
     }
@@ -129,6 +129,9 @@ void updateWiFiConfigDisplay() {
     lcd.setCursor(displayCursorPos, 1);
     lcd.cursor();
   }
+  
+  // Runs in the blocking configuration loop, outside loop()
+  lcd.flush();
 }
 
 bool connectToWiFi() {
@@ -137,6 +140,7 @@ bool connectToWiFi() {
   lcd.print("Connecting...");
   lcd.setCursor(0, 1);
   lcd.print(ssid);
+  lcd.flush();
   
   WiFi.disconnect();
   WiFi.mode(WIFI_STA);
@@ -157,6 +161,7 @@ bool connectToWiFi() {
     lcd.print("WiFi Connected!");
     lcd.setCursor(0, 1);
     lcd.print(WiFi.localIP());
+    lcd.flush();
     delay(2000);
     return true;
   } else {
@@ -165,6 +170,7 @@ bool connectToWiFi() {
     lcd.print("Connection Failed");
     lcd.setCursor(0, 1);
     lcd.print("Check & correct");
+    lcd.flush();
     delay(3000);
     return false;
   }
@@ -312,6 +318,7 @@ bool chooseWiFiConfigMethod() {
     } else {
       lcd.print("> Manual Config ");
     }
+    lcd.flush();
     
     // Check for encoder activity by monitoring the lastMenuActivity
     // which gets updated by the main encoder handler
@@ -0,0 +1,51 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+// A small Arduino String for the host builds. Like the real one it keeps its
+// text on the heap (malloc/realloc), so the allocation counter of
+// pio test -e native-alloccount sees every String a screen would create.
+#include <stdlib.h>
+#include <string.h>
+
+class String {
+public:
+  String() {}
+  String(const char* text) { assign(text); }
+  String(const String& other) { assign(other.c_str()); }
+  ~String() { free(buffer); }
+
+  String& operator=(const char* text) {
+    assign(text);
+    return *this;
+  }
+
+  String& operator=(const String& other) {
+    if (this != &other) assign(other.c_str());
+    return *this;
+  }
+
+  unsigned int length() const { return len; }
+  const char* c_str() const { return buffer ? buffer : ""; }
+  bool operator==(const char* text) const { return strcmp(c_str(), text) == 0; }
+
+private:
+  void assign(const char* text) {
+    unsigned int n = text ? strlen(text) : 0;
+    if (n + 1 > capacity) {
+      char* grown = (char*)realloc(buffer, n + 1);
+      if (!grown) return;
+      buffer = grown;
+      capacity = n + 1;
+    }
+    if (buffer) {
+      memcpy(buffer, text ? text : "", n + 1);
+      len = n;
+    }
+  }
+
+  char* buffer = nullptr;
+  unsigned int capacity = 0;
+  unsigned int len = 0;
+};
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HOST_ASYNCHTTPREQUEST_H
+#define HOST_ASYNCHTTPREQUEST_H
+
+// weather.h only needs the type for its callback declarations
+class asyncHTTPrequest;
+
+#endif
@@ -0,0 +1,561 @@
+// Host tests of the screens composed by display_render.cpp: pio test -e native-alloccount -v
+// Every screen is checked for its text and, with the malloc wraps linked in,
+// for composing without a single heap allocation.
+#include <unity.h>
+#include <stdio.h>
+#include <new>
+#include "display_render.h"
+#include "settings.h"
+#include "menu.h"
+#include "alarm.h"
+#include "weather.h"
+
+// State the screens read, set by each test
+bool isStreaming = false;
+String currentStreamName;
+bool showVolumeDisplay = false;
+String currentTrackInfo;
+bool hasTrackInfo = false;
+bool showTrackInfo = false;
+unsigned long lastTrackToggle = 0;
+int trackScrollPosition = 0;
+unsigned long lastTrackScroll = 0;
+String temporaryMessage;
+
+String ssid;
+String password;
+String weatherApiKey;
+volatile int volume = 0;
+int currentStream = 0;
+bool backlightAlwaysOn = false;
+bool radioPowerOn = false;
+bool levelMeterEnabled = false;
+Alarm alarms[5];
+
+MenuState currentMenu = MENU_SLEEP;
+SleepMenuState currentSleepMenu = SLEEP_MENU_BLANK;
+WiFiMenuState currentWiFiMenu = WIFI_MENU_IP;
+WeatherMenuState currentWeatherMenu = WEATHER_MENU_TEMPERATURE;
+SystemMenuState currentSystemMenu = SYSTEM_MENU_FIRMWARE;
+AlarmMenuState currentAlarmMenu = ALARM_MENU_SLOT1;
+AlarmSubMenuState currentAlarmSubMenu = ALARM_SUB_BACK;
+int currentAlarmSlot = 0;
+bool inAlarmSubMenu = false;
+bool editingAlarmOption = false;
+bool editingTime = false;
+bool editingHours = false;
+bool editingMinutes = false;
+bool showingConfirmation = false;
+bool confirmationChoice = false;
+RadioStream menuStreams[MAX_MENU_STREAMS];
+int menuStreamCount = 0;
+bool streamPaused = false;
+bool sleepTimerActive = false;
+
+int activeAlarmIndex = -1;
+WeatherData currentWeather;
+
+int getSnoozingAlarmIndex() {
+  for (int i = 0; i < MAX_ALARMS; i++) {
+    if (alarms[i].isSnoozing) return i;
+  }
+  return -1;
+}
+
+#ifdef ALLOC_COUNTER
+// Calls from the code under test are redirected here by -Wl,--wrap (GNU ld)
+static volatile bool counting = false;
+static volatile uint32_t allocations = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  if (counting) allocations++;
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  if (counting) allocations++;
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  if (counting) allocations++;
+  return __real_realloc(ptr, size);
+}
+}
+
+// The C++ runtime's operator new calls malloc from inside a shared library,
+// out of reach of the wraps, so count it here
+void* operator new(size_t size) {
+  if (counting) allocations++;
+  void* ptr = __real_malloc(size ? size : 1);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+#endif
+
+static DisplayRows rows;
+static DisplayInputs inputs;
+
+static void beginFrame() {
+#ifdef ALLOC_COUNTER
+  allocations = 0;
+  counting = true;
+#endif
+}
+
+static void endFrame() {
+#ifdef ALLOC_COUNTER
+  counting = false;
+  TEST_ASSERT_EQUAL_UINT32(0, allocations);
+#endif
+}
+
+static DisplayRowsContent renderMain() {
+  beginFrame();
+  DisplayRowsContent content = composeMainScreen(rows, inputs);
+  endFrame();
+  return content;
+}
+
+static void renderMenu() {
+  beginFrame();
+  composeMenuScreen(rows, inputs);
+  endFrame();
+}
+
+static void assertRow(const char* expected, bool center, int row) {
+  const LcdLine& line = rows.line[row];
+  if (strlen(expected) != line.length || memcmp(expected, line.text, line.length) != 0) {
+    char message[80];
+    snprintf(message, sizeof(message), "row %d is \"%.*s\"", row, (int)line.length, line.text);
+    TEST_MESSAGE(message);
+  }
+  TEST_ASSERT_EQUAL_INT(strlen(expected), line.length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, line.text, line.length);
+  TEST_ASSERT_EQUAL_INT(center, rows.center[row]);
+}
+
+void setUp() {
+  isStreaming = false;
+  currentStreamName = "Radio 1";
+  showVolumeDisplay = false;
+  currentTrackInfo = "";
+  hasTrackInfo = false;
+  showTrackInfo = false;
+  lastTrackToggle = millis();
+  trackScrollPosition = 0;
+  lastTrackScroll = millis();
+  temporaryMessage = "";
+
+  ssid = "HomeNetwork";
+  password = "secret";
+  weatherApiKey = "";
+  volume = 12;
+  currentStream = 0;
+  backlightAlwaysOn = false;
+  radioPowerOn = false;
+  levelMeterEnabled = false;
+  for (int i = 0; i < MAX_ALARMS; i++) alarms[i] = Alarm();
+
+  currentMenu = MENU_SLEEP;
+  inAlarmSubMenu = false;
+  editingAlarmOption = false;
+  editingTime = false;
+  editingHours = false;
+  editingMinutes = false;
+  showingConfirmation = false;
+  strcpy(menuStreams[0].name, "Radio 1");
+  strcpy(menuStreams[1].name, "Jazz FM");
+  menuStreamCount = 2;
+  streamPaused = false;
+  sleepTimerActive = false;
+  activeAlarmIndex = -1;
+  currentWeather.valid = false;
+
+  memset(&inputs, 0, sizeof(inputs));
+  inputs.time.tm_hour = 7;
+  inputs.time.tm_min = 5;
+  inputs.timeValid = true;
+}
+
+void tearDown() {}
+
+// The wraps and the operator new above are linked in: each of these is counted
+static void test_allocations_are_counted() {
+#ifdef ALLOC_COUNTER
+  beginFrame();
+  void* volatile probe = malloc(16);
+  counting = false;
+  free(probe);
+  TEST_ASSERT_EQUAL_UINT32(1, allocations);
+
+  beginFrame();
+  String copy = String("a String of some length");
+  counting = false;
+  TEST_ASSERT_TRUE(allocations >= 1);
+
+  beginFrame();
+  int* volatile object = new int(1);
+  counting = false;
+  delete object;
+  TEST_ASSERT_EQUAL_UINT32(1, allocations);
+#else
+  TEST_MESSAGE("Allocations are only counted in the native-alloccount environment");
+#endif
+}
+
+static void test_clock_screen() {
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ROWS_TEXT, renderMain());
+  assertRow("07:05           ", false, 0);
+  assertRow("Radio OFF", true, 1);
+
+  // Weather on the right, alarm clock and sleep indicators in between
+  weatherApiKey = "key";
+  currentWeather.valid = true;
+  currentWeather.temperature = -2.6f;
+  currentWeather.icon = "\x13";
+  alarms[2].enabled = true;
+  sleepTimerActive = true;
+  inputs.time.tm_hour = 23;
+  inputs.time.tm_min = 59;
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ROWS_TEXT, renderMain());
+  assertRow("23:59 \x14 Z  -3\x11" "C\x13", false, 0);
+
+  // Weather not fetched yet
+  currentWeather.valid = false;
+  renderMain();
+  assertRow("23:59 \x14 Z    ?\x11" "C", false, 0);
+
+  // Radio on, waiting for the stream
+  radioPowerOn = true;
+  renderMain();
+  assertRow("", false, 1);
+
+  // Clock not set yet: nothing to draw
+  inputs.timeValid = false;
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ROWS_NONE, renderMain());
+}
+
+static void test_playback_screen() {
+  radioPowerOn = true;
+  isStreaming = true;
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ROWS_TEXT, renderMain());
+  assertRow("07:05           ", false, 0);
+  assertRow("Radio 1", true, 1);
+
+  // Playing behind live after a pause
+  inputs.behindLive = true;
+  inputs.behindLiveMs = 754000;
+  renderMain();
+  assertRow("-12:34 Radio 1", true, 1);
+  inputs.behindLive = false;
+
+  // Track info shown instead of the station, short titles are not scrolled
+  currentTrackInfo = "Artist - Song";
+  hasTrackInfo = true;
+  showTrackInfo = true;
+  renderMain();
+  assertRow("Artist - Song", false, 1);
+
+  // Long titles scroll, 16 characters from the scroll position
+  currentTrackInfo = "A long artist name - A long song title";
+  trackScrollPosition = 3;
+  renderMain();
+  assertRow("ong artist name ", false, 1);
+
+  // Near the end the last 16 characters stay put
+  trackScrollPosition = 25;
+  renderMain();
+  assertRow(" long song title", false, 1);
+}
+
+static void test_paused_screen() {
+  radioPowerOn = true;
+  isStreaming = true;
+  streamPaused = true;
+  inputs.behindLive = true;
+  inputs.behindLiveMs = 125000;
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ROWS_TEXT, renderMain());
+  assertRow("07:05           ", false, 0);
+  assertRow("PAUSED -2:05", true, 1);
+
+  // The pause screen wins over the level meter
+  levelMeterEnabled = true;
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ROWS_TEXT, renderMain());
+  assertRow("PAUSED -2:05", true, 1);
+}
+
+static void test_alarm_screens() {
+  radioPowerOn = true;
+  isStreaming = true;
+  activeAlarmIndex = 1;
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ROWS_TEXT, renderMain());
+  assertRow("ALARM 2  STOP\x15", false, 0);
+  assertRow("Radio 1", true, 1);
+
+  // Snoozing, with the time on the first row
+  activeAlarmIndex = -1;
+  alarms[3].isSnoozing = true;
+  alarms[3].snoozeStart = millis() - 59500;
+  renderMain();
+  assertRow("07:05           ", false, 0);
+  assertRow("SNOOZE    09:00", false, 1);
+
+  // Snooze over: back to playback
+  alarms[3].snoozeStart = millis() - ALARM_SNOOZE_MINUTES * 60 * 1000UL - 1;
+  renderMain();
+  assertRow("Radio 1", true, 1);
+}
+
+static void test_volume_and_message_screens() {
+  beginFrame();
+  composeVolumeScreen(rows);
+  endFrame();
+  assertRow("Volume", true, 0);
+  assertRow("Level: 12", true, 1);
+
+  temporaryMessage = "Alarm 1 set";
+  beginFrame();
+  composeTemporaryMessage(rows);
+  endFrame();
+  assertRow("ALARM", true, 0);
+  assertRow("Alarm 1 set", true, 1);
+}
+
+static void test_level_meter_row() {
+  radioPowerOn = true;
+  isStreaming = true;
+  levelMeterEnabled = true;
+  TEST_ASSERT_EQUAL_INT(DISPLAY_ROWS_LEVEL_METER, renderMain());
+  assertRow("07:05           ", false, 0);
+
+  LevelMeterLevels levels = { -25.5f, -12.0f };
+  uint8_t cells[LCD_COLS];
+  beginFrame();
+  composeLevelMeterRow(levels, cells);
+  endFrame();
+  const uint8_t expected[LCD_COLS] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, METER_CHAR_HALF,
+    ' ', ' ', ' ', ' ', METER_CHAR_PEAK, ' ', ' ', ' '
+  };
+  TEST_ASSERT_EQUAL_MEMORY(expected, cells, LCD_COLS);
+
+  // Silence: empty bar, no peak marker
+  levels.rmsDb = LEVEL_METER_FLOOR_DB;
+  levels.peakDb = LEVEL_METER_FLOOR_DB;
+  beginFrame();
+  composeLevelMeterRow(levels, cells);
+  endFrame();
+  TEST_ASSERT_EQUAL_MEMORY("                ", cells, LCD_COLS);
+}
+
+static void test_sleep_and_station_menus() {
+  static const char* const sleepRows[SLEEP_MENU_COUNT] = {
+    "", "OFF", "15 minutes", "30 minutes", "60 minutes", "90 minutes", "5 minutes"
+  };
+  currentMenu = MENU_SLEEP;
+  for (int i = 0; i < SLEEP_MENU_COUNT; i++) {
+    currentSleepMenu = (SleepMenuState)i;
+    renderMenu();
+    assertRow("MENU: Sleep", false, 0);
+    assertRow(sleepRows[i], false, 1);
+  }
+
+  currentMenu = MENU_STREAMS;
+  currentStream = 1;
+  renderMenu();
+  assertRow("MENU: Station", false, 0);
+  assertRow("Jazz FM", false, 1);
+
+  currentMenu = MENU_BRIGHTNESS;
+  renderMenu();
+  assertRow("MENU: Backlight", false, 0);
+  assertRow("Mode: AUTO OFF", false, 1);
+  backlightAlwaysOn = true;
+  renderMenu();
+  assertRow("Mode: ALWAYS ON", false, 1);
+}
+
+static void test_wifi_menu() {
+  currentMenu = MENU_WIFI;
+  currentWiFiMenu = WIFI_MENU_IP;
+  renderMenu();
+  assertRow("MENU: WiFi", false, 0);
+  assertRow("Not connected", false, 1);
+
+  inputs.wifiConnected = true;
+  const uint8_t ip[4] = { 192, 168, 1, 42 };
+  memcpy(inputs.ip, ip, sizeof(ip));
+  renderMenu();
+  assertRow("192.168.1.42", false, 1);
+
+  currentWiFiMenu = WIFI_MENU_SSID;
+  renderMenu();
+  assertRow("SSID: HomeNetwor", false, 1);
+
+  currentWiFiMenu = WIFI_MENU_PASSWORD;
+  renderMenu();
+  assertRow("PASS: *****", false, 1);
+  password = "";
+  renderMenu();
+  assertRow("PASS: ", false, 1);
+
+  currentWiFiMenu = WIFI_MENU_RESET;
+  renderMenu();
+  assertRow("Reset WiFi", false, 1);
+
+  showingConfirmation = true;
+  confirmationChoice = true;
+  renderMenu();
+  assertRow("Reset WiFi?", false, 0);
+  assertRow("> YES    NO", false, 1);
+  confirmationChoice = false;
+  renderMenu();
+  assertRow("  YES  > NO", false, 1);
+}
+
+static void test_weather_and_system_menus() {
+  currentMenu = MENU_WEATHER;
+  static const char* const unknownRows[WEATHER_MENU_COUNT] = {
+    "TEMP: --", "HUM: --", "DESC: --", "API: NOT SET", "Update Weather"
+  };
+  for (int i = 0; i < WEATHER_MENU_COUNT; i++) {
+    currentWeatherMenu = (WeatherMenuState)i;
+    renderMenu();
+    assertRow("MENU: Weather", false, 0);
+    assertRow(unknownRows[i], false, 1);
+  }
+
+  currentWeather.valid = true;
+  currentWeather.temperature = 21.7f;
+  currentWeather.humidity = 64;
+  currentWeather.description = "scattered clouds";
+  weatherApiKey = "key";
+  static const char* const validRows[WEATHER_MENU_COUNT] = {
+    "TEMP: 21C", "HUM: 64%", "DESC: scattered ", "API: SET", "Update Weather"
+  };
+  for (int i = 0; i < WEATHER_MENU_COUNT; i++) {
+    currentWeatherMenu = (WeatherMenuState)i;
+    renderMenu();
+    assertRow(validRows[i], false, 1);
+  }
+
+  currentMenu = MENU_SYSTEM;
+  currentSystemMenu = SYSTEM_MENU_FIRMWARE;
+  renderMenu();
+  assertRow("MENU: System", false, 0);
+  assertRow("Firm: " FIRMWARE_VERSION, false, 1);
+  currentSystemMenu = SYSTEM_MENU_UPDATE;
+  renderMenu();
+  assertRow("Update", false, 1);
+}
+
+static void test_alarm_menus() {
+  currentMenu = MENU_ALARMS;
+  alarms[1].enabled = true;
+  static const char* const slotRows[ALARM_MENU_COUNT] = {
+    "Slot 1/5", "Slot 2/5    ON", "Slot 3/5", "Slot 4/5", "Slot 5/5", ""
+  };
+  for (int i = 0; i < ALARM_MENU_COUNT; i++) {
+    currentAlarmMenu = (AlarmMenuState)i;
+    renderMenu();
+    assertRow("Alarms", false, 0);
+    assertRow(slotRows[i], false, 1);
+  }
+
+  inAlarmSubMenu = true;
+  currentAlarmSlot = 1;
+  alarms[1].hour = 6;
+  alarms[1].minute = 5;
+  alarms[1].stationIndex = 1;
+  alarms[1].schedule = ALARM_WEEKDAYS;
+  alarms[1].maxVolume = 25;
+  alarms[1].autoOff = AUTO_OFF_30MIN;
+  static const char* const subRows[ALARM_SUB_COUNT][2] = {
+    { "2: ON", "< BACK" },
+    { "2: Enable", "YES" },
+    { "2: Time", "06:05" },
+    { "2: Station", "Jazz FM" },
+    { "2: Schedule", "Weekdays" },
+    { "2: Volume", "25" },
+    { "2: Auto Off", "30 minutes" }
+  };
+  for (int i = 0; i < ALARM_SUB_COUNT; i++) {
+    currentAlarmSubMenu = (AlarmSubMenuState)i;
+    renderMenu();
+    assertRow(subRows[i][0], false, 0);
+    assertRow(subRows[i][1], false, 1);
+  }
+
+  // Editing marker, the unknown station and the remaining options
+  editingAlarmOption = true;
+  currentAlarmSubMenu = ALARM_SUB_STATION;
+  alarms[1].stationIndex = 7;
+  renderMenu();
+  assertRow("2: Station   *", false, 0);
+  assertRow("Unknown", false, 1);
+
+  static const char* const scheduleRows[ALARM_SCHEDULE_COUNT] = { "Daily", "Weekdays", "Weekends", "Once" };
+  currentAlarmSubMenu = ALARM_SUB_SCHEDULE;
+  for (int i = 0; i < ALARM_SCHEDULE_COUNT; i++) {
+    alarms[1].schedule = (AlarmSchedule)i;
+    renderMenu();
+    assertRow(scheduleRows[i], false, 1);
+  }
+
+  static const char* const autoOffRows[AUTO_OFF_COUNT] = {
+    "NO", "15 minutes", "30 minutes", "60 minutes", "90 minutes", "5 minutes"
+  };
+  currentAlarmSubMenu = ALARM_SUB_AUTO_OFF;
+  for (int i = 0; i < AUTO_OFF_COUNT; i++) {
+    alarms[1].autoOff = (AlarmAutoOff)i;
+    renderMenu();
+    assertRow(autoOffRows[i], false, 1);
+  }
+
+  // Time editing blinks the field being edited every 500 ms
+  currentAlarmSubMenu = ALARM_SUB_TIME;
+  editingTime = true;
+  editingHours = true;
+  renderMenu();
+  assertRow("2: Time      *", false, 0);
+  bool hoursShown = rows.line[1].length == 5 && memcmp(rows.line[1].text, "06:05", 5) == 0;
+  bool hoursBlank = rows.line[1].length == 5 && memcmp(rows.line[1].text, "  :05", 5) == 0;
+  TEST_ASSERT_TRUE(hoursShown || hoursBlank);
+
+  editingHours = false;
+  editingMinutes = true;
+  renderMenu();
+  bool minutesShown = rows.line[1].length == 5 && memcmp(rows.line[1].text, "06:05", 5) == 0;
+  bool minutesBlank = rows.line[1].length == 5 && memcmp(rows.line[1].text, "06:  ", 5) == 0;
+  TEST_ASSERT_TRUE(minutesShown || minutesBlank);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_allocations_are_counted);
+  RUN_TEST(test_clock_screen);
+  RUN_TEST(test_playback_screen);
+  RUN_TEST(test_paused_screen);
+  RUN_TEST(test_alarm_screens);
+  RUN_TEST(test_volume_and_message_screens);
+  RUN_TEST(test_level_meter_row);
+  RUN_TEST(test_sleep_and_station_menus);
+  RUN_TEST(test_wifi_menu);
+  RUN_TEST(test_weather_and_system_menus);
+  RUN_TEST(test_alarm_menus);
+  return UNITY_END();
+}
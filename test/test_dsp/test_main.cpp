@@ -0,0 +1,359 @@
+// Host tests and micro-benchmarks of the PCM kernels: pio test -e native -v
+#include <unity.h>
+#include <stdio.h>
+#include "gain_ramp.h"
+#include "level_meter.h"
+#include "tone_control.h"
+#include "asrc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_CYCLE_COUNTER 1
+#endif
+
+#define BENCH_FRAMES 1152             // One MP3 frame of stereo PCM, as on the device
+#define BENCH_RUNS 200                // Best of N, to hide scheduling and cache misses
+#define ASRC_QUALITY_FRAMES 4096      // Output frames analysed per tone
+#define ASRC_QUALITY_SETTLE 256       // Output frames skipped while the filter fills
+#define ASRC_QUALITY_PPM 200          // Correction applied during the test, as when tracking drift
+#define ASRC_MAX_THD_N_DB -75.0       // Worst tone allowed; about -80 dB measured at 15-18 kHz
+
+static int16_t buffer[BENCH_FRAMES * 2];
+
+// Deterministic full-scale noise, the same as the on-device benchmark
+static void fillNoise(int16_t* buff, uint32_t samples) {
+  uint32_t seed = 12345;
+  for (uint32_t i = 0; i < samples; i++) {
+    seed = seed * 1664525 + 1013904223;
+    buff[i] = (int16_t)(seed >> 16);
+  }
+}
+
+typedef void (*BenchStep)();
+
+// Best of BENCH_RUNS; setup runs before every timed call and is not counted
+static void bench(const char* name, BenchStep setup, BenchStep kernel, uint32_t samples) {
+  double bestNs = 1e30;
+  uint64_t bestCycles = UINT64_MAX;
+  for (int run = 0; run < BENCH_RUNS; run++) {
+    setup();
+    auto start = std::chrono::steady_clock::now();
+#ifdef BENCH_HAS_CYCLE_COUNTER
+    uint64_t startCycles = __rdtsc();
+#endif
+    kernel();
+#ifdef BENCH_HAS_CYCLE_COUNTER
+    uint64_t cycles = __rdtsc() - startCycles;
+    if (cycles < bestCycles) bestCycles = cycles;
+#endif
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (ns < bestNs) bestNs = ns;
+  }
+
+  char message[128];
+#ifdef BENCH_HAS_CYCLE_COUNTER
+  snprintf(message, sizeof(message), "%s: %.2f cycles/sample (TSC), %.2f ns/sample",
+           name, (double)bestCycles / samples, bestNs / samples);
+#else
+  snprintf(message, sizeof(message), "%s: %.2f ns/sample", name, bestNs / samples);
+#endif
+  TEST_MESSAGE(message);
+}
+
+// Interleaved stereo sine, continuing from *phase
+static void fillSine(int16_t* buff, uint32_t frames, double frequency, uint32_t rate, double amplitude, double* phase) {
+  for (uint32_t i = 0; i < frames; i++) {
+    int16_t v = (int16_t)lround(amplitude * sin(*phase));
+    buff[i * 2] = v;
+    buff[i * 2 + 1] = v;
+    *phase += 2.0 * M_PI * frequency / rate;
+  }
+}
+
+static double rmsOfLeft(const int16_t* buff, uint32_t frames) {
+  double sum = 0;
+  for (uint32_t i = 0; i < frames; i++) sum += (double)buff[i * 2] * buff[i * 2];
+  return sqrt(sum / frames);
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Gain ramp
+
+static GainRamp benchRamp;
+
+static void test_volume_table() {
+  TEST_ASSERT_EQUAL_INT32(0, gainForVolume(0));
+  TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, gainForVolume(GAIN_VOLUME_MAX));
+  for (int vol = 1; vol <= GAIN_VOLUME_MAX; vol++) {
+    TEST_ASSERT_TRUE(gainForVolume(vol) > gainForVolume(vol - 1));
+  }
+  // Volume 1 is about GAIN_RANGE_DB below full scale
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, -GAIN_RANGE_DB, 20.0f * log10f(gainForVolume(1) / (float)GAIN_UNITY));
+}
+
+static void test_gain_ramp_reaches_target() {
+  GainRamp ramp;
+  gainRampInit(ramp, 40);
+  gainRampSetTarget(ramp, 60, BENCH_FRAMES * 3);
+
+  // The per-frame step is rounded down, the last block finishes the ramp
+  int32_t previous = ramp.gain;
+  for (int block = 0; block < 4; block++) {
+    fillNoise(buffer, BENCH_FRAMES * 2);
+    gainRampProcess(ramp, buffer, BENCH_FRAMES);
+    TEST_ASSERT_TRUE(ramp.gain >= previous);
+    previous = ramp.gain;
+  }
+  TEST_ASSERT_FALSE(gainRampActive(ramp));
+  TEST_ASSERT_EQUAL_INT32(gainForVolume(60), ramp.gain);
+}
+
+static void test_gain_unity_and_mute() {
+  int16_t expected[BENCH_FRAMES * 2];
+  GainRamp ramp;
+
+  gainRampInit(ramp, GAIN_VOLUME_MAX);
+  fillNoise(buffer, BENCH_FRAMES * 2);
+  memcpy(expected, buffer, sizeof(expected));
+  gainRampProcess(ramp, buffer, BENCH_FRAMES);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(expected, buffer, BENCH_FRAMES * 2);
+
+  gainRampInit(ramp, 0);
+  gainRampProcess(ramp, buffer, BENCH_FRAMES);
+  memset(expected, 0, sizeof(expected));
+  TEST_ASSERT_EQUAL_INT16_ARRAY(expected, buffer, BENCH_FRAMES * 2);
+}
+
+static void setupGainConstant() {
+  fillNoise(buffer, BENCH_FRAMES * 2);
+  gainRampInit(benchRamp, 60);
+}
+
+static void setupGainRamp() {
+  fillNoise(buffer, BENCH_FRAMES * 2);
+  gainRampInit(benchRamp, 40);
+  gainRampSetTarget(benchRamp, 60, BENCH_FRAMES * 4); // Still ramping at the end of the block
+}
+
+static void runGainRamp() {
+  gainRampProcess(benchRamp, buffer, BENCH_FRAMES);
+}
+
+static void test_gain_benchmark() {
+  bench("gainConstant", setupGainConstant, runGainRamp, BENCH_FRAMES * 2);
+  bench("gainRamp", setupGainRamp, runGainRamp, BENCH_FRAMES * 2);
+}
+
+// Level meter
+
+static uint32_t benchRms, benchPeak;
+
+static void test_level_meter_measure() {
+  uint32_t rms, peak;
+  memset(buffer, 0, sizeof(buffer));
+  levelMeterMeasure(buffer, BENCH_FRAMES, rms, peak);
+  TEST_ASSERT_EQUAL_UINT32(0, rms);
+  TEST_ASSERT_EQUAL_UINT32(0, peak);
+
+  // Full-scale square wave: RMS and peak are both 32768
+  for (int i = 0; i < BENCH_FRAMES * 2; i++) {
+    buffer[i] = (i / 2) % 2 ? 32767 : -32768;
+  }
+  levelMeterMeasure(buffer, BENCH_FRAMES, rms, peak);
+  TEST_ASSERT_EQUAL_UINT32(32768, peak);
+  TEST_ASSERT_TRUE(rms >= 32767 && rms <= 32768);
+
+  // Measuring leaves the meter the display reads untouched
+  LevelMeterLevels levels;
+  levelMeterFrame(levels);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, LEVEL_METER_FLOOR_DB, levels.rmsDb);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, LEVEL_METER_FLOOR_DB, levels.peakDb);
+}
+
+static void setupNoise() {
+  fillNoise(buffer, BENCH_FRAMES * 2);
+}
+
+static void runLevelMeter() {
+  levelMeterMeasure(buffer, BENCH_FRAMES, benchRms, benchPeak);
+}
+
+static void test_level_meter_benchmark() {
+  bench("levelMeter", setupNoise, runLevelMeter, BENCH_FRAMES * 2);
+}
+
+// Tone control
+
+static ToneControl benchTone; // Holds a 1 KB scratch buffer
+
+static void test_tone_flat_is_bypassed() {
+  const int8_t flat[TONE_BANDS] = {0, 0, 0};
+  int16_t expected[BENCH_FRAMES * 2];
+  toneControlInit(benchTone);
+  toneControlConfigure(benchTone, flat, 44100);
+  TEST_ASSERT_FALSE(benchTone.active);
+
+  fillNoise(buffer, BENCH_FRAMES * 2);
+  memcpy(expected, buffer, sizeof(expected));
+  toneControlProcess(benchTone, buffer, BENCH_FRAMES);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(expected, buffer, BENCH_FRAMES * 2);
+}
+
+// Gain in dB of one band setting for a sine, measured after the filter settles
+static double toneGainDb(const int8_t* gains, double frequency) {
+  toneControlInit(benchTone);
+  toneControlConfigure(benchTone, gains, 44100);
+  double phase = 0;
+  double in = 0, out = 0;
+  for (int block = 0; block < 8; block++) {
+    fillSine(buffer, BENCH_FRAMES, frequency, 44100, 4000.0, &phase);
+    in = rmsOfLeft(buffer, BENCH_FRAMES);
+    toneControlProcess(benchTone, buffer, BENCH_FRAMES);
+    out = rmsOfLeft(buffer, BENCH_FRAMES);
+  }
+  return 20.0 * log10(out / in);
+}
+
+static void test_tone_band_gains() {
+  const int8_t bass[TONE_BANDS] = {6, 0, 0};
+  const int8_t mid[TONE_BANDS] = {0, -6, 0};
+  const int8_t treble[TONE_BANDS] = {0, 0, 6};
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 6.0, toneGainDb(bass, 40));
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 0.0, toneGainDb(bass, 5000));
+  TEST_ASSERT_FLOAT_WITHIN(0.5, -6.0, toneGainDb(mid, 1000));
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 6.0, toneGainDb(treble, 16000));
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 0.0, toneGainDb(treble, 200));
+}
+
+static void setupTone() {
+  const int8_t gains[TONE_BANDS] = {6, -3, 4}; // Every band active
+  fillNoise(buffer, BENCH_FRAMES * 2);
+  toneControlInit(benchTone);
+  toneControlConfigure(benchTone, gains, 44100);
+}
+
+static void runTone() {
+  toneControlProcess(benchTone, buffer, BENCH_FRAMES);
+}
+
+static void test_tone_benchmark() {
+  bench("toneControl", setupTone, runTone, BENCH_FRAMES * 2);
+}
+
+// Sample-rate converter
+
+static Asrc benchAsrc; // Table and history are several KB
+static int16_t asrcOut[256 * 2];
+static int16_t qualityOut[ASRC_QUALITY_FRAMES]; // Left channel of the analysed output
+
+// Least-squares fit of a sine at the expected frequency plus DC; THD+N is the
+// residual (everything but the fitted sine) relative to it
+static double thdNDb(const int16_t* y, uint32_t n, double omega) {
+  double ss = 0, sc = 0, s1 = 0, cc = 0, c1 = 0, ys = 0, yc = 0, y1 = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    double s = sin(omega * i), c = cos(omega * i);
+    ss += s * s; sc += s * c; s1 += s; cc += c * c; c1 += c;
+    ys += y[i] * s; yc += y[i] * c; y1 += y[i];
+  }
+  // Normal equations [ss sc s1; sc cc c1; s1 c1 n] [a b d] = [ys yc y1], by Cramer's rule
+  double m = n;
+  double det = ss * (cc * m - c1 * c1) - sc * (sc * m - c1 * s1) + s1 * (sc * c1 - cc * s1);
+  double a = (ys * (cc * m - c1 * c1) - sc * (yc * m - c1 * y1) + s1 * (yc * c1 - cc * y1)) / det;
+  double b = (ss * (yc * m - c1 * y1) - ys * (sc * m - c1 * s1) + s1 * (sc * y1 - yc * s1)) / det;
+  double d = (ss * (cc * y1 - yc * c1) - sc * (sc * y1 - yc * s1) + ys * (sc * c1 - cc * s1)) / det;
+
+  double residual = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    double e = y[i] - (a * sin(omega * i) + b * cos(omega * i) + d);
+    residual += e * e;
+  }
+  double signal = (a * a + b * b) / 2 * n;
+  return 10.0 * log10(residual / signal);
+}
+
+// A 44.1 kHz sine at -1 dBFS through the converter to ASRC_OUTPUT_RATE with a
+// drift correction applied, compared with an ideal sine at the shifted frequency
+static double asrcThdNDb(uint32_t frequency) {
+  const uint32_t inputRate = 44100;
+  asrcInit(benchAsrc, ASRC_OUTPUT_RATE);
+  asrcConfigure(benchAsrc, inputRate);
+  asrcSetCorrection(benchAsrc, ASRC_QUALITY_PPM);
+
+  double phase = 0;
+  double amplitude = 32767.0 * pow(10.0, -1.0 / 20.0);
+  uint32_t produced = 0;
+  while (produced < ASRC_QUALITY_SETTLE + ASRC_QUALITY_FRAMES) {
+    fillSine(buffer, BENCH_FRAMES, frequency, inputRate, amplitude, &phase);
+    uint32_t done = 0;
+    while (done < BENCH_FRAMES) {
+      done += asrcWrite(benchAsrc, buffer + done * 2, BENCH_FRAMES - done);
+      uint32_t n;
+      while ((n = asrcRead(benchAsrc, asrcOut, 256)) > 0) {
+        for (uint32_t i = 0; i < n; i++, produced++) {
+          if (produced >= ASRC_QUALITY_SETTLE && produced < ASRC_QUALITY_SETTLE + ASRC_QUALITY_FRAMES) {
+            qualityOut[produced - ASRC_QUALITY_SETTLE] = asrcOut[i * 2];
+          }
+        }
+      }
+    }
+  }
+
+  // Consuming input faster by the correction raises the output frequency by as much
+  double omega = 2.0 * M_PI * frequency * (1.0 + ASRC_QUALITY_PPM * 1e-6) / ASRC_OUTPUT_RATE;
+  return thdNDb(qualityOut, ASRC_QUALITY_FRAMES, omega);
+}
+
+static void test_asrc_thd_n() {
+  static const uint32_t tones[] = {100, 1000, 5000, 10000, 15000, 18000};
+  for (uint32_t tone : tones) {
+    double db = asrcThdNDb(tone);
+    char message[64];
+    snprintf(message, sizeof(message), "asrc THD+N at %u Hz: %.1f dB", (unsigned)tone, db);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN_FLOAT(ASRC_MAX_THD_N_DB, db);
+  }
+}
+
+static uint32_t asrcBenchRate;
+
+static void setupAsrc() {
+  fillNoise(buffer, BENCH_FRAMES * 2);
+  asrcInit(benchAsrc, ASRC_OUTPUT_RATE);
+  asrcConfigure(benchAsrc, asrcBenchRate);
+  asrcSetCorrection(benchAsrc, ASRC_QUALITY_PPM);
+}
+
+static void runAsrc() {
+  uint32_t done = 0;
+  while (done < BENCH_FRAMES) {
+    done += asrcWrite(benchAsrc, buffer + done * 2, BENCH_FRAMES - done);
+    while (asrcRead(benchAsrc, asrcOut, 256) > 0) {
+    }
+  }
+}
+
+// Per input sample, so the figures compare with the other kernels
+static void test_asrc_benchmark() {
+  asrcBenchRate = 44100;
+  bench("asrc44to48", setupAsrc, runAsrc, BENCH_FRAMES * 2);
+  asrcBenchRate = 48000;
+  bench("asrc48to48", setupAsrc, runAsrc, BENCH_FRAMES * 2);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_volume_table);
+  RUN_TEST(test_gain_ramp_reaches_target);
+  RUN_TEST(test_gain_unity_and_mute);
+  RUN_TEST(test_gain_benchmark);
+  RUN_TEST(test_level_meter_measure);
+  RUN_TEST(test_level_meter_benchmark);
+  RUN_TEST(test_tone_flat_is_bypassed);
+  RUN_TEST(test_tone_band_gains);
+  RUN_TEST(test_tone_benchmark);
+  RUN_TEST(test_asrc_thd_n);
+  RUN_TEST(test_asrc_benchmark);
+  return UNITY_END();
+}
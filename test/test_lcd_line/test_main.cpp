@@ -0,0 +1,120 @@
+// Host tests of the LCD line composer: pio test -e native -v
+// The screens built from it are tested in test_display_render.
+#include <unity.h>
+#include <stdio.h>
+#include "lcd_line.h"
+#include "lcd_glyphs.h"
+
+#define GLYPH_DEGREE LCD_GLYPH_FIRST  // Any logical glyph code will do
+
+static void assertLine(const char* expected, const LcdLine& line) {
+  TEST_ASSERT_EQUAL_INT(strlen(expected), line.length);
+  TEST_ASSERT_EQUAL_MEMORY(expected, line.text, line.length);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_append_truncates_at_width() {
+  LcdLine line;
+  lineClear(line);
+  TEST_ASSERT_EQUAL_INT(0, line.length);
+
+  lineAppend(line, "Radio ");
+  lineAppendChar(line, '1');
+  assertLine("Radio 1", line);
+
+  lineAppend(line, " is a long station name");
+  assertLine("Radio 1 is a lon", line);
+  lineAppendChar(line, 'x');
+  lineAppendInt(line, 5);
+  assertLine("Radio 1 is a lon", line);
+
+  lineClear(line);
+  lineAppendN(line, "abcdef", 3);
+  lineAppendN(line, "gh", 10);
+  assertLine("abcgh", line);
+}
+
+static void test_append_int() {
+  LcdLine line;
+  lineClear(line);
+  lineAppendInt(line, 0);
+  lineAppendChar(line, ' ');
+  lineAppendInt(line, 7, 2);
+  lineAppendChar(line, ' ');
+  lineAppendInt(line, 123, 2);
+  lineAppendChar(line, ' ');
+  lineAppendInt(line, -5, 3);
+  assertLine("0 07 123 -005", line);
+
+  lineClear(line);
+  lineAppendInt(line, -2147483647L - 1);
+  assertLine("-2147483648", line);
+}
+
+static void test_pad_and_right_align() {
+  LcdLine line, right;
+  lineClear(line);
+  lineAppend(line, "12:30");
+  linePad(line, 8);
+  assertLine("12:30   ", line);
+  linePad(line, 4); // Never shortens
+  assertLine("12:30   ", line);
+  linePad(line, 40);
+  TEST_ASSERT_EQUAL_INT(LCD_LINE_CAPACITY, line.length);
+
+  lineClear(line);
+  lineAppend(line, "12:30");
+  lineClear(right);
+  lineAppend(right, "21C");
+  lineRightAlign(line, right);
+  assertLine("12:30        21C", line);
+
+  // Too long: one space is kept and the right part is cut
+  lineClear(line);
+  lineAppend(line, "12:30 Z");
+  lineClear(right);
+  lineAppend(right, "21C Cloudy");
+  lineRightAlign(line, right);
+  assertLine("12:30 Z 21C Clou", line);
+}
+
+static void test_center() {
+  LcdLine line;
+  lineClear(line);
+  lineAppend(line, "OFF");
+  lineCenter(line);
+  assertLine("      OFF", line);
+
+  lineClear(line);
+  lineAppend(line, "0123456789abcdef");
+  lineCenter(line);
+  assertLine("0123456789abcdef", line);
+
+  lineClear(line);
+  lineCenter(line);
+  assertLine("        ", line);
+}
+
+// Screens write logical glyph codes, resolved to CGRAM slots when the frame is flushed
+static void test_append_glyph() {
+  LcdLine line;
+  lineClear(line);
+  lineAppendInt(line, 21);
+  lineAppendGlyph(line, GLYPH_DEGREE);
+  lineAppendChar(line, 'C');
+  TEST_ASSERT_EQUAL_INT(4, line.length);
+  TEST_ASSERT_EQUAL_UINT8(GLYPH_DEGREE, (uint8_t)line.text[2]);
+  TEST_ASSERT_EQUAL_UINT8('C', (uint8_t)line.text[3]);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_append_truncates_at_width);
+  RUN_TEST(test_append_int);
+  RUN_TEST(test_pad_and_right_align);
+  RUN_TEST(test_center);
+  RUN_TEST(test_append_glyph);
+  return UNITY_END();
+}
@@ -0,0 +1,360 @@
+#!/usr/bin/env python3
+"""Local stand-in for an Internet radio station.
+
+Serves an audio file as an endless ICY stream, paced to a fixed bitrate, with
+optional jitter, stalls, dropped connections and redirect chains. Point the
+radio at it (see stream_bench.py) to measure connect and start-up behaviour
+without depending on a real station or the Internet. The same audio is also
+offered as a live HLS station, cut into segments as MPEG-TS or packed audio.
+
+Endpoints:
+  /stream            the stream itself (ICY metadata when the client asks for it)
+  /redirect/<n>      n chained 302 redirects ending at /stream
+  /playlist.pls      PLS playlist pointing at /stream
+  /playlist.m3u      M3U playlist pointing at /stream
+  /hls/master.m3u8   HLS master playlist with a single variant
+  /hls/live.m3u8     live HLS media playlist (sliding window)
+  /hls/<n>.ts|.aac   segment n (TS, or packed audio with an ID3 timestamp)
+
+Example:
+  python3 icy_standin.py --file test.mp3 --bitrate 128 --jitter-ms 40 --stall-every 60 --stall-for 3
+  python3 icy_standin.py --file test.aac --bitrate 64 --segment-s 6 --segment-delay-ms 300
+"""
+
+import argparse
+import os
+import random
+import socket
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+CONTENT_TYPES = {
+    ".mp3": "audio/mpeg",
+    ".aac": "audio/aac",
+    ".m4a": "audio/aac",
+    ".ogg": "application/ogg",
+    ".flac": "audio/flac",
+}
+
+CHUNK_MS = 50            # Pacing granularity
+TITLE_INTERVAL_S = 30    # How often the StreamTitle changes
+
+HLS_WINDOW = 6           # Segments listed in the live playlist
+TS_AUDIO_PID = 0x101
+TS_PMT_PID = 0x1000
+PES_CHUNK = 2048         # Audio bytes per PES packet
+
+args = None
+audio = b""
+hls_start = 0.0
+connection_ids = iter(range(1, 1 << 31))
+log_lock = threading.Lock()
+
+
+def log(message):
+    with log_lock:
+        print(time.strftime("%H:%M:%S"), message, flush=True)
+
+
+def icy_metadata_block(title):
+    text = "StreamTitle='{}';".format(title.replace("'", "")).encode("utf-8")
+    blocks = (len(text) + 15) // 16
+    return bytes([blocks]) + text.ljust(blocks * 16, b"\0")
+
+
+def mpeg_crc32(data):
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc ^= byte << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) & 0xFFFFFFFF if crc & 0x80000000 else (crc << 1) & 0xFFFFFFFF
+    return crc
+
+
+def psi_section(table_id, table_ext, body):
+    length = 5 + len(body) + 4
+    section = bytes([table_id, 0xB0 | (length >> 8), length & 0xFF,
+                     table_ext >> 8, table_ext & 0xFF, 0xC1, 0x00, 0x00]) + body
+    return section + mpeg_crc32(section).to_bytes(4, "big")
+
+
+def ts_packets(pid, payload, counters):
+    """Split payload into TS packets, stuffing the last one with an adaptation field."""
+    out = bytearray()
+    first = True
+    while payload or first:
+        take = payload[:184]
+        payload = payload[184:]
+        cc = counters.get(pid, 0)
+        counters[pid] = (cc + 1) & 0x0F
+        header = bytes([0x47, (0x40 if first else 0) | (pid >> 8), pid & 0xFF])
+        if len(take) == 184:
+            out += header + bytes([0x10 | cc]) + take
+        else:
+            stuffing = 183 - len(take)
+            adaptation = bytes([stuffing]) + (bytes([0x00]) + b"\xff" * (stuffing - 1) if stuffing > 0 else b"")
+            out += header + bytes([0x30 | cc]) + adaptation + take
+        first = False
+    return bytes(out)
+
+
+def pes_timestamp(pts):
+    return bytes([0x21 | ((pts >> 29) & 0x0E), (pts >> 22) & 0xFF, 0x01 | ((pts >> 14) & 0xFE),
+                  (pts >> 7) & 0xFF, 0x01 | ((pts << 1) & 0xFE)])
+
+
+def ts_segment(data, stream_type, pts):
+    counters = {}
+    pat = psi_section(0x00, 1, bytes([0x00, 0x01, 0xE0 | (TS_PMT_PID >> 8), TS_PMT_PID & 0xFF]))
+    pmt = psi_section(0x02, 1, bytes([0xE0 | (TS_AUDIO_PID >> 8), TS_AUDIO_PID & 0xFF, 0xF0, 0x00,
+                                      stream_type, 0xE0 | (TS_AUDIO_PID >> 8), TS_AUDIO_PID & 0xFF, 0xF0, 0x00]))
+    out = ts_packets(0, b"\x00" + pat, counters) + ts_packets(TS_PMT_PID, b"\x00" + pmt, counters)
+    for offset in range(0, len(data), PES_CHUNK):
+        chunk = data[offset:offset + PES_CHUNK]
+        header = bytes([0x80, 0x80, 5]) + pes_timestamp(pts)
+        pes = b"\x00\x00\x01\xC0" + (len(header) + len(chunk)).to_bytes(2, "big") + header + chunk
+        out += ts_packets(TS_AUDIO_PID, pes, counters)
+    return out
+
+
+def id3_timestamp(pts):
+    """ID3 tag with the HLS packed audio timestamp PRIV frame."""
+    owner = b"com.apple.streaming.transportStreamTimestamp\x00"
+    frame = owner + pts.to_bytes(8, "big")
+    body = b"PRIV" + len(frame).to_bytes(4, "big") + b"\x00\x00" + frame
+    size = len(body)
+    synchsafe = bytes([(size >> 21) & 0x7F, (size >> 14) & 0x7F, (size >> 7) & 0x7F, size & 0x7F])
+    return b"ID3\x04\x00\x00" + synchsafe + body
+
+
+def segment_audio(sequence):
+    """Audio bytes of segment n: the file cut at the bitrate, looping."""
+    size = args.bitrate * 1000 // 8 * args.segment_s
+    start = (sequence * size) % len(audio)
+    data = audio[start:start + size]
+    while len(data) < size:
+        data += audio[:size - len(data)]
+    return data
+
+
+def live_sequence():
+    """Newest complete segment."""
+    return max(0, int((time.monotonic() - hls_start) / args.segment_s) - 1)
+
+
+class StandInHandler(BaseHTTPRequestHandler):
+    server_version = "IcyStandIn/1.0"
+    protocol_version = "HTTP/1.1"  # Keep-alive, the HLS client reuses its connection
+
+    def log_message(self, fmt, *fmt_args):
+        pass  # Connections are logged with their timings instead
+
+    def base_url(self):
+        host = self.headers.get("Host") or "{}:{}".format(args.host, args.port)
+        return "http://" + host
+
+    def do_GET(self):
+        path = self.path.split("?", 1)[0]
+        if path == "/stream":
+            self.send_stream()
+        elif path.startswith("/redirect/"):
+            self.send_redirect(path)
+        elif path == "/playlist.pls":
+            body = "[playlist]\nNumberOfEntries=1\nFile1={}/stream\nTitle1=Stand-in\nLength1=-1\nVersion=2\n"
+            self.send_text("audio/x-scpls", body.format(self.base_url()))
+        elif path == "/playlist.m3u":
+            self.send_text("audio/x-mpegurl", "#EXTM3U\n{}/stream\n".format(self.base_url()))
+        elif path == "/hls/master.m3u8":
+            body = "#EXTM3U\n#EXT-X-STREAM-INF:BANDWIDTH={},CODECS=\"mp4a.40.2\"\nlive.m3u8\n"
+            self.send_text("application/vnd.apple.mpegurl", body.format(args.bitrate * 1000))
+        elif path == "/hls/live.m3u8":
+            self.send_hls_playlist()
+        elif path.startswith("/hls/"):
+            self.send_hls_segment(path[len("/hls/"):])
+        else:
+            self.send_error(404)
+
+    def send_text(self, content_type, body):
+        data = body.encode("utf-8")
+        self.send_response(200)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def send_hls_playlist(self):
+        newest = live_sequence()
+        first = max(0, newest - HLS_WINDOW + 1)
+        ext = "ts" if args.segment_format == "ts" else os.path.splitext(args.file)[1].lstrip(".")
+        lines = ["#EXTM3U", "#EXT-X-VERSION:3", "#EXT-X-TARGETDURATION:{}".format(args.segment_s),
+                 "#EXT-X-MEDIA-SEQUENCE:{}".format(first)]
+        for sequence in range(first, newest + 1):
+            lines.append("#EXTINF:{:.3f},".format(args.segment_s))
+            lines.append("{}.{}".format(sequence, ext))
+        self.send_text("application/vnd.apple.mpegurl", "\n".join(lines) + "\n")
+
+    def send_hls_segment(self, name):
+        try:
+            sequence = int(name.split(".", 1)[0])
+        except ValueError:
+            self.send_error(404)
+            return
+        if args.segment_delay_ms > 0:
+            time.sleep(args.segment_delay_ms / 1000.0)
+
+        data = segment_audio(sequence)
+        pts = (sequence * args.segment_s * 90000) & ((1 << 33) - 1)
+        if args.segment_format == "ts":
+            stream_type = 0x0F if os.path.splitext(args.file)[1].lower() in (".aac", ".m4a") else 0x03
+            body = ts_segment(data, stream_type, pts)
+            content_type = "video/mp2t"
+        else:
+            body = id3_timestamp(pts) + data
+            content_type = CONTENT_TYPES.get(os.path.splitext(args.file)[1].lower(), "audio/mpeg")
+
+        self.send_response(200)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+        log("segment {} ({} bytes) to {}".format(sequence, len(body), self.client_address[0]))
+
+    def send_redirect(self, path):
+        try:
+            remaining = int(path[len("/redirect/"):])
+        except ValueError:
+            self.send_error(400)
+            return
+        target = "/stream" if remaining <= 1 else "/redirect/{}".format(remaining - 1)
+        self.send_response(302)
+        self.send_header("Location", self.base_url() + target)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def send_stream(self):
+        conn_id = next(connection_ids)
+        started = time.monotonic()
+        if args.connect_delay_ms > 0:
+            time.sleep(args.connect_delay_ms / 1000.0)
+
+        metaint = args.metaint if self.headers.get("Icy-MetaData") == "1" else 0
+        self.send_response(200)
+        self.send_header("Content-Type", CONTENT_TYPES.get(os.path.splitext(args.file)[1].lower(), "audio/mpeg"))
+        self.send_header("icy-name", args.name)
+        self.send_header("icy-br", str(args.bitrate))
+        if metaint:
+            self.send_header("icy-metaint", str(metaint))
+        self.send_header("Cache-Control", "no-cache")
+        self.send_header("Connection", "close")
+        self.end_headers()
+        self.wfile.flush()
+        log("#{} {} connected ({}ms to headers, metaint={})".format(
+            conn_id, self.client_address[0], int((time.monotonic() - started) * 1000), metaint))
+
+        rng = random.Random(args.seed + conn_id if args.seed is not None else None)
+        bytes_per_sec = args.bitrate * 1000 // 8
+        chunk = max(1, bytes_per_sec * CHUNK_MS // 1000)
+        position = 0                 # Offset in the audio file
+        until_meta = metaint
+        sent = 0
+        stalls = 0
+
+        # The burst goes out unpaced, like the backlog a real server keeps per listener
+        burst = args.burst_kb * 1024
+        stream_start = time.monotonic()
+        next_stall = stream_start + args.stall_every if args.stall_every > 0 else None
+        reason = "client closed"
+
+        try:
+            while True:
+                now = time.monotonic()
+                if args.drop_after > 0 and now - stream_start >= args.drop_after:
+                    reason = "dropped"
+                    break
+                if next_stall is not None and now >= next_stall:
+                    stalls += 1
+                    log("#{} stalling for {}s".format(conn_id, args.stall_for))
+                    time.sleep(args.stall_for)
+                    next_stall = time.monotonic() + args.stall_every
+
+                data = audio[position:position + chunk]
+                if len(data) < chunk:
+                    data += audio[:chunk - len(data)]
+                position = (position + chunk) % len(audio)
+
+                out = bytearray()
+                if metaint:
+                    pos = 0
+                    while pos < len(data):
+                        n = min(len(data) - pos, until_meta)
+                        out += data[pos:pos + n]
+                        pos += n
+                        until_meta -= n
+                        if until_meta == 0:
+                            elapsed = int(time.monotonic() - stream_start)
+                            out += icy_metadata_block("{} - part {}".format(args.name, elapsed // TITLE_INTERVAL_S + 1))
+                            until_meta = metaint
+                else:
+                    out += data
+
+                self.wfile.write(out)
+                sent += len(data)
+
+                if sent <= burst:
+                    continue
+                # Pace the audio bytes to the bitrate, plus random delivery jitter
+                due = stream_start + (sent - burst) / bytes_per_sec
+                if args.jitter_ms > 0:
+                    due += rng.uniform(0, args.jitter_ms) / 1000.0
+                delay = due - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+        except (BrokenPipeError, ConnectionResetError, socket.timeout):
+            pass
+
+        log("#{} {}: {} audio bytes in {:.1f}s, {} stalls".format(
+            conn_id, reason, sent, time.monotonic() - started, stalls))
+        self.close_connection = True
+
+
+def main():
+    global args, audio
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--file", required=True, help="audio file to loop (MP3/AAC/...)")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--name", default="Stand-in", help="icy-name and title prefix")
+    parser.add_argument("--bitrate", type=int, default=128, help="pacing bitrate in kbit/s (should match the file)")
+    parser.add_argument("--metaint", type=int, default=16000, help="ICY metadata interval in bytes")
+    parser.add_argument("--burst-kb", type=int, default=0, help="unpaced data sent right after the headers")
+    parser.add_argument("--connect-delay-ms", type=int, default=0, help="delay before the response headers")
+    parser.add_argument("--jitter-ms", type=int, default=0, help="random extra delay per chunk")
+    parser.add_argument("--stall-every", type=float, default=0, help="stall the stream every N seconds")
+    parser.add_argument("--stall-for", type=float, default=5, help="length of each stall in seconds")
+    parser.add_argument("--drop-after", type=float, default=0, help="close the connection after N seconds")
+    parser.add_argument("--seed", type=int, default=None, help="jitter seed, for repeatable runs")
+    parser.add_argument("--segment-s", type=int, default=6, help="HLS segment length in seconds")
+    parser.add_argument("--segment-format", choices=["ts", "packed"], default="ts", help="HLS segment container")
+    parser.add_argument("--segment-delay-ms", type=int, default=0, help="delay before each HLS segment response")
+    args = parser.parse_args()
+
+    with open(args.file, "rb") as f:
+        audio = f.read()
+    if not audio:
+        parser.error("audio file is empty")
+
+    global hls_start
+    hls_start = time.monotonic() - HLS_WINDOW * args.segment_s  # A full live window from the start
+
+    server = ThreadingHTTPServer((args.host, args.port), StandInHandler)
+    server.daemon_threads = True
+    log("Serving {} at {} kbit/s on port {}".format(args.file, args.bitrate, args.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Time-to-first-audio benchmark for the radio.
+
+Makes the radio connect to a stream URL several times through /play-url and
+reads the start-up timings it records in /audio-stats:
+
+  firstByteMs   connect request to the first audio byte from the station (relay)
+  firstFrameMs  connect request to the first decoded PCM block
+  audibleMs     connect request to the first audible sample
+  underruns     relay buffer underruns while playing for --settle seconds
+
+Run it against icy_standin.py on the same network for numbers that are
+comparable from run to run:
+
+  python3 icy_standin.py --file test.mp3 --seed 1
+  python3 stream_bench.py --device 192.168.1.50 --url http://192.168.1.10:8000/stream --runs 10
+"""
+
+import argparse
+import csv
+import json
+import sys
+import time
+import urllib.request
+
+METRICS = ["firstByteMs", "firstFrameMs", "audibleMs", "underruns"]
+
+
+def get_stats(device):
+    with urllib.request.urlopen("http://{}/audio-stats".format(device), timeout=5) as response:
+        return json.load(response)
+
+
+def play_url(device, url):
+    body = json.dumps({"url": url}).encode("utf-8")
+    request = urllib.request.Request("http://{}/play-url".format(device), data=body,
+                                     headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(request, timeout=5) as response:
+        result = json.load(response)
+    if not result.get("success"):
+        raise RuntimeError(result.get("message", "play-url failed"))
+
+
+def start_count(stats):
+    start = stats["startLatency"]
+    return start["warmCount"] + start["coldCount"]
+
+
+def run_once(device, url, timeout, settle):
+    before = get_stats(device)
+    play_url(device, url)
+
+    deadline = time.monotonic() + timeout
+    while True:
+        time.sleep(0.1)
+        stats = get_stats(device)
+        if start_count(stats) != start_count(before):
+            break
+        if time.monotonic() > deadline:
+            return None
+
+    start = stats["startLatency"]
+    underruns_at_start = stats["buffer"]["underruns"]
+    time.sleep(settle)
+    after = get_stats(device)
+    return {
+        "firstByteMs": start["lastFirstByteMs"] if stats["buffer"]["active"] else None,
+        "firstFrameMs": start["lastFirstFrameMs"],
+        "audibleMs": start["lastMs"],
+        "underruns": after["buffer"]["underruns"] - underruns_at_start,
+    }
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, int(round(p / 100.0 * (len(ordered) - 1))))
+    return ordered[index]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--device", required=True, help="radio IP address or host name")
+    parser.add_argument("--url", required=True, help="stream URL as the radio sees it")
+    parser.add_argument("--runs", type=int, default=10)
+    parser.add_argument("--timeout", type=float, default=20, help="seconds to wait for audio per run")
+    parser.add_argument("--settle", type=float, default=10, help="seconds to play after start, for underruns")
+    parser.add_argument("--csv", help="write per-run results to this file")
+    args = parser.parse_args()
+
+    results = []
+    for run in range(1, args.runs + 1):
+        result = run_once(args.device, args.url, args.timeout, args.settle)
+        if result is None:
+            print("run {:2d}: no audio within {}s".format(run, args.timeout))
+            continue
+        print("run {:2d}: ".format(run) + "  ".join("{}={}".format(m, result[m]) for m in METRICS))
+        results.append(result)
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.DictWriter(f, fieldnames=METRICS)
+            writer.writeheader()
+            writer.writerows(results)
+
+    if not results:
+        print("No successful runs")
+        return 1
+
+    print()
+    print("{:<14}{:>8}{:>8}{:>8}{:>8}".format("metric", "min", "median", "p90", "max"))
+    for metric in METRICS:
+        values = [r[metric] for r in results if r[metric] is not None]
+        if not values:
+            continue
+        print("{:<14}{:>8}{:>8}{:>8}{:>8}".format(metric, min(values), percentile(values, 50),
+                                                  percentile(values, 90), max(values)))
+    print("{} of {} runs started".format(len(results), args.runs))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())